@@ -0,0 +1,33 @@
+#include "../machine.h"
+#include "../devices.h"
+
+//! Rangement dans le port d'écriture de la console, puis lecture de ce port.
+/*!
+ * Le port ne peut pas être lu : avec la console projetée (test_simul -o),
+ * le \c LOAD provoque \c ERR_SEGDATA. Une optimisation qui supprime le
+ * \c LOAD d'une valeur qui vient d'être rangée ne doit pas s'appliquer ici.
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {LOAD, 	 true, 	false, 	1, 	5	}},  // 0
+    {.instr_absolute =  {STORE,  false, false, 	1, 	DEVICE_CONSOLE	}},  // 1
+    {.instr_absolute =  {LOAD, 	 false, false, 	1, 	DEVICE_CONSOLE	}},  // 2
+    {.instr_immediate = {LOAD, 	 true, 	false, 	2, 	0	}},  // 3
+    {.instr_generic =   {HALT,					}},  // 4
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[4] = {
+    0,
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 1;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
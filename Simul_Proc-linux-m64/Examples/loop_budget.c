@@ -0,0 +1,36 @@
+#include "../machine.h"
+
+//! Boucle comptée interrompue par le budget d'instructions.
+/*!
+ * 400000 itérations de 4 instructions : avec le budget de check_simul
+ * (1000000 instructions), l'exécution s'arrête au milieu d'une itération.
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {LOAD, 	 true, 	false, 	2, 	0	}},  // 0
+    {.instr_immediate = {LOAD, 	 true, 	false, 	1, 	400000	}},  // 1
+    {.instr_absolute =  {BRANCH, false, false, 	LE, 	7	}},  // 2: test de sortie
+    {.instr_absolute =  {ADD, 	 false, false, 	2, 	0	}},  // 3
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 4
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	2	}},  // 5
+    {.instr_generic =   {HALT,					}},  // 6
+    {.instr_absolute =  {STORE,  false, false, 	2, 	1	}},  // 7
+    {.instr_generic =   {HALT,					}},  // 8
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[4] = {
+    3,  // 0: ajouté à chaque itération
+    0,  // 1: résultat
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 2;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,53 @@
+#include "../machine.h"
+
+//! Boucles comptées (voir loops.h) qui vont jusqu'au bout.
+/*!
+ * Trois boucles : test de sortie en tête et branchement arrière \c NC ;
+ * branchement arrière \c GE, dont le compteur passe par zéro ; branchement
+ * arrière \c GT avec \c NOP et opérande indexé invariant.
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {LOAD, 	 true, 	false, 	2, 	0	}},  // 0
+    {.instr_immediate = {LOAD, 	 true, 	false, 	1, 	10	}},  // 1
+    {.instr_absolute =  {BRANCH, false, false, 	LE, 	7	}},  // 2: test de sortie
+    {.instr_immediate = {ADD, 	 true, 	false, 	2, 	3	}},  // 3
+    {.instr_absolute =  {ADD, 	 false, false, 	3, 	0	}},  // 4
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 5
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	2	}},  // 6
+    {.instr_immediate = {LOAD, 	 true, 	false, 	4, 	21	}},  // 7
+    {.instr_immediate = {ADD, 	 true, 	false, 	5, 	-2	}},  // 8
+    {.instr_immediate = {SUB, 	 true, 	false, 	4, 	3	}},  // 9
+    {.instr_absolute =  {BRANCH, false, false, 	GE, 	8	}},  // 10
+    {.instr_immediate = {LOAD, 	 true, 	false, 	8, 	7	}},  // 11
+    {.instr_indexed =   {ADD, 	 false, true, 	6, 	7, +1	}},  // 12
+    {.instr_generic =   {NOP,					}},  // 13
+    {.instr_immediate = {SUB, 	 true, 	false, 	8, 	2	}},  // 14
+    {.instr_absolute =  {BRANCH, false, false, 	GT, 	12	}},  // 15
+    {.instr_absolute =  {STORE,  false, false, 	2, 	2	}},  // 16
+    {.instr_absolute =  {STORE,  false, false, 	3, 	3	}},  // 17
+    {.instr_absolute =  {STORE,  false, false, 	5, 	4	}},  // 18
+    {.instr_absolute =  {STORE,  false, false, 	6, 	5	}},  // 19
+    {.instr_generic =   {HALT,					}},  // 20
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[10] = {
+    7,  // 0: ajouté à chaque itération de la première boucle
+    -4, // 1: ajouté à chaque itération de la troisième boucle
+    0,  // 2: résultats
+    0,  // 3
+    0,  // 4
+    0,  // 5
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 6;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,49 @@
+#include "../machine.h"
+
+//! Sous-programme pur dont un appel est interrompu par le budget d'instructions.
+/*!
+ * mult(2, 3) est appelé deux fois (un échec puis un succès de la table),
+ * puis mult(7, 400000), qui dépasse le budget de check_simul (1000000
+ * instructions) : l'exécution s'arrête dans l'appel.
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	2	}},  // 0
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	3	}},  // 1
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	12	}},  // 2
+    {.instr_absolute =  {STORE,  false, false, 	0, 	0	}},  // 3
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	12	}},  // 4
+    {.instr_absolute =  {STORE,  false, false, 	0, 	1	}},  // 5
+    {.instr_immediate = {ADD, 	 true, 	false, 	15, 	2	}},  // 6
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	7	}},  // 7
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	400000	}},  // 8
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	12	}},  // 9
+    {.instr_absolute =  {STORE,  false, false, 	0, 	2	}},  // 10
+    {.instr_generic =   {HALT,					}},  // 11
+    {.instr_indexed =   {LOAD, 	 false, true, 	0, 	15, +3	}},  // 12: mult
+    {.instr_indexed =   {LOAD, 	 false, true, 	1, 	15, +2	}},  // 13
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 14
+    {.instr_absolute =  {BRANCH, false, false, 	LE, 	19	}},  // 15
+    {.instr_indexed =   {ADD, 	 false, true, 	0, 	15, +3	}},  // 16
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 17
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	15	}},  // 18
+    {.instr_generic =   {RET,					}},  // 19
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[12] = {
+    0,  // 0: résultats
+    0,  // 1
+    0,  // 2
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 3;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,58 @@
+#include "../machine.h"
+
+//! Sous-programme pur appelé de nombreuses fois (voir memo.h).
+/*!
+ * À chaque tour, mult(3, 4) est appelé avec les mêmes arguments (un échec
+ * de la table au premier appel, des succès ensuite), puis mult(R09, 5) avec
+ * un argument différent à chaque fois (toujours un échec).
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {LOAD, 	 true, 	false, 	9, 	6	}},  // 0
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	3	}},  // 1
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	4	}},  // 2
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	20	}},  // 3
+    {.instr_immediate = {ADD, 	 true, 	false, 	15, 	2	}},  // 4
+    {.instr_absolute =  {STORE,  false, false, 	0, 	0	}},  // 5
+    {.instr_absolute =  {ADD, 	 false, false, 	10, 	0	}},  // 6
+    {.instr_absolute =  {STORE,  false, false, 	9, 	1	}},  // 7
+    {.instr_absolute =  {PUSH, 	 false, false, 	0, 	1	}},  // 8
+    {.instr_immediate = {PUSH, 	 true, 	false, 	0, 	5	}},  // 9
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	20	}},  // 10
+    {.instr_immediate = {ADD, 	 true, 	false, 	15, 	2	}},  // 11
+    {.instr_absolute =  {STORE,  false, false, 	0, 	0	}},  // 12
+    {.instr_absolute =  {ADD, 	 false, false, 	11, 	0	}},  // 13
+    {.instr_immediate = {SUB, 	 true, 	false, 	9, 	1	}},  // 14
+    {.instr_absolute =  {BRANCH, false, false, 	GT, 	1	}},  // 15
+    {.instr_absolute =  {STORE,  false, false, 	10, 	2	}},  // 16
+    {.instr_absolute =  {STORE,  false, false, 	11, 	3	}},  // 17
+    {.instr_generic =   {HALT,					}},  // 18
+    {.instr_generic =   {NOP,					}},  // 19
+    {.instr_indexed =   {LOAD, 	 false, true, 	0, 	15, +3	}},  // 20: mult
+    {.instr_indexed =   {LOAD, 	 false, true, 	1, 	15, +2	}},  // 21
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 22
+    {.instr_absolute =  {BRANCH, false, false, 	LE, 	27	}},  // 23
+    {.instr_indexed =   {ADD, 	 false, true, 	0, 	15, +3	}},  // 24
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	1	}},  // 25
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	23	}},  // 26
+    {.instr_generic =   {RET,					}},  // 27
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[20] = {
+    0,  // 0: résultat du dernier appel
+    0,  // 1: argument variable
+    0,  // 2: somme des mult(3, 4)
+    0,  // 3: somme des mult(R09, 5)
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 4;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,54 @@
+#include "../machine.h"
+
+//! Programme où s'appliquent les réécritures de l'optimiseur (voir peephole.h).
+/*!
+ * Opérations immédiates fusionnées (0 à 2), relecture après écriture
+ * supprimée (4), branchement enchaîné (6 vers 8 puis 10), code inaccessible
+ * (7, 9) et branchement vers l'instruction suivante (13). La boucle ajoute
+ * trois fois 12 à R03 : R03 = data[1] = 36.
+ *
+ * Les deux dernières instructions, des NOP, sont supprimées alors que le
+ * BRANCH (jamais pris) et le CALL y mènent : le CALL doit empiler son
+ * adresse de retour avant que l'exécution ne sorte du texte (ERR_SEGTEXT),
+ * dans le programme optimisé comme dans l'original.
+ */
+
+Instruction text[] = {
+//  type                cop     imm	    ind  regcond operand
+//-------------------------------------------------------------
+    {.instr_immediate = {LOAD, 	 true, 	false, 	1, 	10	}},  // 0
+    {.instr_immediate = {ADD, 	 true, 	false, 	1, 	5	}},  // 1
+    {.instr_immediate = {SUB, 	 true, 	false, 	1, 	3	}},  // 2
+    {.instr_absolute =  {STORE,  false, false, 	1, 	0	}},  // 3
+    {.instr_absolute =  {LOAD, 	 false, false, 	1, 	0	}},  // 4
+    {.instr_immediate = {LOAD, 	 true, 	false, 	2, 	3	}},  // 5
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	8	}},  // 6
+    {.instr_generic =   {HALT,					}},  // 7
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	10	}},  // 8
+    {.instr_generic =   {NOP,					}},  // 9
+    {.instr_absolute =  {ADD, 	 false, false, 	3, 	0	}},  // 10
+    {.instr_immediate = {SUB, 	 true, 	false, 	2, 	1	}},  // 11
+    {.instr_absolute =  {BRANCH, false, false, 	GT, 	10	}},  // 12
+    {.instr_absolute =  {BRANCH, false, false, 	NC, 	14	}},  // 13
+    {.instr_absolute =  {STORE,  false, false, 	3, 	1	}},  // 14
+    {.instr_absolute =  {BRANCH, false, false, 	LT, 	18	}},  // 15
+    {.instr_absolute =  {CALL, 	 false, false, 	NC, 	19	}},  // 16
+    {.instr_generic =   {HALT,					}},  // 17
+    {.instr_generic =   {NOP,					}},  // 18
+    {.instr_generic =   {NOP,					}},  // 19
+};
+
+//! Taille utile du programme
+const unsigned textsize = sizeof(text) / sizeof(Instruction);
+
+//! Segment de données initial
+Word data[20] = {
+    0,  // 0: valeur écrite puis relue
+    0,  // 1: somme
+};
+
+//! Fin de la zone de données utile
+const unsigned dataend = 2;
+
+//! Taille utile du segment de données
+const unsigned datasize = sizeof(data) / sizeof(Word);
@@ -0,0 +1,317 @@
+/***** aot.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "aot.h"
+#include "imgcache.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+//! Compilateur C utilisé par aot_compile() (fixé par le Makefile)
+#ifndef AOT_CC
+#define AOT_CC "cc"
+#endif
+
+//! Répertoire des en-têtes du simulateur (fixé par le Makefile)
+#ifndef AOT_INCLUDE
+#define AOT_INCLUDE "."
+#endif
+
+struct Aot_Program
+{
+    void *handle;		//!< Objet partagé (dlopen())
+    Aot_Entry *entry;		//!< Fonction traduite
+};
+
+//! Test du code condition pour chaque condition (voir check_condition())
+static const char *condition_tests[] = {
+	"1", "cc == CC_Z", "cc != CC_Z", "cc == CC_P", "cc != CC_N", "cc == CC_N", "cc != CC_P"
+};
+
+/*!
+ * Adresse de données désignée par une instruction (voir
+ * get_instruction_address()) : range dans \c a l'adresse, vérifiée.
+ */
+static void emit_address(const Machine *pmach, Instruction instr, unsigned k, FILE *out) {
+	if (instr.instr_generic._indexed) {
+		fprintf(out, "\t\ta = (int) (r[%u] + %d);\n", instr.instr_indexed._rindex, instr.instr_indexed._offset);
+		fprintf(out, "\t\tif (a < 0 || (unsigned) a >= DATASIZE) FAULT(ERR_SEGDATA, %u);\n", k);
+	} else if (instr.instr_absolute._address >= pmach->_datasize) {
+		fprintf(out, "\t\tFAULT(ERR_SEGDATA, %u);\n", k);
+	} else {
+		fprintf(out, "\t\ta = %u;\n", instr.instr_absolute._address);
+	}
+}
+
+/*!
+ * Opérande d'une instruction (voir get_instruction_value()) : range sa
+ * valeur dans \c v.
+ */
+static void emit_value(const Machine *pmach, Instruction instr, unsigned k, FILE *out) {
+	if (instr.instr_generic._immediate) {
+		fprintf(out, "\t\tv = %d;\n", instr.instr_immediate._value);
+	} else {
+		emit_address(pmach, instr, k, out);
+		fprintf(out, "\t\tv = d[a];\n");
+	}
+}
+
+
+/*!
+ * Traduction d'une instruction (voir decode_execute()).
+ */
+static void emit_instruction(const Machine *pmach, unsigned k, FILE *out) {
+	Instruction instr = pmach->_text[k];
+	Code_Op cop = instr.instr_generic._cop;
+	unsigned reg = instr.instr_generic._regcond;
+
+	fprintf(out, "L%u:\t/* %s */\n\tSTEP(%u);\n\t{\n", k, cop <= LAST_COP ? cop_names[cop] : "???", k);
+	switch (cop) {
+		case ILLOP:
+			fprintf(out, "\t\tFAULT(ERR_ILLEGAL, %u);\n", k);
+			break;
+		case NOP:
+			break;
+
+		case LOAD:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tr[%u] = v;\n\t\tCC(v);\n", reg);
+			break;
+		case STORE:
+			if (instr.instr_generic._immediate) {
+				fprintf(out, "\t\tFAULT(ERR_IMMEDIATE, %u);\n", k);
+				break;
+			}
+			emit_address(pmach, instr, k, out);
+			fprintf(out, "\t\td[a] = r[%u];\n", reg);
+			break;
+		case ADD:
+		case SUB:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tr[%u] %s= v;\n\t\tCC(r[%u]);\n", reg, cop == ADD ? "+" : "-", reg);
+			break;
+
+		case MUL:
+		case AND:
+		case OR:
+		case XOR:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tr[%u] %s= v;\n\t\tCC(r[%u]);\n", reg,
+				cop == MUL ? "*" : cop == AND ? "&" : cop == OR ? "|" : "^", reg);
+			break;
+		case SHL:
+		case SHR:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tr[%u] %s= v & 31;\n\t\tCC(r[%u]);\n", reg, cop == SHL ? "<<" : ">>", reg);
+			break;
+		case DIV:
+		case MOD:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tif (v == 0)\n\t\t\tFAULT(ERR_DIVZERO, %u);\n", k);
+			if (cop == DIV)
+				fprintf(out, "\t\tr[%u] = (int32_t) v == -1 ? 0 - r[%u] : (Word) ((int32_t) r[%u] / (int32_t) v);\n",
+					reg, reg, reg);
+			else
+				fprintf(out, "\t\tr[%u] = (int32_t) v == -1 ? 0 : (Word) ((int32_t) r[%u] %% (int32_t) v);\n",
+					reg, reg);
+			fprintf(out, "\t\tCC(r[%u]);\n", reg);
+			break;
+
+		case MOVE:
+		case FILL:
+			// Même vérification de toute la plage que check_data_range()
+			fprintf(out, "\t\tWord dst = r[%u], src = r[%u], cnt = r[%u];\n",
+				reg, (reg + 1) % NREGISTERS, (reg + 2) % NREGISTERS);
+			fprintf(out, "\t\tif (cnt != 0) {\n");
+			if (cop == MOVE)
+				fprintf(out, "\t\t\tif (src >= DATASIZE || cnt > DATASIZE - src)\n\t\t\t\tFAULT(ERR_SEGDATA, %u);\n", k);
+			fprintf(out, "\t\t\tif (dst >= DATASIZE || cnt > DATASIZE - dst)\n\t\t\t\tFAULT(ERR_SEGDATA, %u);\n", k);
+			if (cop == MOVE)
+				fprintf(out, "\t\t\tmemmove(d + dst, d + src, cnt * sizeof(Word));\n");
+			else
+				fprintf(out, "\t\t\tfor (Word i = 0; i < cnt; i++)\n\t\t\t\td[dst + i] = src;\n");
+			fprintf(out, "\t\t}\n");
+			break;
+
+		case BRANCH:
+		case CALL:
+			if (instr.instr_generic._immediate) {
+				fprintf(out, "\t\tFAULT(ERR_IMMEDIATE, %u);\n", k);
+				break;
+			}
+			if (reg > LAST_CONDITION) {
+				fprintf(out, "\t\tFAULT(ERR_CONDITION, %u);\n", k);
+				break;
+			}
+			fprintf(out, "\t\tif (%s) {\n", condition_tests[reg]);
+			// Destination hors du segment de texte : erreur avant l'empilement
+			if (instr.instr_absolute._address >= pmach->_textsize)
+				fprintf(out, "\t\t\tFAULT(ERR_SEGTEXT, %u);\n", k);
+			else {
+				if (cop == CALL)
+					fprintf(out, "\t\t\tPUSH(%u, %u);\n", k + 1, k);
+				fprintf(out, "\t\t\tgoto L%u;\n", instr.instr_absolute._address);
+			}
+			fprintf(out, "\t\t}\n");
+			break;
+		case RET:
+			fprintf(out, "\t\tPOP(pc, %u);\n\t\tgoto dispatch;\n", k);
+			break;
+		case PUSH:
+			emit_value(pmach, instr, k, out);
+			fprintf(out, "\t\tPUSH(v, %u);\n", k);
+			break;
+		case POP:
+			if (instr.instr_generic._immediate) {
+				fprintf(out, "\t\tFAULT(ERR_IMMEDIATE, %u);\n", k);
+				break;
+			}
+			emit_address(pmach, instr, k, out);
+			fprintf(out, "\t\tPOP(d[a], %u);\n", k);
+			break;
+
+		case HALT:
+			fprintf(out, "\t\tpc = %u;\n\t\tgoto halt;\n", k + 1);
+			break;
+		default:
+			fprintf(out, "\t\tFAULT(ERR_UNKNOWN, %u);\n", k);
+	}
+	fprintf(out, "\t}\n");
+}
+
+void aot_translate(const Machine *pmach, FILE *out) {
+	unsigned n = pmach->_textsize;
+	fprintf(out,
+		"/* Produit par aot_translate() : ne pas modifier */\n"
+		"#include <string.h>\n"
+		"#include \"machine.h\"\n"
+		"#include \"aot.h\"\n\n"
+		"#define TEXTSIZE %uu\n#define DATASIZE %uu\n#define DATAEND %uu\n\n"
+		"const Aot_Image aot_image = {%d, TEXTSIZE, DATASIZE, DATAEND, 0x%016llxULL};\n\n",
+		n, pmach->_datasize, pmach->_dataend, AOT_VERSION,
+		(unsigned long long) cache_hash(pmach->_text, (uint64_t) n * sizeof(Instruction)));
+
+	// Mêmes vérifications, dans le même ordre, que exec.c et simul_run()
+	fprintf(out,
+		"#define CC(x) (cc = (int) (x) == 0 ? CC_Z : (int) (x) < 0 ? CC_N : CC_P)\n"
+		"#define STEP(k) if (ic >= end) { pc = (k); goto budget; } ic++\n"
+		"#define FAULT(e, k) do { pc = (k) + 1; err = (e); eaddr = (k); goto fault; } while (0)\n"
+		"#define SPCHECK(k) if (r[15] >= DATASIZE || r[15] < DATAEND) FAULT(ERR_SEGSTACK, k)\n"
+		"#define PUSH(x, k) do { SPCHECK(k); d[r[15]--] = (x); SPCHECK(k); } while (0)\n"
+		"#define POP(x, k) do { r[15]++; SPCHECK(k); (x) = d[r[15]]; } while (0)\n\n");
+
+	fprintf(out,
+		"Run_Status aot_entry(Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr) {\n"
+		"\tWord *const d = pmach->_data;\n"
+		"\tWord r[NREGISTERS];\n"
+		"\tmemcpy(r, pmach->_registers, sizeof(r));\n"
+		"\tCondition_Code cc = pmach->_cc;\n"
+		"\tunsigned pc = pmach->_pc;\n"
+		"\tuint64_t ic = pmach->_icount;\n"
+		"\tuint64_t end = budget > UINT64_MAX - ic ? UINT64_MAX : ic + budget;\n"
+		"\tRun_Status status;\n"
+		"\tError err;\n"
+		"\tunsigned eaddr;\n"
+		"\tint a;\n"
+		"\tWord v;\n"
+		"\t(void) a;\n"
+		"\t(void) v;\n\n");
+
+	fprintf(out, "dispatch:\n\tswitch (pc) {\n");
+	for (unsigned k = 0; k < n; k++)
+		fprintf(out, "\t\tcase %u: goto L%u;\n", k, k);
+	fprintf(out, "\t\tdefault: goto outside;\n\t}\n\n");
+
+	for (unsigned k = 0; k < n; k++)
+		emit_instruction(pmach, k, out);
+
+	fprintf(out,
+		"L%u:\n"
+		"\tpc = %u;\n"
+		"outside:\n"
+		"\tif (ic >= end)\n\t\tgoto budget;\n"
+		"\terr = ERR_SEGTEXT;\n"
+		"\teaddr = pc - 1;\n"
+		"fault:\n"
+		"\t*perr = err;\n"
+		"\t*paddr = eaddr;\n"
+		"\tstatus = RUN_ERROR;\n"
+		"\tgoto out;\n"
+		"budget:\n"
+		"\tstatus = RUN_BUDGET;\n"
+		"\tgoto out;\n"
+		"halt:\n"
+		"\tstatus = RUN_HALT;\n"
+		"out:\n"
+		"\tmemcpy(pmach->_registers, r, sizeof(r));\n"
+		"\tpmach->_cc = cc;\n"
+		"\tpmach->_pc = pc;\n"
+		"\tpmach->_icount = ic;\n"
+		"\treturn status;\n"
+		"}\n", n, n);
+}
+
+bool aot_compile(const char *cfile, const char *sofile) {
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return false;
+	}
+	if (pid == 0) {
+		execlp(AOT_CC, AOT_CC, "-std=c99", "-O2", "-fPIC", "-shared", "-w",
+		       "-I", AOT_INCLUDE, "-o", sofile, cfile, (char *) NULL);
+		perror(AOT_CC);
+		_exit(127);
+	}
+	int status;
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "Compilation of %s failed\n", cfile);
+		return false;
+	}
+	return true;
+}
+
+Aot_Program *aot_load(const char *sofile, const Machine *pmach) {
+	// dlopen() ne cherche dans le répertoire courant que si le nom contient '/'
+	char path[4096];
+	snprintf(path, sizeof(path), "%s%s", strchr(sofile, '/') ? "" : "./", sofile);
+	void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (handle == NULL) {
+		fprintf(stderr, "Cannot load %s: %s\n", sofile, dlerror());
+		return NULL;
+	}
+	const Aot_Image *pimg = dlsym(handle, "aot_image");
+	Aot_Entry *entry;
+	*(void **) &entry = dlsym(handle, "aot_entry");
+	if (pimg == NULL || entry == NULL) {
+		fprintf(stderr, "%s is not a translated program\n", sofile);
+		dlclose(handle);
+		return NULL;
+	}
+	uint64_t hash = cache_hash(pmach->_text, (uint64_t) pmach->_textsize * sizeof(Instruction));
+	if (pimg->_version != AOT_VERSION || pimg->_textsize != pmach->_textsize
+	    || pimg->_datasize != pmach->_datasize || pimg->_dataend != pmach->_dataend
+	    || pimg->_hash != hash) {
+		fprintf(stderr, "%s was not translated from this program\n", sofile);
+		dlclose(handle);
+		return NULL;
+	}
+
+	Aot_Program *pa = checked_realloc(NULL, sizeof(Aot_Program), "le programme traduit");
+	pa->handle = handle;
+	pa->entry = entry;
+	return pa;
+}
+
+Run_Status aot_run(Aot_Program *pa, Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr) {
+	return pa->entry(pmach, budget, perr, paddr);
+}
+
+void aot_unload(Aot_Program *pa) {
+	dlclose(pa->handle);
+	free(pa);
+}
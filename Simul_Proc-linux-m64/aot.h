@@ -0,0 +1,94 @@
+#ifndef _AOT_H_
+#define _AOT_H_
+
+/*!
+ * \file aot.h
+ * \brief Traduction anticipée des programmes binaires en C.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "machine.h"
+
+//! Version du code produit par aot_translate()
+/*!
+ * À incrémenter à chaque modification du code produit ou de la structure
+ * \c Machine : les objets partagés d'une autre version sont refusés.
+ */
+#define AOT_VERSION 8
+
+//! Description de l'image traduite, exportée par l'objet partagé
+typedef struct
+{
+    uint32_t _version;		//!< \c AOT_VERSION
+    uint32_t _textsize;		//!< Taille du segment de texte
+    uint32_t _datasize;		//!< Taille du segment de données
+    uint32_t _dataend;		//!< Première adresse libre après les données statiques
+    uint64_t _hash;		//!< Hachage du segment de texte (voir cache_hash())
+} Aot_Image;
+
+//! Point d'entrée exporté par l'objet partagé (même contrat que simul_run())
+typedef Run_Status Aot_Entry(Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr);
+
+//! Programme traduit chargé en mémoire
+typedef struct Aot_Program Aot_Program;
+
+//! Traduction d'un programme en C
+/*!
+ * Le fichier produit définit \c aot_image (un \c Aot_Image) et \c aot_entry
+ * (un \c Aot_Entry). Chaque adresse du segment de texte devient une
+ * étiquette ; \c BRANCH et \c CALL deviennent des \c goto, \c RET un \c switch
+ * sur l'adresse de retour dépilée. Registres, code condition et compteur
+ * d'instructions sont des variables locales, recopiées dans la machine à la
+ * sortie. Les erreurs sont celles de simul_run(), au même endroit et dans le
+ * même état de la machine.
+ *
+ * Seul le segment de texte est figé dans le code produit : le segment de
+ * données initial peut varier d'une exécution à l'autre (mais pas sa taille).
+ *
+ * \param pmach la machine (programme chargé)
+ * \param out le flot de sortie
+ */
+void aot_translate(const Machine *pmach, FILE *out);
+
+//! Compilation d'une traduction en objet partagé
+/*!
+ * Le compilateur C du simulateur est lancé sur \a cfile.
+ *
+ * \param cfile le fichier C produit par aot_translate()
+ * \param sofile l'objet partagé à produire
+ * \return vrai si la compilation a réussi
+ */
+bool aot_compile(const char *cfile, const char *sofile);
+
+//! Chargement d'un objet partagé
+/*!
+ * L'objet doit avoir été produit à partir du même segment de texte (et des
+ * mêmes tailles) que le programme chargé dans \a pmach.
+ *
+ * \param sofile l'objet partagé
+ * \param pmach la machine (programme chargé)
+ * \return le programme traduit, ou NULL (avec un message) en cas d'échec
+ */
+Aot_Program *aot_load(const char *sofile, const Machine *pmach);
+
+//! Exécution d'un programme traduit
+/*!
+ * Même contrat que simul_run(). Les crochets éventuellement enregistrés
+ * dans la machine (voir hooks.h) ne sont pas appelés.
+ *
+ * \param pa le programme traduit
+ * \param pmach la machine (programme chargé par aot_load())
+ * \param budget nombre maximal d'instructions à exécuter
+ * \param perr code de l'erreur si le résultat est \c RUN_ERROR
+ * \param paddr adresse de l'erreur si le résultat est \c RUN_ERROR
+ * \return l'issue de l'exécution
+ */
+Run_Status aot_run(Aot_Program *pa, Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr);
+
+//! Déchargement d'un programme traduit
+void aot_unload(Aot_Program *pa);
+
+#endif
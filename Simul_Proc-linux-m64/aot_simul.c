@@ -0,0 +1,173 @@
+/*!
+ * \file aot_simul.c
+ * \brief Traduction anticipée d'un programme binaire en objet partagé
+ *
+ * Le programme (format de read_program()) est traduit en C (voir aot.h),
+ * compilé en objet partagé par le compilateur C du système, puis exécuté en
+ * chargeant cet objet. Les trois étapes peuvent être séparées : l'objet
+ * partagé se réutilise tant que le segment de texte ne change pas.
+ *
+ * Avec l'option \c -c, le programme est aussi exécuté par simul_run() et les
+ * deux résultats (et les durées) sont comparés.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "machine.h"
+#include "aot.h"
+#include "telemetry.h"
+
+//! Noms des issues d'exécution
+static const char *status_names[] = {"halt", "error", "budget"};
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: aot_simul [options] prog.bin\n"
+	       "where options are:\n"
+	       "\t-o file.c\tWrite the C translation of the program\n"
+	       "\t-s file.so\tTranslate and compile into a shared object\n"
+	       "\t-r file.so\tRun the program with a compiled shared object\n"
+	       "\t-n n\t\tInstruction budget (default: 1000000000)\n"
+	       "\t-c\t\tCheck the run against the interpreter\n"
+	       "\t-h\t\tprint this help message\n");
+}
+
+//! Traduction du programme dans le fichier \a cfile
+static void translate(Machine *pmach, const char *cfile) {
+	FILE *out = fopen(cfile, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Cannot create %s\n", cfile);
+		exit(EXIT_FAILURE);
+	}
+	aot_translate(pmach, out);
+	if (fclose(out) != 0) {
+		fprintf(stderr, "Cannot write %s\n", cfile);
+		exit(EXIT_FAILURE);
+	}
+}
+
+//! Affichage de l'issue d'une exécution
+static void print_status(const char *who, Run_Status status, Error err, unsigned addr,
+                         Machine *pmach, double t) {
+	printf("%s: %s", who, status_names[status]);
+	if (status == RUN_ERROR)
+		printf(" (error %d at 0x%04x)", err, addr);
+	printf(", %llu instructions in %.6f s, PC = 0x%04x, CC = %d\n",
+	       (unsigned long long) pmach->_icount, t, pmach->_pc, pmach->_cc);
+}
+
+int main(int argc, char *argv[]) {
+	const char *cfile = NULL, *sofile = NULL, *runfile = NULL;
+	uint64_t budget = 1000000000;
+	bool check = false;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'c') {
+			check = true;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("osrn", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'o': cfile = val; break;
+			case 's': sofile = val; break;
+			case 'r': runfile = val; break;
+			case 'n': budget = strtoull(val, NULL, 10); break;
+		}
+	}
+	if (iarg + 1 != argc || (cfile == NULL && sofile == NULL && runfile == NULL)) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	Machine mach;
+	read_program(&mach, argv[iarg]);
+
+	// Copie du programme initial pour la vérification (read_program() alloue)
+	Word *initial = malloc(mach._datasize * sizeof(Word) + 1);
+	if (initial == NULL) {
+		fprintf(stderr, "Erreur d'allocation mémoire\n");
+		return EXIT_FAILURE;
+	}
+	memcpy(initial, mach._data, mach._datasize * sizeof(Word));
+
+	if (cfile != NULL)
+		translate(&mach, cfile);
+	if (sofile != NULL) {
+		// Sans -o, la traduction passe par un répertoire temporaire
+		char dir[] = "/tmp/aot_simulXXXXXX", tmp[sizeof(dir) + 8];
+		const char *src = cfile;
+		if (src == NULL) {
+			if (mkdtemp(dir) == NULL) {
+				perror("mkdtemp");
+				return EXIT_FAILURE;
+			}
+			snprintf(tmp, sizeof(tmp), "%s/prog.c", dir);
+			translate(&mach, tmp);
+			src = tmp;
+		}
+		bool ok = aot_compile(src, sofile);
+		if (src == tmp) {
+			unlink(tmp);
+			rmdir(dir);
+		}
+		if (!ok)
+			return EXIT_FAILURE;
+	}
+	if (runfile == NULL)
+		return EXIT_SUCCESS;
+
+	Aot_Program *pa = aot_load(runfile, &mach);
+	if (pa == NULL)
+		return EXIT_FAILURE;
+
+	Error err = ERR_NOERROR;
+	unsigned addr = 0;
+	double t0 = telemetry_now_ns() * 1e-9;
+	Run_Status status = aot_run(pa, &mach, budget, &err, &addr);
+	double taot = telemetry_now_ns() * 1e-9 - t0;
+	print_status("aot", status, err, addr, &mach, taot);
+
+	int result = EXIT_SUCCESS;
+	if (check) {
+		Machine ref;
+		Error rerr = ERR_NOERROR;
+		unsigned raddr = 0;
+		load_program(&ref, mach._textsize, mach._text, mach._datasize, initial, mach._dataend);
+		t0 = telemetry_now_ns() * 1e-9;
+		Run_Status rstatus = simul_run(&ref, budget, &rerr, &raddr);
+		double tref = telemetry_now_ns() * 1e-9 - t0;
+		print_status("interpreter", rstatus, rerr, raddr, &ref, tref);
+
+		bool same = status == rstatus && mach._pc == ref._pc && mach._cc == ref._cc
+			&& mach._icount == ref._icount
+			&& memcmp(mach._registers, ref._registers, sizeof(mach._registers)) == 0
+			&& memcmp(mach._data, ref._data, mach._datasize * sizeof(Word)) == 0
+			&& (status != RUN_ERROR || (err == rerr && addr == raddr));
+		printf("check: %s (speedup %.2fx)\n", same ? "same state" : "MISMATCH", tref / taot);
+		if (!same)
+			result = EXIT_FAILURE;
+	} else {
+		print_cpu(&mach);
+		print_data(&mach);
+	}
+
+	aot_unload(pa);
+	free(initial);
+	return result;
+}
@@ -0,0 +1,799 @@
+/***** batch.c *****/
+#include "batch.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Les boucles sur les voies sont écrites pour être vectorisées par le
+ * compilateur (ce fichier est compilé avec -O3). Avec gcc sous Linux x86-64,
+ * les noyaux sont compilés en deux versions, AVX2 et générique, choisies à
+ * l'exécution selon le processeur.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define BATCH_SIMD __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH_SIMD
+#endif
+
+//! Issue d'une instruction pour une voie (\c _flag)
+enum
+{
+    LANE_NEXT = 0,	//!< La voie passe à l'instruction suivante
+    LANE_TAKEN,		//!< La voie se branche (destination dans \c _pc)
+    LANE_HALT,		//!< La voie a exécuté \c HALT
+    LANE_BUDGET,	//!< Le budget de la voie est épuisé
+    LANE_ERROR,		//!< Erreur d'exécution : \c LANE_ERROR + code d'erreur
+};
+
+//! Registres \a r de tous les emplacements
+#define REG(pb, r) ((pb)->_regs + (size_t) (r) * (pb)->_lanes)
+
+/*======================================
+ *
+ *		NOYAUX VECTORIELS
+ *======================================
+ */
+
+//! Code condition correspondant au signe d'une valeur (voir update_cc())
+static inline int32_t sign_cc(Word v) {
+	int32_t x = (int32_t) v;
+	return x == 0 ? CC_Z : (x < 0 ? CC_N : CC_P);
+}
+
+/*!
+ * LOAD, ADD ou SUB d'une valeur immédiate (SUB : \a v est déjà opposée).
+ */
+BATCH_SIMD static void alu_imm(Word *restrict reg, int32_t *restrict cc, unsigned n, Word v, bool add) {
+	if (add)
+		for (unsigned i = 0; i < n; i++) {
+			reg[i] += v;
+			cc[i] = sign_cc(reg[i]);
+		}
+	else
+		for (unsigned i = 0; i < n; i++) {
+			reg[i] = v;
+			cc[i] = sign_cc(v);
+		}
+}
+
+/*!
+ * LOAD, ADD ou SUB d'opérandes propres à chaque voie, pour les seules voies
+ * sans erreur.
+ */
+BATCH_SIMD static void alu_vec(Word *restrict reg, int32_t *restrict cc, const Word *restrict val,
+                               const uint8_t *restrict flag, unsigned n, bool add, bool neg) {
+	for (unsigned i = 0; i < n; i++) {
+		Word v = neg ? -val[i] : val[i];
+		Word r = add ? reg[i] + v : v;
+		bool ok = flag[i] == LANE_NEXT;
+		reg[i] = ok ? r : reg[i];
+		cc[i] = ok ? sign_cc(r) : cc[i];
+	}
+}
+
+/*!
+ * MUL, AND, OR, XOR, SHL ou SHR d'opérandes propres à chaque voie, pour les
+ * seules voies sans erreur.
+ */
+BATCH_SIMD static void logic_vec(Word *restrict reg, int32_t *restrict cc, const Word *restrict val,
+                                 const uint8_t *restrict flag, unsigned n, Code_Op cop) {
+#define LANES(expr) \
+	for (unsigned i = 0; i < n; i++) { \
+		Word r = (expr); \
+		bool ok = flag[i] == LANE_NEXT; \
+		reg[i] = ok ? r : reg[i]; \
+		cc[i] = ok ? sign_cc(r) : cc[i]; \
+	}
+	switch (cop) {
+		case MUL: LANES(reg[i] * val[i]); break;
+		case AND: LANES(reg[i] & val[i]); break;
+		case OR:  LANES(reg[i] | val[i]); break;
+		case XOR: LANES(reg[i] ^ val[i]); break;
+		case SHL: LANES(reg[i] << (val[i] & 31)); break;
+		case SHR: LANES(reg[i] >> (val[i] & 31)); break;
+		default: break;
+	}
+#undef LANES
+}
+
+/*!
+ * DIV ou MOD (voir process_div()) pour les seules voies sans erreur ; un
+ * diviseur nul met la voie en erreur.
+ */
+static void div_vec(Word *restrict reg, int32_t *restrict cc, const Word *restrict val,
+                    uint8_t *restrict flag, unsigned n, bool mod) {
+	for (unsigned i = 0; i < n; i++) {
+		if (flag[i] != LANE_NEXT)
+			continue;
+		int32_t v = (int32_t) val[i];
+		if (v == 0) {
+			flag[i] = LANE_ERROR + ERR_DIVZERO;
+			continue;
+		}
+		Word r = v == -1 ? (mod ? 0 : 0 - reg[i])
+			: (Word) (mod ? (int32_t) reg[i] % v : (int32_t) reg[i] / v);
+		reg[i] = r;
+		cc[i] = sign_cc(r);
+	}
+}
+
+/*!
+ * Lecture du mot d'adresse \a addr dans le segment de données de chaque voie.
+ */
+BATCH_SIMD static void gather_abs(Word *restrict out, const Word *restrict data,
+                                  const unsigned *restrict base, unsigned n, unsigned addr) {
+	for (unsigned i = 0; i < n; i++)
+		out[i] = data[base[i] + addr];
+}
+
+/*!
+ * Adresses indexées (registre + déplacement) et leur vérification ; une
+ * adresse invalide est remplacée par 0 et la voie est en erreur.
+ */
+BATCH_SIMD static void index_addr(Word *restrict out, uint8_t *restrict flag, const Word *restrict ri,
+                                  unsigned n, int32_t offset, unsigned datasize) {
+	for (unsigned i = 0; i < n; i++) {
+		int32_t a = (int32_t) (ri[i] + offset);
+		bool bad = a < 0 || (unsigned) a >= datasize;
+		flag[i] = bad ? LANE_ERROR + ERR_SEGDATA : LANE_NEXT;
+		out[i] = bad ? 0 : (Word) a;
+	}
+}
+
+/*!
+ * Lecture des mots dont les adresses sont dans \a inout, remplacées par
+ * leur contenu.
+ */
+BATCH_SIMD static void gather_idx(Word *restrict inout, const Word *restrict data,
+                                  const unsigned *restrict base, unsigned n) {
+	for (unsigned i = 0; i < n; i++)
+		inout[i] = data[base[i] + inout[i]];
+}
+
+/*!
+ * Évaluation d'une condition (valide) sur le code condition de chaque voie.
+ */
+BATCH_SIMD static void cond_flags(uint8_t *restrict flag, const int32_t *restrict cc, unsigned n,
+                                  unsigned cond) {
+	switch (cond) {
+		case NC: for (unsigned i = 0; i < n; i++) flag[i] = LANE_TAKEN; break;
+		case EQ: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] == CC_Z ? LANE_TAKEN : LANE_NEXT; break;
+		case NE: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] != CC_Z ? LANE_TAKEN : LANE_NEXT; break;
+		case GT: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] == CC_P ? LANE_TAKEN : LANE_NEXT; break;
+		case GE: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] != CC_N ? LANE_TAKEN : LANE_NEXT; break;
+		case LT: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] == CC_N ? LANE_TAKEN : LANE_NEXT; break;
+		case LE: for (unsigned i = 0; i < n; i++) flag[i] = cc[i] != CC_P ? LANE_TAKEN : LANE_NEXT; break;
+	}
+}
+
+/*!
+ * Épuisement du budget : marque les voies concernées.
+ *
+ * \return le nombre de voies dont le budget est épuisé
+ */
+BATCH_SIMD static unsigned budget_flags(uint8_t *restrict flag, const uint64_t *restrict icount,
+                                        unsigned n, uint64_t budget) {
+	unsigned over = 0;
+	for (unsigned i = 0; i < n; i++) {
+		bool b = icount[i] >= budget;
+		flag[i] = b ? LANE_BUDGET : LANE_NEXT;
+		over += b;
+	}
+	return over;
+}
+
+BATCH_SIMD static void count_instruction(uint64_t *restrict icount, unsigned n) {
+	for (unsigned i = 0; i < n; i++)
+		icount[i]++;
+}
+
+/*!
+ * Toutes les voies passent-elles à l'instruction suivante ?
+ */
+BATCH_SIMD static bool all_next(const uint8_t *restrict flag, unsigned n) {
+	uint8_t any = 0;
+	for (unsigned i = 0; i < n; i++)
+		any |= flag[i];
+	return any == LANE_NEXT;
+}
+
+static void fill(Word *out, unsigned n, Word v) {
+	for (unsigned i = 0; i < n; i++)
+		out[i] = v;
+}
+
+/*======================================
+ *
+ *		GROUPES
+ *======================================
+ */
+
+/*!
+ * Échange de deux emplacements (tout l'état par emplacement).
+ */
+static void swap_slots(Batch *pb, unsigned i, unsigned j) {
+#define SWAP(a) do { __typeof__(a[0]) t = a[i]; a[i] = a[j]; a[j] = t; } while (0)
+	for (int r = 0; r < NREGISTERS; r++) {
+		Word *reg = REG(pb, r);
+		SWAP(reg);
+	}
+	SWAP(pb->_cc);
+	SWAP(pb->_pc);
+	SWAP(pb->_icount);
+	SWAP(pb->_lane);
+	SWAP(pb->_base);
+	SWAP(pb->_flag);
+	SWAP(pb->_tmp);
+#undef SWAP
+}
+
+/*!
+ * Partition des emplacements [lo, hi) : ceux qui vérifient \a left d'abord.
+ * Seuls les emplacements mal placés sont échangés, si bien qu'une partition
+ * presque faite (quelques voies qui divergent) coûte peu.
+ *
+ * \return le premier emplacement qui ne vérifie pas \a left
+ */
+static unsigned split(Batch *pb, unsigned lo, unsigned hi,
+                      bool (*left)(const Batch *, unsigned, unsigned), unsigned value) {
+	for (;;) {
+		while (lo < hi && left(pb, lo, value))
+			lo++;
+		while (lo < hi && !left(pb, hi - 1, value))
+			hi--;
+		if (lo >= hi)
+			return lo;
+		swap_slots(pb, lo++, --hi);
+	}
+}
+
+static bool running(const Batch *pb, unsigned s, unsigned value) {
+	return pb->_flag[s] <= LANE_TAKEN;
+}
+
+static bool sequential(const Batch *pb, unsigned s, unsigned value) {
+	return pb->_flag[s] == LANE_NEXT;
+}
+
+static bool within_budget(const Batch *pb, unsigned s, unsigned value) {
+	return pb->_flag[s] != LANE_BUDGET;
+}
+
+static bool branch_to(const Batch *pb, unsigned s, unsigned target) {
+	return pb->_pc[s] == target;
+}
+
+static void add_group(Batch *pb, unsigned lo, unsigned hi, unsigned pc) {
+	if (pb->_ngroups == pb->_maxgroups) {
+		pb->_maxgroups = 2 * pb->_maxgroups;
+		pb->_groups = checked_realloc(pb->_groups, pb->_maxgroups * sizeof(Batch_Group),
+					      "le lot de machines");
+	}
+	pb->_groups[pb->_ngroups++] = (Batch_Group) {lo, hi, pc};
+}
+
+static void remove_group(Batch *pb, unsigned gi) {
+	pb->_groups[gi] = pb->_groups[--pb->_ngroups];
+}
+
+/*!
+ * Fin d'exécution des voies des emplacements [lo, hi) selon leur issue.
+ *
+ * \param pc le compteur ordinal de l'instruction en cours
+ */
+static void finish(Batch *pb, unsigned lo, unsigned hi, unsigned pc) {
+	for (unsigned s = lo; s < hi; s++) {
+		unsigned lane = pb->_lane[s];
+		uint8_t f = pb->_flag[s];
+		pb->_err[lane] = ERR_NOERROR;
+		pb->_addr[lane] = 0;
+		if (f == LANE_BUDGET) { // Même état qu'avant l'instruction
+			pb->_status[lane] = RUN_BUDGET;
+			pb->_pc[s] = pc;
+		} else if (f == LANE_HALT) {
+			pb->_status[lane] = RUN_HALT;
+			pb->_pc[s] = pc + 1;
+		} else {
+			pb->_status[lane] = RUN_ERROR;
+			pb->_err[lane] = f - LANE_ERROR;
+			pb->_addr[lane] = pc;
+			pb->_pc[s] = pc + 1;
+		}
+	}
+}
+
+/*!
+ * Toutes les voies d'un groupe se terminent de la même façon.
+ */
+static void finish_group(Batch *pb, unsigned gi, uint8_t f, unsigned pc) {
+	Batch_Group g = pb->_groups[gi];
+	memset(pb->_flag + g._lo, f, g._hi - g._lo);
+	finish(pb, g._lo, g._hi, pc);
+	remove_group(pb, gi);
+}
+
+/*!
+ * Répartition des voies d'un groupe après une instruction : les voies qui
+ * continuent en séquence, puis celles qui se branchent (un nouveau groupe par
+ * destination), puis celles qui sont terminées.
+ */
+static void resolve(Batch *pb, unsigned gi) {
+	Batch_Group g = pb->_groups[gi];
+	if (all_next(pb->_flag + g._lo, g._hi - g._lo)) {
+		pb->_groups[gi]._pc++;
+		return;
+	}
+
+	// [lo, lt) suivant, [lt, gt) branchement, [gt, hi) terminées
+	unsigned gt = split(pb, g._lo, g._hi, running, 0);
+	unsigned lt = split(pb, g._lo, gt, sequential, 0);
+	finish(pb, gt, g._hi, g._pc);
+
+	remove_group(pb, gi);
+	if (lt > g._lo)
+		add_group(pb, g._lo, lt, g._pc + 1);
+	// Un groupe par destination (le plus souvent une seule)
+	for (unsigned a = lt; a < gt;) {
+		unsigned target = pb->_pc[a];
+		unsigned b = split(pb, a + 1, gt, branch_to, target);
+		add_group(pb, a, b, target);
+		a = b;
+	}
+}
+
+static int compare_groups(const void *a, const void *b) {
+	const Batch_Group *ga = a, *gb = b;
+	return ga->_pc < gb->_pc ? -1 : ga->_pc > gb->_pc;
+}
+
+/*!
+ * Regroupement : les emplacements sont permutés pour que les voies de même
+ * compteur ordinal soient contiguës et forment un seul groupe. Les voies
+ * terminées sont rangées après.
+ */
+static void regroup(Batch *pb) {
+	unsigned n = pb->_lanes;
+	Word *perm = pb->_tmp;		// Nouvel emplacement -> ancien
+	uint8_t *mark = pb->_flag;	// Emplacement d'une voie en cours
+	memset(mark, 0, n);
+
+	qsort(pb->_groups, pb->_ngroups, sizeof(Batch_Group), compare_groups);
+	unsigned k = 0, ngroups = 0;
+	for (unsigned gi = 0; gi < pb->_ngroups; gi++) {
+		Batch_Group g = pb->_groups[gi];
+		if (ngroups == 0 || pb->_groups[ngroups - 1]._pc != g._pc)
+			pb->_groups[ngroups++] = (Batch_Group) {k, k, g._pc};
+		for (unsigned s = g._lo; s < g._hi; s++) {
+			perm[k++] = s;
+			mark[s] = 1;
+		}
+		pb->_groups[ngroups - 1]._hi = k;
+	}
+	pb->_ngroups = ngroups;
+	for (unsigned s = 0; s < n; s++)
+		if (!mark[s])
+			perm[k++] = s;
+
+	uint64_t *scratch = checked_realloc(NULL, n * sizeof(uint64_t), "le lot de machines");
+#define PERMUTE(a) do { \
+		__typeof__(a[0]) *t = (__typeof__(a[0]) *) scratch; \
+		for (unsigned s = 0; s < n; s++) t[s] = a[perm[s]]; \
+		memcpy(a, t, n * sizeof(a[0])); \
+	} while (0)
+	for (int r = 0; r < NREGISTERS; r++) {
+		Word *reg = REG(pb, r);
+		PERMUTE(reg);
+	}
+	PERMUTE(pb->_cc);
+	PERMUTE(pb->_pc);
+	PERMUTE(pb->_icount);
+	PERMUTE(pb->_lane);
+	PERMUTE(pb->_base);
+#undef PERMUTE
+	free(scratch);
+	pb->_regroups++;
+}
+
+/*======================================
+ *
+ *		EXÉCUTION
+ *======================================
+ */
+
+/*!
+ * Empilement de \a val par les voies d'issue \a active (voir stack_data()).
+ * En cas de débordement, la voie est en erreur.
+ */
+static void push_lanes(Batch *pb, unsigned lo, unsigned n, const Word *val, uint8_t active) {
+	Word *sp = REG(pb, NREGISTERS - 1) + lo;
+	uint8_t *flag = pb->_flag + lo;
+	const unsigned *base = pb->_base + lo;
+	for (unsigned i = 0; i < n; i++) {
+		if (flag[i] != active)
+			continue;
+		if (sp[i] >= pb->_datasize || sp[i] < pb->_dataend) {
+			flag[i] = LANE_ERROR + ERR_SEGSTACK;
+			continue;
+		}
+		pb->_data[base[i] + sp[i]] = val[i];
+		sp[i]--;
+		if (sp[i] >= pb->_datasize || sp[i] < pb->_dataend)
+			flag[i] = LANE_ERROR + ERR_SEGSTACK;
+	}
+}
+
+/*!
+ * Adresses de l'opérande de l'instruction, dans \c _tmp (erreurs dans
+ * \c _flag).
+ *
+ * \return faux si l'adresse (absolue) est invalide pour toutes les voies
+ */
+static bool operand_address(Batch *pb, unsigned lo, unsigned n, Instruction instr) {
+	if (pb->_datasize == 0)
+		return false;
+	if (instr.instr_generic._indexed) {
+		index_addr(pb->_tmp + lo, pb->_flag + lo, REG(pb, instr.instr_indexed._rindex) + lo, n,
+			   instr.instr_indexed._offset, pb->_datasize);
+		return true;
+	}
+	if (instr.instr_absolute._address >= pb->_datasize)
+		return false;
+	fill(pb->_tmp + lo, n, instr.instr_absolute._address);
+	return true;
+}
+
+/*!
+ * Valeur de l'opérande (immédiate ou en mémoire), dans \c _tmp.
+ *
+ * \return faux si l'adresse (absolue) est invalide pour toutes les voies
+ */
+static bool operand_value(Batch *pb, unsigned lo, unsigned n, Instruction instr) {
+	if (instr.instr_generic._immediate) {
+		fill(pb->_tmp + lo, n, instr.instr_immediate._value);
+		return true;
+	}
+	if (pb->_datasize == 0)
+		return false;
+	if (!instr.instr_generic._indexed) {
+		if (instr.instr_absolute._address >= pb->_datasize)
+			return false;
+		gather_abs(pb->_tmp + lo, pb->_data, pb->_base + lo, n, instr.instr_absolute._address);
+		return true;
+	}
+	index_addr(pb->_tmp + lo, pb->_flag + lo, REG(pb, instr.instr_indexed._rindex) + lo, n,
+		   instr.instr_indexed._offset, pb->_datasize);
+	gather_idx(pb->_tmp + lo, pb->_data, pb->_base + lo, n);
+	return true;
+}
+
+/*!
+ * Exécution de l'instruction d'un groupe par toutes ses voies (même
+ * sémantique que simul_run() puis decode_execute()).
+ */
+static void step(Batch *pb, unsigned gi, uint64_t budget) {
+	Batch_Group g = pb->_groups[gi];
+	unsigned lo = g._lo, n = g._hi - g._lo, pc = g._pc;
+	uint8_t *flag = pb->_flag + lo;
+
+	// Budget épuisé : ces voies quittent le groupe avant l'instruction
+	if (budget_flags(flag, pb->_icount + lo, n, budget) > 0) {
+		unsigned j = split(pb, lo, g._hi, within_budget, 0);
+		finish(pb, j, g._hi, pc);
+		if (j == lo) {
+			remove_group(pb, gi);
+			return;
+		}
+		pb->_groups[gi]._hi = j;
+		n = j - lo;
+	}
+
+	if (pc >= pb->_textsize) {
+		// Même convention que simul_run() : l'instruction n'est pas comptée,
+		// l'erreur est signalée en pc - 1 et le compteur ordinal ne bouge pas
+		memset(flag, LANE_ERROR + ERR_SEGTEXT, n);
+		finish(pb, lo, lo + n, pc - 1);
+		for (unsigned s = lo; s < lo + n; s++)
+			pb->_pc[s] = pc;
+		remove_group(pb, gi);
+		return;
+	}
+	count_instruction(pb->_icount + lo, n);
+	pb->_steps++;
+
+	Instruction instr = pb->_text[pc];
+	unsigned rc = instr.instr_generic._regcond;
+	memset(flag, LANE_NEXT, n);
+	switch (instr.instr_generic._cop) {
+		case ILLOP:
+			finish_group(pb, gi, LANE_ERROR + ERR_ILLEGAL, pc);
+			return;
+		case NOP:
+			break;
+
+		case LOAD:
+		case ADD:
+		case SUB: {
+			bool add = instr.instr_generic._cop != LOAD;
+			bool neg = instr.instr_generic._cop == SUB;
+			if (instr.instr_generic._immediate) {
+				Word v = instr.instr_immediate._value;
+				alu_imm(REG(pb, rc) + lo, pb->_cc + lo, n, neg ? -v : v, add);
+				break;
+			}
+			if (!operand_value(pb, lo, n, instr)) {
+				finish_group(pb, gi, LANE_ERROR + ERR_SEGDATA, pc);
+				return;
+			}
+			alu_vec(REG(pb, rc) + lo, pb->_cc + lo, pb->_tmp + lo, flag, n, add, neg);
+			break;
+		}
+
+		case MUL:
+		case DIV:
+		case MOD:
+		case AND:
+		case OR:
+		case XOR:
+		case SHL:
+		case SHR:
+			if (!operand_value(pb, lo, n, instr)) {
+				finish_group(pb, gi, LANE_ERROR + ERR_SEGDATA, pc);
+				return;
+			}
+			if (instr.instr_generic._cop == DIV || instr.instr_generic._cop == MOD)
+				div_vec(REG(pb, rc) + lo, pb->_cc + lo, pb->_tmp + lo, flag, n,
+					instr.instr_generic._cop == MOD);
+			else
+				logic_vec(REG(pb, rc) + lo, pb->_cc + lo, pb->_tmp + lo, flag, n,
+					  instr.instr_generic._cop);
+			break;
+
+		case STORE: {
+			if (instr.instr_generic._immediate) {
+				finish_group(pb, gi, LANE_ERROR + ERR_IMMEDIATE, pc);
+				return;
+			}
+			if (!operand_address(pb, lo, n, instr)) {
+				finish_group(pb, gi, LANE_ERROR + ERR_SEGDATA, pc);
+				return;
+			}
+			const Word *reg = REG(pb, rc) + lo, *addr = pb->_tmp + lo;
+			const unsigned *base = pb->_base + lo;
+			for (unsigned i = 0; i < n; i++)
+				if (flag[i] == LANE_NEXT)
+					pb->_data[base[i] + addr[i]] = reg[i];
+			break;
+		}
+
+		case MOVE:
+		case FILL: {
+			// Voie par voie : chaque voie a sa plage (voir process_move())
+			bool move = instr.instr_generic._cop == MOVE;
+			const Word *dst = REG(pb, rc) + lo;
+			const Word *src = REG(pb, (rc + 1) % NREGISTERS) + lo;
+			const Word *cnt = REG(pb, (rc + 2) % NREGISTERS) + lo;
+			const unsigned *base = pb->_base + lo;
+			for (unsigned i = 0; i < n; i++) {
+				Word c = cnt[i];
+				if (c == 0)
+					continue;
+				if (dst[i] >= pb->_datasize || c > pb->_datasize - dst[i]
+				    || (move && (src[i] >= pb->_datasize || c > pb->_datasize - src[i]))) {
+					flag[i] = LANE_ERROR + ERR_SEGDATA;
+					continue;
+				}
+				Word *d = pb->_data + base[i];
+				if (move)
+					memmove(d + dst[i], d + src[i], c * sizeof(Word));
+				else
+					for (Word j = 0; j < c; j++)
+						d[dst[i] + j] = src[i];
+			}
+			break;
+		}
+
+		case PUSH:
+			if (!operand_value(pb, lo, n, instr)) {
+				finish_group(pb, gi, LANE_ERROR + ERR_SEGDATA, pc);
+				return;
+			}
+			push_lanes(pb, lo, n, pb->_tmp + lo, LANE_NEXT);
+			break;
+
+		case POP: {
+			if (instr.instr_generic._immediate) {
+				finish_group(pb, gi, LANE_ERROR + ERR_IMMEDIATE, pc);
+				return;
+			}
+			if (!operand_address(pb, lo, n, instr)) {
+				finish_group(pb, gi, LANE_ERROR + ERR_SEGDATA, pc);
+				return;
+			}
+			Word *sp = REG(pb, NREGISTERS - 1) + lo;
+			const Word *addr = pb->_tmp + lo;
+			const unsigned *base = pb->_base + lo;
+			for (unsigned i = 0; i < n; i++) {
+				if (flag[i] != LANE_NEXT)
+					continue;
+				sp[i]++; // Avant la vérification, comme pop_data()
+				if (sp[i] >= pb->_datasize || sp[i] < pb->_dataend)
+					flag[i] = LANE_ERROR + ERR_SEGSTACK;
+				else
+					pb->_data[base[i] + addr[i]] = pb->_data[base[i] + sp[i]];
+			}
+			break;
+		}
+
+		case BRANCH:
+		case CALL: {
+			if (instr.instr_generic._immediate) {
+				finish_group(pb, gi, LANE_ERROR + ERR_IMMEDIATE, pc);
+				return;
+			}
+			if (rc > LAST_CONDITION) {
+				finish_group(pb, gi, LANE_ERROR + ERR_CONDITION, pc);
+				return;
+			}
+			cond_flags(flag, pb->_cc + lo, n, rc);
+			unsigned target = instr.instr_absolute._address;
+			if (target >= pb->_textsize) {
+				// Destination hors du segment de texte : erreur avant l'empilement
+				for (unsigned i = 0; i < n; i++)
+					if (flag[i] == LANE_TAKEN)
+						flag[i] = LANE_ERROR + ERR_SEGTEXT;
+				break;
+			}
+			if (instr.instr_generic._cop == CALL) {
+				fill(pb->_tmp + lo, n, pc + 1);
+				push_lanes(pb, lo, n, pb->_tmp + lo, LANE_TAKEN);
+			}
+			if (rc == NC && instr.instr_generic._cop == BRANCH) {
+				pb->_groups[gi]._pc = target; // Saut inconditionnel : pas de divergence
+				return;
+			}
+			for (unsigned i = 0; i < n; i++)
+				if (flag[i] == LANE_TAKEN)
+					pb->_pc[lo + i] = target;
+			break;
+		}
+
+		case RET: {
+			Word *sp = REG(pb, NREGISTERS - 1) + lo;
+			const unsigned *base = pb->_base + lo;
+			for (unsigned i = 0; i < n; i++) {
+				sp[i]++;
+				if (sp[i] >= pb->_datasize || sp[i] < pb->_dataend)
+					flag[i] = LANE_ERROR + ERR_SEGSTACK;
+				else {
+					flag[i] = LANE_TAKEN;
+					pb->_pc[lo + i] = pb->_data[base[i] + sp[i]];
+				}
+			}
+			break;
+		}
+
+		case HALT:
+			finish_group(pb, gi, LANE_HALT, pc);
+			return;
+
+		default:
+			finish_group(pb, gi, LANE_ERROR + ERR_UNKNOWN, pc);
+			return;
+	}
+	resolve(pb, gi);
+}
+
+/*======================================
+ *
+ *		INTERFACE
+ *======================================
+ */
+
+Batch *batch_new(unsigned lanes, unsigned textsize, Instruction *text,
+                 unsigned datasize, const Word *data, unsigned dataend) {
+	if (lanes == 0 || (uint64_t) lanes * datasize > UINT32_MAX)
+		return NULL;
+
+	Batch *pb = checked_realloc(NULL, sizeof(Batch), "le lot de machines");
+	pb->_lanes = lanes;
+	pb->_textsize = textsize;
+	pb->_text = text;
+	pb->_datasize = datasize;
+	pb->_dataend = dataend;
+	pb->_data = checked_realloc(NULL, (size_t) lanes * datasize * sizeof(Word), "le lot de machines");
+	pb->_regs = checked_realloc(NULL, (size_t) NREGISTERS * lanes * sizeof(Word), "le lot de machines");
+	pb->_cc = checked_realloc(NULL, lanes * sizeof(int32_t), "le lot de machines");
+	pb->_pc = checked_realloc(NULL, lanes * sizeof(unsigned), "le lot de machines");
+	pb->_icount = checked_realloc(NULL, lanes * sizeof(uint64_t), "le lot de machines");
+	pb->_lane = checked_realloc(NULL, lanes * sizeof(unsigned), "le lot de machines");
+	pb->_base = checked_realloc(NULL, lanes * sizeof(unsigned), "le lot de machines");
+	pb->_flag = checked_realloc(NULL, lanes, "le lot de machines");
+	pb->_tmp = checked_realloc(NULL, lanes * sizeof(Word), "le lot de machines");
+	pb->_slot = checked_realloc(NULL, lanes * sizeof(unsigned), "le lot de machines");
+	pb->_status = checked_realloc(NULL, lanes * sizeof(Run_Status), "le lot de machines");
+	pb->_err = checked_realloc(NULL, lanes * sizeof(Error), "le lot de machines");
+	pb->_addr = checked_realloc(NULL, lanes * sizeof(unsigned), "le lot de machines");
+
+	// Même état initial que load_program()
+	memset(pb->_regs, 0, (size_t) NREGISTERS * lanes * sizeof(Word));
+	for (unsigned s = 0; s < lanes; s++) {
+		memcpy(pb->_data + (size_t) s * datasize, data, datasize * sizeof(Word));
+		REG(pb, NREGISTERS - 1)[s] = datasize - 1;
+		pb->_cc[s] = CC_U;
+		pb->_pc[s] = 0;
+		pb->_icount[s] = 0;
+		pb->_lane[s] = pb->_slot[s] = s;
+		pb->_base[s] = s * datasize;
+		pb->_status[s] = RUN_BUDGET;
+		pb->_err[s] = ERR_NOERROR;
+		pb->_addr[s] = 0;
+	}
+
+	pb->_maxgroups = 16;
+	pb->_groups = checked_realloc(NULL, pb->_maxgroups * sizeof(Batch_Group), "le lot de machines");
+	pb->_ngroups = 0;
+	add_group(pb, 0, lanes, 0);
+	pb->_steps = pb->_regroups = 0;
+	return pb;
+}
+
+Word *batch_data(Batch *pb, unsigned lane) {
+	return pb->_data + (size_t) lane * pb->_datasize;
+}
+
+void batch_run(Batch *pb, uint64_t budget) {
+	while (pb->_ngroups > 0) {
+		// Groupe de plus petit compteur ordinal ; regroupement si plusieurs
+		unsigned best = 0;
+		bool shared = false;
+		for (unsigned gi = 1; gi < pb->_ngroups; gi++) {
+			if (pb->_groups[gi]._pc < pb->_groups[best]._pc) {
+				best = gi;
+				shared = false;
+			} else if (pb->_groups[gi]._pc == pb->_groups[best]._pc)
+				shared = true;
+		}
+		if (shared)
+			regroup(pb);
+		else
+			step(pb, best, budget);
+	}
+	for (unsigned s = 0; s < pb->_lanes; s++)
+		pb->_slot[pb->_lane[s]] = s;
+}
+
+Run_Status batch_status(Batch *pb, unsigned lane, Error *perr, unsigned *paddr) {
+	*perr = pb->_err[lane];
+	*paddr = pb->_addr[lane];
+	return pb->_status[lane];
+}
+
+void batch_machine(Batch *pb, unsigned lane, Machine *pmach) {
+	unsigned s = pb->_slot[lane];
+	load_program(pmach, pb->_textsize, pb->_text, pb->_datasize, batch_data(pb, lane), pb->_dataend);
+	for (int r = 0; r < NREGISTERS; r++)
+		pmach->_registers[r] = REG(pb, r)[s];
+	pmach->_cc = pb->_cc[s];
+	pmach->_pc = pb->_pc[s];
+	pmach->_icount = pb->_icount[s];
+}
+
+void batch_free(Batch *pb) {
+	free(pb->_data);
+	free(pb->_regs);
+	free(pb->_cc);
+	free(pb->_pc);
+	free(pb->_icount);
+	free(pb->_lane);
+	free(pb->_base);
+	free(pb->_flag);
+	free(pb->_tmp);
+	free(pb->_slot);
+	free(pb->_status);
+	free(pb->_err);
+	free(pb->_addr);
+	free(pb->_groups);
+	free(pb);
+}
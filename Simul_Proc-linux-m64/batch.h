@@ -0,0 +1,142 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+/*!
+ * \file batch.h
+ * \brief Exécution simultanée d'un même programme sur de nombreuses machines.
+ *
+ * Un lot (\e batch) est formé de N machines (\e voies) qui partagent le même
+ * segment de texte et diffèrent par leur segment de données initial. L'état
+ * des voies est rangé « par structure de tableaux » : chaque registre est un
+ * tableau indexé par la voie, de même pour le code condition, le compteur
+ * ordinal et le compteur d'instructions. Une instruction est exécutée d'un
+ * seul coup pour toutes les voies d'un \e groupe (voies au même compteur
+ * ordinal), par des boucles que le compilateur vectorise (AVX2 si le
+ * processeur le permet).
+ *
+ * Quand les voies d'un groupe divergent (branchement conditionnel, retour de
+ * sous-programme, erreur), le groupe est scindé ; les groupes qui atteignent
+ * le même compteur ordinal sont regroupés. On exécute toujours le groupe de
+ * plus petit compteur ordinal, ce qui favorise la reconvergence.
+ *
+ * Le résultat de chaque voie (état final, issue, erreur) est celui qu'aurait
+ * donné simul_run() sur une machine seule.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Un groupe de voies au même compteur ordinal
+typedef struct
+{
+    unsigned _lo;		//!< Premier emplacement du groupe
+    unsigned _hi;		//!< Emplacement qui suit le dernier
+    unsigned _pc;		//!< Compteur ordinal commun
+} Batch_Group;
+
+//! Un lot de machines
+/*!
+ * Les voies sont rangées dans des \e emplacements que l'on permute pour que
+ * chaque groupe occupe des emplacements contigus. Les segments de données,
+ * eux, ne bougent pas : chaque voie a le sien (\c _datasize mots consécutifs).
+ */
+typedef struct
+{
+    unsigned _lanes;		//!< Nombre de voies
+    unsigned _textsize;		//!< Taille du segment de texte
+    Instruction *_text;		//!< Segment de texte commun
+    unsigned _datasize;		//!< Taille du segment de données de chaque voie
+    unsigned _dataend;		//!< Première adresse libre après les données statiques
+    Word *_data;		//!< Segments de données, voie par voie
+
+    // Par emplacement
+    Word *_regs;		//!< Registres : \c _regs[r * _lanes + emplacement]
+    int32_t *_cc;		//!< Codes condition
+    unsigned *_pc;		//!< Compteur ordinal (voie terminée ou branchement)
+    uint64_t *_icount;		//!< Nombres d'instructions exécutées
+    unsigned *_lane;		//!< Voie de l'emplacement
+    unsigned *_base;		//!< Début du segment de données de la voie
+    uint8_t *_flag;		//!< Issue de l'instruction en cours
+    Word *_tmp;			//!< Valeurs intermédiaires (adresses, opérandes)
+
+    // Par voie
+    unsigned *_slot;		//!< Emplacement de la voie (après batch_run())
+    Run_Status *_status;	//!< Issue de l'exécution
+    Error *_err;		//!< Erreur (si \c RUN_ERROR)
+    unsigned *_addr;		//!< Adresse de l'erreur
+
+    Batch_Group *_groups;	//!< Groupes en cours d'exécution
+    unsigned _ngroups;		//!< Nombre de groupes
+    unsigned _maxgroups;	//!< Nombre de groupes alloués
+
+    uint64_t _steps;		//!< Instructions exécutées par groupe
+    uint64_t _regroups;		//!< Regroupements effectués
+} Batch;
+
+//! Création d'un lot
+/*!
+ * Chaque voie reçoit une copie du segment de données initial ; ses registres
+ * sont initialisés comme par load_program().
+ *
+ * \param lanes le nombre de voies
+ * \param textsize taille du segment de texte
+ * \param text le segment de texte (partagé, non recopié)
+ * \param datasize taille du segment de données
+ * \param data le segment de données initial
+ * \param dataend première adresse libre après les données statiques
+ * \return le lot, ou NULL s'il est trop grand
+ */
+Batch *batch_new(unsigned lanes, unsigned textsize, Instruction *text,
+                 unsigned datasize, const Word *data, unsigned dataend);
+
+//! Segment de données d'une voie
+/*!
+ * Avant batch_run(), permet de donner à chaque voie ses données initiales.
+ *
+ * \param pb le lot
+ * \param lane la voie
+ * \return le segment de données de la voie (\c _datasize mots)
+ */
+Word *batch_data(Batch *pb, unsigned lane);
+
+//! Exécution de toutes les voies
+/*!
+ * Chaque voie s'exécute jusqu'à \c HALT, une erreur ou l'épuisement de son
+ * budget d'instructions, comme par simul_run(). Un lot ne s'exécute qu'une
+ * fois.
+ *
+ * \param pb le lot
+ * \param budget le nombre maximal d'instructions de chaque voie
+ */
+void batch_run(Batch *pb, uint64_t budget);
+
+//! Issue de l'exécution d'une voie
+/*!
+ * \param pb le lot
+ * \param lane la voie
+ * \param perr l'erreur (si \c RUN_ERROR)
+ * \param paddr l'adresse de l'erreur (si \c RUN_ERROR)
+ * \return l'issue, comme celle de simul_run()
+ */
+Run_Status batch_status(Batch *pb, unsigned lane, Error *perr, unsigned *paddr);
+
+//! État final d'une voie
+/*!
+ * La machine partage le segment de texte et le segment de données de la voie
+ * (pour print_cpu(), print_data()...).
+ *
+ * \param pb le lot
+ * \param lane la voie
+ * \param pmach la machine à remplir
+ */
+void batch_machine(Batch *pb, unsigned lane, Machine *pmach);
+
+//! Destruction d'un lot
+/*!
+ * \param pb le lot
+ */
+void batch_free(Batch *pb);
+
+#endif
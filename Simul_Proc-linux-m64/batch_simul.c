@@ -0,0 +1,215 @@
+/*!
+ * \file batch_simul.c
+ * \brief Exécution d'un programme sur de nombreux jeux de données
+ *
+ * Le programme (format de read_program()) est exécuté simultanément par
+ * toutes les voies d'un lot (voir batch.h), chacune avec son propre segment
+ * de données initial. Les jeux de données sont décrits par un fichier texte,
+ * une ligne par voie, chaque ligne étant une suite de modifications
+ * <tt>adresse:valeur</tt> du segment de données du programme.
+ *
+ * Avec l'option \c -c, chaque voie est aussi exécutée seule par simul_run()
+ * et les deux résultats sont comparés.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+#include "batch.h"
+#include "telemetry.h"
+
+//! Noms des issues d'exécution
+static const char *status_names[] = {"halt", "error", "budget"};
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: batch_simul [options] prog.bin [datasets]\n"
+	       "where options are:\n"
+	       "\t-l n\tNumber of lanes (default: number of datasets, or 1)\n"
+	       "\t-r n\tRandomize the static data of each lane in [0, n)\n"
+	       "\t-n n\tInstruction budget per lane (default: 10000000)\n"
+	       "\t-c\tCheck each lane against a separate run\n"
+	       "\t-q\tQuiet: print only the summary\n"
+	       "\t-h\tprint this help message\n"
+	       "Each line of the datasets file gives addr:value pairs for one lane.\n");
+}
+
+/*!
+ * Lecture des jeux de données : une ligne par voie.
+ *
+ * \return le nombre de lignes lues
+ */
+static unsigned read_datasets(Batch *pb, const char *file, unsigned lanes) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open datasets file %s\n", file);
+		exit(EXIT_FAILURE);
+	}
+	char *line = NULL;
+	size_t size = 0;
+	unsigned lane = 0;
+	while (lane < lanes && getline(&line, &size, in) > 0) {
+		Word *data = batch_data(pb, lane);
+		char *p = line;
+		for (;;) {
+			char *end;
+			unsigned long addr = strtoul(p, &end, 0);
+			if (end == p || *end != ':')
+				break;
+			long value = strtol(end + 1, &p, 0);
+			if (addr < pb->_datasize)
+				data[addr] = value;
+			else
+				fprintf(stderr, "Dataset %u: address 0x%lx ignored\n", lane, addr);
+		}
+		lane++;
+	}
+	free(line);
+	fclose(in);
+	return lane;
+}
+
+static unsigned count_lines(const char *file) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open datasets file %s\n", file);
+		exit(EXIT_FAILURE);
+	}
+	unsigned n = 0;
+	int c;
+	while ((c = getc(in)) != EOF)
+		n += c == '\n';
+	fclose(in);
+	return n;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned lanes = 0, randomize = 0;
+	uint64_t budget = 10000000;
+	bool check = false, quiet = false;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'c' || opt == 'q') {
+			if (opt == 'c')
+				check = true;
+			else
+				quiet = true;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("lrn", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'l': lanes = atoi(val); break;
+			case 'r': randomize = atoi(val); break;
+			case 'n': budget = strtoull(val, NULL, 10); break;
+		}
+	}
+	if (iarg >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	const char *programfile = argv[iarg];
+	const char *datasets = iarg + 1 < argc ? argv[iarg + 1] : NULL;
+	if (lanes == 0)
+		lanes = datasets != NULL ? count_lines(datasets) : 1;
+
+	Machine prog;
+	read_program(&prog, programfile);
+	Batch *pb = batch_new(lanes, prog._textsize, prog._text, prog._datasize, prog._data, prog._dataend);
+	if (pb == NULL) {
+		fprintf(stderr, "Batch too large (%u lanes)\n", lanes);
+		return EXIT_FAILURE;
+	}
+	if (datasets != NULL)
+		read_datasets(pb, datasets, lanes);
+	if (randomize > 0) {
+		srand(1);
+		for (unsigned lane = 0; lane < lanes; lane++)
+			for (unsigned a = 0; a < prog._dataend; a++)
+				batch_data(pb, lane)[a] = rand() % randomize;
+	}
+
+	// Copie des données initiales pour la vérification
+	Word *initial = NULL;
+	if (check) {
+		initial = malloc((size_t) lanes * prog._datasize * sizeof(Word));
+		if (initial == NULL) {
+			fprintf(stderr, "Erreur d'allocation mémoire\n");
+			return EXIT_FAILURE;
+		}
+		memcpy(initial, batch_data(pb, 0), (size_t) lanes * prog._datasize * sizeof(Word));
+	}
+
+	double t0 = telemetry_now_ns() * 1e-9;
+	batch_run(pb, budget);
+	double tbatch = telemetry_now_ns() * 1e-9 - t0;
+
+	uint64_t total = 0;
+	for (unsigned lane = 0; lane < lanes; lane++) {
+		Machine mach;
+		Error err;
+		unsigned addr;
+		Run_Status status = batch_status(pb, lane, &err, &addr);
+		batch_machine(pb, lane, &mach);
+		total += mach._icount;
+		if (!quiet) {
+			printf("%u: %s", lane, status_names[status]);
+			if (status == RUN_ERROR)
+				printf(" (error %d at 0x%04x)", err, addr);
+			printf(", %llu instructions, PC = 0x%04x, CC = %d, R00 = %d\n",
+			       (unsigned long long) mach._icount, mach._pc, mach._cc, mach._registers[0]);
+		}
+	}
+	printf("%u lanes, %llu instructions in %.6f s (%.1f Minstr/s), %llu group steps, %llu regroups\n",
+	       lanes, (unsigned long long) total, tbatch, total / tbatch * 1e-6,
+	       (unsigned long long) pb->_steps, (unsigned long long) pb->_regroups);
+
+	int result = EXIT_SUCCESS;
+	if (check) {
+		unsigned mismatches = 0;
+		double tsingle = 0;
+		for (unsigned lane = 0; lane < lanes; lane++) {
+			Machine single, batched;
+			Error err, berr;
+			unsigned addr, baddr;
+			Word *data = initial + (size_t) lane * prog._datasize;
+			load_program(&single, prog._textsize, prog._text, prog._datasize, data, prog._dataend);
+			t0 = telemetry_now_ns() * 1e-9;
+			Run_Status status = simul_run(&single, budget, &err, &addr);
+			tsingle += telemetry_now_ns() * 1e-9 - t0;
+
+			Run_Status bstatus = batch_status(pb, lane, &berr, &baddr);
+			batch_machine(pb, lane, &batched);
+			bool same = status == bstatus && single._pc == batched._pc && single._cc == batched._cc
+				&& single._icount == batched._icount
+				&& memcmp(single._registers, batched._registers, sizeof(single._registers)) == 0
+				&& memcmp(single._data, batched._data, prog._datasize * sizeof(Word)) == 0
+				&& (status != RUN_ERROR || (err == berr && addr == baddr));
+			if (!same) {
+				if (mismatches++ < 10)
+					fprintf(stderr, "Lane %u differs from a separate run\n", lane);
+				result = EXIT_FAILURE;
+			}
+		}
+		printf("check: %u mismatches; separate runs took %.6f s (batch speedup %.2fx)\n",
+		       mismatches, tsingle, tsingle / tbatch);
+		free(initial);
+	}
+
+	batch_free(pb);
+	return result;
+}
@@ -0,0 +1,545 @@
+/***** btrace.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "btrace.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+//! Taille du tampon d'écriture
+#define BTRACE_BUFSIZE (1 << 16)
+
+//! Taille de l'en-tête en octets
+#define BTRACE_HEADER (6 * 4)
+
+//! Trace ouverte, refermée à la fin du simulateur (voir btrace_open())
+static Btrace *active = NULL;
+
+/*======================================
+ *
+ *		ÉCRITURE
+ *======================================
+ */
+
+/*!
+ * Vidage du tampon d'écriture dans le fichier.
+ */
+static void flush(Btrace *bt) {
+	unsigned char *p = bt->_buf;
+	unsigned len = bt->_len;
+	while (len > 0) {
+		ssize_t n = write(bt->_fd, p, len);
+		if (n <= 0) {
+			fprintf(stderr, "Erreur d'écriture de la trace binaire\n");
+			exit(1);
+		}
+		p += n;
+		len -= n;
+	}
+	bt->_offset += bt->_len;
+	bt->_len = 0;
+}
+
+/*!
+ * Réserve de la place dans le tampon pour au moins \a n octets.
+ */
+static inline void reserve(Btrace *bt, unsigned n) {
+	if (bt->_len + n > BTRACE_BUFSIZE)
+		flush(bt);
+}
+
+static inline void put_byte(Btrace *bt, unsigned char c) {
+	reserve(bt, 1);
+	bt->_buf[bt->_len++] = c;
+}
+
+static inline void put_varint(Btrace *bt, uint64_t v) {
+	reserve(bt, 10);
+	while (v >= 0x80) {
+		bt->_buf[bt->_len++] = (unsigned char) (v | 0x80);
+		v >>= 7;
+	}
+	bt->_buf[bt->_len++] = (unsigned char) v;
+}
+
+static inline void put_u32(Btrace *bt, uint32_t v) {
+	reserve(bt, 4);
+	for (int i = 0; i < 4; i++)
+		bt->_buf[bt->_len++] = (unsigned char) (v >> (8 * i));
+}
+
+//! Codage zigzag d'un écart sur 32 bits
+static inline uint64_t zigzag(uint32_t delta) {
+	int32_t d = (int32_t) delta;
+	return ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+}
+
+//! Décodage zigzag
+static inline uint32_t unzigzag(uint64_t v) {
+	return (uint32_t) (v >> 1) ^ -(uint32_t) (v & 1);
+}
+
+/*!
+ * Écriture d'une image clé : état complet de la machine.
+ */
+static void keyframe(Btrace *bt) {
+	Machine *pmach = bt->_pmach;
+	if (bt->_nkeys == bt->_maxkeys) {
+		bt->_maxkeys = bt->_maxkeys ? 2 * bt->_maxkeys : 64;
+		bt->_keys = checked_realloc(bt->_keys, 2 * bt->_maxkeys * sizeof(uint64_t), "la trace binaire");
+	}
+	bt->_keys[2 * bt->_nkeys] = bt->_records;
+	bt->_keys[2 * bt->_nkeys + 1] = bt->_offset + bt->_len;
+	bt->_nkeys++;
+
+	put_byte(bt, 0);
+	put_byte(bt, 'K');
+	put_varint(bt, bt->_records);
+	put_varint(bt, bt->_prevpc);
+	put_varint(bt, pmach->_pc);
+	put_varint(bt, pmach->_cc);
+	for (int r = 0; r < NREGISTERS; r++)
+		put_varint(bt, pmach->_registers[r]);
+	for (unsigned a = 0; a < pmach->_datasize; a++)
+		put_u32(bt, pmach->_data[a]);
+}
+
+/*!
+ * Fermeture de la trace active à la fin du simulateur.
+ */
+static void close_active(void) {
+	if (active != NULL)
+		btrace_close(active);
+}
+
+/*!
+ * Crochet d'écriture en mémoire.
+ */
+static void hook_write(void *ctx, Machine *pmach, unsigned addr, Word old, Word value) {
+	btrace_data(ctx, addr, old, value);
+}
+
+/*!
+ * Crochet de fin d'instruction.
+ */
+static void hook_retire(void *ctx, Machine *pmach, unsigned addr, Instruction instr) {
+	btrace_step(ctx, addr);
+}
+
+Btrace *btrace_open(const char *file, Machine *pmach, unsigned interval) {
+	static bool registered = false;
+
+	Btrace *bt = checked_realloc(NULL, sizeof(Btrace), "la trace binaire");
+	bt->_fd = open(file, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (bt->_fd < 0) {
+		fprintf(stderr, "Erreur lors de l'ouverture du fichier de trace %s\n", file);
+		exit(1);
+	}
+	bt->_buf = checked_realloc(NULL, BTRACE_BUFSIZE, "la trace binaire");
+	bt->_len = 0;
+	bt->_offset = 0;
+	bt->_pmach = pmach;
+	bt->_interval = interval ? interval : BTRACE_INTERVAL;
+	bt->_records = 0;
+	bt->_prevpc = pmach->_pc - 1;
+	for (int r = 0; r < NREGISTERS; r++)
+		bt->_shadow[r] = pmach->_registers[r];
+	bt->_shadow[BTRACE_CC] = pmach->_cc;
+	bt->_seen = checked_calloc(pmach->_textsize, "la trace binaire");
+	bt->_writes = NULL;
+	bt->_nwrites = bt->_maxwrites = 0;
+	bt->_keys = NULL;
+	bt->_nkeys = bt->_maxkeys = 0;
+
+	put_u32(bt, BTRACE_MAGIC);
+	put_u32(bt, BTRACE_VERSION);
+	put_u32(bt, pmach->_textsize);
+	put_u32(bt, pmach->_datasize);
+	put_u32(bt, pmach->_dataend);
+	put_u32(bt, bt->_interval);
+	keyframe(bt);
+
+	bt->_hooks = (Hooks) {._ctx = bt, ._notrace = true, ._write = hook_write, ._retire = hook_retire};
+	hooks_add(pmach, &bt->_hooks);
+	active = bt;
+	if (!registered) {
+		atexit(close_active);
+		registered = true;
+	}
+	return bt;
+}
+
+void btrace_data(Btrace *bt, unsigned addr, Word old, Word value) {
+	if (bt->_nwrites == bt->_maxwrites) {
+		bt->_maxwrites = bt->_maxwrites > 0 ? 2 * bt->_maxwrites : BTRACE_MAXWRITES;
+		bt->_writes = checked_realloc(bt->_writes, bt->_maxwrites * sizeof(Btrace_Write), "la trace binaire");
+	}
+	Btrace_Write *pw = &bt->_writes[bt->_nwrites++];
+	pw->_mem = true;
+	pw->_index = addr;
+	pw->_old = old;
+	pw->_value = value;
+}
+
+void btrace_step(Btrace *bt, unsigned pc) {
+	Machine *pmach = bt->_pmach;
+
+	// Registres et code condition modifiés depuis le dernier enregistrement
+	unsigned changed[NREGISTERS + 1];
+	unsigned nchanged = 0;
+	for (int r = 0; r < NREGISTERS; r++)
+		if (pmach->_registers[r] != bt->_shadow[r])
+			changed[nchanged++] = r;
+	if ((Word) pmach->_cc != bt->_shadow[BTRACE_CC])
+		changed[nchanged++] = BTRACE_CC;
+
+	bool fresh = pc < pmach->_textsize && !bt->_seen[pc];
+	unsigned nwrites = bt->_nwrites + nchanged;
+	put_varint(bt, ((zigzag(pc - (bt->_prevpc + 1)) << 2) | (fresh << 1) | (nwrites > 0)) + 1);
+	if (fresh) {
+		put_u32(bt, pmach->_text[pc]._raw);
+		bt->_seen[pc] = 1;
+	}
+	if (nwrites > 0) {
+		put_varint(bt, nwrites);
+		for (unsigned i = 0; i < bt->_nwrites; i++) {
+			Btrace_Write *pw = &bt->_writes[i];
+			put_varint(bt, ((uint64_t) pw->_index << 1) | 1);
+			put_varint(bt, zigzag(pw->_value - pw->_old));
+		}
+		for (unsigned i = 0; i < nchanged; i++) {
+			unsigned r = changed[i];
+			Word value = r == BTRACE_CC ? (Word) pmach->_cc : pmach->_registers[r];
+			put_varint(bt, (uint64_t) r << 1);
+			put_varint(bt, zigzag(value - bt->_shadow[r]));
+			bt->_shadow[r] = value;
+		}
+	}
+
+	bt->_nwrites = 0;
+	bt->_prevpc = pc;
+	if (++bt->_records % bt->_interval == 0)
+		keyframe(bt);
+}
+
+void btrace_close(Btrace *bt) {
+	Machine *pmach = bt->_pmach;
+
+	// Instruction interrompue par une erreur après avoir écrit en mémoire
+	if (bt->_nwrites > 0)
+		btrace_step(bt, pmach->_pc - 1);
+
+	uint64_t end = bt->_offset + bt->_len;
+	put_byte(bt, 0);
+	put_byte(bt, 'E');
+	put_varint(bt, bt->_records);
+	put_varint(bt, pmach->_pc);
+	put_varint(bt, bt->_nkeys);
+	for (unsigned k = 0; k < bt->_nkeys; k++) {
+		put_varint(bt, bt->_keys[2 * k]);
+		put_varint(bt, bt->_keys[2 * k + 1]);
+	}
+	for (unsigned a = 0; a < pmach->_textsize; a++)
+		put_u32(bt, bt->_seen[a] ? pmach->_text[a]._raw : 0);
+	for (unsigned a = 0; a < pmach->_textsize; a++)
+		put_byte(bt, bt->_seen[a]);
+	put_u32(bt, (uint32_t) end);
+	put_u32(bt, (uint32_t) (end >> 32));
+	put_u32(bt, BTRACE_END);
+	flush(bt);
+	close(bt->_fd);
+
+	hooks_remove(pmach, &bt->_hooks);
+	if (active == bt)
+		active = NULL;
+	free(bt->_buf);
+	free(bt->_seen);
+	free(bt->_writes);
+	free(bt->_keys);
+	free(bt);
+}
+
+/*======================================
+ *
+ *		RELECTURE
+ *======================================
+ */
+
+static bool get_byte(Btrace_Reader *prd, unsigned char *pc) {
+	if (prd->_pos >= prd->_size)
+		return false;
+	*pc = prd->_map[prd->_pos++];
+	return true;
+}
+
+static bool get_varint(Btrace_Reader *prd, uint64_t *pv) {
+	uint64_t v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		unsigned char c;
+		if (!get_byte(prd, &c))
+			return false;
+		v |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*pv = v;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool get_u32(Btrace_Reader *prd, uint32_t *pv) {
+	if (prd->_pos + 4 > prd->_size)
+		return false;
+	const unsigned char *p = prd->_map + prd->_pos;
+	*pv = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+	prd->_pos += 4;
+	return true;
+}
+
+/*!
+ * Lecture d'une image clé (après le marqueur 0 'K') et application à l'état.
+ */
+static bool read_keyframe(Btrace_Reader *prd) {
+	uint64_t v, prevpc, pc, cc;
+	if (!get_varint(prd, &v) || !get_varint(prd, &prevpc) || !get_varint(prd, &pc) || !get_varint(prd, &cc))
+		return false;
+	prd->_current = v;
+	prd->_prevpc = prevpc;
+	prd->_mach._pc = pc;
+	prd->_mach._cc = cc <= LAST_CC ? (Condition_Code) cc : CC_U;
+	for (int r = 0; r < NREGISTERS; r++) {
+		if (!get_varint(prd, &v))
+			return false;
+		prd->_mach._registers[r] = v;
+	}
+	for (unsigned a = 0; a < prd->_mach._datasize; a++)
+		if (!get_u32(prd, &prd->_data[a]))
+			return false;
+	prd->_mach._icount = prd->_current;
+	return true;
+}
+
+/*!
+ * Lecture de la fin de trace et de l'index des images clés.
+ */
+static bool read_footer(Btrace_Reader *prd) {
+	if (prd->_size < BTRACE_HEADER + 12)
+		return false;
+	prd->_pos = prd->_size - 12;
+	uint32_t lo, hi, magic;
+	if (!get_u32(prd, &lo) || !get_u32(prd, &hi) || !get_u32(prd, &magic) || magic != BTRACE_END)
+		return false;
+
+	prd->_pos = ((uint64_t) hi << 32) | lo;
+	unsigned char c0, c1;
+	uint64_t records, finalpc, nkeys;
+	if (!get_byte(prd, &c0) || !get_byte(prd, &c1) || c0 != 0 || c1 != 'E'
+	    || !get_varint(prd, &records) || !get_varint(prd, &finalpc) || !get_varint(prd, &nkeys)
+	    || nkeys > prd->_size)
+		return false;
+	prd->_records = records;
+	prd->_finalpc = finalpc;
+	prd->_keys = checked_realloc(NULL, 2 * (nkeys + 1) * sizeof(uint64_t), "la trace binaire");
+	for (uint64_t k = 0; k < nkeys; k++)
+		if (!get_varint(prd, &prd->_keys[2 * k]) || !get_varint(prd, &prd->_keys[2 * k + 1]))
+			return false;
+	prd->_nkeys = nkeys;
+
+	for (unsigned a = 0; a < prd->_mach._textsize; a++)
+		if (!get_u32(prd, &prd->_text[a]._raw))
+			return false;
+	for (unsigned a = 0; a < prd->_mach._textsize; a++)
+		if (!get_byte(prd, &prd->_seen[a]))
+			return false;
+	prd->_complete = true;
+	return true;
+}
+
+bool btrace_reader_open(Btrace_Reader *prd, const char *file) {
+	memset(prd, 0, sizeof(*prd));
+	int fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < BTRACE_HEADER) {
+		close(fd);
+		return false;
+	}
+	void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+	prd->_map = p;
+	prd->_size = st.st_size;
+
+	uint32_t magic, version, textsize, datasize, dataend, interval;
+	if (!get_u32(prd, &magic) || !get_u32(prd, &version) || magic != BTRACE_MAGIC
+	    || version != BTRACE_VERSION || !get_u32(prd, &textsize) || !get_u32(prd, &datasize)
+	    || !get_u32(prd, &dataend) || !get_u32(prd, &interval)
+	    || (uint64_t) datasize * 4 > prd->_size) {
+		btrace_reader_close(prd);
+		return false;
+	}
+	prd->_interval = interval;
+	prd->_text = calloc(textsize > 0 ? textsize : 1, sizeof(Instruction));
+	prd->_data = calloc(datasize > 0 ? datasize : 1, sizeof(Word));
+	prd->_seen = calloc(textsize > 0 ? textsize : 1, 1);
+	if (prd->_text == NULL || prd->_data == NULL || prd->_seen == NULL) {
+		btrace_reader_close(prd);
+		return false;
+	}
+	load_program(&prd->_mach, textsize, prd->_text, datasize, prd->_data, dataend);
+
+	// Index et instructions (trace complète), puis image clé initiale
+	uint64_t start = prd->_pos;
+	if (!read_footer(prd)) {
+		free(prd->_keys);
+		prd->_keys = NULL;
+		prd->_nkeys = 0;
+		prd->_complete = false;
+	}
+	prd->_pos = start;
+	unsigned char c0, c1;
+	if (!get_byte(prd, &c0) || !get_byte(prd, &c1) || c0 != 0 || c1 != 'K' || !read_keyframe(prd)) {
+		btrace_reader_close(prd);
+		return false;
+	}
+	return true;
+}
+
+bool btrace_next(Btrace_Reader *prd, Btrace_Record *prec) {
+	Btrace_Record rec;
+	if (prec == NULL)
+		prec = &rec;
+	Machine *pmach = &prd->_mach;
+
+	uint64_t h;
+	for (;;) {
+		if (!get_varint(prd, &h))
+			return false;
+		if (h != 0)
+			break;
+		unsigned char type;
+		if (!get_byte(prd, &type) || type != 'K' || !read_keyframe(prd))
+			return false; // 'E' : fin de trace
+	}
+	h -= 1;
+
+	unsigned pc = prd->_prevpc + 1 + unzigzag(h >> 2);
+	prec->_index = prd->_current;
+	prec->_pc = pc;
+	prec->_nwrites = 0;
+	if (h & 2) {
+		uint32_t raw;
+		if (!get_u32(prd, &raw))
+			return false;
+		if (pc < pmach->_textsize) {
+			prd->_text[pc]._raw = raw;
+			prd->_seen[pc] = 1;
+		}
+	}
+	prec->_known = pc < pmach->_textsize && prd->_seen[pc];
+	prec->_instr = prec->_known ? prd->_text[pc] : (Instruction) {._raw = 0};
+
+	if (h & 1) {
+		uint64_t n;
+		if (!get_varint(prd, &n))
+			return false;
+		for (uint64_t i = 0; i < n; i++) {
+			uint64_t idx, delta;
+			if (!get_varint(prd, &idx) || !get_varint(prd, &delta))
+				return false;
+			Btrace_Write w = {._mem = idx & 1, ._index = idx >> 1};
+			if (w._mem) {
+				if (w._index >= pmach->_datasize)
+					return false;
+				w._old = prd->_data[w._index];
+				w._value = w._old + unzigzag(delta);
+				prd->_data[w._index] = w._value;
+			} else if (w._index == BTRACE_CC) {
+				w._old = pmach->_cc;
+				w._value = w._old + unzigzag(delta);
+				pmach->_cc = w._value <= LAST_CC ? (Condition_Code) w._value : CC_U;
+			} else if (w._index < NREGISTERS) {
+				w._old = pmach->_registers[w._index];
+				w._value = w._old + unzigzag(delta);
+				pmach->_registers[w._index] = w._value;
+			} else {
+				return false;
+			}
+			if (prec->_nwrites < BTRACE_MAXWRITES)
+				prec->_writes[prec->_nwrites++] = w;
+		}
+	}
+
+	prd->_prevpc = pc;
+	prd->_current++;
+	pmach->_icount = prd->_current;
+	pmach->_pc = pc + 1; // Corrigé par btrace_seek() d'après l'enregistrement suivant
+	return true;
+}
+
+/*!
+ * Compteur ordinal après l'état courant : adresse de l'enregistrement suivant,
+ * ou compteur final en fin de trace.
+ */
+static void peek_pc(Btrace_Reader *prd) {
+	uint64_t save = prd->_pos;
+	uint64_t h;
+	while (get_varint(prd, &h)) {
+		if (h != 0) {
+			prd->_mach._pc = prd->_prevpc + 1 + unzigzag((h - 1) >> 2);
+			break;
+		}
+		unsigned char type;
+		if (!get_byte(prd, &type))
+			break;
+		if (type == 'E') {
+			uint64_t records, finalpc;
+			if (get_varint(prd, &records) && get_varint(prd, &finalpc))
+				prd->_mach._pc = finalpc;
+			break;
+		}
+		if (type != 'K' || !read_keyframe(prd))
+			break;
+		save = prd->_pos;
+	}
+	prd->_pos = save;
+}
+
+bool btrace_seek(Btrace_Reader *prd, uint64_t pos) {
+	// Dernière image clé qui précède la position (la première est après l'en-tête)
+	uint64_t offset = BTRACE_HEADER;
+	uint64_t keyrec = 0;
+	for (unsigned k = 0; k < prd->_nkeys; k++) {
+		if (prd->_keys[2 * k] > pos)
+			break;
+		keyrec = prd->_keys[2 * k];
+		offset = prd->_keys[2 * k + 1];
+	}
+	if (pos < prd->_current || keyrec > prd->_current) {
+		prd->_pos = offset;
+		unsigned char c0, c1;
+		if (!get_byte(prd, &c0) || !get_byte(prd, &c1) || c0 != 0 || c1 != 'K' || !read_keyframe(prd))
+			return false;
+	}
+	while (prd->_current < pos)
+		if (!btrace_next(prd, NULL))
+			return false;
+	peek_pc(prd);
+	return true;
+}
+
+void btrace_reader_close(Btrace_Reader *prd) {
+	if (prd->_map != NULL)
+		munmap((void *) prd->_map, prd->_size);
+	free(prd->_keys);
+	free(prd->_text);
+	free(prd->_data);
+	free(prd->_seen);
+	memset(prd, 0, sizeof(*prd));
+}
@@ -0,0 +1,202 @@
+#ifndef _BTRACE_H_
+#define _BTRACE_H_
+
+/*!
+ * \file btrace.h
+ * \brief Trace binaire compacte de l'exécution et relecture.
+ *
+ * Une trace binaire est une suite d'enregistrements, un par instruction
+ * exécutée. Tous les entiers sont des \e varints (7 bits par octet, bit de
+ * poids fort = suite) ; les valeurs signées sont codées en \e zigzag. Les mots
+ * de 32 bits bruts sont en petit-boutiste.
+ *
+ *   - En-tête : \c BTRACE_MAGIC, \c BTRACE_VERSION, \c textsize, \c datasize,
+ *   \c dataend, intervalle entre images clés (6 mots de 32 bits) ; suit une
+ *   image clé initiale.
+ *
+ *   - Enregistrement : \c H = ((zigzag(pc - (pc_précédent + 1)) << 2) |
+ *   (nouvelle_instruction << 1) | écritures) + 1. Si le bit
+ *   nouvelle_instruction est mis, le mot d'instruction brut suit (il n'est
+ *   écrit qu'à la première exécution de chaque adresse). Si le bit écritures
+ *   est mis, suivent le nombre d'écritures puis, pour chacune, \c (i << 1) |
+ *   mémoire et zigzag(nouvelle - ancienne valeur), où \c i est l'adresse
+ *   écrite, le numéro du registre ou 16 pour le code condition.
+ *
+ *   - \c H = 0 introduit un enregistrement spécial : \c 'K' image clé (numéro
+ *   d'enregistrement, pc précédent, pc, code condition, registres puis segment
+ *   de données brut), \c 'E' fin de trace (nombre d'enregistrements, pc
+ *   final), suivie de l'index des images clés (nombre puis couples numéro,
+ *   position dans le fichier) et de la table des instructions vues (mots bruts
+ *   puis un octet vu/non vu par adresse), puis de la position de \c 'E' (64
+ *   bits) et de \c BTRACE_END.
+ *
+ * Les images clés périodiques permettent de se positionner rapidement
+ * n'importe où dans la trace ; une trace interrompue (sans fin) reste
+ * lisible séquentiellement.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+#include "hooks.h"
+
+//! Marque de début d'une trace binaire ("SPBT")
+#define BTRACE_MAGIC 0x54425053u
+
+//! Marque de fin d'une trace binaire ("SPBE")
+#define BTRACE_END 0x45425053u
+
+//! Version du format de trace
+#define BTRACE_VERSION 1
+
+//! Intervalle par défaut entre deux images clés (en instructions)
+#define BTRACE_INTERVAL 65536
+
+//! Nombre maximal d'écritures d'une instruction gardées dans un enregistrement relu
+#define BTRACE_MAXWRITES 32
+
+//! Numéro de « registre » désignant le code condition dans une écriture
+#define BTRACE_CC NREGISTERS
+
+//! Une écriture (registre, code condition ou mot mémoire)
+typedef struct
+{
+    bool _mem;			//!< Écriture en mémoire de données ?
+    unsigned _index;		//!< Adresse ou numéro de registre (\c BTRACE_CC : code condition)
+    Word _old;			//!< Ancienne valeur
+    Word _value;		//!< Nouvelle valeur
+} Btrace_Write;
+
+//! Écriture d'une trace binaire
+typedef struct Btrace
+{
+    int _fd;			//!< Fichier de sortie
+    unsigned char *_buf;	//!< Tampon d'écriture
+    unsigned _len;		//!< Octets occupés dans le tampon
+    uint64_t _offset;		//!< Position dans le fichier du début du tampon
+    Machine *_pmach;		//!< Machine tracée
+    unsigned _interval;		//!< Intervalle entre images clés
+    uint64_t _records;		//!< Nombre d'enregistrements écrits
+    unsigned _prevpc;		//!< Adresse de la dernière instruction tracée
+    Word _shadow[NREGISTERS + 1];//!< Registres et code condition au dernier enregistrement
+    unsigned char *_seen;	//!< Instructions déjà écrites, par adresse
+    Btrace_Write *_writes;	//!< Écritures mémoire de l'instruction en cours (MOVE, FILL : un bloc)
+    unsigned _nwrites;		//!< Nombre d'écritures mémoire en cours
+    unsigned _maxwrites;	//!< Nombre d'écritures allouées
+    uint64_t *_keys;		//!< Index des images clés : numéro d'enregistrement, position
+    unsigned _nkeys;		//!< Nombre d'images clés
+    unsigned _maxkeys;		//!< Nombre d'images clés allouées
+    Hooks _hooks;		//!< Crochets d'écriture et de fin d'instruction
+} Btrace;
+
+//! Ouverture d'une trace binaire
+/*!
+ * L'en-tête et l'image clé initiale (état courant de la machine) sont écrits,
+ * puis la trace enregistre ses crochets dans la machine (btrace_data() à
+ * chaque écriture en mémoire, btrace_step() à chaque fin d'instruction) ;
+ * elle remplace la trace textuelle de simul(). La trace est refermée
+ * automatiquement à la fin du simulateur, même sur erreur fatale.
+ *
+ * \param file le nom du fichier de trace
+ * \param pmach la machine tracée (programme chargé)
+ * \param interval intervalle entre images clés (0 : \c BTRACE_INTERVAL)
+ * \return la trace (à refermer par btrace_close())
+ */
+Btrace *btrace_open(const char *file, Machine *pmach, unsigned interval);
+
+//! Notification d'une écriture en mémoire de données (avant l'écriture)
+/*!
+ * \param bt la trace
+ * \param addr l'adresse écrite
+ * \param old l'ancienne valeur
+ * \param value la nouvelle valeur
+ */
+void btrace_data(Btrace *bt, unsigned addr, Word old, Word value);
+
+//! Enregistrement d'une instruction exécutée
+/*!
+ * \param bt la trace
+ * \param pc l'adresse de l'instruction (déjà exécutée)
+ */
+void btrace_step(Btrace *bt, unsigned pc);
+
+//! Fermeture d'une trace binaire (écriture de l'index)
+/*!
+ * Les crochets sont retirés de la machine.
+ *
+ * \param bt la trace
+ */
+void btrace_close(Btrace *bt);
+
+//! Un enregistrement relu
+typedef struct
+{
+    uint64_t _index;		//!< Numéro de l'enregistrement (0 pour la première instruction)
+    unsigned _pc;		//!< Adresse de l'instruction
+    Instruction _instr;		//!< L'instruction (si connue)
+    bool _known;		//!< L'instruction a-t-elle déjà été vue ?
+    Btrace_Write _writes[BTRACE_MAXWRITES];//!< Premières écritures (avec leur ancienne valeur)
+    unsigned _nwrites;		//!< Nombre d'écritures gardées
+} Btrace_Record;
+
+//! Relecture d'une trace binaire
+/*!
+ * L'état reconstruit est celui d'une machine (registres, code condition,
+ * compteur ordinal, segment de données, segment de texte pour les
+ * instructions déjà vues) après un certain nombre d'instructions.
+ */
+typedef struct
+{
+    const unsigned char *_map;	//!< Contenu du fichier (projeté en mémoire)
+    uint64_t _size;		//!< Taille du fichier
+    uint64_t _pos;		//!< Position de lecture
+    unsigned _interval;		//!< Intervalle entre images clés
+    uint64_t *_keys;		//!< Index des images clés (NULL si trace interrompue)
+    unsigned _nkeys;		//!< Nombre d'images clés indexées
+    uint64_t _records;		//!< Nombre total d'enregistrements (si fin présente)
+    bool _complete;		//!< La fin de trace est-elle présente ?
+    unsigned _finalpc;		//!< Compteur ordinal final (si fin présente)
+    uint64_t _current;		//!< Nombre d'instructions appliquées à l'état
+    unsigned _prevpc;		//!< Adresse de la dernière instruction appliquée
+    unsigned char *_seen;	//!< Instructions connues, par adresse
+    Instruction *_text;		//!< Segment de texte reconstruit
+    Word *_data;		//!< Segment de données reconstruit
+    Machine _mach;		//!< Machine reconstruite (pointe sur _text et _data)
+} Btrace_Reader;
+
+//! Ouverture d'une trace en lecture
+/*!
+ * \param prd le lecteur à initialiser
+ * \param file le nom du fichier de trace
+ * \return faux si le fichier n'est pas une trace valide
+ */
+bool btrace_reader_open(Btrace_Reader *prd, const char *file);
+
+//! Lecture et application de l'enregistrement suivant
+/*!
+ * \param prd le lecteur
+ * \param prec l'enregistrement lu (peut être NULL)
+ * \return faux à la fin de la trace
+ */
+bool btrace_next(Btrace_Reader *prd, Btrace_Record *prec);
+
+//! Positionnement après un nombre donné d'instructions
+/*!
+ * On repart de la dernière image clé qui précède la position demandée puis on
+ * applique les enregistrements suivants. L'état de la machine reconstruite
+ * (\c _mach) est alors celui qui suivait l'exécution de \a pos instructions.
+ *
+ * \param prd le lecteur
+ * \param pos le nombre d'instructions exécutées
+ * \return faux si la trace est plus courte
+ */
+bool btrace_seek(Btrace_Reader *prd, uint64_t pos);
+
+//! Fermeture d'une trace en lecture
+/*!
+ * \param prd le lecteur
+ */
+void btrace_reader_close(Btrace_Reader *prd);
+
+#endif
@@ -0,0 +1,476 @@
+/*!
+ * \file check_simul.c
+ * \brief Vérification des programmes d'exemple : résultats et débit
+ *
+ * Chaque fichier binaire de la ligne de commande est exécuté par simul_run()
+ * et son état final (issue, code et adresse de l'erreur, nombre
+ * d'instructions, \c pc, \c cc, registres et segment de données) comparé au
+ * fichier de référence \c nom.golden du répertoire \c -g ; une image que
+ * program_read() refuse doit toujours l'être.
+ *
+ * Le temps d'une exécution (remise à zéro de la machine comprise) est
+ * ensuite mesuré : chaque échantillon répète l'exécution pendant au moins
+ * \c CHECK_SAMPLE_NS, et la médiane de \c -n échantillons est comparée à
+ * celle du fichier \c baseline du même répertoire. Une image dont le débit
+ * baisse de plus de \c -t pour cent échoue. Les temps de référence dépendent
+ * de la machine hôte : ils se régénèrent, avec les résultats, par \c -u.
+ *
+ * Avec \c -f, les boucles comptées sont accélérées (voir loops.h), avec
+ * \c -m les appels des sous-programmes purs sont mémoïsés (voir memo.h) :
+ * l'état final doit rester exactement celui des références, écrites sans
+ * accélération.
+ *
+ * Avec \c -O, chaque image est d'abord optimisée par peephole_optimize()
+ * (voir peephole.h). Le nombre d'instructions, le compteur ordinal et
+ * l'adresse d'une erreur changent alors avec le programme, comme les
+ * adresses de retour empilées : seuls l'issue, le code de l'erreur, \c cc,
+ * les registres et les données statiques (sous \c dataend) sont comparés.
+ * D'une exécution arrêtée par le budget, seule l'issue est comparée.
+ *
+ * Avec \c -o, la console et le compteur sont projetés comme par
+ * <tt>test_simul -o</tt> (voir devices.h) ; ce qu'écrit le programme est
+ * ajouté à l'état, en lignes \c console.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+#include "program.h"
+#include "loops.h"
+#include "memo.h"
+#include "peephole.h"
+#include "devices.h"
+#include "error.h"
+#include "telemetry.h"
+
+//! Durée minimale d'un échantillon de mesure (ns)
+#define CHECK_SAMPLE_NS 10000000u
+
+//! Nombre maximal d'échantillons par image (option -n)
+#define CHECK_MAXSAMPLES 64
+
+//! Nombre maximal d'images de référence dans le fichier baseline
+#define CHECK_MAXIMAGES 1024
+
+//! Noms des issues d'exécution
+static const char *status_names[] = {"halt", "error", "budget"};
+
+//! Noms des codes condition
+static const char cc_names[] = "UZPN";
+
+//! Temps de référence d'une image
+typedef struct
+{
+    char _name[256];		//!< Nom de l'image (sans répertoire)
+    double _ns;			//!< Médiane du temps d'une exécution (ns)
+} Baseline;
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: check_simul [options] prog.bin...\n"
+	       "where options are:\n"
+	       "\t-g dir\t\tReference directory (default: Examples/golden)\n"
+	       "\t-u\t\tRewrite the reference results and times\n"
+	       "\t-n n\t\tTimed samples per image, median kept (default: 7)\n"
+	       "\t-t pct\t\tAllowed throughput drop in percent (default: 50)\n"
+	       "\t-b n\t\tInstruction budget per run (default: 1000000)\n"
+	       "\t-s\t\tSkip the timing: check the results only\n"
+	       "\t-f\t\tFast-forward counted loops (implies -s; not with -u)\n"
+	       "\t-m\t\tMemoize pure subroutines (implies -s; not with -u)\n"
+	       "\t-O\t\tPeephole-optimize each image first; compare only what the\n"
+	       "\t\t\toptimizer keeps (implies -s; not with -u)\n"
+	       "\t-o\t\tMap the console and counter ports, console output\n"
+	       "\t\t\tchecked too (implies -s)\n"
+	       "\t-h\t\tprint this help message\n");
+}
+
+//! Nom de l'image sans répertoire ni extension .bin
+static void image_name(const char *file, char *name, size_t size) {
+	const char *base = strrchr(file, '/');
+	base = base != NULL ? base + 1 : file;
+	size_t len = strlen(base);
+	if (len > 4 && strcmp(base + len - 4, ".bin") == 0)
+		len -= 4;
+	if (len >= size)
+		len = size - 1;
+	memcpy(name, base, len);
+	name[len] = '\0';
+}
+
+//! Écriture de l'état final d'une exécution, au format des fichiers de référence
+static void write_state(FILE *out, Machine *pmach, Run_Status status, Error err, unsigned addr) {
+	fprintf(out, "status %s\n", status_names[status]);
+	if (status == RUN_ERROR)
+		fprintf(out, "error %d at 0x%04x\n", err, addr);
+	fprintf(out, "icount %llu\n", (unsigned long long) pmach->_icount);
+	fprintf(out, "pc 0x%04x\n", pmach->_pc);
+	fprintf(out, "cc %c\n", cc_names[pmach->_cc <= LAST_CC ? pmach->_cc : CC_U]);
+	for (unsigned r = 0; r < NREGISTERS; r++)
+		fprintf(out, "R%02u 0x%08x\n", r, pmach->_registers[r]);
+	for (unsigned a = 0; a < pmach->_datasize; a++)
+		fprintf(out, "%s0x%08x%s", a % 8 == 0 ? "data " : " ", pmach->_data[a],
+			a % 8 == 7 || a + 1 == pmach->_datasize ? "\n" : "");
+}
+
+/*!
+ * Réduction d'un état à ce que l'optimisation doit préserver (option -O) :
+ * lignes \c icount et \c pc supprimées, adresse de l'erreur retirée, un
+ * mot de données par ligne et seulement sous \a dataend ; d'une exécution
+ * arrêtée par le budget, seule la ligne \c status reste.
+ *
+ * \return l'état réduit, à libérer par free()
+ */
+static char *reduce_state(const char *state, unsigned dataend) {
+	char *reduced;
+	size_t size;
+	FILE *out = open_memstream(&reduced, &size);
+	bool budget = strncmp(state, "status budget\n", 14) == 0;
+	unsigned a = 0;
+	for (const char *p = state; *p != '\0'; ) {
+		size_t len = strcspn(p, "\n");
+		if (strncmp(p, "status ", 7) == 0)
+			fprintf(out, "%.*s\n", (int) len, p);
+		else if (budget || strncmp(p, "icount ", 7) == 0 || strncmp(p, "pc ", 3) == 0)
+			;
+		else if (strncmp(p, "error ", 6) == 0)
+			fprintf(out, "error %d\n", atoi(p + 6));
+		else if (strncmp(p, "data ", 5) == 0) {
+			char *w = (char *) p + 5;
+			while (w < p + len) {
+				unsigned long word = strtoul(w, &w, 16);
+				if (a < dataend)
+					fprintf(out, "data 0x%04x 0x%08lx\n", a, word);
+				a++;
+			}
+		}
+		else
+			fprintf(out, "%.*s\n", (int) len, p);
+		p += len + (p[len] != '\0');
+	}
+	fclose(out);
+	return reduced;
+}
+
+/*!
+ * Copie optimisée d'un programme (option -O). Le programme d'origine est
+ * libéré ; il est rendu tel quel si l'optimiseur le refuse.
+ */
+static Program *optimize_program(Program *prog) {
+	size_t bytes = prog->_textsize * sizeof(Instruction);
+	Instruction *text = checked_realloc(NULL, bytes + 1, "la vérification");
+	memcpy(text, prog->_text, bytes);
+	Machine tmp;
+	// Les données ne sont que lues par l'optimiseur
+	load_program(&tmp, prog->_textsize, text, prog->_datasize, (Word *) prog->_data,
+		     prog->_dataend);
+	Peephole_Stats stats;
+	if (peephole_optimize(&tmp, &stats)) {
+		Program *opt = program_new(tmp._textsize, text, prog->_datasize, prog->_data,
+					   prog->_dataend);
+		program_release(prog);
+		prog = opt;
+	}
+	free(text);
+	return prog;
+}
+
+//! Lecture complète d'un fichier texte (NULL s'il est illisible)
+static char *read_file(const char *file) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL)
+		return NULL;
+	size_t size = 0, max = 4096;
+	char *buf = malloc(max);
+	size_t n;
+	while (buf != NULL && (n = fread(buf + size, 1, max - size - 1, in)) > 0) {
+		size += n;
+		if (size + 1 == max)
+			buf = realloc(buf, max *= 2);
+	}
+	fclose(in);
+	if (buf != NULL)
+		buf[size] = '\0';
+	return buf;
+}
+
+/*!
+ * Comparaison de l'état obtenu au fichier de référence, ou réécriture de
+ * celui-ci. La première ligne différente est affichée.
+ *
+ * \param reduce la référence est réduite par reduce_state() avant la
+ * comparaison (l'état \a state l'est déjà)
+ * \param dataend fin des données statiques du programme
+ * \return vrai si l'état est conforme (ou a été écrit)
+ */
+static bool check_state(const char *name, const char *golden, const char *state, bool update,
+			bool reduce, unsigned dataend) {
+	if (update) {
+		FILE *out = fopen(golden, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot create %s\n", golden);
+			return false;
+		}
+		fputs(state, out);
+		fclose(out);
+		return true;
+	}
+	char *expected = read_file(golden);
+	if (expected == NULL) {
+		printf("%s: FAIL (no reference %s)\n", name, golden);
+		return false;
+	}
+	if (reduce) {
+		char *reduced = reduce_state(expected, dataend);
+		free(expected);
+		expected = reduced;
+	}
+	bool same = strcmp(expected, state) == 0;
+	if (!same) {
+		const char *e = expected, *g = state;
+		unsigned line = 1;
+		for (;;) {
+			// Les textes diffèrent : ils ne peuvent pas finir ensemble ici
+			if (*e == '\0' || *g == '\0') {
+				printf("%s: FAIL at line %u (end of file)\n", name, line);
+				break;
+			}
+			size_t le = strcspn(e, "\n"), lg = strcspn(g, "\n");
+			if (le != lg || strncmp(e, g, le) != 0) {
+				printf("%s: FAIL at line %u\n\texpected: %.*s\n\tgot:      %.*s\n",
+				       name, line, (int) le, e, (int) lg, g);
+				break;
+			}
+			if ((e[le] == '\0') != (g[lg] == '\0')) {	// Fin de ligne finale d'un seul côté
+				printf("%s: FAIL at line %u (end of file)\n", name, line);
+				break;
+			}
+			e += le + (e[le] != '\0');
+			g += lg + (g[lg] != '\0');
+			line++;
+		}
+	}
+	free(expected);
+	return same;
+}
+
+//! Comparaison de deux durées pour qsort()
+static int compare_ns(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/*!
+ * Mesure du temps d'une exécution : médiane de \a nsamples échantillons,
+ * chacun répétant l'exécution (précédée de program_reset()) pendant au moins
+ * \c CHECK_SAMPLE_NS.
+ *
+ * \return la médiane, en ns par exécution
+ */
+static double time_runs(Machine *pmach, uint64_t budget, unsigned nsamples) {
+	double samples[CHECK_MAXSAMPLES];
+	for (unsigned s = 0; s < nsamples; s++) {
+		uint64_t runs = 0, t0 = telemetry_now_ns(), t;
+		do {
+			Error err;
+			unsigned addr;
+			program_reset(pmach);
+			simul_run(pmach, budget, &err, &addr);
+			runs++;
+		} while ((t = telemetry_now_ns()) - t0 < CHECK_SAMPLE_NS);
+		samples[s] = (double) (t - t0) / runs;
+	}
+	qsort(samples, nsamples, sizeof(double), compare_ns);
+	return samples[nsamples / 2];
+}
+
+//! Lecture du fichier des temps de référence (vide s'il n'existe pas)
+static unsigned read_baseline(const char *file, Baseline *base) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL)
+		return 0;
+	unsigned n = 0;
+	char line[512];
+	while (n < CHECK_MAXIMAGES && fgets(line, sizeof(line), in) != NULL)
+		if (line[0] != '#' && sscanf(line, "%255s %lf", base[n]._name, &base[n]._ns) == 2)
+			n++;
+	fclose(in);
+	return n;
+}
+
+int main(int argc, char *argv[]) {
+	const char *dir = "Examples/golden";
+	bool update = false, timing = true, fast_loops = false, memoize = false, optimize = false,
+		devices = false;
+	unsigned nsamples = 7;
+	double threshold = 50;
+	uint64_t budget = 1000000;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'u' || opt == 's' || opt == 'f' || opt == 'm' || opt == 'O'
+		    || opt == 'o') {
+			if (opt == 'u')
+				update = true;
+			else
+				timing = false;
+			if (opt == 'f')
+				fast_loops = true;
+			if (opt == 'm')
+				memoize = true;
+			if (opt == 'O')
+				optimize = true;
+			if (opt == 'o')
+				devices = true;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("gntb", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'g': dir = val; break;
+			case 'n': nsamples = strtoul(val, NULL, 10); break;
+			case 't': threshold = strtod(val, NULL); break;
+			case 'b': budget = strtoull(val, NULL, 10); break;
+		}
+	}
+	if (iarg >= argc || nsamples == 0 || nsamples > CHECK_MAXSAMPLES
+	    || threshold < 0 || threshold >= 100 || (update && (fast_loops || memoize || optimize))) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	char basefile[4096];
+	snprintf(basefile, sizeof(basefile), "%s/baseline", dir);
+	static Baseline base[CHECK_MAXIMAGES];
+	unsigned nbase = update ? 0 : read_baseline(basefile, base);
+	FILE *baseout = NULL;
+	if (update && timing) {
+		baseout = fopen(basefile, "w");
+		if (baseout == NULL) {
+			fprintf(stderr, "Cannot create %s\n", basefile);
+			return EXIT_FAILURE;
+		}
+		fprintf(baseout, "# image ns/run (median of %u samples, budget %llu)\n",
+			nsamples, (unsigned long long) budget);
+	}
+
+	unsigned failures = 0;
+	for (int i = iarg; i < argc; i++) {
+		char name[256], golden[4096];
+		image_name(argv[i], name, sizeof(name));
+		snprintf(golden, sizeof(golden), "%s/%s.golden", dir, name);
+
+		// Résultats
+		char *state;
+		size_t size;
+		FILE *out = open_memstream(&state, &size);
+		Program *prog = program_read(argv[i]);
+		if (prog != NULL && optimize)
+			prog = optimize_program(prog);
+		unsigned dataend = prog != NULL ? prog->_dataend : 0;
+		Machine mach;
+		if (prog == NULL)
+			fprintf(out, "status invalid\n");
+		else {
+			program_attach(prog, &mach);
+			program_release(prog);	// La machine tient sa référence
+			if (fast_loops)
+				loops_enable(&mach);
+			if (memoize)
+				memo_enable(&mach);
+			Console console;
+			Device counter;
+			char *output = NULL;
+			size_t outsize;
+			FILE *cout = NULL;
+			if (devices) {
+				cout = open_memstream(&output, &outsize);
+				console_attach(&console, &mach, cout);
+				counter_attach(&counter, &mach);
+			}
+			Error err = ERR_NOERROR;
+			unsigned addr = 0;
+			Run_Status status = simul_run(&mach, budget, &err, &addr);
+			write_state(out, &mach, status, err, addr);
+			if (devices) {
+				console_detach(&console, &mach);
+				device_remove(&mach, &counter);
+				fclose(cout);
+				for (const char *p = output; *p != '\0'; ) {
+					size_t len = strcspn(p, "\n");
+					fprintf(out, "console %.*s\n", (int) len, p);
+					p += len + (p[len] != '\0');
+				}
+				free(output);
+			}
+			loops_disable(&mach);
+			memo_disable(&mach);
+		}
+		fclose(out);
+		if (optimize) {
+			char *reduced = reduce_state(state, dataend);
+			free(state);
+			state = reduced;
+		}
+		bool ok = check_state(name, golden, state, update, optimize, dataend);
+		free(state);
+		if (prog == NULL || !ok) {
+			if (update)
+				printf("%s: reference written\n", name);
+			else if (ok)
+				printf("%s: ok (invalid image)\n", name);
+			failures += !ok;
+			if (prog != NULL)
+				program_detach(&mach);
+			continue;
+		}
+		uint64_t icount = mach._icount;
+
+		// Débit
+		if (!timing) {
+			printf("%s: %s\n", name, update ? "reference written" : "ok");
+			program_detach(&mach);
+			continue;
+		}
+		double ns = time_runs(&mach, budget, nsamples);
+		program_detach(&mach);
+		printf("%s: %s, %.0f ns/run, %.3g instructions/s", name,
+		       update ? "reference written" : "ok", ns, icount * 1e9 / ns);
+		if (update)
+			fprintf(baseout, "%s %.1f\n", name, ns);
+		else {
+			unsigned b = 0;
+			while (b < nbase && strcmp(base[b]._name, name) != 0)
+				b++;
+			if (b == nbase)
+				printf(" (no baseline)");
+			else {
+				double drop = 100 * (1 - base[b]._ns / ns);
+				printf(" (throughput %+.1f%% vs baseline)", -drop);
+				if (drop > threshold) {
+					printf(": FAIL, throughput dropped by more than %g%%", threshold);
+					failures++;
+				}
+			}
+		}
+		printf("\n");
+	}
+
+	if (baseout != NULL)
+		fclose(baseout);
+	if (!update)
+		printf("%d image(s), %u failure(s)\n", argc - iarg, failures);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
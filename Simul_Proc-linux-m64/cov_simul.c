@@ -0,0 +1,143 @@
+/*!
+ * \file cov_simul.c
+ * \brief Couverture d'un programme binaire sur un ensemble d'exécutions
+ *
+ * Chaque fichier binaire de la ligne de commande (format de read_program())
+ * est exécuté par simul_run() en relevant sa couverture (voir coverage.h).
+ * Tous doivent avoir le même segment de texte : ils ne diffèrent que par
+ * leurs données. Les couvertures sont fusionnées entre elles, avec les
+ * fichiers de couverture donnés par \c -m, et éventuellement accumulées dans
+ * un fichier (\c -o) que d'autres processus peuvent compléter en même temps.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+#include "coverage.h"
+
+//! Noms des issues d'exécution
+static const char *status_names[] = {"halt", "error", "budget"};
+
+//! Nombre maximal de fichiers de couverture fusionnés (option -m)
+#define MAXMERGE 256
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: cov_simul [options] prog.bin...\n"
+	       "where options are:\n"
+	       "\t-o file.cov\tAccumulate the coverage into file (created if needed)\n"
+	       "\t-m file.cov\tMerge a coverage file (may be repeated)\n"
+	       "\t-l\t\tDisplay the annotated listing\n"
+	       "\t-i file.info\tWrite an lcov summary\n"
+	       "\t-n n\t\tInstruction budget per run (default: 1000000000)\n"
+	       "\t-r\t\tReport only: do not run the programs\n"
+	       "\t-h\t\tprint this help message\n"
+	       "All programs must share the same text segment.\n");
+}
+
+int main(int argc, char *argv[]) {
+	const char *outfile = NULL, *infofile = NULL;
+	const char *merged[MAXMERGE];
+	unsigned nmerged = 0;
+	uint64_t budget = 1000000000;
+	bool listing = false, run = true;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'l' || opt == 'r') {
+			if (opt == 'l')
+				listing = true;
+			else
+				run = false;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("omin", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'o': outfile = val; break;
+			case 'i': infofile = val; break;
+			case 'n': budget = strtoull(val, NULL, 10); break;
+			case 'm':
+				if (nmerged == MAXMERGE) {
+					fprintf(stderr, "Too many coverage files\n");
+					return EXIT_FAILURE;
+				}
+				merged[nmerged++] = val;
+				break;
+		}
+	}
+	if (iarg >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	// Le premier programme fixe le segment de texte
+	Machine ref;
+	read_program(&ref, argv[iarg]);
+	Coverage *pcov = coverage_new(&ref);
+	int result = EXIT_SUCCESS;
+
+	for (int i = iarg; run && i < argc; i++) {
+		Machine mach;
+		read_program(&mach, argv[i]);
+		Coverage *prun = coverage_new(&mach);
+		if (prun->_hash != pcov->_hash || prun->_textsize != pcov->_textsize) {
+			fprintf(stderr, "%s: text segment differs from %s; skipped\n", argv[i], argv[iarg]);
+			coverage_free(prun);
+			result = EXIT_FAILURE;
+			continue;
+		}
+		Error err = ERR_NOERROR;
+		unsigned addr = 0;
+		coverage_attach(prun, &mach);
+		Run_Status status = simul_run(&mach, budget, &err, &addr);
+		coverage_detach(prun, &mach);
+		coverage_merge(pcov, prun);
+		coverage_free(prun);
+
+		printf("%s: %s", argv[i], status_names[status]);
+		if (status == RUN_ERROR)
+			printf(" (error %d at 0x%04x)", err, addr);
+		printf(", %llu instructions\n", (unsigned long long) mach._icount);
+	}
+
+	for (unsigned k = 0; k < nmerged; k++)
+		if (!coverage_load(pcov, merged[k]))
+			result = EXIT_FAILURE;
+	if (outfile != NULL && !coverage_save(pcov, outfile))
+		result = EXIT_FAILURE;
+
+	if (listing)
+		coverage_print(pcov, &ref);
+	else {
+		Coverage_Summary sum;
+		coverage_summary(pcov, &ref, &sum);
+		printf("%llu run(s): %u/%u instructions, %u/%u branch outcomes\n",
+		       (unsigned long long) pcov->_runs, sum._executed, sum._instructions,
+		       sum._outcomes, sum._branches);
+	}
+	if (infofile != NULL) {
+		FILE *out = fopen(infofile, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot create %s\n", infofile);
+			return EXIT_FAILURE;
+		}
+		coverage_lcov(pcov, &ref, argv[iarg], out);
+		fclose(out);
+	}
+
+	coverage_free(pcov);
+	return result;
+}
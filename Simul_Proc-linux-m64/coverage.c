@@ -0,0 +1,252 @@
+/***** coverage.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "coverage.h"
+#include "exec.h"
+#include "imgcache.h"
+#include "printer.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//! Taille d'un tableau de bits en octets
+#define BITMAP_SIZE(n) (((n) + 7) / 8)
+
+//! Bit de l'adresse \a a
+#define BIT(map, a) ((map)[(a) >> 3] >> ((a) & 7) & 1)
+
+//! Positionnement du bit de l'adresse \a a
+#define SET_BIT(map, a) ((map)[(a) >> 3] |= 1 << ((a) & 7))
+
+//! Branchement conditionnel bien formé
+static bool is_conditional(Instruction instr) {
+	Code_Op cop = instr.instr_generic._cop;
+	return (cop == BRANCH || cop == CALL) && instr.instr_generic._regcond != NC
+		&& instruction_check(instr) == ERR_NOERROR;
+}
+
+/*!
+ * Crochet de fin d'instruction : l'adresse est exécutée. Un branchement ne
+ * modifie pas le code condition : on en déduit s'il a été pris.
+ */
+static void hook_retire(void *ctx, Machine *pmach, unsigned addr, Instruction instr) {
+	Coverage *pcov = ctx;
+	SET_BIT(pcov->_executed, addr);
+	Code_Op cop = instr.instr_generic._cop;
+	if ((cop == BRANCH || cop == CALL) && instr.instr_generic._regcond != NC) {
+		if (condition_holds(instr.instr_generic._regcond, pmach->_cc))
+			SET_BIT(pcov->_taken, addr);
+		else
+			SET_BIT(pcov->_nottaken, addr);
+	}
+}
+
+//! Crochet d'erreur : l'instruction fautive a été atteinte
+static void hook_fault(void *ctx, Machine *pmach, Error err, unsigned addr) {
+	Coverage *pcov = ctx;
+	if (addr < pcov->_textsize)
+		SET_BIT(pcov->_executed, addr);
+}
+
+Coverage *coverage_new(const Machine *pmach) {
+	Coverage *pcov = checked_calloc(sizeof(Coverage), "la couverture");
+	size_t size = BITMAP_SIZE(pmach->_textsize);
+	pcov->_textsize = pmach->_textsize;
+	pcov->_hash = cache_hash(pmach->_text, pmach->_textsize * sizeof(Instruction));
+	pcov->_executed = checked_calloc(size, "la couverture");
+	pcov->_taken = checked_calloc(size, "la couverture");
+	pcov->_nottaken = checked_calloc(size, "la couverture");
+	pcov->_hooks = (Hooks) {._ctx = pcov, ._retire = hook_retire, ._fault = hook_fault};
+	return pcov;
+}
+
+void coverage_attach(Coverage *pcov, Machine *pmach) {
+	hooks_add(pmach, &pcov->_hooks);
+	pcov->_runs++;
+}
+
+void coverage_detach(Coverage *pcov, Machine *pmach) {
+	hooks_remove(pmach, &pcov->_hooks);
+}
+
+//! Union des tableaux de bits de \a src dans \a dst (mêmes tailles)
+static void merge_bitmaps(Coverage *dst, const uint8_t *executed, const uint8_t *taken,
+                          const uint8_t *nottaken, uint64_t runs) {
+	for (size_t i = 0; i < BITMAP_SIZE(dst->_textsize); i++) {
+		dst->_executed[i] |= executed[i];
+		dst->_taken[i] |= taken[i];
+		dst->_nottaken[i] |= nottaken[i];
+	}
+	dst->_runs += runs;
+}
+
+bool coverage_merge(Coverage *dst, const Coverage *src) {
+	if (dst->_textsize != src->_textsize || dst->_hash != src->_hash)
+		return false;
+	merge_bitmaps(dst, src->_executed, src->_taken, src->_nottaken, src->_runs);
+	return true;
+}
+
+/*!
+ * Lecture d'un fichier de couverture ouvert et fusion dans \a pcov.
+ *
+ * \return faux (avec un message) en cas d'erreur
+ */
+static bool read_coverage(Coverage *pcov, int fd, const char *file) {
+	Coverage_Header header;
+	size_t size = BITMAP_SIZE(pcov->_textsize);
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || header._magic != COVERAGE_MAGIC) {
+		fprintf(stderr, "%s: not a coverage file\n", file);
+		return false;
+	}
+	if (header._textsize != pcov->_textsize || header._hash != pcov->_hash) {
+		fprintf(stderr, "%s: coverage of another program\n", file);
+		return false;
+	}
+	uint8_t *maps = checked_calloc(3 * size, "la couverture");
+	bool ok = pread(fd, maps, 3 * size, sizeof(header)) == (ssize_t) (3 * size);
+	if (ok)
+		merge_bitmaps(pcov, maps, maps + size, maps + 2 * size, header._runs);
+	else
+		fprintf(stderr, "%s: truncated coverage file\n", file);
+	free(maps);
+	return ok;
+}
+
+bool coverage_load(Coverage *pcov, const char *file) {
+	int fd = open(file, O_RDONLY);
+	if (fd < 0) {
+		perror(file);
+		return false;
+	}
+	bool ok = read_coverage(pcov, fd, file);
+	close(fd);
+	return ok;
+}
+
+bool coverage_save(const Coverage *pcov, const char *file) {
+	int fd = open(file, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0) {
+		perror(file);
+		return false;
+	}
+	// Verrou exclusif sur tout le fichier, libéré par close()
+	struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET, .l_start = 0, .l_len = 0};
+	if (fcntl(fd, F_SETLKW, &lock) < 0) {
+		perror(file);
+		close(fd);
+		return false;
+	}
+
+	// Copie de pcov, augmentée du contenu actuel du fichier
+	size_t size = BITMAP_SIZE(pcov->_textsize);
+	Coverage total = *pcov;
+	uint8_t *maps = checked_calloc(3 * size, "la couverture");
+	memcpy(maps, pcov->_executed, size);
+	memcpy(maps + size, pcov->_taken, size);
+	memcpy(maps + 2 * size, pcov->_nottaken, size);
+	total._executed = maps;
+	total._taken = maps + size;
+	total._nottaken = maps + 2 * size;
+
+	struct stat st;
+	bool ok = fstat(fd, &st) == 0 && (st.st_size == 0 || read_coverage(&total, fd, file));
+	if (ok) {
+		Coverage_Header header = {
+			._magic = COVERAGE_MAGIC,
+			._textsize = total._textsize,
+			._hash = total._hash,
+			._runs = total._runs,
+		};
+		ok = pwrite(fd, &header, sizeof(header), 0) == sizeof(header)
+			&& pwrite(fd, maps, 3 * size, sizeof(header)) == (ssize_t) (3 * size)
+			&& ftruncate(fd, sizeof(header) + 3 * size) == 0;
+		if (!ok)
+			perror(file);
+	}
+	free(maps);
+	close(fd);
+	return ok;
+}
+
+void coverage_summary(const Coverage *pcov, const Machine *pmach, Coverage_Summary *psum) {
+	memset(psum, 0, sizeof(*psum));
+	psum->_instructions = pcov->_textsize;
+	for (unsigned a = 0; a < pcov->_textsize; a++) {
+		psum->_executed += BIT(pcov->_executed, a);
+		if (is_conditional(pmach->_text[a])) {
+			psum->_branches += 2;
+			psum->_outcomes += BIT(pcov->_taken, a) + BIT(pcov->_nottaken, a);
+		}
+	}
+}
+
+//! Contexte de l'annotation du listing
+typedef struct
+{
+    const Coverage *pcov;
+    const Machine *pmach;
+} Listing;
+
+//! Préfixe d'une ligne du listing annoté
+static void annotate(void *ctx, unsigned addr, Print_Buffer *pb) {
+	const Listing *pl = ctx;
+	const Coverage *pcov = pl->pcov;
+	pbuf_printf(pb, "%c ", BIT(pcov->_executed, addr) ? '*' : '#');
+	if (is_conditional(pl->pmach->_text[addr]))
+		pbuf_printf(pb, "%c%c | ", BIT(pcov->_taken, addr) ? 'T' : '-', BIT(pcov->_nottaken, addr) ? 'N' : '-');
+	else
+		pbuf_printf(pb, "   | ");
+}
+
+//! Pourcentage, 100 pour un total nul
+static double percent(unsigned n, unsigned total) {
+	return total == 0 ? 100.0 : 100.0 * n / total;
+}
+
+void coverage_print(const Coverage *pcov, Machine *pmach) {
+	Listing listing = {pcov, pmach};
+	print_program_annotated(pmach, annotate, &listing);
+
+	Coverage_Summary sum;
+	coverage_summary(pcov, pmach, &sum);
+	printf("\n*** COVERAGE (%llu run(s)) ***\n", (unsigned long long) pcov->_runs);
+	printf("Instructions: %u/%u (%.1f%%)\n", sum._executed, sum._instructions,
+	       percent(sum._executed, sum._instructions));
+	printf("Branch outcomes: %u/%u (%.1f%%)\n", sum._outcomes, sum._branches,
+	       percent(sum._outcomes, sum._branches));
+}
+
+void coverage_lcov(const Coverage *pcov, const Machine *pmach, const char *source, FILE *out) {
+	Coverage_Summary sum;
+	coverage_summary(pcov, pmach, &sum);
+
+	fprintf(out, "TN:\nSF:%s\n", source);
+	for (unsigned a = 0; a < pcov->_textsize; a++) {
+		if (!is_conditional(pmach->_text[a]))
+			continue;
+		// Branches non évaluées : "-" ; évaluées : nombre d'exécutions connues (0 ou 1)
+		bool seen = BIT(pcov->_executed, a);
+		for (unsigned b = 0; b < 2; b++) {
+			unsigned hit = BIT(b == 0 ? pcov->_taken : pcov->_nottaken, a);
+			if (seen)
+				fprintf(out, "BRDA:%u,0,%u,%u\n", a + 1, b, hit);
+			else
+				fprintf(out, "BRDA:%u,0,%u,-\n", a + 1, b);
+		}
+	}
+	fprintf(out, "BRF:%u\nBRH:%u\n", sum._branches, sum._outcomes);
+	for (unsigned a = 0; a < pcov->_textsize; a++)
+		fprintf(out, "DA:%u,%u\n", a + 1, BIT(pcov->_executed, a));
+	fprintf(out, "LF:%u\nLH:%u\nend_of_record\n", sum._instructions, sum._executed);
+}
+
+void coverage_free(Coverage *pcov) {
+	free(pcov->_executed);
+	free(pcov->_taken);
+	free(pcov->_nottaken);
+	free(pcov);
+}
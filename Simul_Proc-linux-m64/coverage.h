@@ -0,0 +1,142 @@
+#ifndef _COVERAGE_H_
+#define _COVERAGE_H_
+
+/*!
+ * \file coverage.h
+ * \brief Couverture des instructions et des branchements d'un programme.
+ *
+ * La couverture est relevée par des crochets (voir hooks.h) dans trois
+ * tableaux de bits indexés par l'adresse : instructions exécutées, et pour
+ * chaque \c BRANCH ou \c CALL conditionnel, condition vraie (pris) et
+ * condition fausse (non pris). L'union de deux couvertures du même segment de
+ * texte est le « ou » de leurs tableaux : elles se fusionnent d'une exécution,
+ * d'un fichier ou d'un processus à l'autre.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "machine.h"
+#include "hooks.h"
+
+//! En-tête d'un fichier de couverture
+/*!
+ * Le fichier contient cet en-tête puis les trois tableaux de bits (exécutées,
+ * prises, non prises) de \c (_textsize + 7) / 8 octets chacun ; le bit \c a%8
+ * de l'octet \c a/8 correspond à l'adresse \c a.
+ */
+typedef struct
+{
+    uint32_t _magic;		//!< \c COVERAGE_MAGIC
+    uint32_t _textsize;		//!< Taille du segment de texte
+    uint64_t _hash;		//!< Hachage du segment de texte (voir cache_hash())
+    uint64_t _runs;		//!< Nombre d'exécutions fusionnées
+} Coverage_Header;
+
+//! Marque des fichiers de couverture ("SCOV")
+#define COVERAGE_MAGIC 0x564f4353u
+
+//! Couverture d'un programme
+typedef struct
+{
+    unsigned _textsize;		//!< Taille du segment de texte
+    uint64_t _hash;		//!< Hachage du segment de texte
+    uint64_t _runs;		//!< Nombre d'exécutions relevées ou fusionnées
+    uint8_t *_executed;		//!< Instructions exécutées
+    uint8_t *_taken;		//!< Branchements conditionnels pris
+    uint8_t *_nottaken;		//!< Branchements conditionnels non pris
+    Hooks _hooks;		//!< Crochets de relevé
+} Coverage;
+
+//! Bilan d'une couverture
+typedef struct
+{
+    unsigned _instructions;	//!< Instructions du segment de texte
+    unsigned _executed;		//!< Instructions exécutées
+    unsigned _branches;		//!< Issues possibles (2 par branchement conditionnel)
+    unsigned _outcomes;		//!< Issues observées
+} Coverage_Summary;
+
+//! Création d'une couverture vide pour le programme chargé dans une machine
+/*!
+ * \param pmach la machine (programme chargé)
+ * \return la couverture, à libérer par coverage_free()
+ */
+Coverage *coverage_new(const Machine *pmach);
+
+//! Relevé de la couverture d'une exécution
+/*!
+ * Les crochets sont enregistrés dans la machine, qui doit contenir le même
+ * segment de texte ; l'exécution est comptée dans \c _runs.
+ */
+void coverage_attach(Coverage *pcov, Machine *pmach);
+
+//! Fin du relevé
+void coverage_detach(Coverage *pcov, Machine *pmach);
+
+//! Fusion de \a src dans \a dst
+/*!
+ * \return faux (sans rien modifier) si les segments de texte diffèrent
+ */
+bool coverage_merge(Coverage *dst, const Coverage *src);
+
+//! Fusion d'un fichier de couverture dans \a pcov
+/*!
+ * \param pcov la couverture
+ * \param file le fichier
+ * \return faux (avec un message) si le fichier est illisible ou concerne un
+ * autre segment de texte
+ */
+bool coverage_load(Coverage *pcov, const char *file);
+
+//! Fusion de \a pcov dans un fichier de couverture (créé au besoin)
+/*!
+ * Le fichier est verrouillé en écriture (verrou POSIX, \c fcntl(F_SETLKW),
+ * et non \c flock) le temps de la lecture, de la fusion et de la
+ * réécriture : plusieurs processus peuvent y accumuler leurs exécutions en
+ * même temps.
+ *
+ * \param pcov la couverture
+ * \param file le fichier
+ * \return faux (avec un message) en cas d'erreur ou si le fichier concerne un
+ * autre segment de texte
+ */
+bool coverage_save(const Coverage *pcov, const char *file);
+
+//! Bilan d'une couverture
+/*!
+ * \param pcov la couverture
+ * \param pmach la machine (même segment de texte) : situe les branchements
+ * \param psum le bilan à remplir
+ */
+void coverage_summary(const Coverage *pcov, const Machine *pmach, Coverage_Summary *psum);
+
+//! Listing annoté (voir print_program_annotated())
+/*!
+ * Chaque instruction est précédée de \c * si elle a été exécutée, \c # sinon,
+ * et pour les branchements conditionnels de \c T (pris) et \c N (non pris),
+ * ou \c - pour une issue jamais observée. Le bilan suit le listing.
+ *
+ * \param pcov la couverture
+ * \param pmach la machine (même segment de texte)
+ */
+void coverage_print(const Coverage *pcov, Machine *pmach);
+
+//! Bilan au format lcov (tracefile \c .info)
+/*!
+ * Chaque adresse du segment de texte est une ligne (numérotée à partir de
+ * 1) du fichier source \a source ; chaque branchement conditionnel est un
+ * bloc de deux branches (prise, non prise).
+ *
+ * \param pcov la couverture
+ * \param pmach la machine (même segment de texte)
+ * \param source nom du fichier source déclaré (\c SF)
+ * \param out le flot de sortie
+ */
+void coverage_lcov(const Coverage *pcov, const Machine *pmach, const char *source, FILE *out);
+
+//! Libération d'une couverture
+void coverage_free(Coverage *pcov);
+
+#endif
@@ -0,0 +1,158 @@
+/***** devices.c *****/
+#include "devices.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void device_add(Machine *pmach, Device *pdev) {
+	Device **pp = &pmach->_devices;
+	while (*pp != NULL)
+		pp = &(*pp)->_next;
+	pdev->_next = NULL;
+	*pp = pdev;
+}
+
+void device_remove(Machine *pmach, Device *pdev) {
+	for (Device **pp = &pmach->_devices; *pp != NULL; pp = &(*pp)->_next)
+		if (*pp == pdev) {
+			*pp = pdev->_next;
+			pdev->_next = NULL;
+			return;
+		}
+}
+
+//! Périphérique projeté à une adresse, ou NULL
+static Device *device_at(const Machine *pmach, unsigned addr) {
+	for (Device *pdev = pmach->_devices; pdev != NULL; pdev = pdev->_next)
+		if (addr - pdev->_base < pdev->_nports)
+			return pdev;
+	return NULL;
+}
+
+bool device_read(Machine *pmach, unsigned addr, Word *pvalue) {
+	Device *pdev = device_at(pmach, addr);
+	if (pdev == NULL || pdev->_read == NULL)
+		return false;
+	*pvalue = pdev->_read(pdev->_ctx, pmach, addr - pdev->_base);
+	return true;
+}
+
+bool device_writable(const Machine *pmach, unsigned addr) {
+	Device *pdev = device_at(pmach, addr);
+	return pdev != NULL && pdev->_write != NULL;
+}
+
+bool device_write(Machine *pmach, unsigned addr, Word value) {
+	Device *pdev = device_at(pmach, addr);
+	if (pdev == NULL || pdev->_write == NULL)
+		return false;
+	pdev->_write(pdev->_ctx, pmach, addr - pdev->_base, value);
+	return true;
+}
+
+/*======================================
+ *
+ *		CONSOLE
+ *======================================
+ */
+
+void console_flush(Console *pcons) {
+	if (pcons->_len == 0)
+		return;
+	fwrite(pcons->_buf, 1, pcons->_len, pcons->_out);
+	fflush(pcons->_out);
+	pcons->_len = 0;
+	pcons->_flushes++;
+}
+
+//! Écriture d'un port de la console : entier (port 0) ou caractère (port 1)
+static void console_write(void *ctx, Machine *pmach, unsigned port, Word value) {
+	Console *pcons = ctx;
+	// Place pour un entier signé sur 32 bits et sa fin de ligne (12 caractères,
+	// « -2147483648\n ») ; le texte est formaté à part, sans son '\0'
+	char num[13];
+	if (pcons->_len + sizeof(num) - 1 > CONSOLE_BUFSIZE)
+		console_flush(pcons);
+	if (port == 0) {
+		int n = snprintf(num, sizeof(num), "%d\n", (int32_t) value);
+		memcpy(pcons->_buf + pcons->_len, num, n);
+		pcons->_len += n;
+	}
+	else
+		pcons->_buf[pcons->_len++] = (char) value;
+}
+
+void console_attach(Console *pcons, Machine *pmach, FILE *out) {
+	pcons->_out = out;
+	pcons->_buf = checked_realloc(NULL, CONSOLE_BUFSIZE, "la console");
+	pcons->_len = 0;
+	pcons->_flushes = 0;
+	pcons->_device = (Device) {._ctx = pcons, ._base = DEVICE_CONSOLE, ._nports = 2, ._write = console_write};
+	device_add(pmach, &pcons->_device);
+}
+
+void console_detach(Console *pcons, Machine *pmach) {
+	console_flush(pcons);
+	device_remove(pmach, &pcons->_device);
+	free(pcons->_buf);
+	pcons->_buf = NULL;
+}
+
+/*======================================
+ *
+ *		ENTRÉE
+ *======================================
+ */
+
+//! Lecture anticipée de l'entier suivant
+static void input_fill(Input *pin) {
+	if (pin->_ready || pin->_eof)
+		return;
+	int value;
+	if (fscanf(pin->_in, "%d", &value) == 1) {
+		pin->_next = value;
+		pin->_ready = true;
+	} else
+		pin->_eof = true;
+}
+
+//! Lecture d'un port de l'entrée : entier suivant (port 0) ou état (port 1)
+static Word input_read(void *ctx, Machine *pmach, unsigned port) {
+	Input *pin = ctx;
+	input_fill(pin);
+	if (port == 1)
+		return pin->_ready;
+	if (!pin->_ready)
+		return 0;
+	pin->_ready = false;
+	return pin->_next;
+}
+
+void input_attach(Input *pin, Machine *pmach, FILE *in) {
+	pin->_in = in;
+	pin->_ready = false;
+	pin->_eof = false;
+	pin->_device = (Device) {._ctx = pin, ._base = DEVICE_INPUT, ._nports = 2, ._read = input_read};
+	device_add(pmach, &pin->_device);
+}
+
+void input_detach(Input *pin, Machine *pmach) {
+	device_remove(pmach, &pin->_device);
+}
+
+/*======================================
+ *
+ *		COMPTEUR
+ *======================================
+ */
+
+//! Lecture d'un port du compteur : poids faible (port 0) ou fort (port 1)
+static Word counter_read(void *ctx, Machine *pmach, unsigned port) {
+	return port == 0 ? (Word) pmach->_icount : (Word) (pmach->_icount >> 32);
+}
+
+void counter_attach(Device *pdev, Machine *pmach) {
+	*pdev = (Device) {._base = DEVICE_COUNTER, ._nports = 2, ._read = counter_read};
+	device_add(pmach, pdev);
+}
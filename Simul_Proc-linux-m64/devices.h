@@ -0,0 +1,160 @@
+#ifndef _DEVICES_H_
+#define _DEVICES_H_
+
+/*!
+ * \file devices.h
+ * \brief Périphériques projetés en mémoire de données.
+ *
+ * Un périphérique occupe une plage d'adresses (ses \e ports) au-delà du
+ * segment de données de la machine. Les instructions qui lisent un opérande
+ * en mémoire (\c LOAD, \c ADD, \c SUB, \c PUSH) ou y rangent une valeur
+ * (\c STORE, \c POP) à l'une de ces adresses accèdent au périphérique au
+ * lieu de provoquer \c ERR_SEGDATA. Le bus n'est consulté qu'après l'échec
+ * de la vérification habituelle de l'adresse : un accès ordinaire au segment
+ * de données ne coûte rien de plus. Une adresse du segment de données n'est
+ * jamais celle d'un port, même si un périphérique s'y trouve projeté. Les
+ * instructions de bloc (\c MOVE, \c FILL) n'accèdent jamais aux ports.
+ *
+ * Les périphériques standard sont projetés en haut de l'espace adressable
+ * (voir \c DEVICE_CONSOLE, \c DEVICE_INPUT, \c DEVICE_COUNTER) :
+ *
+ *   - la console reçoit des entiers (écrits en décimal, un par ligne) ou des
+ *   caractères, et les accumule dans un tampon de l'hôte vidé par gros blocs ;
+ *
+ *   - l'entrée fournit un à un les entiers (en décimal) d'un fichier de
+ *   l'hôte ;
+ *
+ *   - le compteur donne le nombre d'instructions exécutées par la machine.
+ *
+ * Les accès aux ports ne sont pas signalés aux crochets (voir hooks.h), et
+ * simul() comme simul_run() n'accélèrent ni boucles ni appels (voir loops.h,
+ * memo.h) quand un périphérique est projeté. Les autres moteurs d'exécution
+ * (aot.h, batch.h) ne connaissent pas les périphériques : leurs ports y
+ * provoquent toujours \c ERR_SEGDATA.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "machine.h"
+
+//! Ports de la console : \c +0 entier (écriture), \c +1 caractère (écriture)
+#define DEVICE_CONSOLE 0xffff0
+
+//! Ports de l'entrée : \c +0 entier suivant (0 à la fin), \c +1 1 s'il en reste un (lectures)
+#define DEVICE_INPUT 0xffff4
+
+//! Ports du compteur d'instructions : \c +0 32 bits de poids faible, \c +1 de poids fort (lectures)
+#define DEVICE_COUNTER 0xffff8
+
+//! Taille du tampon de la console
+#define CONSOLE_BUFSIZE 65536
+
+//! Un périphérique
+/*!
+ * Chaque opération peut être NULL : le port correspondant ne peut pas être
+ * lu (ou écrit), et son accès provoque \c ERR_SEGDATA. Les opérations
+ * reçoivent le numéro du port dans la plage du périphérique.
+ */
+typedef struct Device
+{
+    void *_ctx;			//!< Contexte passé à chaque opération
+    unsigned _base;		//!< Adresse du premier port
+    unsigned _nports;		//!< Nombre de ports
+
+    //! Lecture d'un port
+    Word (*_read)(void *ctx, Machine *pmach, unsigned port);
+    //! Écriture d'un port
+    void (*_write)(void *ctx, Machine *pmach, unsigned port, Word value);
+
+    struct Device *_next;	//!< Périphérique suivant de la machine
+} Device;
+
+//! Projection d'un périphérique
+/*!
+ * Le périphérique doit rester valide tant qu'il est projeté. Si des plages se
+ * recouvrent, le premier projeté l'emporte.
+ *
+ * \param pmach la machine
+ * \param pdev le périphérique
+ */
+void device_add(Machine *pmach, Device *pdev);
+
+//! Retrait d'un périphérique (sans effet s'il n'est pas projeté)
+void device_remove(Machine *pmach, Device *pdev);
+
+//! Lecture d'un port (utilisé par decode_execute())
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse (hors du segment de données)
+ * \param pvalue reçoit la valeur lue
+ * \return faux si aucun port lisible n'est projeté à cette adresse
+ */
+bool device_read(Machine *pmach, unsigned addr, Word *pvalue);
+
+//! Le port de cette adresse peut-il être écrit ?
+bool device_writable(const Machine *pmach, unsigned addr);
+
+//! Écriture d'un port (utilisé par decode_execute())
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse (hors du segment de données)
+ * \param value la valeur écrite
+ * \return faux si aucun port inscriptible n'est projeté à cette adresse
+ */
+bool device_write(Machine *pmach, unsigned addr, Word value);
+
+//! Console : sortie tamponnée
+typedef struct
+{
+    Device _device;		//!< Le périphérique
+    FILE *_out;			//!< Destination
+    char *_buf;			//!< Tampon de \c CONSOLE_BUFSIZE octets
+    size_t _len;		//!< Nombre d'octets en attente
+    uint64_t _flushes;		//!< Nombre d'écritures sur \c _out
+} Console;
+
+//! Projection d'une console en \c DEVICE_CONSOLE
+/*!
+ * \param pcons la console
+ * \param pmach la machine
+ * \param out la destination, qui reçoit le tampon quand il est plein
+ */
+void console_attach(Console *pcons, Machine *pmach, FILE *out);
+
+//! Vidage du tampon de la console
+void console_flush(Console *pcons);
+
+//! Retrait de la console, après vidage de son tampon
+void console_detach(Console *pcons, Machine *pmach);
+
+//! Entrée : entiers lus dans un fichier
+typedef struct
+{
+    Device _device;		//!< Le périphérique
+    FILE *_in;			//!< Source
+    Word _next;			//!< Prochain entier (si \c _ready)
+    bool _ready;		//!< \c _next est-il lu ?
+    bool _eof;			//!< Fin de la source (ou texte qui n'est pas un entier)
+} Input;
+
+//! Projection d'une entrée en \c DEVICE_INPUT
+/*!
+ * \param pin l'entrée
+ * \param pmach la machine
+ * \param in la source, lue au fil des accès
+ */
+void input_attach(Input *pin, Machine *pmach, FILE *in);
+
+//! Retrait de l'entrée (la source n'est pas refermée)
+void input_detach(Input *pin, Machine *pmach);
+
+//! Projection du compteur d'instructions en \c DEVICE_COUNTER
+/*!
+ * \param pdev le périphérique à initialiser
+ * \param pmach la machine
+ */
+void counter_attach(Device *pdev, Machine *pmach);
+
+#endif
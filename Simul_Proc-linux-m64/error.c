@@ -15,8 +15,13 @@
     ERR_SEGTEXT,	//!< Violation de taille du segment de texte
     ERR_SEGDATA,	//!< Violation de taille du segment de données
     ERR_SEGSTACK,	//!< Violation de taille du segment de pile
+    ERR_DIVZERO,	//!< Division par zéro
 
 */
+
+/*extern*/ __thread jmp_buf *error_recover = NULL;
+/*extern*/ __thread unsigned error_addr = 0;
+
 //! Affichage d'une erreur et fin du simulateur
 /*!
  * \note Toutes les erreurs étant fatales on ne revient jamais de cette
@@ -27,6 +32,10 @@
  * \param addr adresse de l'erreur
  */
 void error(Error err, unsigned addr){
+	if(error_recover != NULL && err != ERR_NOERROR){//Erreur récupérée par l'appelant : ni message ni fin du simulateur.
+		error_addr = addr;
+		longjmp(*error_recover, err);
+	}
 	printf("ERROR: ");
 	switch(err){
 		case ERR_NOERROR:
@@ -53,6 +62,9 @@ void error(Error err, unsigned addr){
 		case ERR_SEGSTACK://Si on empile beaucoup. La segment de pile déborde dans la segment de donnée. 
 			printf("Erreur de segmentation : Violation de taille du segment de pile à l'adresse 0x%08x\n", addr);
 			exit(1);
+		case ERR_DIVZERO://DIV ou MOD avec un opérande nul.
+			printf("Division par zéro à l'adresse 0x%08x\n", addr);
+			exit(1);
 		default:
 			exit(0);
 	}
@@ -66,5 +78,33 @@ void error(Error err, unsigned addr){
  * \param addr adresse de l'erreur
  */
 void warning(Warning warn, unsigned addr){
-	printf("WARNING: Program fini correctement au \tat 0x%08x\n",addr);
+	if(error_recover != NULL){//Exécution silencieuse (voir simul_run())
+		return;
+	}
+	switch(warn){
+		case WARN_HALT:
+			printf("WARNING: Program fini correctement au \tat 0x%08x\n",addr);
+			break;
+		case WARN_STACK://L'analyse statique ne peut garantir que la pile suffit.
+			printf("WARNING: Pile d'exécution potentiellement insuffisante à l'adresse 0x%08x\n",addr);
+			break;
+	}
+}
+
+void *checked_realloc(void *ptr, size_t size, const char *what){
+	void *p = realloc(ptr, size > 0 ? size : 1);
+	if(p == NULL){
+		fprintf(stderr, "Erreur d'allocation mémoire pour %s\n", what);
+		exit(1);
+	}
+	return p;
+}
+
+void *checked_calloc(size_t size, const char *what){
+	void *p = calloc(1, size > 0 ? size : 1);
+	if(p == NULL){
+		fprintf(stderr, "Erreur d'allocation mémoire pour %s\n", what);
+		exit(1);
+	}
+	return p;
 }
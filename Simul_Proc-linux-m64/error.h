@@ -2,6 +2,7 @@
 #define _ERROR_H_
 
 #include <stdlib.h>
+#include <setjmp.h>
 
 /*!
  * \file error.h
@@ -25,10 +26,11 @@ typedef enum
     ERR_SEGTEXT,	//!< Violation de taille du segment de texte
     ERR_SEGDATA,	//!< Violation de taille du segment de données
     ERR_SEGSTACK,	//!< Violation de taille du segment de pile
+    ERR_DIVZERO,	//!< Division par zéro (\c DIV ou \c MOD)
 } Error; 
 
 //! Dernière valeur possible du code d'erreur
-static const unsigned LAST_ERROR = ERR_SEGSTACK;
+static const unsigned LAST_ERROR = ERR_DIVZERO;
 
 //! Codes d'avertissement
 /*!
@@ -38,15 +40,29 @@ static const unsigned LAST_ERROR = ERR_SEGSTACK;
 typedef enum 
 {
     WARN_HALT,		//!< Fin normale du programme (sur HALT)
+    WARN_STACK,		//!< La pile d'exécution risque d'être insuffisante
 } Warning;
 
 //! Dernière valeur possible du code d'avertissement
-static const unsigned LAST_WARNING = WARN_HALT;
+static const unsigned LAST_WARNING = WARN_STACK;
+
+//! Point de reprise après une erreur d'exécution
+/*!
+ * Lorsque ce pointeur (propre à chaque thread) n'est pas nul, error()
+ * n'affiche rien et ne termine pas le simulateur : elle range l'adresse de
+ * l'erreur dans \c error_addr et effectue un \c longjmp() vers ce point de
+ * reprise avec le code d'erreur. Les avertissements sont alors silencieux.
+ * C'est ainsi que simul_run() récupère les erreurs du programme simulé.
+ */
+extern __thread jmp_buf *error_recover;
+
+//! Adresse de la dernière erreur récupérée (voir \c error_recover)
+extern __thread unsigned error_addr;
 
 //! Affichage d'une erreur et fin du simulateur
 /*!
  * \note Toutes les erreurs étant fatales on ne revient jamais de cette
- * fonction. L'attribut \a noreturn est une extension (non standard) de GNU C
+ * fonction (sauf par \c longjmp() si \c error_recover est positionné). L'attribut \a noreturn est une extension (non standard) de GNU C
  * qui indique ce fait.
  * 
  * \param err code de l'erreur
@@ -66,4 +82,26 @@ void error(Error err, unsigned addr);
  */
 void warning(Warning warn, unsigned addr);
 
+//! Allocation avec arrêt du simulateur en cas d'échec
+/*!
+ * Comme realloc() (ou malloc() si \a ptr est NULL), mais sans jamais rendre
+ * NULL : un échec affiche « Erreur d'allocation mémoire pour \a what » et
+ * termine le simulateur. Une taille nulle est comptée comme 1.
+ *
+ * \param ptr zone à réallouer (ou NULL)
+ * \param size nouvelle taille en octets
+ * \param what ce qui est alloué, pour le message (« le profileur »...)
+ * \return la zone (ré)allouée
+ */
+void *checked_realloc(void *ptr, size_t size, const char *what);
+
+//! Allocation d'une zone mise à zéro, avec arrêt du simulateur en cas d'échec
+/*!
+ * \param size taille en octets
+ * \param what ce qui est alloué, pour le message
+ * \return la zone allouée
+ * \see checked_realloc()
+ */
+void *checked_calloc(size_t size, const char *what);
+
 #endif
@@ -1,55 +1,55 @@
 #include <stdio.h>
+#include <string.h>
 #include "machine.h"
+#include "exec.h"
 #include "error.h"
+#include "hooks.h"
+#include "devices.h"
 
-void stack_data(Machine *pmach, int data);
-int  pop_data(Machine *pmach);
-void check_data_address(Machine *pmach, int addr);
-
-void process_load(Machine *pmach, Instruction instr);
-void process_store(Machine *pmach, Instruction instr);
-void process_add(Machine *pmach, Instruction instr);
-void process_sub(Machine *pmach, Instruction instr);
+/*
+ * Ce fichier est compilé deux fois (voir hooks.h). Avec EXEC_HOOKS, il
+ * produit decode_execute_hooked(), qui appelle les crochets de la machine ;
+ * sinon decode_execute(), où HOOK() ne laisse aucun code.
+ */
+#ifdef EXEC_HOOKS
+#define decode_execute decode_execute_hooked
+#define HOOK(pmach, event, ...) hooks_##event(pmach, __VA_ARGS__)
+#else
+#define HOOK(pmach, event, ...) do { if (0) hooks_##event(pmach, __VA_ARGS__); } while (0)
+#endif
+
+#ifdef __GNUC__
+static void fault(Machine *pmach, Error err, unsigned addr) __attribute__((noreturn));
+#else
+static void fault(Machine *pmach, Error err, unsigned addr);
+#endif
+static void write_data(Machine *pmach, unsigned addr, Word value);
+static void stack_data(Machine *pmach, int data);
+static int  pop_data(Machine *pmach);
+static void check_text_address(Machine *pmach, unsigned addr);
+static Word read_device(Machine *pmach, unsigned addr);
+static void write_device(Machine *pmach, unsigned addr, Word value);
+
+//! Traitement d'une instruction, son opérande déjà obtenu (voir opcodes.def)
+#define OPCODE(NAME, name, operand, regcond) \
+	static bool process_##name(Machine *pmach, Instruction instr, Word operand);
+#include "opcodes.def"
+
+#ifndef EXEC_HOOKS
+bool condition_holds(Condition cond, Condition_Code cc) {
+	switch (cond) {
+		case NC: return true;
 
-void process_branch(Machine *pmach, Instruction instr);
-void process_call(Machine *pmach, Instruction instr);
-void process_ret(Machine *pmach, Instruction instr);
-void process_push(Machine *pmach, Instruction instr);
-void process_pop(Machine *pmach, Instruction instr);
+		case EQ: return cc == CC_Z;
+		case NE: return cc != CC_Z;
 
-void trace(const char *msg, Machine *pmach, Instruction instr, unsigned addr);
+		case GT: return cc == CC_P;
+		case GE: return cc != CC_N;
 
-//! Décodage et exécution d'une instruction
-/*!
- * \param pmach la machine/programme en cours d'exécution
- * \param instr l'instruction à exécuter
- * \return faux après l'exécution de \c HALT ; vrai sinon
- */
-bool decode_execute(Machine *pmach, Instruction instr) {
-	int pc = pmach->_pc - 1;
-	// Brace yourselves !
-	switch (instr.instr_generic._cop) {
-		case ILLOP: error(ERR_ILLEGAL, pc); // arret intempestif
-		case NOP: break;
-
-		case LOAD: process_load(pmach, instr); break;
-		case STORE: process_store(pmach, instr); break;
-		case ADD: process_add(pmach, instr); break;
-		case SUB: process_sub(pmach, instr); break;
-
-		case BRANCH: process_branch(pmach, instr); break;
-		case CALL: process_call(pmach, instr); break;
-		case RET: process_ret(pmach, instr); break;
-		case PUSH: process_push(pmach, instr); break;
-		case POP: process_pop(pmach, instr); break;
-
-		case HALT: 
-			warning(WARN_HALT, pmach->_pc-1);
-			return false;
-		
-		default: error(ERR_UNKNOWN, pc);
+		case LT: return cc == CC_N;
+		case LE: return cc != CC_P;
 	}
-	return true;
+	return false;
 }
 
 //! Trace de l'exécution
@@ -66,33 +66,61 @@ void trace(const char *msg, Machine *pmach, Instruction instr, unsigned addr) {
 	print_instruction(instr, addr);
 	printf("\n");
 }
+#endif
 
 /*
  *		METHODES UTILES
  * 
  */
 
+/*!
+ * Erreur d'exécution, signalée aux crochets avant error().
+ *
+ * \param pmach Machine en cours d'exécution
+ * \param err Code de l'erreur
+ * \param addr Adresse de l'erreur
+ */
+static void fault(Machine *pmach, Error err, unsigned addr) {
+	HOOK(pmach, fault, err, addr);
+	error(err, addr);
+}
+
 /*!
  * Vérifie que le pointeur de la pile ne va pas causer d'erreur de segmentation.
  * Lance une erreur ERR_SEGSTACK si c'est le cas.
  *
  * \param pmach Machine sur laquelle effectuer la vérification
  */
-void stack_validation(Machine *pmach) {
+static void stack_validation(Machine *pmach) {
 	// Check the stack index
 	if (pmach->_sp >= pmach->_datasize || pmach->_sp < pmach->_dataend) {
-		error(ERR_SEGSTACK, pmach->_pc-1);
+		fault(pmach, ERR_SEGSTACK, pmach->_pc-1);
 	}
 }
 
+/*!
+ * Écrit une valeur en mémoire de données (adresse déjà vérifiée), en la
+ * signalant aux crochets.
+ *
+ * \param pmach Machine dans laquelle effectuer l'écriture
+ * \param addr Adresse écrite
+ * \param value Valeur écrite
+ */
+static void write_data(Machine *pmach, unsigned addr, Word value) {
+	HOOK(pmach, write, addr, pmach->_data[addr], value);
+	pmach->_data[addr] = value;
+}
+
 /*!
  * Empile une valeur dans la pile d'une Machine.
  *
  * \param pmach Machine dans laquelle effectuer l'opération
  * \param data Valeur à empiler
  */
-void stack_data(Machine *pmach, int data) {
-	pmach->_data[(pmach->_sp)--] = data;
+static void stack_data(Machine *pmach, int data) {
+	stack_validation(pmach); // R15 a pu être modifié arbitrairement
+	write_data(pmach, (pmach->_sp)--, data);
+	HOOK(pmach, push, pmach->_sp + 1, data);
 	stack_validation(pmach);
 }
 
@@ -103,10 +131,11 @@ void stack_data(Machine *pmach, int data) {
  * \param pmach Machine dans laquelle effectuer l'opération
  * \return La valeur au sommet de la pile
  */
-int pop_data(Machine *pmach) {
-	int data = pmach->_data[++(pmach->_sp)];
-	stack_validation(pmach);
-	return data;
+static int pop_data(Machine *pmach) {
+	++(pmach->_sp);
+	stack_validation(pmach); // Avant la lecture : la pile peut être corrompue
+	HOOK(pmach, pop, pmach->_sp, pmach->_data[pmach->_sp]);
+	return pmach->_data[pmach->_sp];
 }
 
 /*!
@@ -117,21 +146,10 @@ int pop_data(Machine *pmach) {
  * \param instr Instruction contenant la condition à vérifier
  * \return Vrai si la condition est respectée ; faux sinon
  */
-bool check_condition(Machine *pmach, Instruction instr) {
-	switch (instr.instr_generic._regcond) {
-		case NC: return true;
-
-		case EQ: return pmach->_cc == CC_Z;
-		case NE: return pmach->_cc != CC_Z;
-
-		case GT: return pmach->_cc == CC_P;
-		case GE: return pmach->_cc != CC_N;
-
-		case LT: return pmach->_cc == CC_N;
-		case LE: return pmach->_cc != CC_P;
-		default: error(ERR_CONDITION, pmach->_pc-1);
-	}
-	return false;
+static bool check_condition(Machine *pmach, Instruction instr) {
+	if (instr.instr_generic._regcond > LAST_CONDITION)
+		fault(pmach, ERR_CONDITION, pmach->_pc-1);
+	return condition_holds(instr.instr_generic._regcond, pmach->_cc);
 }
 
 /*!
@@ -140,44 +158,75 @@ bool check_condition(Machine *pmach, Instruction instr) {
  * \param pmach Machine dans laquelle effectuer l'opération
  * \param value Valeur à mettre dans CC
  */
-void update_cc(Machine *pmach, int value) {
+static void update_cc(Machine *pmach, int value) {
 	if (value == 0) 	pmach->_cc = CC_Z;
 	else if (value < 0) pmach->_cc = CC_N;
 	else if (value > 0) pmach->_cc = CC_P;
 }
 
 /*!
- * Retourne la valeur contenue dans une instruction.
- * Les différents modes sont supportés : immediate, absolute & indexed.
+ * Retourne l'adresse indexée désignée par une instruction (I = 0, X = 1).
+ * L'adresse n'est pas vérifiée ; une adresse négative devient très grande.
  *
  * \param pmach Machine dans laquelle effectuer l'opération
- * \param instr Instruction de laquelle récupérer la valeur.
- * \return La valeur correspondante.
- */
-int get_instruction_value(Machine *pmach, Instruction instr) {
-	int value;
-	if (instr.instr_generic._immediate) {
-		value = instr.instr_immediate._value;
-	} else {
-		int address = instr.instr_absolute._address;
-		if (instr.instr_generic._indexed) {
-			address = pmach->_registers[instr.instr_indexed._rindex] + instr.instr_indexed._offset;
-		}
-		check_data_address(pmach, address) ;
-
-		value = pmach->_data[address];	
-	}
+ * \param instr Instruction de laquelle récupérer l'adresse.
+ * \return L'adresse correspondante.
+ */
+static inline unsigned indexed_address(Machine *pmach, Instruction instr) {
+	return pmach->_registers[instr.instr_indexed._rindex] + instr.instr_indexed._offset;
+}
+
+/*!
+ * Lit un opérande en mémoire de données (adresse déjà vérifiée).
+ *
+ * \param pmach Machine dans laquelle effectuer l'opération
+ * \param addr Adresse lue
+ * \return La valeur lue
+ */
+static inline Word read_data(Machine *pmach, unsigned addr) {
+	Word value = pmach->_data[addr];
+	HOOK(pmach, read, addr, value);
 	return value;
 }
 
 /*!
- * Lance une erreur si l'instruction est immédiate.
+ * Lit un opérande en mémoire. Une adresse hors du segment de données est
+ * confiée aux périphériques (voir devices.h) : le cas ordinaire ne paie que
+ * la vérification de l'adresse.
+ *
+ * \param pmach Machine dans laquelle effectuer l'opération
+ * \param addr Adresse lue (non vérifiée)
+ * \return La valeur lue
+ */
+static inline Word load_operand(Machine *pmach, unsigned addr) {
+	if (addr >= pmach->_datasize)
+		return read_device(pmach, addr);
+	return read_data(pmach, addr);
+}
+
+/*!
+ * Range une valeur en mémoire ; une adresse hors du segment de données est
+ * confiée aux périphériques.
+ *
+ * \param pmach Machine dans laquelle effectuer l'écriture
+ * \param addr Adresse écrite (non vérifiée)
+ * \param value Valeur écrite
+ */
+static inline void store_data(Machine *pmach, unsigned addr, Word value) {
+	if (addr >= pmach->_datasize)
+		write_device(pmach, addr, value);
+	else
+		write_data(pmach, addr, value);
+}
+
+/*!
+ * Lance une erreur : opérande immédiat interdit pour cette instruction.
  *
  * \param pmach Machine dans laquelle effectuer l'opération
- * \param instr Instruction à vérifier
+ * \return Jamais
  */
-void block_immediate(Machine *pmach, Instruction instr) {
-	if (instr.instr_generic._immediate) error(ERR_IMMEDIATE, pmach->_pc-1);
+static Word immediate_forbidden(Machine *pmach) {
+	fault(pmach, ERR_IMMEDIATE, pmach->_pc-1);
 }
 
 /*!
@@ -187,37 +236,110 @@ void block_immediate(Machine *pmach, Instruction instr) {
  * \param reg Numéro du registre à modifier
  * \param delta Variation de valeur à appliquer
  */
-void change_register(Machine *pmach, int reg, int delta) {
+static void change_register(Machine *pmach, int reg, int delta) {
 	pmach->_registers[reg] += delta;
 	update_cc(pmach, pmach->_registers[reg]);
 }
 
 /*!
- * Vérifie que la valeur de l'adresse ne provoque pas d'erreur de 
- * segmentation sur Data. Lance une erreur si c'est le cas.
+ * Remplace la valeur d'un registre et met à jour CC.
+ *
+ * \param pmach Machine dans laquelle on effectue la modification
+ * \param reg Numéro du registre à modifier
+ * \param value Nouvelle valeur
+ */
+static void set_register(Machine *pmach, int reg, Word value) {
+	pmach->_registers[reg] = value;
+	update_cc(pmach, value);
+}
+
+/*!
+ * Vérifie que la destination d'un branchement ou d'un appel est dans le
+ * segment de texte. Lance une erreur ERR_SEGTEXT sinon, à l'adresse du
+ * branchement, avant tout autre effet de l'instruction.
  */
-void check_data_address(Machine *pmach, int addr) {
-	if (addr > pmach->_datasize) {
-		error(ERR_SEGDATA, pmach->_pc - 1);
+static void check_text_address(Machine *pmach, unsigned addr) {
+	if (addr >= pmach->_textsize) {
+		fault(pmach, ERR_SEGTEXT, pmach->_pc - 1);
 	}
 }
 
+/*!
+ * Vérifie qu'une plage de mots tient dans le segment de données (pile
+ * comprise), en une seule comparaison pour toute la plage. Lance une erreur
+ * ERR_SEGDATA sinon ; les périphériques ne sont pas accessibles par bloc.
+ *
+ * \param pmach Machine sur laquelle effectuer la vérification
+ * \param addr Première adresse de la plage
+ * \param count Nombre de mots (non nul)
+ */
+static void check_data_range(Machine *pmach, Word addr, Word count) {
+	if (addr >= pmach->_datasize || count > pmach->_datasize - addr)
+		fault(pmach, ERR_SEGDATA, pmach->_pc - 1);
+}
+
+/*!
+ * Lit le port d'un périphérique. Lance ERR_SEGDATA si aucun port lisible
+ * n'est projeté à cette adresse.
+ */
+static Word read_device(Machine *pmach, unsigned addr) {
+	Word value;
+	if (!device_read(pmach, addr, &value))
+		fault(pmach, ERR_SEGDATA, pmach->_pc - 1);
+	return value;
+}
+
+/*!
+ * Écrit le port d'un périphérique. Lance ERR_SEGDATA si aucun port
+ * inscriptible n'est projeté à cette adresse.
+ */
+static void write_device(Machine *pmach, unsigned addr, Word value) {
+	if (!device_write(pmach, addr, value))
+		fault(pmach, ERR_SEGDATA, pmach->_pc - 1);
+}
+
 /*======================================
  *
  *		TRAITEMENT DES INSTRUCTIONS
  *======================================
  */
 
+/*!
+ * Traitement de l'instruction ILLOP.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Jamais (arrêt intempestif)
+ */
+static bool process_illop(Machine *pmach, Instruction instr, Word operand) {
+	fault(pmach, ERR_ILLEGAL, pmach->_pc-1);
+}
+
+/*!
+ * Traitement de l'instruction NOP.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Vrai
+ */
+static bool process_nop(Machine *pmach, Instruction instr, Word operand) {
+	return true;
+}
+
 /*!
  * Traitement de l'instruction LOAD.
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand La valeur à charger
+ * \return Vrai
  */
-void process_load(Machine *pmach, Instruction instr) {
-	int value = get_instruction_value(pmach, instr);
-	pmach->_registers[instr.instr_generic._regcond] = value;
-	update_cc(pmach, value);
+static bool process_load(Machine *pmach, Instruction instr, Word operand) {
+	pmach->_registers[instr.instr_generic._regcond] = operand;
+	update_cc(pmach, operand);
+	return true;
 }
 
 /*!
@@ -225,10 +347,12 @@ void process_load(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand L'adresse de rangement (vérifiée au rangement)
+ * \return Vrai
  */
-void process_store(Machine *pmach, Instruction instr) {
-	block_immediate(pmach, instr);
-	pmach->_data[instr.instr_absolute._address] = pmach->_registers[instr.instr_generic._regcond];
+static bool process_store(Machine *pmach, Instruction instr, Word operand) {
+	store_data(pmach, operand, pmach->_registers[instr.instr_generic._regcond]);
+	return true;
 }
 
 /*!
@@ -236,10 +360,12 @@ void process_store(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand La valeur à ajouter
+ * \return Vrai
  */
-void process_add(Machine *pmach, Instruction instr) {
-	int value = get_instruction_value(pmach, instr);
-	change_register(pmach, instr.instr_generic._regcond, value);
+static bool process_add(Machine *pmach, Instruction instr, Word operand) {
+	change_register(pmach, instr.instr_generic._regcond, operand);
+	return true;
 }
 
 /*!
@@ -247,10 +373,12 @@ void process_add(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand La valeur à soustraire
+ * \return Vrai
  */
-void process_sub(Machine *pmach, Instruction instr) {
-	int value = get_instruction_value(pmach, instr);
-	change_register(pmach, instr.instr_generic._regcond, -value);
+static bool process_sub(Machine *pmach, Instruction instr, Word operand) {
+	change_register(pmach, instr.instr_generic._regcond, -(int) operand);
+	return true;
 }
 
 /*!
@@ -258,14 +386,18 @@ void process_sub(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand L'adresse du sous-programme
+ * \return Vrai
  */
-void process_call(Machine *pmach, Instruction instr) {
-	block_immediate(pmach, instr);
+static bool process_call(Machine *pmach, Instruction instr, Word operand) {
 	if (check_condition(pmach, instr)) {
+		unsigned from = pmach->_pc - 1;
+		check_text_address(pmach, operand);
 		stack_data(pmach, pmach->_pc);
-		check_data_address(pmach, instr.instr_absolute._address);
-		pmach->_pc = instr.instr_absolute._address;
+		pmach->_pc = operand;
+		HOOK(pmach, call, from, pmach->_pc);
 	}
+	return true;
 }
 
 /*!
@@ -273,9 +405,14 @@ void process_call(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Vrai
  */
-void process_ret(Machine *pmach, Instruction instr) {
+static bool process_ret(Machine *pmach, Instruction instr, Word operand) {
+	unsigned from = pmach->_pc - 1;
 	pmach->_pc = pop_data(pmach);
+	HOOK(pmach, ret, from, pmach->_pc);
+	return true;
 }
 
 /*!
@@ -283,10 +420,12 @@ void process_ret(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand La valeur à empiler
+ * \return Vrai
  */
-void process_push(Machine *pmach, Instruction instr) {
-	int value = get_instruction_value(pmach, instr);
-	stack_data(pmach, value);
+static bool process_push(Machine *pmach, Instruction instr, Word operand) {
+	stack_data(pmach, operand);
+	return true;
 }
 
 /*!
@@ -294,11 +433,17 @@ void process_push(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand L'adresse de rangement (vérifiée avant de dépiler)
+ * \return Vrai
  */
-void process_pop(Machine *pmach, Instruction instr) {
-	block_immediate(pmach, instr);
-	check_data_address(pmach, instr.instr_absolute._address);
-	pmach->_data[instr.instr_absolute._address] = pop_data(pmach);
+static bool process_pop(Machine *pmach, Instruction instr, Word operand) {
+	if (operand >= pmach->_datasize) {
+		if (!device_writable(pmach, operand))
+			fault(pmach, ERR_SEGDATA, pmach->_pc - 1);
+		write_device(pmach, operand, pop_data(pmach));
+	} else
+		write_data(pmach, operand, pop_data(pmach));
+	return true;
 }
 
 /*!
@@ -306,11 +451,300 @@ void process_pop(Machine *pmach, Instruction instr) {
  *
  * \param pmach Machine qui exécute l'instruction
  * \param instr L'instruction à exécuter
+ * \param operand L'adresse de destination
+ * \return Vrai
  */
-void process_branch(Machine *pmach, Instruction instr) {
-	block_immediate(pmach, instr);
-	if (check_condition(pmach, instr)) {
-		check_data_address(pmach, instr.instr_absolute._address);
-		pmach->_pc = instr.instr_absolute._address;
+static bool process_branch(Machine *pmach, Instruction instr, Word operand) {
+	unsigned addr = pmach->_pc - 1;
+	bool taken = check_condition(pmach, instr);
+	if (taken) {
+		check_text_address(pmach, operand);
+		pmach->_pc = operand;
+	}
+	HOOK(pmach, branch, addr, operand, taken);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction HALT.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Faux : fin du programme
+ */
+static bool process_halt(Machine *pmach, Instruction instr, Word operand) {
+	warning(WARN_HALT, pmach->_pc-1);
+	return false;
+}
+
+/*!
+ * Traitement de l'instruction MUL.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le multiplicateur
+ * \return Vrai
+ */
+static bool process_mul(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] * operand);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction DIV (quotient arrondi vers zéro).
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le diviseur
+ * \return Vrai
+ */
+static bool process_div(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	if (operand == 0)
+		fault(pmach, ERR_DIVZERO, pmach->_pc-1);
+	// Diviser par -1 revient à changer de signe, sans débordement en C
+	Word q = (int32_t) operand == -1 ? 0 - pmach->_registers[reg]
+		: (Word) ((int32_t) pmach->_registers[reg] / (int32_t) operand);
+	set_register(pmach, reg, q);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction MOD (reste du signe du dividende).
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le diviseur
+ * \return Vrai
+ */
+static bool process_mod(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	if (operand == 0)
+		fault(pmach, ERR_DIVZERO, pmach->_pc-1);
+	Word r = (int32_t) operand == -1 ? 0
+		: (Word) ((int32_t) pmach->_registers[reg] % (int32_t) operand);
+	set_register(pmach, reg, r);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction AND.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le masque
+ * \return Vrai
+ */
+static bool process_and(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] & operand);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction OR.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Les bits à positionner
+ * \return Vrai
+ */
+static bool process_or(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] | operand);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction XOR.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Les bits à inverser
+ * \return Vrai
+ */
+static bool process_xor(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] ^ operand);
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction SHL.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le nombre de positions (modulo 32)
+ * \return Vrai
+ */
+static bool process_shl(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] << (operand & 31));
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction SHR (des zéros entrent à gauche).
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Le nombre de positions (modulo 32)
+ * \return Vrai
+ */
+static bool process_shr(Machine *pmach, Instruction instr, Word operand) {
+	int reg = instr.instr_generic._regcond;
+	set_register(pmach, reg, pmach->_registers[reg] >> (operand & 31));
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction MOVE : Rk+2 mots copiés de l'adresse Rk+1 à
+ * l'adresse Rk, comme par memmove().
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Vrai
+ */
+static bool process_move(Machine *pmach, Instruction instr, Word operand) {
+	unsigned reg = instr.instr_generic._regcond;
+	Word dst = pmach->_registers[reg];
+	Word src = pmach->_registers[(reg + 1) % NREGISTERS];
+	Word count = pmach->_registers[(reg + 2) % NREGISTERS];
+	if (count == 0)
+		return true;
+	check_data_range(pmach, src, count);
+	check_data_range(pmach, dst, count);
+#ifdef EXEC_HOOKS
+	// Mot à mot, dans le sens de memmove(), pour signaler chaque accès
+	if (dst <= src)
+		for (Word i = 0; i < count; i++)
+			write_data(pmach, dst + i, read_data(pmach, src + i));
+	else
+		for (Word i = count; i-- > 0; )
+			write_data(pmach, dst + i, read_data(pmach, src + i));
+#else
+	memmove(pmach->_data + dst, pmach->_data + src, count * sizeof(Word));
+#endif
+	return true;
+}
+
+/*!
+ * Traitement de l'instruction FILL : Rk+2 mots de valeur Rk+1 écrits à
+ * partir de l'adresse Rk.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \param operand Inutilisé
+ * \return Vrai
+ */
+static bool process_fill(Machine *pmach, Instruction instr, Word operand) {
+	unsigned reg = instr.instr_generic._regcond;
+	Word dst = pmach->_registers[reg];
+	Word value = pmach->_registers[(reg + 1) % NREGISTERS];
+	Word count = pmach->_registers[(reg + 2) % NREGISTERS];
+	if (count == 0)
+		return true;
+	check_data_range(pmach, dst, count);
+#ifdef EXEC_HOOKS
+	for (Word i = 0; i < count; i++)
+		write_data(pmach, dst + i, value);
+#else
+	// memset() quand les quatre octets du mot sont égaux (0 et -1 surtout)
+	if (value == (value & 0xff) * 0x01010101u)
+		memset(pmach->_data + dst, value & 0xff, count * sizeof(Word));
+	else
+		for (Word i = 0; i < count; i++)
+			pmach->_data[dst + i] = value;
+#endif
+	return true;
+}
+
+/*!
+ * Traitement d'un code opération inconnu.
+ *
+ * \param pmach Machine qui exécute l'instruction
+ * \param instr L'instruction à exécuter
+ * \return Jamais
+ */
+static bool process_unknown(Machine *pmach, Instruction instr) {
+	fault(pmach, ERR_UNKNOWN, pmach->_pc-1);
+}
+
+/*======================================
+ *
+ *		GESTIONNAIRES SPÉCIALISÉS
+ *======================================
+ */
+
+/*
+ * Obtention de l'opérande selon sa nature (opcodes.def) et le mode
+ * d'adressage : abs (I = 0, X = 0), idx (I = 0, X = 1), imm (I = 1 ; X est
+ * alors ignoré). Une destination de branchement est toujours l'adresse
+ * absolue. Une adresse de rangement n'est vérifiée qu'au rangement (voir
+ * store_data()), pour ne tester qu'une fois si c'est un port.
+ */
+#define FETCH_NONE_abs(pmach, instr)	0
+#define FETCH_NONE_idx(pmach, instr)	0
+#define FETCH_NONE_imm(pmach, instr)	0
+#define FETCH_VALUE_abs(pmach, instr)	load_operand(pmach, instr.instr_absolute._address)
+#define FETCH_VALUE_idx(pmach, instr)	load_operand(pmach, indexed_address(pmach, instr))
+#define FETCH_VALUE_imm(pmach, instr)	(Word) instr.instr_immediate._value
+#define FETCH_ADDRESS_abs(pmach, instr)	instr.instr_absolute._address
+#define FETCH_ADDRESS_idx(pmach, instr)	indexed_address(pmach, instr)
+#define FETCH_ADDRESS_imm(pmach, instr)	immediate_forbidden(pmach)
+#define FETCH_TARGET_abs(pmach, instr)	instr.instr_absolute._address
+#define FETCH_TARGET_idx(pmach, instr)	instr.instr_absolute._address
+#define FETCH_TARGET_imm(pmach, instr)	immediate_forbidden(pmach)
+
+//! Un gestionnaire par code opération et par mode d'adressage
+#define OPCODE(NAME, name, operand, regcond) \
+	static bool name##_abs(Machine *pmach, Instruction instr) { \
+		return process_##name(pmach, instr, FETCH_##operand##_abs(pmach, instr)); \
+	} \
+	static bool name##_idx(Machine *pmach, Instruction instr) { \
+		return process_##name(pmach, instr, FETCH_##operand##_idx(pmach, instr)); \
+	} \
+	static bool name##_imm(Machine *pmach, Instruction instr) { \
+		return process_##name(pmach, instr, FETCH_##operand##_imm(pmach, instr)); \
 	}
-}
\ No newline at end of file
+#include "opcodes.def"
+
+//! Gestionnaire d'une instruction
+typedef bool Handler(Machine *pmach, Instruction instr);
+
+//! Indice d'une instruction dans la table des gestionnaires : code opération, I, X
+#define HANDLER_INDEX(instr) \
+	((instr).instr_generic._cop | (instr).instr_generic._immediate << 6 | (instr).instr_generic._indexed << 7)
+
+//! Table des gestionnaires, indexée par HANDLER_INDEX() (entrée NULL : code inconnu)
+static Handler *const handlers[256] = {
+#ifdef __GNUC__
+	[0 ... 255] = process_unknown,
+#endif
+#define OPCODE(NAME, name, operand, regcond) \
+	[NAME] = name##_abs, [NAME | 1 << 7] = name##_idx, \
+	[NAME | 1 << 6] = name##_imm, [NAME | 3 << 6] = name##_imm,
+#include "opcodes.def"
+};
+
+//! Décodage et exécution d'une instruction
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param instr l'instruction à exécuter
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+bool decode_execute(Machine *pmach, Instruction instr) {
+	unsigned pc = pmach->_pc - 1;
+	// Un seul saut indirect : le mode d'adressage fait partie de l'indice
+	Handler *handler = handlers[HANDLER_INDEX(instr)];
+#ifndef __GNUC__
+	if (handler == NULL)
+		handler = process_unknown;
+#endif
+	bool running = handler(pmach, instr);
+	HOOK(pmach, retire, pc, instr);
+	return running;
+}
@@ -16,6 +16,25 @@
  */
 bool decode_execute(Machine *pmach, Instruction instr);
 
+//! Décodage et exécution d'une instruction, avec appel des crochets
+/*!
+ * Même effet que decode_execute() ; les crochets enregistrés dans la machine
+ * (voir hooks.h) sont appelés à chaque événement.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param instr l'instruction à exécuter
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+bool decode_execute_hooked(Machine *pmach, Instruction instr);
+
+//! Valeur d'une condition pour un code condition
+/*!
+ * \param cond la condition (valide)
+ * \param cc le code condition
+ * \return vrai si un branchement de condition \a cond est pris
+ */
+bool condition_holds(Condition cond, Condition_Code cc);
+
 //! Trace de l'exécution
 /*!
  * On écrit l'adresse et l'instruction sous forme lisible.
@@ -0,0 +1,569 @@
+/*!
+ * \file fuzz_simul.c
+ * \brief Fuzzing guidé par la couverture de l'interpréteur
+ *
+ * Les images binaires (format de read_program()) sont mutées puis exécutées
+ * dans le processus même, par simul_run(), avec un budget d'instructions, sur
+ * autant de threads que de processeurs. Le module \c exec est compilé avec
+ * \c -fsanitize-coverage=trace-pc : chaque bloc de base appelle
+ * __sanitizer_cov_trace_pc() qui enregistre l'arc (bloc précédent, bloc
+ * courant) dans une table de couverture. Toute image qui atteint un arc
+ * nouveau rejoint le corpus.
+ *
+ * Sont sauvegardées dans le répertoire de sortie :
+ *
+ *   - \c crash-N.bin : l'image qui a fait planter le simulateur (signal) ;
+ *
+ *   - \c fault-XXXXXXXX.bin : une image dont l'erreur rapportée ne correspond
+ *   pas à l'instruction fautive (mauvais code, mauvaise adresse...).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "machine.h"
+#include "error.h"
+#include "image.h"
+
+//! Taille maximale du segment de texte des images fuzzées
+#define FUZZ_MAXTEXT 1024
+
+//! Taille maximale du segment de données des images fuzzées
+#define FUZZ_MAXDATA 4096
+
+//! Taille maximale d'une image en mots (en-tête compris)
+#define FUZZ_MAXWORDS (3 + FUZZ_MAXTEXT + FUZZ_MAXDATA)
+
+//! Taille de la table de couverture des arcs (puissance de 2)
+#define COV_SIZE (1 << 16)
+
+//! Nombre maximal de threads
+#define FUZZ_MAXTHREADS 256
+
+//! Une image : en-tête (textsize, datasize, dataend), texte puis données
+typedef struct
+{
+    uint32_t *_words;
+    unsigned _len;
+} Image;
+
+//! État d'un thread de fuzzing
+typedef struct
+{
+    unsigned _id;
+    uint64_t _rng;
+    uint64_t _execs;
+    Image _cur;				//!< Image en cours d'exécution
+    Instruction _text[FUZZ_MAXTEXT];
+    Word _data[FUZZ_MAXDATA];
+    char _crashfile[512];		//!< Fichier de sauvegarde en cas de plantage
+} Worker;
+
+// Paramètres
+static uint64_t budget = 10000;
+static const char *outdir = ".";
+
+// Corpus partagé
+static pthread_mutex_t corpus_lock = PTHREAD_MUTEX_INITIALIZER;
+static Image *corpus = NULL;
+static unsigned ncorpus = 0, maxcorpus = 0;
+
+// Couverture globale
+static uint8_t global_cov[COV_SIZE];
+static unsigned nedges = 0;
+static unsigned nfaults = 0;
+
+static volatile int stop = 0;
+
+// Couverture locale au thread (voir __sanitizer_cov_trace_pc())
+static __thread uint8_t *cov_local = NULL;
+static __thread unsigned *cov_touched = NULL;
+static __thread unsigned cov_ntouched = 0;
+static __thread uintptr_t cov_prev = 0;
+
+// Image courante, pour le gestionnaire de signaux
+static __thread Worker *current = NULL;
+
+/*!
+ * Appelée par le code instrumenté (\c exec.c) à chaque bloc de base.
+ * L'arc est identifié par le hachage des adresses des deux blocs.
+ */
+void __sanitizer_cov_trace_pc(void) {
+	if (cov_local == NULL)
+		return;
+	uintptr_t cur = (uintptr_t) __builtin_return_address(0);
+	cur = (cur ^ (cur >> 15)) * 0x9E3779B1u;
+	unsigned edge = (cur ^ cov_prev) & (COV_SIZE - 1);
+	cov_prev = cur >> 1;
+	if (cov_local[edge]++ == 0 && cov_ntouched < COV_SIZE)
+		cov_touched[cov_ntouched++] = edge;
+}
+
+/*!
+ * Générateur pseudo-aléatoire (xorshift64*).
+ *
+ * \param pw le thread
+ * \param n borne supérieure (exclue)
+ * \return un entier dans [0, n)
+ */
+static uint32_t rnd(Worker *pw, uint32_t n) {
+	pw->_rng ^= pw->_rng >> 12;
+	pw->_rng ^= pw->_rng << 25;
+	pw->_rng ^= pw->_rng >> 27;
+	uint64_t r = pw->_rng * 0x2545F4914F6CDD1DULL;
+	return n ? (uint32_t) (r >> 32) % n : 0;
+}
+
+/*!
+ * Hachage FNV-1a d'une image (nom des fichiers sauvegardés).
+ */
+static uint32_t image_hash(const Image *pimg) {
+	uint32_t h = 2166136261u;
+	const unsigned char *p = (const unsigned char *) pimg->_words;
+	for (size_t i = 0; i < pimg->_len * sizeof(uint32_t); i++)
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+
+/*!
+ * Écriture d'une image au format de read_program().
+ *
+ * \return vrai si l'écriture a réussi
+ */
+static bool save_image(const char *file, const Image *pimg) {
+	int fd = open(file, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+		return false;
+	ssize_t n = write(fd, pimg->_words, pimg->_len * sizeof(uint32_t));
+	close(fd);
+	return n == (ssize_t) (pimg->_len * sizeof(uint32_t));
+}
+
+/*!
+ * Gestionnaire des signaux fatals : sauvegarde de l'image en cours puis fin
+ * du fuzzer. On n'utilise que des fonctions sûres dans ce contexte.
+ */
+static void on_crash(int sig) {
+	Worker *pw = current;
+	if (pw != NULL) {
+		int fd = open(pw->_crashfile, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+		if (fd >= 0) {
+			ssize_t n = write(fd, pw->_cur._words, pw->_cur._len * sizeof(uint32_t));
+			(void) n;
+			close(fd);
+		}
+		static const char msg[] = "\nfuzz_simul: host crash, image saved\n";
+		ssize_t n = write(STDERR_FILENO, msg, sizeof(msg) - 1);
+		(void) n;
+	}
+	_exit(128 + sig);
+}
+
+/*!
+ * Ajout d'une image au corpus (copie).
+ */
+static void corpus_add(const Image *pimg) {
+	pthread_mutex_lock(&corpus_lock);
+	if (ncorpus == maxcorpus) {
+		maxcorpus = maxcorpus ? 2 * maxcorpus : 64;
+		corpus = checked_realloc(corpus, maxcorpus * sizeof(Image), "le corpus");
+	}
+	Image *pnew = &corpus[ncorpus];
+	pnew->_len = pimg->_len;
+	pnew->_words = checked_realloc(NULL, pimg->_len * sizeof(uint32_t), "le corpus");
+	memcpy(pnew->_words, pimg->_words, pimg->_len * sizeof(uint32_t));
+	ncorpus++;
+	pthread_mutex_unlock(&corpus_lock);
+}
+
+/*!
+ * Copie d'une image tirée au hasard dans le corpus.
+ */
+static void corpus_pick(Worker *pw, Image *pimg) {
+	pthread_mutex_lock(&corpus_lock);
+	Image *psrc = &corpus[rnd(pw, ncorpus)];
+	memcpy(pimg->_words, psrc->_words, psrc->_len * sizeof(uint32_t));
+	pimg->_len = psrc->_len;
+	pthread_mutex_unlock(&corpus_lock);
+}
+
+/*!
+ * Une instruction aléatoire, biaisée vers les cas limites du décodeur :
+ * codes opération au-delà de \c LAST_COP, conditions au-delà de
+ * \c LAST_CONDITION, déplacements négatifs, registre \c R15...
+ */
+static uint32_t random_instruction(Worker *pw) {
+	Instruction instr;
+	instr._raw = rnd(pw, UINT32_MAX);
+	switch (rnd(pw, 4)) {
+		case 0: // Code opération connu
+			instr.instr_generic._cop = rnd(pw, LAST_COP + 1);
+			break;
+		case 1: // Juste au-delà du dernier code
+			instr.instr_generic._cop = LAST_COP + 1 + rnd(pw, 4);
+			break;
+		case 2: // Indexé sur la pile avec un petit déplacement, éventuellement négatif
+			instr.instr_generic._cop = rnd(pw, LAST_COP + 1);
+			instr.instr_generic._immediate = false;
+			instr.instr_generic._indexed = true;
+			instr.instr_indexed._rindex = rnd(pw, 2) ? NREGISTERS - 1 : rnd(pw, NREGISTERS);
+			instr.instr_indexed._offset = (int) rnd(pw, 9) - 4;
+			break;
+		default: // Branchement ou appel, condition éventuellement invalide
+			instr.instr_generic._cop = rnd(pw, 2) ? BRANCH : CALL;
+			instr.instr_generic._immediate = false;
+			instr.instr_generic._regcond = rnd(pw, 4) ? rnd(pw, LAST_CONDITION + 1) : rnd(pw, 16);
+			instr.instr_absolute._address = rnd(pw, FUZZ_MAXTEXT);
+			break;
+	}
+	return instr._raw;
+}
+
+/*!
+ * Mutation d'une image (une à quatre transformations).
+ */
+static void mutate(Worker *pw, Image *pimg) {
+	static const uint32_t interesting[] = {
+		0, 1, 2, 0x7fffffff, 0x80000000, 0xffffffff, 0xfffff, 0x80000, 0xffff, 0x8000
+	};
+	unsigned nmut = 1 + rnd(pw, 4);
+	for (unsigned m = 0; m < nmut; m++) {
+		if (pimg->_len < 3) {
+			pimg->_len = 3;
+			memset(pimg->_words, 0, 3 * sizeof(uint32_t));
+		}
+		unsigned i = 3 + rnd(pw, pimg->_len > 3 ? pimg->_len - 3 : 1);
+		if (i >= pimg->_len)
+			i = pimg->_len - 1;
+		switch (rnd(pw, 9)) {
+			case 0: // Inversion d'un bit
+				pimg->_words[i] ^= 1u << rnd(pw, 32);
+				break;
+			case 1: // Mot aléatoire
+				pimg->_words[i] = rnd(pw, UINT32_MAX);
+				break;
+			case 2:
+			case 3: // Instruction aléatoire dans le texte
+				if (pimg->_words[0] > 0 && pimg->_words[0] <= FUZZ_MAXTEXT && 3 + pimg->_words[0] <= pimg->_len)
+					pimg->_words[3 + rnd(pw, pimg->_words[0])] = random_instruction(pw);
+				else
+					pimg->_words[i] = random_instruction(pw);
+				break;
+			case 4: // Valeur remarquable
+				pimg->_words[i] = interesting[rnd(pw, sizeof(interesting) / sizeof(interesting[0]))];
+				break;
+			case 5: { // En-tête : tailles (bornées) et fin des données
+				unsigned field = rnd(pw, 3);
+				uint32_t bound = field == 0 ? FUZZ_MAXTEXT : FUZZ_MAXDATA;
+				pimg->_words[field] = rnd(pw, bound + 1);
+				break;
+			}
+			case 6: // Insertion d'un mot
+				if (pimg->_len < FUZZ_MAXWORDS) {
+					memmove(&pimg->_words[i + 1], &pimg->_words[i], (pimg->_len - i) * sizeof(uint32_t));
+					pimg->_words[i] = random_instruction(pw);
+					pimg->_len++;
+				}
+				break;
+			case 7: // Suppression d'un mot
+				if (pimg->_len > 4) {
+					memmove(&pimg->_words[i], &pimg->_words[i + 1], (pimg->_len - i - 1) * sizeof(uint32_t));
+					pimg->_len--;
+				}
+				break;
+			default: { // Greffe d'un morceau d'une autre image du corpus
+				pthread_mutex_lock(&corpus_lock);
+				Image *psrc = &corpus[rnd(pw, ncorpus)];
+				if (psrc->_len > 3) {
+					unsigned from = 3 + rnd(pw, psrc->_len - 3);
+					unsigned n = 1 + rnd(pw, psrc->_len - from);
+					if (i + n > FUZZ_MAXWORDS)
+						n = FUZZ_MAXWORDS - i;
+					memcpy(&pimg->_words[i], &psrc->_words[from], n * sizeof(uint32_t));
+					if (i + n > pimg->_len)
+						pimg->_len = i + n;
+				}
+				pthread_mutex_unlock(&corpus_lock);
+				break;
+			}
+		}
+	}
+}
+
+/*!
+ * Chargement d'une image dans la machine d'un thread. Les mots manquants
+ * sont nuls.
+ *
+ * \return faux si les tailles dépassent les limites du fuzzer
+ */
+static bool fuzz_load(Worker *pw, Machine *pmach, const Image *pimg) {
+	uint32_t header[3] = {0, 0, 0};
+	for (unsigned i = 0; i < 3 && i < pimg->_len; i++)
+		header[i] = pimg->_words[i];
+	unsigned textsize = header[0], datasize = header[1], dataend = header[2];
+	if (textsize > FUZZ_MAXTEXT || datasize > FUZZ_MAXDATA)
+		return false;
+
+	unsigned avail = pimg->_len > 3 ? pimg->_len - 3 : 0;
+	for (unsigned i = 0; i < textsize; i++)
+		pw->_text[i]._raw = i < avail ? pimg->_words[3 + i] : 0;
+	for (unsigned i = 0; i < datasize; i++)
+		pw->_data[i] = textsize + i < avail ? pimg->_words[3 + textsize + i] : 0;
+
+	load_program(pmach, textsize, pw->_text, datasize, pw->_data, dataend);
+	return true;
+}
+
+/*!
+ * Vérification de la sémantique des erreurs : le code et l'adresse rapportés
+ * doivent correspondre à l'instruction fautive.
+ *
+ * \return NULL si tout est cohérent, un message sinon
+ */
+static const char *check_fault(Machine *pmach, Run_Status status, Error err, unsigned addr) {
+	if (status == RUN_BUDGET)
+		return NULL;
+	if (status == RUN_HALT)
+		return pmach->_text[pmach->_pc - 1].instr_generic._cop == HALT ? NULL : "halt without HALT";
+
+	if (err == ERR_NOERROR || err > LAST_ERROR)
+		return "invalid error code";
+	if (addr != pmach->_pc - 1)
+		return "error address is not the faulting instruction";
+	if (err == ERR_SEGTEXT && pmach->_pc >= pmach->_textsize)
+		return NULL; // Sortie du segment de texte en séquence ou par RET
+	if (addr >= pmach->_textsize)
+		return "error address outside the text segment";
+
+	Instruction instr = pmach->_text[addr];
+	Code_Op cop = instr.instr_generic._cop;
+	bool target = cop <= LAST_COP && cop_info[cop]._operand == OPERAND_TARGET;
+	switch (err) {
+		case ERR_SEGTEXT:
+			// Branchement pris vers une destination hors du segment de texte
+			return target && instr.instr_absolute._address >= pmach->_textsize
+				? NULL : "ERR_SEGTEXT inside the text segment";
+		case ERR_UNKNOWN:
+		case ERR_ILLEGAL:
+		case ERR_IMMEDIATE:
+		case ERR_CONDITION:
+			// Erreurs statiques : la table des codes opérations fait foi
+			return instruction_check(instr) == err ? NULL : "static error not matching instruction_check()";
+		case ERR_SEGDATA:
+			// Une destination de branchement n'est pas une adresse de données
+			return cop == MOVE || cop == FILL
+				|| (cop <= LAST_COP && cop_info[cop]._operand != OPERAND_NONE && !target)
+				? NULL : "data segmentation error on an instruction without data access";
+		case ERR_SEGSTACK:
+			return cop == CALL || cop == RET || cop == PUSH || cop == POP
+				? NULL : "stack error on an instruction without stack access";
+		case ERR_DIVZERO:
+			return cop == DIV || cop == MOD ? NULL : "division by zero outside DIV and MOD";
+		default:
+			return "unexpected error code";
+	}
+}
+
+/*!
+ * Boucle d'un thread de fuzzing.
+ */
+static void *worker_main(void *arg) {
+	Worker *pw = arg;
+	current = pw;
+
+	// Pile de secours pour les débordements de pile du simulateur
+	stack_t ss;
+	ss.ss_sp = checked_realloc(NULL, SIGSTKSZ, "le fuzzer");
+	ss.ss_size = SIGSTKSZ;
+	ss.ss_flags = 0;
+	sigaltstack(&ss, NULL);
+
+	cov_local = checked_calloc(COV_SIZE, "le fuzzer");
+	cov_touched = checked_realloc(NULL, COV_SIZE * sizeof(unsigned), "le fuzzer");
+	pw->_cur._words = checked_realloc(NULL, FUZZ_MAXWORDS * sizeof(uint32_t), "le fuzzer");
+
+	Machine mach;
+	while (!stop) {
+		corpus_pick(pw, &pw->_cur);
+		mutate(pw, &pw->_cur);
+		if (!fuzz_load(pw, &mach, &pw->_cur))
+			continue;
+
+		Error err = ERR_NOERROR;
+		unsigned addr = 0;
+		cov_prev = 0;
+		cov_ntouched = 0;
+		Run_Status status = simul_run(&mach, budget, &err, &addr);
+		__atomic_add_fetch(&pw->_execs, 1, __ATOMIC_RELAXED);
+
+		const char *msg = check_fault(&mach, status, err, addr);
+		if (msg != NULL) {
+			char file[512];
+			snprintf(file, sizeof(file), "%s/fault-%08x.bin", outdir, image_hash(&pw->_cur));
+			save_image(file, &pw->_cur);
+			__atomic_add_fetch(&nfaults, 1, __ATOMIC_RELAXED);
+			fprintf(stderr, "fuzz_simul: %s (error %d at 0x%04x, pc 0x%04x): %s\n",
+				msg, err, addr, mach._pc, file);
+		}
+
+		// Nouveaux arcs ?
+		bool fresh = false;
+		for (unsigned i = 0; i < cov_ntouched; i++) {
+			unsigned edge = cov_touched[i];
+			cov_local[edge] = 0;
+			if (!__atomic_load_n(&global_cov[edge], __ATOMIC_RELAXED)
+			    && !__atomic_exchange_n(&global_cov[edge], 1, __ATOMIC_RELAXED)) {
+				__atomic_add_fetch(&nedges, 1, __ATOMIC_RELAXED);
+				fresh = true;
+			}
+		}
+		if (fresh)
+			corpus_add(&pw->_cur);
+	}
+	return NULL;
+}
+
+/*!
+ * Lecture d'une image de départ (format de read_program()). Le fuzzer mute
+ * les images au format de la version 1 : une image de version 2 est
+ * convertie.
+ */
+static bool read_seed(const char *file) {
+	Image_Reader reader;
+	if (!image_open(&reader, file)) {
+		fprintf(stderr, "Cannot open seed %s\n", file);
+		return false;
+	}
+	Image img;
+	img._words = checked_realloc(NULL, FUZZ_MAXWORDS * sizeof(uint32_t), "le fuzzer");
+	bool ok;
+	if (reader._version == 1) {
+		// Telle quelle, même tronquée
+		img._len = 0;
+		while (img._len < FUZZ_MAXWORDS) {
+			ssize_t n = read(reader._fd, img._words + img._len, (FUZZ_MAXWORDS - img._len) * sizeof(uint32_t));
+			if (n <= 0)
+				break;
+			img._len += n / sizeof(uint32_t);
+		}
+		ok = img._len >= 3 && img._words[0] <= FUZZ_MAXTEXT && img._words[1] <= FUZZ_MAXDATA;
+	} else {
+		ok = reader._textsize <= FUZZ_MAXTEXT && reader._datasize <= FUZZ_MAXDATA;
+		if (ok) {
+			img._len = 3 + reader._textsize + reader._datasize;
+			img._words[0] = reader._textsize;
+			img._words[1] = reader._datasize;
+			img._words[2] = reader._dataend;
+			ok = image_read_text(&reader, (Instruction *) &img._words[3])
+				&& image_read_data(&reader, &img._words[3 + reader._textsize]);
+		}
+	}
+	image_close(&reader);
+	if (ok)
+		corpus_add(&img);
+	else
+		fprintf(stderr, "Seed %s ignored (too large, truncated or corrupted)\n", file);
+	free(img._words);
+	return ok;
+}
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: fuzz_simul [options] seed.bin...\n"
+	       "where options are:\n"
+	       "\t-j n\tNumber of threads (default: number of cores)\n"
+	       "\t-t s\tDuration in seconds (default: 60)\n"
+	       "\t-n n\tInstruction budget per execution (default: 10000)\n"
+	       "\t-o dir\tDirectory for crash and fault images (default: .)\n"
+	       "\t-h\tprint this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned duration = 60;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (iarg + 1 >= argc || strchr("jtno", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'j': nthreads = atol(val); break;
+			case 't': duration = atoi(val); break;
+			case 'n': budget = strtoull(val, NULL, 10); break;
+			case 'o': outdir = val; break;
+		}
+	}
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > FUZZ_MAXTHREADS)
+		nthreads = FUZZ_MAXTHREADS;
+
+	for (; iarg < argc; iarg++)
+		read_seed(argv[iarg]);
+	if (ncorpus == 0) { // Graine minimale : un HALT
+		Instruction halt = {.instr_generic = {HALT}};
+		uint32_t words[] = {1, 16, 0, halt._raw};
+		Image img = {words, 4};
+		corpus_add(&img);
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_crash;
+	sa.sa_flags = SA_ONSTACK;
+	sigaction(SIGSEGV, &sa, NULL);
+	sigaction(SIGBUS, &sa, NULL);
+	sigaction(SIGFPE, &sa, NULL);
+	sigaction(SIGILL, &sa, NULL);
+	sigaction(SIGABRT, &sa, NULL);
+
+	Worker *workers = calloc(nthreads, sizeof(Worker));
+	pthread_t threads[FUZZ_MAXTHREADS];
+	if (workers == NULL) {
+		fprintf(stderr, "Erreur d'allocation mémoire pour le fuzzer\n");
+		return EXIT_FAILURE;
+	}
+	for (long t = 0; t < nthreads; t++) {
+		workers[t]._id = t;
+		workers[t]._rng = 0x9E3779B97F4A7C15ULL * (t + 1) ^ (uint64_t) time(NULL);
+		snprintf(workers[t]._crashfile, sizeof(workers[t]._crashfile), "%s/crash-%ld.bin", outdir, t);
+		pthread_create(&threads[t], NULL, worker_main, &workers[t]);
+	}
+
+	uint64_t last = 0;
+	for (unsigned sec = 0; sec < duration; sec++) {
+		sleep(1);
+		uint64_t execs = 0;
+		for (long t = 0; t < nthreads; t++)
+			execs += __atomic_load_n(&workers[t]._execs, __ATOMIC_RELAXED);
+		printf("[%4us] execs: %llu (%llu/s), corpus: %u, edges: %u, faults: %u\n",
+		       sec + 1, (unsigned long long) execs, (unsigned long long) (execs - last),
+		       __atomic_load_n(&ncorpus, __ATOMIC_RELAXED), __atomic_load_n(&nedges, __ATOMIC_RELAXED),
+		       __atomic_load_n(&nfaults, __ATOMIC_RELAXED));
+		fflush(stdout);
+		last = execs;
+	}
+	stop = 1;
+	for (long t = 0; t < nthreads; t++)
+		pthread_join(threads[t], NULL);
+
+	return nfaults == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,694 @@
+/***** gdbstub.c *****/
+#define _GNU_SOURCE
+#include "gdbstub.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+//! Taille maximale d'un paquet (annoncée au client)
+#define GDB_PACKETSIZE 4096
+
+//! Signaux des réponses d'arrêt (numérotation de GDB)
+enum
+{
+    GDB_SIGINT = 2,		//!< Interruption par le client
+    GDB_SIGILL = 4,		//!< Instruction inconnue, illégale ou mal formée
+    GDB_SIGTRAP = 5,		//!< Point d'arrêt ou pas à pas
+    GDB_SIGFPE = 8,		//!< Division par zéro
+    GDB_SIGSEGV = 11,		//!< Erreur de segmentation
+};
+
+//! Point d'arrêt logiciel
+typedef struct
+{
+    unsigned _addr;		//!< Adresse de l'instruction
+    Instruction _saved;		//!< Instruction remplacée par \c trap
+} Breakpoint;
+
+//! État d'une session
+typedef struct
+{
+    Machine *_mach;		//!< La machine mise au point
+    int _fd;			//!< Connexion du client
+    bool _noack;		//!< Acquittements supprimés (QStartNoAckMode)
+    bool _closed;		//!< Le client s'est déconnecté pendant l'exécution
+    unsigned char _in[GDB_PACKETSIZE];//!< Tampon de réception
+    size_t _inlen;		//!< Octets reçus dans \c _in
+    size_t _inpos;		//!< Octets de \c _in déjà lus
+    char _packet[GDB_PACKETSIZE + 1];//!< Paquet reçu (sans cadre)
+    char _reply[GDB_PACKETSIZE + 1];//!< Réponse en construction
+    Breakpoint *_bps;		//!< Points d'arrêt
+    unsigned _nbps;		//!< Nombre de points d'arrêt
+    unsigned _maxbps;		//!< Nombre de points d'arrêt alloués
+    bool _alive;		//!< La machine peut-elle encore s'exécuter ?
+    bool _terminated;		//!< Reprise demandée après une erreur d'exécution
+    int _signal;		//!< Signal du dernier arrêt
+    Gdb_Outcome _outcome;	//!< Fin de la session
+    Error _err;			//!< Erreur (si \c GDB_ERROR)
+    unsigned _addr;		//!< Adresse de \c HALT ou de l'erreur
+} Session;
+
+//! Instruction de remplacement d'un point d'arrêt
+static const Instruction trap = {.instr_generic = {._cop = ILLOP}};
+
+/*======================================
+ *
+ *		PAQUETS
+ *======================================
+ */
+
+//! Valeur d'un chiffre hexadécimal, ou -1
+static int hexval(int c) {
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+//! Lecture d'un nombre hexadécimal (au moins un chiffre) ; avance \a *pp
+static bool parse_hex(const char **pp, uint64_t *pv) {
+	const char *p = *pp;
+	uint64_t v = 0;
+	while (hexval(*p) >= 0 && v >> 60 == 0)
+		v = v << 4 | hexval(*p++);
+	if (p == *pp || hexval(*p) >= 0)
+		return false;
+	*pp = p;
+	*pv = v;
+	return true;
+}
+
+//! Écriture d'un mot en hexadécimal, octet de poids faible en tête
+static void put_word(char *p, Word w) {
+	for (int i = 0; i < 4; i++)
+		sprintf(p + 2 * i, "%02x", (w >> (8 * i)) & 0xff);
+}
+
+//! Lecture d'un mot écrit par put_word()
+static bool get_word(const char *p, Word *pw) {
+	Word w = 0;
+	for (int i = 0; i < 8; i += 2) {
+		int h = hexval(p[i]), l = h >= 0 ? hexval(p[i + 1]) : -1;
+		if (l < 0)
+			return false;
+		w |= (Word) (h << 4 | l) << (4 * i);
+	}
+	*pw = w;
+	return true;
+}
+
+//! Octet suivant du client, ou -1 en fin de connexion
+static int get_byte(Session *ps) {
+	if (ps->_inpos == ps->_inlen) {
+		ssize_t n;
+		do
+			n = recv(ps->_fd, ps->_in, sizeof(ps->_in), 0);
+		while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return -1;
+		ps->_inlen = n;
+		ps->_inpos = 0;
+	}
+	return ps->_in[ps->_inpos++];
+}
+
+//! Envoi de \a len octets
+static bool send_all(Session *ps, const char *buf, size_t len) {
+	while (len > 0) {
+		ssize_t n = send(ps->_fd, buf, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/*!
+ * Réception d'un paquet <tt>$données#cc</tt> dans \c _packet, acquitté sauf
+ * en mode sans acquittement. Les octets hors paquet (acquittements,
+ * interruptions pendant l'arrêt) sont ignorés ; un paquet altéré est refusé
+ * (\c -) et le client le renvoie.
+ *
+ * \return la longueur des données, ou -1 en fin de connexion
+ */
+static int read_packet(Session *ps) {
+	for (;;) {
+		int c;
+		while ((c = get_byte(ps)) != '$')
+			if (c < 0)
+				return -1;
+		size_t len = 0;
+		unsigned sum = 0;
+		bool overflow = false;
+		while ((c = get_byte(ps)) != '#') {
+			if (c < 0)
+				return -1;
+			sum += c;
+			if (len < GDB_PACKETSIZE)
+				ps->_packet[len++] = c;
+			else
+				overflow = true;
+		}
+		int h = get_byte(ps), l = get_byte(ps);
+		if (h < 0 || l < 0)
+			return -1;
+		bool ok = !overflow && (ps->_noack
+					|| (hexval(h) >= 0 && hexval(l) >= 0 && (hexval(h) << 4 | hexval(l)) == (int) (sum & 0xff)));
+		if (!ps->_noack && !send_all(ps, ok ? "+" : "-", 1))
+			return -1;
+		if (ok) {
+			ps->_packet[len] = '\0';
+			return len;
+		}
+	}
+}
+
+/*!
+ * Envoi d'un paquet, renvoyé tant que le client le refuse.
+ *
+ * \return faux si la connexion est rompue
+ */
+static bool send_packet(Session *ps, const char *data) {
+	static char frame[GDB_PACKETSIZE + 5];
+	size_t len = strlen(data);
+	unsigned sum = 0;
+	frame[0] = '$';
+	for (size_t i = 0; i < len; i++) {
+		frame[i + 1] = data[i];
+		sum += (unsigned char) data[i];
+	}
+	sprintf(frame + len + 1, "#%02x", sum & 0xff);
+	for (;;) {
+		if (!send_all(ps, frame, len + 4))
+			return false;
+		if (ps->_noack)
+			return true;
+		int c = get_byte(ps);
+		if (c < 0)
+			return false;
+		if (c != '-')
+			return true;
+	}
+}
+
+/*======================================
+ *
+ *		MACHINE
+ *======================================
+ */
+
+//! Point d'arrêt à une adresse, ou NULL
+static Breakpoint *find_breakpoint(Session *ps, unsigned addr) {
+	for (unsigned i = 0; i < ps->_nbps; i++)
+		if (ps->_bps[i]._addr == addr)
+			return &ps->_bps[i];
+	return NULL;
+}
+
+//! Pose d'un point d'arrêt (faux hors du segment de texte)
+static bool insert_breakpoint(Session *ps, uint64_t addr) {
+	Machine *pmach = ps->_mach;
+	if (addr >= pmach->_textsize)
+		return false;
+	if (find_breakpoint(ps, addr) != NULL)
+		return true;
+	if (ps->_nbps == ps->_maxbps) {
+		ps->_maxbps = ps->_maxbps > 0 ? 2 * ps->_maxbps : 16;
+		ps->_bps = checked_realloc(ps->_bps, ps->_maxbps * sizeof(Breakpoint), "les points d'arrêt");
+	}
+	ps->_bps[ps->_nbps++] = (Breakpoint) {addr, pmach->_text[addr]};
+	pmach->_text[addr] = trap;
+	return true;
+}
+
+//! Retrait d'un point d'arrêt (sans effet s'il n'est pas posé)
+static void remove_breakpoint(Session *ps, uint64_t addr) {
+	Breakpoint *pb = addr < ps->_mach->_textsize ? find_breakpoint(ps, addr) : NULL;
+	if (pb == NULL)
+		return;
+	ps->_mach->_text[pb->_addr] = pb->_saved;
+	*pb = ps->_bps[--ps->_nbps];
+}
+
+//! Valeur d'un registre du protocole
+static Word get_register(const Machine *pmach, unsigned r) {
+	if (r < NREGISTERS)
+		return pmach->_registers[r];
+	return r == GDB_REG_PC ? pmach->_pc : (Word) pmach->_cc;
+}
+
+//! Modification d'un registre du protocole
+static void set_register(Machine *pmach, unsigned r, Word value) {
+	if (r < NREGISTERS)
+		pmach->_registers[r] = value;
+	else if (r == GDB_REG_PC)
+		pmach->_pc = value;
+	else
+		pmach->_cc = value <= LAST_CC ? (Condition_Code) value : CC_U;
+}
+
+//! Lecture d'un octet de l'espace du client (les points d'arrêt sont invisibles)
+static bool read_byte(Session *ps, uint64_t addr, unsigned char *pb) {
+	const Machine *pmach = ps->_mach;
+	Word w;
+	if (addr >= GDB_TEXT_BASE) {
+		uint64_t k = (addr - GDB_TEXT_BASE) / 4;
+		if (k >= pmach->_textsize)
+			return false;
+		Breakpoint *pbp = find_breakpoint(ps, k);
+		w = pbp != NULL ? pbp->_saved._raw : pmach->_text[k]._raw;
+	} else {
+		if (addr / 4 >= pmach->_datasize)
+			return false;
+		w = pmach->_data[addr / 4];
+	}
+	*pb = w >> (8 * (addr % 4));
+	return true;
+}
+
+//! Écriture d'un octet du segment de données
+static bool write_byte(Session *ps, uint64_t addr, unsigned char b) {
+	Machine *pmach = ps->_mach;
+	if (addr / 4 >= pmach->_datasize)
+		return false;
+	unsigned shift = 8 * (addr % 4);
+	Word *pw = &pmach->_data[addr / 4];
+	*pw = (*pw & ~((Word) 0xff << shift)) | (Word) b << shift;
+	return true;
+}
+
+//! Signal correspondant à une erreur d'exécution
+static int error_signal(Error err) {
+	switch (err) {
+		case ERR_SEGTEXT:
+		case ERR_SEGDATA:
+		case ERR_SEGSTACK:
+			return GDB_SIGSEGV;
+		case ERR_DIVZERO:
+			return GDB_SIGFPE;
+		default:
+			return GDB_SIGILL;
+	}
+}
+
+/*!
+ * Réponse d'arrêt (ou de fin du programme) dans \c _reply. Après une erreur
+ * d'exécution, le programme reste arrêté sur son signal (et peut être
+ * examiné) jusqu'à ce que le client tente de le reprendre.
+ */
+static void stop_reply(Session *ps) {
+	if (ps->_outcome == GDB_HALT)
+		strcpy(ps->_reply, "W00");
+	else if (ps->_alive || !ps->_terminated)
+		sprintf(ps->_reply, "S%02x", ps->_signal);
+	else
+		sprintf(ps->_reply, "X%02x", ps->_signal);
+}
+
+/*!
+ * Le client demande-t-il une interruption (octet 0x03) ? Une déconnexion
+ * interrompt aussi l'exécution.
+ */
+static bool interrupted(Session *ps) {
+	while (ps->_inpos < ps->_inlen)
+		if (ps->_in[ps->_inpos++] == 0x03)
+			return true;
+	struct pollfd pfd = {.fd = ps->_fd, .events = POLLIN};
+	if (poll(&pfd, 1, 0) <= 0)
+		return false;
+	int c = get_byte(ps);
+	if (c < 0)
+		ps->_closed = true;
+	return c < 0 || c == 0x03;
+}
+
+/*!
+ * Exécution jusqu'au prochain arrêt (une seule instruction si \a step) ; le
+ * motif de l'arrêt est rangé dans la session. Une instruction sous un point
+ * d'arrêt est exécutée en remettant l'instruction d'origine le temps de
+ * cette seule instruction.
+ */
+static void resume(Session *ps, bool step) {
+	Machine *pmach = ps->_mach;
+	Error err = ERR_NOERROR;
+	unsigned addr = 0;
+	Run_Status status = RUN_BUDGET;
+	Breakpoint *pb = pmach->_pc < pmach->_textsize ? find_breakpoint(ps, pmach->_pc) : NULL;
+	if (step || pb != NULL) {
+		if (pb != NULL)
+			pmach->_text[pb->_addr] = pb->_saved;
+		status = simul_run(pmach, 1, &err, &addr);
+		if (pb != NULL)
+			pmach->_text[pb->_addr] = trap;
+	}
+	while (status == RUN_BUDGET && !step) {
+		if (interrupted(ps)) {
+			ps->_signal = GDB_SIGINT;
+			return;
+		}
+		status = simul_run(pmach, GDB_CHUNK, &err, &addr);
+	}
+
+	switch (status) {
+		case RUN_BUDGET:
+			ps->_signal = GDB_SIGTRAP;
+			break;
+		case RUN_HALT:
+			ps->_alive = false;
+			ps->_outcome = GDB_HALT;
+			ps->_addr = pmach->_pc - 1;
+			break;
+		case RUN_ERROR:
+			if (err == ERR_ILLEGAL && addr < pmach->_textsize && find_breakpoint(ps, addr) != NULL) {
+				// Point d'arrêt : l'instruction n'a pas été exécutée
+				pmach->_pc = addr;
+				pmach->_icount--;
+				ps->_signal = GDB_SIGTRAP;
+				break;
+			}
+			ps->_alive = false;
+			ps->_outcome = GDB_ERROR;
+			ps->_err = err;
+			ps->_addr = addr;
+			ps->_signal = error_signal(err);
+			break;
+	}
+}
+
+/*======================================
+ *
+ *		REQUÊTES
+ *======================================
+ */
+
+//! Description des registres (qXfer:features:read:target.xml)
+static const char *target_xml(void) {
+	static char xml[2048];
+	if (xml[0] != '\0')
+		return xml;
+	int n = sprintf(xml,
+			"<?xml version=\"1.0\"?>\n"
+			"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">\n"
+			"<target version=\"1.0\">\n"
+			"<feature name=\"org.simul.cpu\">\n");
+	for (int r = 0; r < NREGISTERS; r++)
+		n += sprintf(xml + n, "<reg name=\"r%d\" bitsize=\"32\" type=\"%s\" regnum=\"%d\"/>\n",
+			     r, r == NREGISTERS - 1 ? "data_ptr" : "int32", r);
+	sprintf(xml + n,
+		"<reg name=\"pc\" bitsize=\"32\" type=\"code_ptr\" regnum=\"%d\"/>\n"
+		"<reg name=\"cc\" bitsize=\"32\" type=\"int32\" regnum=\"%d\"/>\n"
+		"</feature>\n</target>\n", GDB_REG_PC, GDB_REG_CC);
+	return xml;
+}
+
+//! Requêtes générales (\c q...)
+static void handle_query(Session *ps, const char *p) {
+	char *reply = ps->_reply;
+	const char *xfer = "qXfer:features:read:target.xml:";
+	uint64_t offset, length;
+	if (strncmp(p, "qSupported", 10) == 0)
+		sprintf(reply, "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+", GDB_PACKETSIZE);
+	else if (strcmp(p, "qAttached") == 0)
+		strcpy(reply, "1");
+	else if (strcmp(p, "qC") == 0)
+		strcpy(reply, "QC1");
+	else if (strcmp(p, "qfThreadInfo") == 0)
+		strcpy(reply, "m1");
+	else if (strcmp(p, "qsThreadInfo") == 0)
+		strcpy(reply, "l");
+	else if (strncmp(p, xfer, strlen(xfer)) == 0) {
+		p += strlen(xfer);
+		if (!parse_hex(&p, &offset) || *p++ != ',' || !parse_hex(&p, &length)) {
+			strcpy(reply, "E01");
+			return;
+		}
+		const char *xml = target_xml();
+		size_t size = strlen(xml);
+		if (length > GDB_PACKETSIZE - 1)
+			length = GDB_PACKETSIZE - 1;
+		if (offset >= size) {
+			strcpy(reply, "l");
+			return;
+		}
+		size_t n = size - offset < length ? size - offset : length;
+		reply[0] = offset + n < size ? 'm' : 'l';
+		memcpy(reply + 1, xml + offset, n);
+		reply[n + 1] = '\0';
+	}
+}
+
+/*!
+ * Traitement d'un paquet reçu ; la réponse est envoyée ici.
+ *
+ * \return vrai si la session est terminée
+ */
+static bool handle_packet(Session *ps) {
+	Machine *pmach = ps->_mach;
+	const char *p = ps->_packet;
+	char *reply = ps->_reply;
+	uint64_t addr, len, value;
+	reply[0] = '\0';
+
+	switch (*p++) {
+		case '?':
+			stop_reply(ps);
+			break;
+
+		case 'g':
+			for (unsigned r = 0; r < GDB_NREGS; r++)
+				put_word(reply + 8 * r, get_register(pmach, r));
+			break;
+		case 'G':
+			if (strlen(p) != 8 * GDB_NREGS) {
+				strcpy(reply, "E01");
+				break;
+			}
+			for (unsigned r = 0; r < GDB_NREGS; r++) {
+				Word w;
+				if (!get_word(p + 8 * r, &w)) {
+					strcpy(reply, "E01");
+					return !send_packet(ps, reply);
+				}
+				set_register(pmach, r, w);
+			}
+			strcpy(reply, "OK");
+			break;
+		case 'p':
+			if (!parse_hex(&p, &value) || value >= GDB_NREGS)
+				strcpy(reply, "E01");
+			else
+				put_word(reply, get_register(pmach, value));
+			break;
+		case 'P': {
+			Word w;
+			if (!parse_hex(&p, &value) || value >= GDB_NREGS || *p++ != '=' || strlen(p) != 8 || !get_word(p, &w))
+				strcpy(reply, "E01");
+			else {
+				set_register(pmach, value, w);
+				strcpy(reply, "OK");
+			}
+			break;
+		}
+
+		case 'm': {
+			if (!parse_hex(&p, &addr) || *p++ != ',' || !parse_hex(&p, &len)) {
+				strcpy(reply, "E01");
+				break;
+			}
+			if (len > GDB_PACKETSIZE / 2)
+				len = GDB_PACKETSIZE / 2;
+			// Lecture partielle jusqu'au premier octet inaccessible
+			uint64_t i = 0;
+			unsigned char b;
+			for (; i < len && read_byte(ps, addr + i, &b); i++)
+				sprintf(reply + 2 * i, "%02x", b);
+			if (i == 0 && len > 0)
+				strcpy(reply, "E01");
+			break;
+		}
+		case 'M': {
+			if (!parse_hex(&p, &addr) || *p++ != ',' || !parse_hex(&p, &len) || *p++ != ':'
+			    || strlen(p) != 2 * len) {
+				strcpy(reply, "E01");
+				break;
+			}
+			strcpy(reply, "OK");
+			for (uint64_t i = 0; i < len; i++) {
+				int h = hexval(p[2 * i]), l = hexval(p[2 * i + 1]);
+				if (h < 0 || l < 0 || !write_byte(ps, addr + i, h << 4 | l)) {
+					strcpy(reply, "E01");
+					break;
+				}
+			}
+			break;
+		}
+
+		case 'c':
+		case 's':
+			if (*p != '\0') {
+				if (!parse_hex(&p, &addr)) {
+					strcpy(reply, "E01");
+					break;
+				}
+				pmach->_pc = addr;
+			}
+			if (ps->_alive)
+				resume(ps, ps->_packet[0] == 's');
+			else
+				ps->_terminated = true;
+			if (ps->_closed)
+				return true;
+			stop_reply(ps);
+			break;
+
+		case 'Z':
+		case 'z': {
+			// Points d'arrêt logiciels (0) ou matériels (1), traités de même
+			char type = *p++;
+			if ((type != '0' && type != '1') || *p++ != ',' || !parse_hex(&p, &addr))
+				break;
+			if (ps->_packet[0] == 'z')
+				remove_breakpoint(ps, addr);
+			else if (!insert_breakpoint(ps, addr)) {
+				strcpy(reply, "E01");
+				break;
+			}
+			strcpy(reply, "OK");
+			break;
+		}
+
+		case 'H':
+		case 'T':
+			strcpy(reply, "OK");
+			break;
+		case 'D':
+			send_packet(ps, "OK");
+			return true;
+		case 'k':
+			if (ps->_alive)
+				ps->_outcome = GDB_KILLED;
+			return true;
+
+		case 'q':
+			handle_query(ps, ps->_packet);
+			break;
+		case 'Q':
+			if (strcmp(p, "StartNoAckMode") == 0) {
+				bool sent = send_packet(ps, "OK");
+				ps->_noack = true;
+				return !sent;
+			}
+			break;
+		case 'v':
+			if (strcmp(p, "Kill") == 0 || strncmp(p, "Kill;", 5) == 0) {
+				if (ps->_alive)
+					ps->_outcome = GDB_KILLED;
+				send_packet(ps, "OK");
+				return true;
+			}
+			break;
+	}
+	return !send_packet(ps, reply);
+}
+
+/*======================================
+ *
+ *		SESSION
+ *======================================
+ */
+
+/*!
+ * Socket d'écoute : port TCP de 127.0.0.1 si \a address n'a que des
+ * chiffres, socket Unix sinon.
+ */
+static int listen_on(const char *address, bool *punix) {
+	*punix = address[0] == '\0' || strspn(address, "0123456789") != strlen(address);
+	int fd;
+	if (*punix) {
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (strlen(address) >= sizeof(sa.sun_path)) {
+			fprintf(stderr, "Socket path too long: %s\n", address);
+			exit(1);
+		}
+		strcpy(sa.sun_path, address);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(address);
+		if (fd < 0 || bind(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0 || listen(fd, 1) != 0)
+			fd = -1;
+	} else {
+		struct sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = htons(atoi(address));
+		sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		int one = 1;
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd >= 0)
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (fd < 0 || bind(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0 || listen(fd, 1) != 0)
+			fd = -1;
+	}
+	if (fd < 0) {
+		fprintf(stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+		exit(1);
+	}
+	return fd;
+}
+
+Gdb_Outcome gdb_serve(Machine *pmach, const char *address, Error *perr, unsigned *paddr) {
+	bool unix_socket;
+	int lfd = listen_on(address, &unix_socket);
+	printf("gdbstub: waiting for a debugger on %s\n", address);
+	fflush(stdout);
+	int fd;
+	do
+		fd = accept(lfd, NULL, NULL);
+	while (fd < 0 && errno == EINTR);
+	if (fd < 0) {
+		fprintf(stderr, "accept: %s\n", strerror(errno));
+		exit(1);
+	}
+	close(lfd);
+	if (unix_socket)
+		unlink(address);
+	else {
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	}
+
+	Session *ps = checked_calloc(sizeof(Session), "la session de mise au point");
+	ps->_mach = pmach;
+	ps->_fd = fd;
+	ps->_alive = true;
+	ps->_signal = GDB_SIGTRAP;
+	ps->_outcome = GDB_DETACHED;
+
+	while (read_packet(ps) >= 0 && !handle_packet(ps))
+		;
+
+	while (ps->_nbps > 0)
+		remove_breakpoint(ps, ps->_bps[0]._addr);
+	close(fd);
+	Gdb_Outcome outcome = ps->_outcome;
+	*perr = ps->_err;
+	*paddr = ps->_addr;
+	free(ps->_bps);
+	free(ps);
+	return outcome;
+}
@@ -0,0 +1,77 @@
+#ifndef _GDBSTUB_H_
+#define _GDBSTUB_H_
+
+/*!
+ * \file gdbstub.h
+ * \brief Serveur du protocole distant de GDB (RSP) sur socket locale.
+ *
+ * Le serveur attend un débogueur (GDB, ou tout client RSP) sur une socket
+ * TCP locale (127.0.0.1) ou du domaine Unix, puis lui obéit : lecture et
+ * écriture des registres et de la mémoire, points d'arrêt logiciels, pas à
+ * pas, exécution jusqu'au prochain arrêt, interruption (Ctrl-C).
+ *
+ * Registres (32 bits, petit-boutistes), décrits au client par
+ * <tt>target.xml</tt> : \c r0 à \c r15 (numéros 0 à 15, \c r15 est le
+ * pointeur de pile), \c pc (16, adresse d'instruction) et \c cc (17, valeur
+ * de \c Condition_Code).
+ *
+ * Mémoire : le segment de données occupe les adresses d'octets à partir de 0
+ * (le mot \e k en \e 4k, petit-boutiste) ; le segment de texte est lisible à
+ * partir de \c GDB_TEXT_BASE, de la même façon. Les ports des périphériques
+ * ne sont pas accessibles : leur lecture a des effets.
+ *
+ * Un point d'arrêt remplace l'instruction par \c ILLOP dans le segment de
+ * texte : entre deux arrêts, la machine s'exécute par simul_run() à pleine
+ * vitesse, par tranches de \c GDB_CHUNK instructions entre lesquelles seule
+ * une interruption du client est guettée. L'erreur \c ERR_ILLEGAL d'un point
+ * d'arrêt n'est pas comptée comme instruction exécutée ; le client ne voit
+ * jamais l'instruction de remplacement.
+ *
+ * L'accélération des boucles et la mémoïsation (loops.h, memo.h) ne doivent
+ * pas être actives : elles franchiraient les points d'arrêt.
+ */
+
+#include <stdint.h>
+
+#include "machine.h"
+#include "error.h"
+
+//! Adresse (en octets) du segment de texte dans l'espace vu par le client
+#define GDB_TEXT_BASE 0x80000000u
+
+//! Nombre d'instructions exécutées entre deux recherches d'interruption
+#define GDB_CHUNK (1u << 20)
+
+//! Numéros des registres du protocole au-delà des registres généraux
+enum
+{
+    GDB_REG_PC = NREGISTERS,	//!< Compteur ordinal
+    GDB_REG_CC,			//!< Code condition
+    GDB_NREGS,			//!< Nombre de registres
+};
+
+//! Fin d'une session de mise au point
+typedef enum
+{
+    GDB_DETACHED = 0,		//!< Le client s'est détaché (ou déconnecté) : la machine peut continuer
+    GDB_HALT,			//!< Le programme a exécuté \c HALT
+    GDB_ERROR,			//!< Le programme a provoqué une erreur d'exécution
+    GDB_KILLED,			//!< Le client a arrêté le programme
+} Gdb_Outcome;
+
+//! Session de mise au point d'une machine par un client RSP
+/*!
+ * Attend une connexion, la sert jusqu'à sa fin, puis referme la socket
+ * (et retire la socket Unix du système de fichiers). Les points d'arrêt sont
+ * retirés du segment de texte avant le retour. Le simulateur s'arrête si la
+ * socket ne peut pas être ouverte.
+ *
+ * \param pmach la machine, programme chargé
+ * \param address numéro de port TCP (que des chiffres) ou chemin de socket Unix
+ * \param perr code de l'erreur si le résultat est \c GDB_ERROR
+ * \param paddr adresse de \c HALT ou de l'erreur
+ * \return la fin de la session
+ */
+Gdb_Outcome gdb_serve(Machine *pmach, const char *address, Error *perr, unsigned *paddr);
+
+#endif
@@ -0,0 +1,68 @@
+/***** hooks.c *****/
+#include "hooks.h"
+
+void hooks_add(Machine *pmach, Hooks *ph) {
+	Hooks **pp = &pmach->_hooks;
+	while (*pp != NULL)
+		pp = &(*pp)->_next;
+	ph->_next = NULL;
+	*pp = ph;
+}
+
+void hooks_remove(Machine *pmach, Hooks *ph) {
+	for (Hooks **pp = &pmach->_hooks; *pp != NULL; pp = &(*pp)->_next)
+		if (*pp == ph) {
+			*pp = ph->_next;
+			ph->_next = NULL;
+			return;
+		}
+}
+
+bool hooks_notrace(const Machine *pmach) {
+	for (Hooks *ph = pmach->_hooks; ph != NULL; ph = ph->_next)
+		if (ph->_notrace)
+			return true;
+	return false;
+}
+
+//! Appel du crochet \a hook de chaque jeu qui en a un
+#define EACH(pmach, hook, ...) \
+	for (Hooks *ph = (pmach)->_hooks; ph != NULL; ph = ph->_next) \
+		if (ph->hook != NULL) \
+			ph->hook(ph->_ctx, (pmach), __VA_ARGS__)
+
+void hooks_retire(Machine *pmach, unsigned addr, Instruction instr) {
+	EACH(pmach, _retire, addr, instr);
+}
+
+void hooks_read(Machine *pmach, unsigned addr, Word value) {
+	EACH(pmach, _read, addr, value);
+}
+
+void hooks_write(Machine *pmach, unsigned addr, Word old, Word value) {
+	EACH(pmach, _write, addr, old, value);
+}
+
+void hooks_push(Machine *pmach, unsigned addr, Word value) {
+	EACH(pmach, _push, addr, value);
+}
+
+void hooks_pop(Machine *pmach, unsigned addr, Word value) {
+	EACH(pmach, _pop, addr, value);
+}
+
+void hooks_call(Machine *pmach, unsigned from, unsigned to) {
+	EACH(pmach, _call, from, to);
+}
+
+void hooks_ret(Machine *pmach, unsigned from, unsigned to) {
+	EACH(pmach, _ret, from, to);
+}
+
+void hooks_branch(Machine *pmach, unsigned addr, unsigned target, bool taken) {
+	EACH(pmach, _branch, addr, target, taken);
+}
+
+void hooks_fault(Machine *pmach, Error err, unsigned addr) {
+	EACH(pmach, _fault, err, addr);
+}
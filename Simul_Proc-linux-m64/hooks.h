@@ -0,0 +1,93 @@
+#ifndef _HOOKS_H_
+#define _HOOKS_H_
+
+/*!
+ * \file hooks.h
+ * \brief Crochets d'instrumentation de l'exécution.
+ *
+ * Une analyse (profileur, trace, couverture, modèle de cache...) s'attache à
+ * une machine en y enregistrant un jeu de crochets : des fonctions appelées
+ * à chaque événement de l'exécution. Une machine peut en porter plusieurs ;
+ * ils sont appelés dans l'ordre d'enregistrement.
+ *
+ * exec.c est compilé deux fois : decode_execute() ne contient aucun appel de
+ * crochet, decode_execute_hooked() les appelle tous. simul() et simul_run()
+ * choisissent l'une ou l'autre une fois pour toutes au lancement, selon
+ * qu'un crochet est enregistré ou non : sans crochet, l'exécution ne paie
+ * aucun test par instruction.
+ */
+
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Jeu de crochets d'une analyse
+/*!
+ * Chaque crochet peut être NULL. Ils reçoivent le contexte de l'analyse et la
+ * machine, et sont appelés après l'événement (sauf indication contraire).
+ * Les adresses d'instruction sont celles de l'instruction en cours.
+ */
+typedef struct Hooks
+{
+    void *_ctx;			//!< Contexte passé à chaque crochet
+    bool _notrace;		//!< Remplace la trace textuelle de simul()
+
+    //! Instruction terminée (y compris \c HALT ; pas en cas d'erreur)
+    void (*_retire)(void *ctx, Machine *pmach, unsigned addr, Instruction instr);
+    //! Lecture d'un opérande en mémoire de données (hors pile)
+    void (*_read)(void *ctx, Machine *pmach, unsigned addr, Word value);
+    //! Écriture en mémoire de données, pile comprise (appelé avant l'écriture)
+    void (*_write)(void *ctx, Machine *pmach, unsigned addr, Word old, Word value);
+    //! Empilement de \a value à l'adresse \a addr
+    void (*_push)(void *ctx, Machine *pmach, unsigned addr, Word value);
+    //! Dépilement de \a value depuis l'adresse \a addr
+    void (*_pop)(void *ctx, Machine *pmach, unsigned addr, Word value);
+    //! \c CALL effectif de \a from vers \a to
+    void (*_call)(void *ctx, Machine *pmach, unsigned from, unsigned to);
+    //! \c RET de \a from vers \a to
+    void (*_ret)(void *ctx, Machine *pmach, unsigned from, unsigned to);
+    //! \c BRANCH résolu (\a target est la destination, prise ou non)
+    void (*_branch)(void *ctx, Machine *pmach, unsigned addr, unsigned target, bool taken);
+    //! Erreur d'exécution (appelé avant error())
+    void (*_fault)(void *ctx, Machine *pmach, Error err, unsigned addr);
+
+    struct Hooks *_next;	//!< Jeu suivant de la machine
+} Hooks;
+
+//! Enregistrement d'un jeu de crochets
+/*!
+ * Le jeu doit rester valide tant qu'il est enregistré. Il est ajouté à la
+ * fin de la liste de la machine.
+ *
+ * \param pmach la machine
+ * \param ph le jeu de crochets
+ */
+void hooks_add(Machine *pmach, Hooks *ph);
+
+//! Retrait d'un jeu de crochets (sans effet s'il n'est pas enregistré)
+/*!
+ * \param pmach la machine
+ * \param ph le jeu de crochets
+ */
+void hooks_remove(Machine *pmach, Hooks *ph);
+
+//! Un des jeux enregistrés remplace-t-il la trace textuelle ?
+bool hooks_notrace(const Machine *pmach);
+
+/*!
+ * \name Appel des crochets de tous les jeux d'une machine
+ * Utilisés par decode_execute_hooked() et les boucles de simulation.
+ * \{
+ */
+void hooks_retire(Machine *pmach, unsigned addr, Instruction instr);
+void hooks_read(Machine *pmach, unsigned addr, Word value);
+void hooks_write(Machine *pmach, unsigned addr, Word old, Word value);
+void hooks_push(Machine *pmach, unsigned addr, Word value);
+void hooks_pop(Machine *pmach, unsigned addr, Word value);
+void hooks_call(Machine *pmach, unsigned from, unsigned to);
+void hooks_ret(Machine *pmach, unsigned from, unsigned to);
+void hooks_branch(Machine *pmach, unsigned addr, unsigned target, bool taken);
+void hooks_fault(Machine *pmach, Error err, unsigned addr);
+//! \}
+
+#endif
@@ -0,0 +1,655 @@
+/***** image.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "image.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+//! Nombre maximal de sections d'une image
+#define IMAGE_MAXSECTIONS 1024
+
+//! Taille d'un segment adressable (adresses absolues de 20 bits)
+#define IMAGE_MAXWORDS (1u << 20)
+
+//! Taille arrondie au multiple de 4 supérieur
+#define ROUND4(n) (((n) + 3) & ~(uint64_t) 3)
+
+//! Valeur initiale de la somme de contrôle (FNV-1a)
+#define FNV_BASIS 0xcbf29ce484222325ULL
+
+//! Distance maximale d'une répétition (codée sur au plus 2 octets)
+#define LZ_WINDOW 16383
+
+//! Nombre d'entrées de la table de hachage du compresseur
+#define LZ_HASH 4096
+
+//! Taille des blocs lus par le décompresseur
+#define LZ_BLOCK 4096
+
+//! Ordre des octets de la machine hôte
+static uint8_t host_order(void) {
+	uint16_t one = 1;
+	return *(uint8_t *) &one ? IMAGE_LITTLE : IMAGE_BIG;
+}
+
+//! Poursuite d'une somme de contrôle sur \a size octets
+static uint64_t fnv(uint64_t h, const void *buf, uint64_t size) {
+	const unsigned char *p = buf;
+	for (uint64_t i = 0; i < size; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+uint64_t image_checksum(const void *buf, uint64_t size) {
+	return fnv(FNV_BASIS, buf, size);
+}
+
+/*!
+ * Lecture de \a size octets de la source à partir de la position \a offset.
+ *
+ * \return le nombre d'octets lus (moins que \a size à la fin de la source)
+ */
+static uint64_t fetch(const Image_Reader *prd, uint64_t offset, void *dst, uint64_t size) {
+	if (prd->_fd < 0) {
+		uint64_t n = offset >= prd->_size ? 0 : prd->_size - offset;
+		n = n < size ? n : size;
+		memcpy(dst, prd->_buf + offset, n);
+		return n;
+	}
+	uint64_t done = 0;
+	while (done < size) {
+		ssize_t n = pread(prd->_fd, (char *) dst + done, size - done, offset + done);
+		if (n <= 0)
+			break;
+		done += n;
+	}
+	return done;
+}
+
+//! Échec de l'analyse : libération de la table
+static bool fail(Image_Reader *prd, const char *error) {
+	free(prd->_sections);
+	free(prd->_lengths);
+	prd->_sections = NULL;
+	prd->_lengths = NULL;
+	prd->_nsections = 0;
+	prd->_error = error;
+	return false;
+}
+
+//! Table reconstituée d'une image de version 1 (ordre de l'hôte)
+static bool parse_v1(Image_Reader *prd) {
+	uint32_t header[3];
+	if (fetch(prd, 0, header, sizeof(header)) != sizeof(header))
+		return fail(prd, "truncated header");
+	prd->_version = 1;
+	prd->_swap = false;
+	prd->_textsize = header[0];
+	prd->_datasize = header[1];
+	prd->_dataend = header[2];
+	prd->_nsections = 2;
+	prd->_sections = checked_realloc(NULL, 2 * sizeof(Image_Section), "l'image");
+	prd->_sections[0] = (Image_Section) {
+		._type = SECTION_TEXT, ._offset = sizeof(header), ._size = prd->_textsize * sizeof(Instruction)
+	};
+	prd->_sections[1] = (Image_Section) {
+		._type = SECTION_DATA, ._offset = sizeof(header) + prd->_sections[0]._size,
+		._size = prd->_datasize * sizeof(Word)
+	};
+	prd->_lengths = checked_realloc(NULL, 2 * sizeof(uint64_t), "l'image");
+	prd->_lengths[0] = prd->_sections[0]._size;
+	prd->_lengths[1] = prd->_sections[1]._size;
+	// Au-delà de la fin du fichier, on ne complète que des segments adressables
+	if (prd->_sections[1]._offset + prd->_sections[1]._size > prd->_size
+	    && (prd->_textsize > IMAGE_MAXWORDS || prd->_datasize > IMAGE_MAXWORDS))
+		return fail(prd, "truncated image");
+	return true;
+}
+
+//! Vérification de la somme de contrôle du contenu stocké d'une section, bloc par bloc
+static bool verify_stored(const Image_Reader *prd, const Image_Section *psec) {
+	unsigned char block[LZ_BLOCK];
+	uint64_t h = FNV_BASIS;
+	for (uint64_t pos = 0; pos < psec->_size; pos += LZ_BLOCK) {
+		uint64_t n = psec->_size - pos < LZ_BLOCK ? psec->_size - pos : LZ_BLOCK;
+		if (fetch(prd, psec->_offset + pos, block, n) != n)
+			return false;
+		h = fnv(h, block, n);
+	}
+	return h == psec->_checksum;
+}
+
+//! Lecture et vérification de l'en-tête et de la table d'une image de version 2
+static bool parse_v2(Image_Reader *prd) {
+	Image_Header header;
+	if (fetch(prd, 0, &header, sizeof(header)) != sizeof(header))
+		return fail(prd, "truncated header");
+	if (header._byteorder != IMAGE_LITTLE && header._byteorder != IMAGE_BIG)
+		return fail(prd, "unknown byte order");
+	prd->_version = 2;
+	prd->_swap = header._byteorder != host_order();
+	if (prd->_swap) {
+		header._version = __builtin_bswap16(header._version);
+		header._nsections = __builtin_bswap32(header._nsections);
+		header._dataend = __builtin_bswap64(header._dataend);
+		header._tablesum = __builtin_bswap64(header._tablesum);
+	}
+	if (header._version != IMAGE_VERSION)
+		return fail(prd, "unsupported image version");
+	if (header._nsections > IMAGE_MAXSECTIONS)
+		return fail(prd, "too many sections");
+
+	uint64_t tablesize = header._nsections * sizeof(Image_Section);
+	prd->_nsections = header._nsections;
+	prd->_sections = checked_realloc(NULL, tablesize, "l'image");
+	prd->_lengths = checked_realloc(NULL, header._nsections * sizeof(uint64_t), "l'image");
+	if (fetch(prd, sizeof(header), prd->_sections, tablesize) != tablesize)
+		return fail(prd, "truncated section table");
+	if (image_checksum(prd->_sections, tablesize) != header._tablesum)
+		return fail(prd, "section table checksum mismatch");
+
+	const Image_Section *text = NULL, *data = NULL;
+	for (unsigned i = 0; i < prd->_nsections; i++) {
+		Image_Section *psec = &prd->_sections[i];
+		if (prd->_swap) {
+			psec->_type = __builtin_bswap32(psec->_type);
+			psec->_flags = __builtin_bswap32(psec->_flags);
+			psec->_offset = __builtin_bswap64(psec->_offset);
+			psec->_size = __builtin_bswap64(psec->_size);
+			psec->_checksum = __builtin_bswap64(psec->_checksum);
+		}
+		if (psec->_size > prd->_size || psec->_offset > prd->_size - psec->_size)
+			return fail(prd, "section beyond end of image");
+		// Section compressée : taille du contenu en tête, vérifiée avant toute allocation
+		uint64_t length = psec->_size;
+		if (psec->_flags & SECTION_COMPRESSED) {
+			if (psec->_size < sizeof(length)
+			    || fetch(prd, psec->_offset, &length, sizeof(length)) != sizeof(length))
+				return fail(prd, "truncated compressed section");
+			if (!verify_stored(prd, psec))
+				return fail(prd, "section checksum mismatch");
+			if (prd->_swap)
+				length = __builtin_bswap64(length);
+		}
+		prd->_lengths[i] = length;
+		if (psec->_type == SECTION_TEXT || psec->_type == SECTION_DATA) {
+			const Image_Section **pseg = psec->_type == SECTION_TEXT ? &text : &data;
+			if (*pseg != NULL)
+				return fail(prd, "duplicate text or data section");
+			if (length % sizeof(Word) != 0 || length / sizeof(Word) > UINT32_MAX)
+				return fail(prd, "bad segment size");
+			// Une taille décompressée ne coûte rien à déclarer : seuls des segments
+			// adressables sont admis (un segment stocké tel quel est borné par le fichier)
+			if ((psec->_flags & SECTION_COMPRESSED) && length / sizeof(Word) > IMAGE_MAXWORDS)
+				return fail(prd, "corrupted compressed section");
+			*pseg = psec;
+		}
+	}
+	if (text == NULL || data == NULL)
+		return fail(prd, "missing text or data section");
+	prd->_textsize = image_length(prd, text) / sizeof(Instruction);
+	prd->_datasize = image_length(prd, data) / sizeof(Word);
+	prd->_dataend = header._dataend;
+	if (prd->_dataend > prd->_datasize)
+		return fail(prd, "static data beyond data segment");
+	return true;
+}
+
+//! Analyse de la source selon sa version
+static bool parse(Image_Reader *prd) {
+	char magic[4];
+	prd->_sections = NULL;
+	prd->_lengths = NULL;
+	prd->_nsections = 0;
+	prd->_error = NULL;
+	if (fetch(prd, 0, magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, IMAGE_MAGIC, 4) == 0)
+		return parse_v2(prd);
+	return parse_v1(prd);
+}
+
+bool image_open(Image_Reader *prd, const char *file) {
+	prd->_buf = NULL;
+	prd->_fd = open(file, O_RDONLY);
+	struct stat st;
+	if (prd->_fd < 0 || fstat(prd->_fd, &st) != 0) {
+		prd->_error = "cannot open file";
+		if (prd->_fd >= 0)
+			close(prd->_fd);
+		return false;
+	}
+	prd->_size = st.st_size;
+	if (!parse(prd)) {
+		close(prd->_fd);
+		return false;
+	}
+	return true;
+}
+
+bool image_open_buffer(Image_Reader *prd, const void *buf, uint64_t size) {
+	prd->_fd = -1;
+	prd->_buf = buf;
+	prd->_size = size;
+	return parse(prd);
+}
+
+const Image_Section *image_section(const Image_Reader *prd, Section_Type type) {
+	for (unsigned i = 0; i < prd->_nsections; i++)
+		if (prd->_sections[i]._type == type)
+			return &prd->_sections[i];
+	return NULL;
+}
+
+uint64_t image_length(const Image_Reader *prd, const Image_Section *psec) {
+	return prd->_lengths[psec - prd->_sections];
+}
+
+//! Lecture par blocs du contenu stocké d'une section compressée
+typedef struct
+{
+    Image_Reader *prd;
+    uint64_t offset;		//!< Position du prochain bloc
+    uint64_t end;		//!< Fin du contenu
+    bool eof;			//!< Lecture au-delà de la fin ?
+    unsigned pos, len;		//!< Octet courant et taille du bloc
+    unsigned char buf[LZ_BLOCK];
+} Stream;
+
+//! Octet suivant du contenu (0 et \c eof à la fin)
+static unsigned stream_get(Stream *ps) {
+	if (ps->pos == ps->len) {
+		uint64_t n = ps->end - ps->offset < LZ_BLOCK ? ps->end - ps->offset : LZ_BLOCK;
+		if (n == 0 || fetch(ps->prd, ps->offset, ps->buf, n) != n) {
+			ps->eof = true;
+			return 0;
+		}
+		ps->offset += n;
+		ps->len = n;
+		ps->pos = 0;
+	}
+	return ps->buf[ps->pos++];
+}
+
+//! Entier de taille variable (7 bits par octet, poids faibles d'abord)
+static uint64_t stream_varint(Stream *ps) {
+	uint64_t v = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		unsigned b = stream_get(ps);
+		v |= (uint64_t) (b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return v;
+	}
+	ps->eof = true;
+	return 0;
+}
+
+/*!
+ * Décompression d'une section directement dans \a dst, bloc par bloc (voir
+ * SECTION_COMPRESSED). La somme de contrôle a été vérifiée à l'ouverture.
+ */
+static bool decompress(Image_Reader *prd, const Image_Section *psec, unsigned char *dst) {
+	uint64_t length = image_length(prd, psec), out = 0;
+	Stream st = {.prd = prd, .offset = psec->_offset, .end = psec->_offset + psec->_size};
+	// Taille du contenu, déjà lue par l'analyse de la table
+	for (unsigned i = 0; i < sizeof(uint64_t); i++)
+		stream_get(&st);
+
+	while (out < length && !st.eof) {
+		unsigned t = stream_get(&st);
+		uint64_t n;
+		if (t < 0x80) {
+			// Littéraux
+			n = t + 1;
+			if (n > length - out)
+				break;
+			for (uint64_t k = 0; k < n; k++)
+				dst[out++] = stream_get(&st);
+			continue;
+		}
+		n = t & 0x3f;
+		if (n == 0x3f) {
+			uint64_t more = stream_varint(&st);
+			if (more > length)
+				break;
+			n += more;
+		}
+		if (t < 0xc0) {
+			// Suite d'octets nuls
+			n += 1;
+			if (n > length - out)
+				break;
+			memset(dst + out, 0, n);
+		} else {
+			// Répétition de n octets à distance dist (recouvrement permis)
+			n += 4;
+			uint64_t dist = stream_varint(&st);
+			if (n > length - out || dist == 0 || dist > out)
+				break;
+			for (uint64_t k = 0; k < n; k++)
+				dst[out + k] = dst[out + k - dist];
+		}
+		out += n;
+	}
+	if (out != length || st.eof || st.pos != st.len || st.offset != st.end) {
+		prd->_error = "corrupted compressed section";
+		return false;
+	}
+	return true;
+}
+
+bool image_read_section(Image_Reader *prd, const Image_Section *psec, void *buf) {
+	if (psec->_flags & SECTION_COMPRESSED)
+		return decompress(prd, psec, buf);
+	uint64_t n = fetch(prd, psec->_offset, buf, psec->_size);
+	if (prd->_version == 1) {
+		// Mots manquants d'une image de version 1 : nuls
+		memset((char *) buf + n, 0, psec->_size - n);
+		return true;
+	}
+	if (n != psec->_size) {
+		prd->_error = "read error";
+		return false;
+	}
+	if (image_checksum(buf, psec->_size) != psec->_checksum) {
+		prd->_error = "section checksum mismatch";
+		return false;
+	}
+	return true;
+}
+
+//! Lecture d'un segment de mots, converti dans l'ordre de l'hôte
+static bool read_words(Image_Reader *prd, Section_Type type, uint32_t *words) {
+	const Image_Section *psec = image_section(prd, type);
+	if (!image_read_section(prd, psec, words))
+		return false;
+	if (prd->_swap)
+		for (uint64_t i = 0; i < image_length(prd, psec) / sizeof(uint32_t); i++)
+			words[i] = __builtin_bswap32(words[i]);
+	return true;
+}
+
+bool image_read_text(Image_Reader *prd, Instruction *text) {
+	return read_words(prd, SECTION_TEXT, &text->_raw);
+}
+
+bool image_read_data(Image_Reader *prd, Word *data) {
+	return read_words(prd, SECTION_DATA, data);
+}
+
+bool image_read_symbols(Image_Reader *prd, Image_Symbol **psyms, unsigned *pnsyms) {
+	*psyms = NULL;
+	*pnsyms = 0;
+	const Image_Section *psec = image_section(prd, SECTION_SYMBOLS);
+	if (psec == NULL)
+		return true;
+	uint64_t size = image_length(prd, psec);
+	unsigned char *buf = checked_realloc(NULL, size, "l'image");
+	if (!image_read_section(prd, psec, buf)) {
+		free(buf);
+		return false;
+	}
+
+	// Deux passes : décompte et vérification des enregistrements, puis copie des noms
+	for (int pass = 0; pass < 2; pass++) {
+		unsigned n = 0;
+		uint64_t pos = 0;
+		while (pos < size) {
+			uint32_t rec[2];
+			if (size - pos < sizeof(rec)) {
+				free(buf);
+				prd->_error = "corrupted symbol section";
+				return false;
+			}
+			memcpy(rec, buf + pos, sizeof(rec));
+			if (prd->_swap) {
+				rec[0] = __builtin_bswap32(rec[0]);
+				rec[1] = __builtin_bswap32(rec[1]);
+			}
+			pos += sizeof(rec);
+			if (rec[1] > size - pos) {
+				free(buf);
+				prd->_error = "corrupted symbol section";
+				return false;
+			}
+			if (pass == 1) {
+				Image_Symbol *psym = &(*psyms)[n];
+				psym->_addr = rec[0];
+				psym->_name = checked_realloc(NULL, rec[1] + 1, "l'image");
+				memcpy(psym->_name, buf + pos, rec[1]);
+				psym->_name[rec[1]] = '\0';
+			}
+			pos += ROUND4(rec[1]);
+			n++;
+		}
+		if (pass == 0)
+			*psyms = checked_realloc(NULL, n * sizeof(Image_Symbol), "l'image");
+		*pnsyms = n;
+	}
+	free(buf);
+	return true;
+}
+
+void image_free_symbols(Image_Symbol *syms, unsigned nsyms) {
+	for (unsigned i = 0; i < nsyms; i++)
+		free(syms[i]._name);
+	free(syms);
+}
+
+void image_close(Image_Reader *prd) {
+	free(prd->_sections);
+	free(prd->_lengths);
+	prd->_sections = NULL;
+	prd->_lengths = NULL;
+	if (prd->_fd >= 0)
+		close(prd->_fd);
+	prd->_fd = -1;
+}
+
+bool image_load(Image_Reader *prd, Machine *pmach) {
+	if (prd->_textsize > UINT32_MAX || prd->_datasize > UINT32_MAX) {
+		prd->_error = "program too large";
+		return false;
+	}
+	Instruction *text = checked_realloc(NULL, prd->_textsize * sizeof(Instruction), "l'image");
+	Word *data = checked_realloc(NULL, prd->_datasize * sizeof(Word), "l'image");
+	if (!image_read_text(prd, text) || !image_read_data(prd, data)) {
+		free(text);
+		free(data);
+		return false;
+	}
+	load_program(pmach, prd->_textsize, text, prd->_datasize, data, prd->_dataend);
+	return true;
+}
+
+//! Écriture complète d'une zone
+static bool write_all(int fd, const void *buf, uint64_t size) {
+	const char *p = buf;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+//! Écriture d'un entier de taille variable
+static unsigned char *put_varint(unsigned char *p, uint64_t v) {
+	for (; v >= 0x80; v >>= 7)
+		*p++ = v | 0x80;
+	*p++ = v;
+	return p;
+}
+
+//! Écriture d'un jeton de suite (nuls ou répétition) de longueur réduite \a n
+static unsigned char *put_run(unsigned char *p, unsigned kind, uint64_t n) {
+	if (n < 0x3f)
+		*p++ = kind | n;
+	else {
+		*p++ = kind | 0x3f;
+		p = put_varint(p, n - 0x3f);
+	}
+	return p;
+}
+
+//! Écriture de \a n littéraux, par jetons de 128 au plus
+static unsigned char *put_literals(unsigned char *p, const unsigned char *src, uint64_t n) {
+	while (n > 0) {
+		unsigned k = n < 128 ? n : 128;
+		*p++ = k - 1;
+		memcpy(p, src, k);
+		p += k;
+		src += k;
+		n -= k;
+	}
+	return p;
+}
+
+/*!
+ * Compression de \a n octets (voir SECTION_COMPRESSED) : suites d'au moins 4
+ * nuls, puis répétitions d'au moins 4 octets trouvées par une table de
+ * hachage (dernière position de chaque groupe de 4 octets), puis littéraux.
+ *
+ * \param dst la destination, d'au moins \c n + \c n/128 + 1 octets
+ * \return la taille du résultat
+ */
+static uint64_t compress_bytes(const unsigned char *src, uint64_t n, unsigned char *dst) {
+	uint64_t *table = checked_realloc(NULL, LZ_HASH * sizeof(uint64_t), "l'image"); // Position + 1, 0 si vide
+	memset(table, 0, LZ_HASH * sizeof(uint64_t));
+	unsigned char *p = dst;
+	uint64_t i = 0, lit = 0;
+	while (i < n) {
+		uint64_t z = 0;
+		while (i + z < n && src[i + z] == 0)
+			z++;
+		if (z >= 4) {
+			p = put_literals(p, src + lit, i - lit);
+			p = put_run(p, 0x80, z - 1);
+			i += z;
+			lit = i;
+			continue;
+		}
+		if (i + 4 <= n) {
+			uint32_t w;
+			memcpy(&w, src + i, 4);
+			unsigned h = (w * 2654435761u) >> 20;
+			uint64_t c = table[h];
+			table[h] = i + 1;
+			if (c > 0 && i - (c - 1) <= LZ_WINDOW && memcmp(src + c - 1, src + i, 4) == 0) {
+				uint64_t len = 4;
+				while (i + len < n && src[c - 1 + len] == src[i + len])
+					len++;
+				p = put_literals(p, src + lit, i - lit);
+				p = put_run(p, 0xc0, len - 4);
+				p = put_varint(p, i - (c - 1));
+				i += len;
+				lit = i;
+				continue;
+			}
+		}
+		i++;
+	}
+	p = put_literals(p, src + lit, n - lit);
+	free(table);
+	return p - dst;
+}
+
+//! Ajout d'une section à la table, son contenu suivant celui de la précédente
+/*!
+ * Avec \a compress, le contenu est compressé s'il y gagne ; la zone compressée
+ * est rangée dans \a owned pour être libérée après l'écriture.
+ */
+static void add_section(Image_Section *table, const void **contents, void **owned, unsigned *pn,
+                        uint64_t *poffset, Section_Type type, const void *content, uint64_t size,
+                        bool compress) {
+	uint32_t flags = 0;
+	owned[*pn] = NULL;
+	if (compress) {
+		unsigned char *packed = checked_realloc(NULL, sizeof(uint64_t) + size + size / 128 + 1, "l'image");
+		memcpy(packed, &size, sizeof(uint64_t));
+		uint64_t psize = sizeof(uint64_t) + compress_bytes(content, size, packed + sizeof(uint64_t));
+		if (psize < size) {
+			flags = SECTION_COMPRESSED;
+			content = owned[*pn] = packed;
+			size = psize;
+		} else
+			free(packed);
+	}
+	table[*pn] = (Image_Section) {
+		._type = type, ._flags = flags, ._offset = *poffset, ._size = size,
+		._checksum = image_checksum(content, size)
+	};
+	contents[*pn] = content;
+	*poffset += size;
+	(*pn)++;
+}
+
+bool image_write(const Machine *pmach, const char *file,
+                 const Image_Symbol *syms, unsigned nsyms, const char *meta, bool compress) {
+	// Contenu de la section de symboles
+	uint64_t symsize = 0;
+	for (unsigned i = 0; i < nsyms; i++)
+		symsize += 2 * sizeof(uint32_t) + ROUND4(strlen(syms[i]._name));
+	unsigned char *symbuf = checked_realloc(NULL, symsize, "l'image");
+	memset(symbuf, 0, symsize);
+	for (uint64_t i = 0, pos = 0; i < nsyms; i++) {
+		uint32_t rec[2] = {syms[i]._addr, strlen(syms[i]._name)};
+		memcpy(symbuf + pos, rec, sizeof(rec));
+		memcpy(symbuf + pos + sizeof(rec), syms[i]._name, rec[1]);
+		pos += sizeof(rec) + ROUND4(rec[1]);
+	}
+
+	unsigned nsections = 2 + (nsyms > 0) + (meta != NULL), n = 0;
+	Image_Section table[4];
+	const void *contents[4];
+	void *owned[4];
+	uint64_t offset = sizeof(Image_Header) + nsections * sizeof(Image_Section);
+	add_section(table, contents, owned, &n, &offset, SECTION_TEXT,
+		    pmach->_text, pmach->_textsize * sizeof(Instruction), compress);
+	add_section(table, contents, owned, &n, &offset, SECTION_DATA,
+		    pmach->_data, pmach->_datasize * sizeof(Word), compress);
+	if (nsyms > 0)
+		add_section(table, contents, owned, &n, &offset, SECTION_SYMBOLS, symbuf, symsize, compress);
+	if (meta != NULL)
+		add_section(table, contents, owned, &n, &offset, SECTION_META, meta, strlen(meta), compress);
+
+	Image_Header header = {
+		._byteorder = host_order(),
+		._version = IMAGE_VERSION,
+		._nsections = nsections,
+		._dataend = pmach->_dataend,
+		._tablesum = image_checksum(table, nsections * sizeof(Image_Section)),
+	};
+	memcpy(header._magic, IMAGE_MAGIC, 4);
+
+	int fd = open(file, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	bool ok = fd >= 0 && write_all(fd, &header, sizeof(header))
+		&& write_all(fd, table, nsections * sizeof(Image_Section));
+	for (unsigned i = 0; ok && i < nsections; i++)
+		ok = write_all(fd, contents[i], table[i]._size);
+	if (fd >= 0 && close(fd) != 0)
+		ok = false;
+	if (!ok)
+		perror(file);
+	for (unsigned i = 0; i < nsections; i++)
+		free(owned[i]);
+	free(symbuf);
+	return ok;
+}
+
+bool image_write_v1(const Machine *pmach, const char *file) {
+	uint32_t header[3] = {pmach->_textsize, pmach->_datasize, pmach->_dataend};
+	int fd = open(file, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	bool ok = fd >= 0 && write_all(fd, header, sizeof(header))
+		&& write_all(fd, pmach->_text, pmach->_textsize * sizeof(Instruction))
+		&& write_all(fd, pmach->_data, pmach->_datasize * sizeof(Word));
+	if (fd >= 0 && close(fd) != 0)
+		ok = false;
+	if (!ok)
+		perror(file);
+	return ok;
+}
@@ -0,0 +1,244 @@
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+/*!
+ * \file image.h
+ * \brief Format des fichiers binaires (images) des programmes.
+ *
+ * <b>Version 1</b> (historique) : trois entiers de 32 bits \c textsize,
+ * \c datasize et \c dataend dans l'ordre des octets de la machine qui a écrit
+ * le fichier, puis les \c textsize instructions et les \c datasize mots de
+ * données. Ni marque, ni version, ni somme de contrôle.
+ *
+ * <b>Version 2</b> : un en-tête (voir Image_Header), une table de sections
+ * (voir Image_Section) puis le contenu des sections, aux positions indiquées
+ * par la table. Le 5<sup>e</sup> octet de l'en-tête donne l'ordre des octets
+ * de tous les entiers du fichier (\c 'L' : petit-boutiste, \c 'B' :
+ * gros-boutiste) ; le lecteur les convertit au besoin. Chaque section porte
+ * la somme de contrôle de son contenu tel qu'il est stocké, et la table porte
+ * la sienne dans l'en-tête.
+ *
+ * Les deux versions se distinguent par les quatre premiers octets : \c "SIMG"
+ * en version 2, la taille du segment de texte en version 1 (un programme de
+ * plus d'un milliard d'instructions serait pris pour une image de version 2).
+ *
+ * Le lecteur ne charge pas le fichier en entier : il lit l'en-tête et la
+ * table, puis chaque section directement à sa destination, en la
+ * décompressant au passage (voir SECTION_COMPRESSED).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Marque des images de version 2
+#define IMAGE_MAGIC "SIMG"
+
+//! Version écrite par image_write()
+#define IMAGE_VERSION 2
+
+//! Ordre des octets : petit-boutiste
+#define IMAGE_LITTLE 'L'
+
+//! Ordre des octets : gros-boutiste
+#define IMAGE_BIG 'B'
+
+//! En-tête d'une image de version 2 (32 octets)
+typedef struct
+{
+    char _magic[4];		//!< \c IMAGE_MAGIC
+    uint8_t _byteorder;		//!< \c IMAGE_LITTLE ou \c IMAGE_BIG
+    uint8_t _pad;		//!< Nul
+    uint16_t _version;		//!< \c IMAGE_VERSION
+    uint32_t _nsections;	//!< Nombre d'entrées de la table des sections
+    uint32_t _flags;		//!< Nul (réservé)
+    uint64_t _dataend;		//!< Première adresse libre après les données statiques
+    uint64_t _tablesum;		//!< Somme de contrôle de la table des sections
+} Image_Header;
+
+//! Types de sections
+typedef enum {
+    SECTION_TEXT = 1,		//!< Segment de texte : une instruction par mot (obligatoire)
+    SECTION_DATA = 2,		//!< Segment de données : un mot par adresse (obligatoire)
+    SECTION_SYMBOLS = 3,	//!< Symboles (voir Image_Symbol)
+    SECTION_META = 4,		//!< Texte libre (provenance, options de compilation...)
+} Section_Type;
+
+//! Indicateur de section : contenu compressé
+/*!
+ * Le contenu stocké commence par sa taille décompressée (64 bits) suivie
+ * d'une suite de jetons d'un octet \c t :
+ *
+ *   - \c t < 0x80 : \c t+1 octets littéraux suivent ;
+ *
+ *   - <tt>0x80 <= t < 0xc0</tt> : \c n+1 octets nuls ;
+ *
+ *   - \c t >= 0xc0 : répétition de \c n+4 octets situés \c d octets plus
+ *   tôt dans le contenu décompressé (\c d suit le jeton ; les deux zones
+ *   peuvent se recouvrir).
+ *
+ * \c n vaut <tt>t & 0x3f</tt> ; s'il vaut 0x3f, un entier de taille variable
+ * s'y ajoute. Les entiers de taille variable (dont \c d) sont codés 7 bits par
+ * octet, poids faibles d'abord, le bit de poids fort indiquant une suite. La
+ * somme de contrôle de la section porte sur le contenu stocké (compressé) ;
+ * elle est vérifiée à l'ouverture, avant que la taille ne serve. Un segment
+ * compressé ne peut pas dépasser l'espace adressable (2<sup>20</sup> mots).
+ */
+#define SECTION_COMPRESSED 1u
+
+//! Entrée de la table des sections (32 octets)
+/*!
+ * Les sections de types inconnus sont ignorées. Le contenu d'une section de
+ * symboles est une suite d'enregistrements : adresse (32 bits), longueur du
+ * nom (32 bits), puis le nom, complété par des octets nuls jusqu'à un
+ * multiple de 4 octets.
+ */
+typedef struct
+{
+    uint32_t _type;		//!< Section_Type
+    uint32_t _flags;		//!< \c SECTION_COMPRESSED ou nul
+    uint64_t _offset;		//!< Position du contenu dans le fichier
+    uint64_t _size;		//!< Taille du contenu stocké en octets
+    uint64_t _checksum;		//!< Somme de contrôle du contenu (voir image_checksum())
+} Image_Section;
+
+//! Symbole : nom d'une adresse du programme
+typedef struct
+{
+    unsigned _addr;		//!< Adresse
+    char *_name;		//!< Nom
+} Image_Symbol;
+
+//! Lecture d'une image
+/*!
+ * La source est un fichier (lu par \c pread) ou une zone de mémoire. Pour une
+ * image de version 1, la table est reconstituée (texte puis données, sans
+ * somme de contrôle) et les mots au-delà de la fin du fichier sont nuls (si
+ * les segments ne dépassent pas l'espace adressable, 2<sup>20</sup> mots).
+ */
+typedef struct
+{
+    int _fd;			//!< Descripteur du fichier, ou -1
+    const unsigned char *_buf;	//!< Contenu en mémoire si \c _fd vaut -1
+    uint64_t _size;		//!< Taille de la source en octets
+    unsigned _version;		//!< 1 ou 2
+    bool _swap;			//!< Ordre des octets différent de celui de la machine ?
+    uint64_t _textsize;		//!< Taille du segment de texte (en mots)
+    uint64_t _datasize;		//!< Taille du segment de données (en mots)
+    uint64_t _dataend;		//!< Première adresse libre après les données statiques
+    unsigned _nsections;	//!< Nombre de sections
+    Image_Section *_sections;	//!< Table des sections (ordre de l'hôte)
+    uint64_t *_lengths;		//!< Taille décompressée du contenu de chaque section
+    const char *_error;		//!< Dernière erreur
+} Image_Reader;
+
+//! Somme de contrôle d'une suite d'octets (FNV-1a sur 64 bits)
+uint64_t image_checksum(const void *buf, uint64_t size);
+
+//! Ouverture d'une image
+/*!
+ * L'en-tête et la table sont lus et vérifiés.
+ *
+ * \param prd le lecteur à initialiser
+ * \param file le nom du fichier
+ * \return faux (\c _error renseigné, rien à refermer) si le fichier est
+ * illisible ou n'est pas une image valide
+ */
+bool image_open(Image_Reader *prd, const char *file);
+
+//! Ouverture d'une image en mémoire
+/*!
+ * \param prd le lecteur à initialiser
+ * \param buf le contenu de l'image, qui doit rester valide jusqu'à image_close()
+ * \param size sa taille en octets
+ * \return faux (\c _error renseigné) si ce n'est pas une image valide
+ */
+bool image_open_buffer(Image_Reader *prd, const void *buf, uint64_t size);
+
+//! Recherche d'une section
+/*!
+ * \return la première section du type \a type, ou NULL
+ */
+const Image_Section *image_section(const Image_Reader *prd, Section_Type type);
+
+//! Taille du contenu décompressé d'une section
+/*!
+ * \param prd le lecteur
+ * \param psec la section (de la table de \a prd)
+ */
+uint64_t image_length(const Image_Reader *prd, const Image_Section *psec);
+
+//! Lecture brute du contenu d'une section, avec vérification de sa somme de contrôle
+/*!
+ * Un contenu compressé est décompressé par blocs directement dans \a buf.
+ *
+ * \param prd le lecteur
+ * \param psec la section (de la table de \a prd)
+ * \param buf la destination, de image_length() octets
+ * \return faux (\c _error renseigné) si la lecture échoue ou si le contenu est altéré
+ */
+bool image_read_section(Image_Reader *prd, const Image_Section *psec, void *buf);
+
+//! Lecture du segment de texte
+/*!
+ * \param prd le lecteur
+ * \param text la destination, de \c _textsize instructions
+ * \return faux (\c _error renseigné) en cas d'erreur
+ */
+bool image_read_text(Image_Reader *prd, Instruction *text);
+
+//! Lecture du segment de données
+/*!
+ * \param prd le lecteur
+ * \param data la destination, de \c _datasize mots
+ * \return faux (\c _error renseigné) en cas d'erreur
+ */
+bool image_read_data(Image_Reader *prd, Word *data);
+
+//! Lecture des symboles
+/*!
+ * \param prd le lecteur
+ * \param psyms reçoit le tableau des symboles (NULL s'il n'y en a pas), à
+ * libérer par image_free_symbols()
+ * \param pnsyms reçoit le nombre de symboles
+ * \return faux (\c _error renseigné) si la section est altérée
+ */
+bool image_read_symbols(Image_Reader *prd, Image_Symbol **psyms, unsigned *pnsyms);
+
+//! Libération d'un tableau de symboles
+void image_free_symbols(Image_Symbol *syms, unsigned nsyms);
+
+//! Fermeture d'une image
+void image_close(Image_Reader *prd);
+
+//! Chargement complet d'une image dans une machine (voir load_program())
+/*!
+ * \param prd le lecteur
+ * \param pmach la machine
+ * \return faux (\c _error renseigné, rien d'alloué) en cas d'erreur
+ */
+bool image_load(Image_Reader *prd, Machine *pmach);
+
+//! Écriture d'une image de version 2
+/*!
+ * Les entiers sont écrits dans l'ordre des octets de la machine hôte.
+ *
+ * \param pmach la machine dont on écrit le programme et les données
+ * \param file le nom du fichier
+ * \param syms les symboles (ou NULL)
+ * \param nsyms leur nombre
+ * \param meta le texte de la section de métadonnées (ou NULL : pas de section)
+ * \param compress compresser les sections qui y gagnent (voir SECTION_COMPRESSED)
+ * \return faux (avec un message) en cas d'erreur
+ */
+bool image_write(const Machine *pmach, const char *file,
+                 const Image_Symbol *syms, unsigned nsyms, const char *meta, bool compress);
+
+//! Écriture d'une image de version 1 (pour les outils qui ne lisent que ce format)
+/*!
+ * \return faux (avec un message) en cas d'erreur
+ */
+bool image_write_v1(const Machine *pmach, const char *file);
+
+#endif
@@ -0,0 +1,185 @@
+/*!
+ * \file img_simul.c
+ * \brief Inspection et conversion des fichiers binaires (voir image.h)
+ *
+ * Le fichier (version 1 ou 2) est ouvert et son contenu vérifié section par
+ * section. Avec \c -i, l'en-tête, la table des sections, les symboles et les
+ * métadonnées sont affichés ; avec \c -o, le programme est réécrit en
+ * version 2 (ou 1 avec \c -1), augmenté des symboles et des métadonnées
+ * donnés par \c -s et \c -M, et compressé avec \c -z.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+#include "image.h"
+
+//! Noms des types de sections
+static const char *section_names[] = {"?", "text", "data", "symbols", "meta"};
+
+//! Nombre maximal de symboles lus par -s
+#define MAXSYMBOLS 4096
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: img_simul [options] prog.bin\n"
+	       "where options are:\n"
+	       "\t-i\t\tDisplay the header, sections, symbols and metadata\n"
+	       "\t-o out.bin\tRewrite the program (version 2)\n"
+	       "\t-z\t\tCompress the rewritten sections\n"
+	       "\t-1\t\tRewrite in version 1 (no sections, symbols or metadata)\n"
+	       "\t-s file.sym\tSymbols to write, one \"address name\" per line\n"
+	       "\t-M text\t\tMetadata to write\n"
+	       "\t-h\t\tprint this help message\n"
+	       "Without -o, the image is only checked.\n");
+}
+
+/*!
+ * Lecture d'un fichier de symboles : une ligne "adresse nom" par symbole.
+ *
+ * \return le nombre de symboles lus
+ */
+static unsigned read_symbols(const char *file, Image_Symbol *syms) {
+	FILE *in = fopen(file, "r");
+	if (in == NULL) {
+		fprintf(stderr, "Cannot open symbol file %s\n", file);
+		exit(EXIT_FAILURE);
+	}
+	unsigned n = 0;
+	char name[256];
+	long addr;
+	while (n < MAXSYMBOLS && fscanf(in, "%li %255s", &addr, name) == 2) {
+		syms[n]._addr = addr;
+		syms[n]._name = strdup(name);
+		n++;
+	}
+	fclose(in);
+	return n;
+}
+
+//! Affichage de l'en-tête, de la table, des symboles et des métadonnées
+static bool print_info(Image_Reader *prd) {
+	printf("version %u", prd->_version);
+	if (prd->_version > 1)
+		printf(", %s byte order", prd->_swap ? "foreign" : "host");
+	printf(", textsize %llu, datasize %llu, dataend %llu\n",
+	       (unsigned long long) prd->_textsize, (unsigned long long) prd->_datasize,
+	       (unsigned long long) prd->_dataend);
+
+	bool ok = true;
+	for (unsigned i = 0; i < prd->_nsections; i++) {
+		const Image_Section *psec = &prd->_sections[i];
+		uint64_t length = image_length(prd, psec);
+		void *buf = malloc(length > 0 ? length : 1);
+		if (buf == NULL)
+			prd->_error = "out of memory";
+		bool valid = buf != NULL && image_read_section(prd, psec, buf);
+		printf("section %u: %-7s offset %llu, %llu bytes", i,
+		       section_names[psec->_type <= SECTION_META ? psec->_type : 0],
+		       (unsigned long long) psec->_offset, (unsigned long long) psec->_size);
+		if (psec->_flags & SECTION_COMPRESSED)
+			printf(" (%llu uncompressed)", (unsigned long long) length);
+		printf(", checksum %016llx %s\n", (unsigned long long) psec->_checksum,
+		       prd->_version == 1 ? "" : valid ? "ok" : prd->_error);
+		if (valid && psec->_type == SECTION_META)
+			printf("%.*s\n", (int) length, (char *) buf);
+		ok = ok && valid;
+		free(buf);
+	}
+
+	Image_Symbol *syms;
+	unsigned nsyms;
+	if (!image_read_symbols(prd, &syms, &nsyms))
+		return false;
+	for (unsigned i = 0; i < nsyms; i++)
+		printf("0x%04x %s\n", syms[i]._addr, syms[i]._name);
+	image_free_symbols(syms, nsyms);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	const char *outfile = NULL, *symfile = NULL, *meta = NULL;
+	bool info = false, v1 = false, compress = false;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'i' || opt == '1' || opt == 'z') {
+			if (opt == 'i')
+				info = true;
+			else if (opt == '1')
+				v1 = true;
+			else
+				compress = true;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("osM", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'o': outfile = val; break;
+			case 's': symfile = val; break;
+			case 'M': meta = val; break;
+		}
+	}
+	if (iarg + 1 != argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	Image_Reader reader;
+	if (!image_open(&reader, argv[iarg])) {
+		fprintf(stderr, "%s: %s\n", argv[iarg], reader._error);
+		return EXIT_FAILURE;
+	}
+	if (info && !print_info(&reader)) {
+		fprintf(stderr, "%s: %s\n", argv[iarg], reader._error);
+		image_close(&reader);
+		return EXIT_FAILURE;
+	}
+
+	// Symboles et métadonnées conservés sauf s'ils sont remplacés par -s et -M
+	Image_Symbol *syms;
+	unsigned nsyms;
+	Machine mach;
+	char *oldmeta = NULL;
+	const Image_Section *pmeta = image_section(&reader, SECTION_META);
+	if (meta == NULL && pmeta != NULL) {
+		oldmeta = calloc(1, image_length(&reader, pmeta) + 1);
+		if (!image_read_section(&reader, pmeta, oldmeta)) {
+			fprintf(stderr, "%s: %s\n", argv[iarg], reader._error);
+			return EXIT_FAILURE;
+		}
+		meta = oldmeta;
+	}
+	if (!image_read_symbols(&reader, &syms, &nsyms) || !image_load(&reader, &mach)) {
+		fprintf(stderr, "%s: %s\n", argv[iarg], reader._error);
+		image_close(&reader);
+		return EXIT_FAILURE;
+	}
+	image_close(&reader);
+	if (symfile != NULL) {
+		image_free_symbols(syms, nsyms);
+		syms = malloc(MAXSYMBOLS * sizeof(Image_Symbol));
+		nsyms = read_symbols(symfile, syms);
+	}
+
+	bool ok = true;
+	if (outfile != NULL)
+		ok = v1 ? image_write_v1(&mach, outfile) : image_write(&mach, outfile, syms, nsyms, meta, compress);
+	image_free_symbols(syms, nsyms);
+	free(oldmeta);
+	free(mach._text);
+	free(mach._data);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,226 @@
+/***** imgcache.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "imgcache.h"
+#include "stackdepth.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/*!
+ * Mélange final d'un hachage 64 bits (murmur3).
+ */
+static uint64_t mix64(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t cache_hash(const void *buf, uint64_t size) {
+	const unsigned char *p = buf;
+	uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+	uint64_t w;
+	// Par mots de 64 bits, puis octet par octet pour la fin
+	for (; size >= 8; size -= 8, p += 8) {
+		memcpy(&w, p, 8);
+		h = (h ^ mix64(w)) * 0x100000001b3ULL;
+		h = (h << 27) | (h >> 37);
+	}
+	for (; size > 0; size--, p++)
+		h = (h ^ *p) * 0x100000001b3ULL;
+	return mix64(h);
+}
+
+/*!
+ * Projection en mémoire d'une entrée du cache et chargement de la machine.
+ *
+ * \param pmach la machine à charger
+ * \param entry le chemin de l'entrée
+ * \param hash le hachage attendu du fichier source (0 : non vérifié)
+ * \param srcsize la taille attendue du fichier source
+ * \param pval les résultats de validation (remplis si l'entrée est valide)
+ * \return vrai si l'entrée est valide (bonne version, bonne source)
+ */
+static bool map_entry(Machine *pmach, const char *entry, uint64_t hash, uint64_t srcsize,
+                      Image_Validation *pval) {
+	int fd = open(entry, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Cache_Header)) {
+		close(fd);
+		return false;
+	}
+	// Projection privée : les écritures dans les données restent locales
+	void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return false;
+
+	Cache_Header *phdr = p;
+	uint64_t expected = sizeof(Cache_Header)
+		+ (uint64_t) phdr->_textsize * sizeof(Instruction) + (uint64_t) phdr->_datasize * sizeof(Word);
+	if (phdr->_magic != CACHE_MAGIC || phdr->_version != CACHE_VERSION
+	    || phdr->_srcsize != srcsize || (hash != 0 && phdr->_hash != hash)
+	    || (uint64_t) st.st_size != expected) {
+		munmap(p, st.st_size);
+		return false;
+	}
+
+	Instruction *text = (Instruction *) (phdr + 1);
+	Word *data = (Word *) (text + phdr->_textsize);
+	load_program(pmach, phdr->_textsize, text, phdr->_datasize, data, phdr->_dataend);
+
+	pval->_stack_ok = phdr->_stack_ok;
+	pval->_stack_depth = phdr->_stack_depth;
+	pval->_stack_where = phdr->_stack_where;
+	pval->_stack_capacity = phdr->_stack_capacity;
+	return true;
+}
+
+/*!
+ * Validation d'un programme fraîchement chargé (analyse de pile).
+ */
+static void validate(Machine *pmach, Image_Validation *pval) {
+	Stack_Report rep;
+	pval->_stack_ok = stack_analysis(pmach, &rep);
+	pval->_stack_depth = rep._depth;
+	pval->_stack_where = rep._where;
+	pval->_stack_capacity = rep._capacity;
+	stack_report_free(&rep);
+}
+
+/*!
+ * Écriture complète d'une zone mémoire dans un fichier.
+ */
+static bool write_all(int fd, const void *buf, size_t size) {
+	const char *p = buf;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n <= 0)
+			return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+/*!
+ * Création d'une entrée du cache pour la machine fraîchement chargée. Le
+ * fichier est écrit sous un nom temporaire puis renommé, de sorte qu'un autre
+ * processus ne voit jamais d'entrée incomplète.
+ */
+static void store_entry(Machine *pmach, const char *entry, uint64_t hash, uint64_t srcsize,
+                        const Image_Validation *pval) {
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", entry, (long) getpid());
+	int fd = open(tmp, O_TRUNC | O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+		return;
+
+	Cache_Header hdr = {
+		._magic = CACHE_MAGIC,
+		._version = CACHE_VERSION,
+		._hash = hash,
+		._srcsize = srcsize,
+		._textsize = pmach->_textsize,
+		._datasize = pmach->_datasize,
+		._dataend = pmach->_dataend,
+		._stack_ok = pval->_stack_ok,
+		._stack_depth = pval->_stack_depth,
+		._stack_where = pval->_stack_where,
+		._stack_capacity = pval->_stack_capacity,
+		._pad = 0,
+	};
+	bool ok = write_all(fd, &hdr, sizeof(hdr))
+		&& write_all(fd, pmach->_text, pmach->_textsize * sizeof(Instruction))
+		&& write_all(fd, pmach->_data, pmach->_datasize * sizeof(Word));
+	if (close(fd) != 0 || !ok || rename(tmp, entry) != 0)
+		unlink(tmp);
+}
+
+/*!
+ * Mise à jour de l'index secondaire : lien \c s-<clé> vers l'entrée.
+ */
+static void store_link(const char *link, const char *target) {
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", link, (long) getpid());
+	unlink(tmp);
+	if (symlink(target, tmp) != 0 || rename(tmp, link) != 0)
+		unlink(tmp);
+}
+
+bool cache_read_program(Machine *pmach, const char *programfile, const char *cachedir,
+                        Image_Validation *pval) {
+	struct stat st;
+	if ((mkdir(cachedir, 0755) != 0 && errno != EEXIST) || stat(programfile, &st) != 0) {
+		// Pas de cache utilisable : lecture et validation directes
+		read_program(pmach, programfile);
+		validate(pmach, pval);
+		return false;
+	}
+	uint64_t srcsize = st.st_size;
+
+	// 1. Index secondaire par identité du fichier (sans lire son contenu)
+	struct { uint64_t dev, ino, size, sec, nsec; } id = {
+		st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec
+	};
+	char link[PATH_MAX], target[256], entry[PATH_MAX + 256];
+	snprintf(link, sizeof(link), "%s/s-%016llx", cachedir,
+		 (unsigned long long) cache_hash(&id, sizeof(id)));
+	ssize_t n = readlink(link, target, sizeof(target) - 1);
+	if (n > 0) {
+		target[n] = '\0';
+		snprintf(entry, sizeof(entry), "%s/%s", cachedir, target);
+		if (map_entry(pmach, entry, 0, srcsize, pval))
+			return true;
+	}
+
+	// 2. Entrée indexée par le hachage du contenu
+	uint64_t hash = 0;
+	bool hashed = false;
+	int fd = open(programfile, O_RDONLY);
+	if (fd >= 0) {
+		void *p = srcsize > 0 ? mmap(NULL, srcsize, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+		if (p != MAP_FAILED) {
+			hash = cache_hash(p, srcsize);
+			hashed = true;
+			if (p != NULL)
+				munmap(p, srcsize);
+		}
+		close(fd);
+	}
+	if (!hashed) {
+		// Sans hachage, l'entrée ne peut pas être vérifiée : cache ignoré
+		read_program(pmach, programfile);
+		validate(pmach, pval);
+		return false;
+	}
+	snprintf(target, sizeof(target), "%016llx.spc", (unsigned long long) hash);
+	snprintf(entry, sizeof(entry), "%s/%s", cachedir, target);
+	if (map_entry(pmach, entry, hash, srcsize, pval)) {
+		store_link(link, target);
+		return true;
+	}
+
+	// 3. Absent du cache (ou périmé) : lecture, validation et création de l'entrée
+	read_program(pmach, programfile);
+	validate(pmach, pval);
+
+	store_entry(pmach, entry, hash, srcsize, pval);
+	store_link(link, target);
+	return false;
+}
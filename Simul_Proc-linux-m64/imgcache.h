@@ -0,0 +1,89 @@
+#ifndef _IMGCACHE_H_
+#define _IMGCACHE_H_
+
+/*!
+ * \file imgcache.h
+ * \brief Cache disque des programmes binaires prêts à l'exécution.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Version du format des entrées du cache
+/*!
+ * À incrémenter à chaque modification du simulateur qui change la forme
+ * prête à l'exécution (décodage des instructions, analyses au chargement...) :
+ * les entrées d'une autre version sont ignorées puis remplacées.
+ */
+#define CACHE_VERSION 3
+
+//! Résultats de validation conservés avec l'image (voir stack_analysis())
+typedef struct
+{
+    bool _stack_ok;		//!< La pile est assurée de suffire
+    unsigned _stack_depth;	//!< Profondeur maximale du programme (ou \c STACK_UNBOUNDED)
+    unsigned _stack_where;	//!< Adresse de l'instruction qui atteint cette profondeur
+    unsigned _stack_capacity;	//!< Nombre de mots empilables
+} Image_Validation;
+
+//! En-tête d'une entrée du cache
+/*!
+ * Une entrée est un fichier \c <hash>.spc du répertoire de cache, où \c hash
+ * est le hachage (64 bits, en hexadécimal) du contenu du fichier binaire
+ * source. Le fichier contient cet en-tête puis le segment de texte puis le
+ * segment de données, et se projette tel quel en mémoire (\c mmap) : la
+ * machine pointe directement dans la projection, privée, de sorte que les
+ * écritures dans les données ne modifient pas le cache.
+ */
+typedef struct
+{
+    uint32_t _magic;		//!< \c CACHE_MAGIC
+    uint32_t _version;		//!< \c CACHE_VERSION
+    uint64_t _hash;		//!< Hachage du contenu du fichier source
+    uint64_t _srcsize;		//!< Taille du fichier source en octets
+    uint32_t _textsize;		//!< Taille du segment de texte
+    uint32_t _datasize;		//!< Taille du segment de données
+    uint32_t _dataend;		//!< Première adresse libre après les données statiques
+    uint32_t _stack_ok;		//!< Résultats de validation (voir Image_Validation)
+    uint32_t _stack_depth;
+    uint32_t _stack_where;
+    uint32_t _stack_capacity;
+    uint32_t _pad;
+} Cache_Header;
+
+//! Marque des entrées du cache ("SPIC")
+#define CACHE_MAGIC 0x43495053u
+
+//! Hachage du contenu d'un fichier binaire
+/*!
+ * \param buf le contenu
+ * \param size sa taille en octets
+ * \return le hachage sur 64 bits
+ */
+uint64_t cache_hash(const void *buf, uint64_t size);
+
+//! Lecture d'un programme binaire au travers du cache
+/*!
+ * Si le cache contient déjà la forme prête à l'exécution de ce fichier (même
+ * contenu, même version du simulateur), la machine est chargée directement
+ * depuis l'entrée projetée en mémoire, validation comprise. Sinon le fichier
+ * est lu par read_program(), validé, et l'entrée est créée.
+ *
+ * Un index secondaire, lien symbolique \c s-<clé> où la clé est calculée à
+ * partir du périphérique, du numéro d'inode, de la taille et de la date de
+ * modification du fichier source, évite de relire le fichier source lors des
+ * chargements suivants : un chargement à chaud coûte quelques appels système,
+ * quelle que soit la taille de l'image.
+ *
+ * \param pmach la machine à simuler
+ * \param programfile le nom du fichier binaire
+ * \param cachedir le répertoire du cache (créé au besoin)
+ * \param pval les résultats de validation de l'image
+ * \return vrai si l'image provient du cache
+ */
+bool cache_read_program(Machine *pmach, const char *programfile, const char *cachedir,
+                        Image_Validation *pval);
+
+#endif
@@ -3,38 +3,51 @@
 #include <string.h>
 
 //! Forme imprimable des codes opérations
-/*extern*/ const char *cop_names[] = {"ILLOP", "NOP", "LOAD", "STORE", "ADD", "SUB", "BRANCH", "CALL", "RET", "PUSH", "POP", "HALT"};
+/*extern*/ const char *cop_names[] = {
+#define OPCODE(NAME, name, operand, regcond) #NAME,
+#include "opcodes.def"
+};
+
+//! Description des codes opérations
+/*extern*/ const Cop_Info cop_info[] = {
+#define OPCODE(NAME, name, operand, regcond) {#NAME, OPERAND_##operand, REGCOND_##regcond},
+#include "opcodes.def"
+};
 
 //! Forme imprimable des conditions
 /*extern*/ const char *condition_names[] = { "NC", "EQ", "NE", "GT", "GE", "LT", "LE" };
 
-//! Impression d'une instruction sous forme lisible (désassemblage)
+//! Désassemblage d'une instruction dans une chaîne
 /*!
- * \param instr l'instruction à imprimer
- * \param addr son adresse
+ * \param buf la chaîne, d'au moins \c INSTR_TEXT_MAX caractères
+ * \param instr l'instruction à désassembler
+ * \return la longueur de la chaîne écrite
  */
-void print_instruction(Instruction instr, unsigned addr)
+int format_instruction(char *buf, Instruction instr)
 {
 	//Affichage du nom d'instruction : récupération de la position dans le tableau 
 	//cop_names dans la structure générique du header
-	printf("%s ", cop_names[instr.instr_generic._cop] );
+	// Les mots qui ne sont pas des instructions connues ne doivent pas faire déborder cop_names
+	if (instr.instr_generic._cop > LAST_COP)
+		return sprintf(buf, "??? (0x%08x)", instr._raw);
+	const Cop_Info *pinfo = &cop_info[instr.instr_generic._cop];
+	int len = sprintf(buf, "%s ", pinfo->_name);
 	 
 	// Selon l'instruction qui va être execute, le terme suivant sera une condition ou un numero de registre ou...rien.
-	switch (instr.instr_generic._cop) {
+	switch (pinfo->_regcond) {
 
 		// Dans ces cas là, c'est une condition, donc affichage de la condition via le tab condition_names
-		case BRANCH:
-		case CALL:
-			printf("%s, ", condition_names[instr.instr_generic._regcond] ); 
+		case REGCOND_COND:
+			if (instr.instr_generic._regcond > LAST_CONDITION)
+				len += sprintf(buf + len, "??, ");
+			else
+				len += sprintf(buf + len, "%s, ", condition_names[instr.instr_generic._regcond] ); 
 			break;
 
 		// Dans ces cas là, c'est un registre, donc faut l'afficher proprement...
-		case LOAD:
-		case STORE:
-		case ADD:
-		case SUB:
+		case REGCOND_REG:
 				//%02d means "format the integer with 2 digits, left padding it with zeroes"
-				printf("R%02d, ", instr.instr_generic._regcond);
+				len += sprintf(buf + len, pinfo->_operand == OPERAND_NONE ? "R%02d" : "R%02d, ", instr.instr_generic._regcond);
 			break;
 
 		default:
@@ -42,12 +55,9 @@ void print_instruction(Instruction instr, unsigned addr)
 	}
 
 	// Affichage des opérandes
-	switch (instr.instr_generic._cop)
+	switch (pinfo->_operand)
 	{
-		case HALT:
-		case RET:
-		case ILLOP:
-		case NOP:
+		case OPERAND_NONE:
 			// Dans ces cas là, pas d'opérandes
 			break;
 
@@ -55,7 +65,7 @@ void print_instruction(Instruction instr, unsigned addr)
 
 			if (instr.instr_generic._immediate) 
 			{ // Si I = 1 , l'opérande est une valeur immédiate
-				printf("#%d", instr.instr_immediate._value);
+				len += sprintf(buf + len, "#%d", instr.instr_immediate._value);
 			} 
 			else 
 			{				
@@ -63,13 +73,40 @@ void print_instruction(Instruction instr, unsigned addr)
 				{ 
 				// Si I = 0 et X = 1, l'opérande est une adresse relative indexée sur un registre
 				// En deux parties : un numéro de registre et un offset
-					printf("%d[R%02d]", instr.instr_indexed._offset, instr.instr_indexed._rindex); // crochets pour accès mémoire indirect
+					len += sprintf(buf + len, "%d[R%02d]", instr.instr_indexed._offset, instr.instr_indexed._rindex); // crochets pour accès mémoire indirect
 				}
 				else
 				{ // Si I = 0 et X = 0, L'opérande est une adresse absolue
-					printf("@0x%04x", instr.instr_absolute._address); // %x -> hexadecimal	
+					len += sprintf(buf + len, "@0x%04x", instr.instr_absolute._address); // %x -> hexadecimal	
 				}
 			}
 		break;
 	}
-}
\ No newline at end of file
+	return len;
+}
+
+//! Impression d'une instruction sous forme lisible (désassemblage)
+/*!
+ * \param instr l'instruction à imprimer
+ * \param addr son adresse
+ */
+void print_instruction(Instruction instr, unsigned addr)
+{
+	char buf[INSTR_TEXT_MAX];
+	format_instruction(buf, instr);
+	fputs(buf, stdout);
+}
+
+Error instruction_check(Instruction instr) {
+	if (instr.instr_generic._cop > LAST_COP)
+		return ERR_UNKNOWN;
+	if (instr.instr_generic._cop == ILLOP)
+		return ERR_ILLEGAL;
+	const Cop_Info *pinfo = &cop_info[instr.instr_generic._cop];
+	if (instr.instr_generic._immediate
+	    && (pinfo->_operand == OPERAND_ADDRESS || pinfo->_operand == OPERAND_TARGET))
+		return ERR_IMMEDIATE;
+	if (pinfo->_regcond == REGCOND_COND && instr.instr_generic._regcond > LAST_CONDITION)
+		return ERR_CONDITION;
+	return ERR_NOERROR;
+}
@@ -8,25 +8,45 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-//! Codes opérations
+#include "error.h"
+
+//! Codes opérations (voir opcodes.def)
 typedef enum 
 {
-    ILLOP = 0,	//!< Instruction illégale
-    NOP,	//!< Instruction sans effet
-    LOAD,	//!< Chargement d'un registre
-    STORE,	//!< Rangement du contenu d'un registre 
-    ADD,	//!< Addition à un registre 
-    SUB,	//!< Soustraction d'un registre 
-    BRANCH,	//!< Branchement conditionnel ou non  
-    CALL,	//!< Appel de sous-programme 
-    RET,	//!< Retour de sous-programme 
-    PUSH,	//!< Empilement sur la pile d'exécution 
-    POP,	//!< Dépilement de la pile d'exécution
-    HALT,	//!< Arrêt (normal) du programme
+#define OPCODE(NAME, name, operand, regcond) NAME,
+#include "opcodes.def"
 } Code_Op;
 
 //! Dernière valeur possible du code opération
-const static unsigned LAST_COP = HALT;
+const static unsigned LAST_COP = 0
+#define OPCODE(NAME, name, operand, regcond) + 1
+#include "opcodes.def"
+    - 1;
+
+//! Nature de l'opérande d'une instruction (voir opcodes.def)
+typedef enum
+{
+    OPERAND_NONE,	//!< Pas d'opérande
+    OPERAND_VALUE,	//!< Valeur immédiate, ou lue à une adresse absolue ou indexée
+    OPERAND_ADDRESS,	//!< Adresse de données absolue ou indexée (immédiat interdit)
+    OPERAND_TARGET,	//!< Adresse absolue dans le segment de texte (immédiat interdit)
+} Operand_Kind;
+
+//! Nature du champ registre/condition d'une instruction (voir opcodes.def)
+typedef enum
+{
+    REGCOND_NONE,	//!< Champ inutilisé
+    REGCOND_REG,	//!< Numéro de registre
+    REGCOND_COND,	//!< Condition
+} Regcond_Kind;
+
+//! Description d'un code opération
+typedef struct
+{
+    const char *_name;		//!< Forme imprimable
+    Operand_Kind _operand;	//!< Nature de l'opérande
+    Regcond_Kind _regcond;	//!< Nature du champ registre/condition
+} Cop_Info;
 
 
 //! Structure d'une instruction 
@@ -125,6 +145,9 @@ typedef uint32_t Word;
 //! Forme imprimable des codes opérations
 extern const char *cop_names[];
 
+//! Description des codes opérations, indexée par \c Code_Op (jusqu'à \c LAST_COP)
+extern const Cop_Info cop_info[];
+
 //! Forme imprimable des conditions
 extern const char *condition_names[];
 
@@ -135,4 +158,26 @@ extern const char *condition_names[];
  */
 void print_instruction(Instruction instr, unsigned addr);
 
+//! Longueur maximale du désassemblage d'une instruction, zéro final compris
+#define INSTR_TEXT_MAX 32
+
+//! Désassemblage d'une instruction dans une chaîne (même texte que print_instruction())
+/*!
+ * \param buf la chaîne, d'au moins \c INSTR_TEXT_MAX caractères
+ * \param instr l'instruction à désassembler
+ * \return la longueur du texte écrit
+ */
+int format_instruction(char *buf, Instruction instr);
+
+//! Validation d'une instruction
+/*!
+ * Erreurs détectables à la seule lecture de l'instruction, dans l'ordre où
+ * l'exécution les signale : \c ERR_UNKNOWN, \c ERR_ILLEGAL, \c ERR_IMMEDIATE
+ * puis \c ERR_CONDITION.
+ *
+ * \param instr l'instruction
+ * \return l'erreur que provoquera son exécution, ou \c ERR_NOERROR
+ */
+Error instruction_check(Instruction instr);
+
 #endif
@@ -0,0 +1,166 @@
+/***** loops.c *****/
+#include "loops.h"
+#include "exec.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//! \c BRANCH bien formé
+static bool is_branch(Instruction instr) {
+	return instr.instr_generic._cop == BRANCH && instruction_check(instr) == ERR_NOERROR;
+}
+
+//! \c ADD ou \c SUB bien formé
+static bool is_arith(Instruction instr) {
+	Code_Op cop = instr.instr_generic._cop;
+	return cop == ADD || cop == SUB;
+}
+
+/*!
+ * Analyse de la boucle fermée par le branchement arrière à l'adresse \a e.
+ *
+ * \param pmach la machine
+ * \param e adresse d'un \c BRANCH vers une adresse inférieure ou égale
+ * \param ploop la boucle à remplir
+ * \return vrai si c'est une boucle comptée
+ */
+static bool analyse(const Machine *pmach, unsigned e, Loop *ploop) {
+	Instruction back = pmach->_text[e];
+	unsigned h = back.instr_absolute._address;
+
+	// Test de sortie éventuel en tête : il doit laisser passer un compteur positif
+	unsigned body = h;
+	Instruction test = pmach->_text[h];
+	if (h < e && is_branch(test)) {
+		unsigned x = test.instr_absolute._address;
+		if ((x >= h && x <= e) || condition_holds(test.instr_generic._regcond, CC_P))
+			return false;
+		body = h + 1;
+	}
+	// Le branchement arrière doit être pris pour un compteur positif
+	if (!condition_holds(back.instr_generic._regcond, CC_P))
+		return false;
+
+	// Corps : NOP, ADD et SUB ; la dernière opération est la décrémentation
+	bool written[NREGISTERS] = {false}, index[NREGISTERS] = {false};
+	int last = -1;
+	for (unsigned a = body; a < e; a++) {
+		Instruction instr = pmach->_text[a];
+		if (instr.instr_generic._cop == NOP)
+			continue;
+		if (!is_arith(instr))
+			return false;
+		written[instr.instr_generic._regcond] = true;
+		if (!instr.instr_generic._immediate && instr.instr_generic._indexed)
+			index[instr.instr_indexed._rindex] = true;
+		last = a;
+	}
+	if (last < 0)
+		return false;
+
+	Instruction dec = pmach->_text[last];
+	unsigned ind = dec.instr_generic._regcond;
+	if (!dec.instr_generic._immediate)
+		return false;
+	int step = dec.instr_immediate._value;
+	if (dec.instr_generic._cop == ADD)
+		step = -step;
+	if (step <= 0)
+		return false;
+
+	// Registre d'induction modifié une seule fois ; pas d'index modifié
+	for (unsigned a = body; a < (unsigned) last; a++)
+		if (is_arith(pmach->_text[a]) && pmach->_text[a].instr_generic._regcond == ind)
+			return false;
+	for (unsigned r = 0; r < NREGISTERS; r++)
+		if (written[r] && index[r])
+			return false;
+
+	ploop->_head = h;
+	ploop->_branch = e;
+	ploop->_body = body;
+	ploop->_induction = ind;
+	ploop->_step = step;
+	return true;
+}
+
+Loops *loops_enable(Machine *pmach) {
+	loops_disable(pmach);
+
+	Loops *pl = checked_realloc(NULL, sizeof(Loops), "l'analyse des boucles");
+	pl->_loops = checked_realloc(NULL, pmach->_textsize * sizeof(Loop), "l'analyse des boucles");
+	pl->_nloops = 0;
+	pl->_at = checked_realloc(NULL, pmach->_textsize * sizeof(int), "l'analyse des boucles");
+	pl->_forwarded = 0;
+
+	for (unsigned e = 0; e < pmach->_textsize; e++) {
+		pl->_at[e] = -1;
+		Instruction instr = pmach->_text[e];
+		if (is_branch(instr) && instr.instr_absolute._address <= e
+		    && analyse(pmach, e, &pl->_loops[pl->_nloops]))
+			pl->_at[e] = pl->_nloops++;
+	}
+	pmach->_loops = pl;
+	return pl;
+}
+
+void loops_disable(Machine *pmach) {
+	Loops *pl = pmach->_loops;
+	if (pl == NULL)
+		return;
+	free(pl->_loops);
+	free(pl->_at);
+	free(pl);
+	pmach->_loops = NULL;
+}
+
+uint64_t loops_forward(Machine *pmach, uint64_t limit) {
+	Loops *pl = pmach->_loops;
+	int i = pl->_at[pmach->_pc];
+	if (i < 0)
+		return 0;
+	const Loop *ploop = &pl->_loops[i];
+
+	// Le code condition doit être le signe (positif) du registre d'induction
+	int32_t count = pmach->_registers[ploop->_induction];
+	if (pmach->_cc != CC_P || count <= 0)
+		return 0;
+
+	// Itérations restantes tant que le compteur reste positif, dans la limite
+	uint64_t length = ploop->_branch - ploop->_head + 1;
+	uint64_t n = ((uint64_t) count + ploop->_step - 1) / ploop->_step;
+	uint64_t room = limit > pmach->_icount ? (limit - pmach->_icount) / length : 0;
+	if (n > room)
+		n = room;
+	if (n == 0)
+		return 0;
+
+	// Apport de chaque itération aux autres registres (opérandes invariants)
+	Word delta[NREGISTERS] = {0};
+	for (unsigned a = ploop->_body; a < ploop->_branch; a++) {
+		Instruction instr = pmach->_text[a];
+		if (!is_arith(instr) || instr.instr_generic._regcond == ploop->_induction)
+			continue;
+		Word value;
+		if (instr.instr_generic._immediate)
+			value = instr.instr_immediate._value;
+		else {
+			int addr = instr.instr_generic._indexed
+				? (int) (pmach->_registers[instr.instr_indexed._rindex] + instr.instr_indexed._offset)
+				: (int) instr.instr_absolute._address;
+			if (addr < 0 || (unsigned) addr >= pmach->_datasize)
+				return 0; // L'exécution normale signalera l'erreur
+			value = pmach->_data[addr];
+		}
+		delta[instr.instr_generic._regcond] += instr.instr_generic._cop == ADD ? value : -value;
+	}
+
+	for (unsigned r = 0; r < NREGISTERS; r++)
+		pmach->_registers[r] += (Word) n * delta[r];
+	int32_t left = count - (int64_t) n * ploop->_step;
+	pmach->_registers[ploop->_induction] = left;
+	pmach->_cc = left > 0 ? CC_P : left == 0 ? CC_Z : CC_N;
+	pmach->_icount += n * length;
+	pl->_forwarded += n;
+	return n;
+}
@@ -0,0 +1,89 @@
+#ifndef _LOOPS_H_
+#define _LOOPS_H_
+
+/*!
+ * \file loops.h
+ * \brief Détection et accélération des boucles comptées.
+ *
+ * Une boucle comptée est une suite d'instructions \c h..e du segment de
+ * texte :
+ *
+ *   - \c e est un \c BRANCH vers \c h (branchement arrière) ;
+ *
+ *   - \c h peut être un test de sortie, \c BRANCH vers une adresse hors de la
+ *   boucle ;
+ *
+ *   - les autres instructions sont des \c NOP, \c ADD et \c SUB ; la dernière
+ *   opération arithmétique décrémente le <em>registre d'induction</em> d'une
+ *   valeur immédiate ; les autres ajoutent à d'autres registres des valeurs
+ *   immédiates ou lues en mémoire (invariantes : la boucle n'écrit pas en
+ *   mémoire) ;
+ *
+ *   - ni le registre d'induction, ni les registres modifiés ne servent à
+ *   l'adressage indexé dans la boucle.
+ *
+ * Arrivée sur \c e, la boucle continue tant que le registre d'induction est
+ * positif (le code condition est son signe). Le nombre d'itérations restantes
+ * a donc une forme close : loops_forward() les exécute d'un coup, avec des
+ * registres, un code condition et un compteur d'instructions exacts. Toute
+ * autre situation (registre négatif ou nul, opérande hors du segment de
+ * données, budget épuisé...) est laissée à l'exécution normale.
+ */
+
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Boucle comptée
+typedef struct
+{
+    unsigned _head;		//!< Adresse de la première instruction (\c h)
+    unsigned _branch;		//!< Adresse du branchement arrière (\c e)
+    unsigned _body;		//!< Première instruction après le test de sortie éventuel
+    unsigned _induction;	//!< Registre d'induction
+    Word _step;			//!< Décrément du registre d'induction à chaque itération
+} Loop;
+
+//! Boucles comptées d'un programme
+typedef struct Loops
+{
+    Loop *_loops;		//!< Boucles détectées
+    unsigned _nloops;		//!< Nombre de boucles détectées
+
+    //! Indice dans \c _loops de la boucle fermée à chaque adresse, -1 sinon
+    /*! Tableau de \c _textsize entiers. */
+    int *_at;
+
+    uint64_t _forwarded;	//!< Nombre total d'itérations accélérées
+} Loops;
+
+//! Activation de l'accélération des boucles comptées
+/*!
+ * Le segment de texte est analysé et le résultat est attaché à la machine
+ * (\c _loops). simul() et simul_run() accélèrent alors les boucles, sauf si
+ * des crochets sont enregistrés (voir hooks.h) ou en mode de mise au point.
+ *
+ * \param pmach la machine (programme chargé)
+ * \return les boucles détectées
+ */
+Loops *loops_enable(Machine *pmach);
+
+//! Désactivation de l'accélération et libération de l'analyse
+/*!
+ * \param pmach la machine
+ */
+void loops_disable(Machine *pmach);
+
+//! Accélération de la boucle dont le branchement arrière est à l'adresse \c _pc
+/*!
+ * Les itérations complètes restantes (de \c e à \c e) sont exécutées d'un
+ * coup, sans que le compteur d'instructions ne dépasse \a limit. La machine
+ * reste sur \c e, dans l'état exact où l'aurait laissée l'exécution normale.
+ *
+ * \param pmach la machine (\c _pc est une adresse du segment de texte)
+ * \param limit valeur maximale du compteur d'instructions
+ * \return le nombre d'itérations exécutées (0 si rien n'a été fait)
+ */
+uint64_t loops_forward(Machine *pmach, uint64_t limit);
+
+#endif
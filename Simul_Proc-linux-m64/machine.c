@@ -3,6 +3,11 @@
 #include "exec.h"
 #include "debug.h"
 #include "error.h"
+#include "hooks.h"
+#include "loops.h"
+#include "memo.h"
+#include "image.h"
+#include "printer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -31,65 +36,49 @@ void load_program(Machine *pmach,
   pmach->_dataend=dataend; 
   //Init de SP ;
   pmach->_sp = datasize-1;
+  //Pas encore d'instruction exécutée, ni crochet, ni accélération des boucles, ni mémoïsation, ni programme partagé, ni périphérique
+  pmach->_icount = 0;
+  pmach->_hooks = NULL;
+  pmach->_loops = NULL;
+  pmach->_memo = NULL;
+  pmach->_program = NULL;
+  pmach->_devices = NULL;
 }
 
 void read_program(Machine *pmach, const char *programfile){
-  unsigned int textsize, datasize, dataend; 
-  int opening= open(programfile,O_RDONLY);
-
-  // Verifications avant la lecture par rapport aux champs de pmach.
-  if(opening<0){
-    fprintf(stderr, "Erreur lors de l'ouverture du fichier\n");
+  Image_Reader reader;
+  // Version 1 ou 2 (voir image.h) : les segments sont lus directement à leur place
+  if(!image_open(&reader, programfile)){
+    fprintf(stderr, "Erreur lors de l'ouverture du fichier %s : %s\n", programfile, reader._error);
     exit(1);
   }
+  if(!image_load(&reader, pmach)){
+    fprintf(stderr, "Erreur lors de la lecture du fichier %s : %s\n", programfile, reader._error);
+    exit(1);
+  }
+  image_close(&reader);
+}
 
-  // Verification du nombre de bits lus pour textsize.
-  read(opening, &textsize, sizeof(pmach->_textsize));
-
-  // Verification du nombre de bits lus pour datasize. 
-  read(opening, &datasize, sizeof(pmach->_datasize));  
+void write_program(Machine *pmach, const char *programfile){
+  //Image de version 2, sans symboles ni métadonnées
+  if(!image_write(pmach, programfile, NULL, 0, NULL, false)){
+    exit(1);
+  }
+}
 
-  // Verification du nombre de bits lus pour dataend. Si ce nombre ne correspond pas au nombre de bits de dataend dans pmach alors on renvoie une erreur.
-  read(opening, &dataend, sizeof(pmach->_dataend));//sizeof
-  
-  // On lit les instructions:
-  Instruction *instruction = malloc(textsize * sizeof(Instruction));
-  read(opening, instruction, textsize*sizeof(Instruction));
-  
-  // On lit les données: 
-  Word *data = malloc(datasize * sizeof(Word));
-  read(opening, data, datasize*sizeof(Word));
-
-  // On ferme le fichier et on verifie que la fermeture s'est bien deroulée.
-  int file_close=close(opening); 
-  if(file_close != 0){
-    fprintf(stderr, "Erreur lors de la fermeture du fichier binaire\n");
+void write_program_compressed(Machine *pmach, const char *programfile){
+  if(!image_write(pmach, programfile, NULL, 0, NULL, true)){
     exit(1);
   }
-  
-  // On charge ensuite le programme à l'intérieur de la machine
-  load_program(pmach, textsize,instruction,datasize,data,dataend); 
 }
 
-void dump_memory(Machine *pmach){
+//! Affichage du programme et des données, sauvegarde éventuellement compressée
+static void dump(Machine *pmach, bool compress){
   putchar('\n');
   
-  int file= open("dump.bin", O_TRUNC|O_WRONLY|O_CREAT,S_IRUSR|S_IWUSR); //Dernier champ permission: qui peut lire ou ecrire dans le fichier
-  //On verifie si il n'y a pas eu de problème lors de l'ouverture.
-  if (file==-1){
-    printf("Erreur lors de l'ouverture du fichier dump.bin\n");
-    exit(1); 
-  }
-  //En premier on met textsize
-  write(file, &pmach->_textsize,sizeof(pmach->_textsize));
-  //Puis datasize
-  write(file, &pmach->_datasize,sizeof(pmach->_datasize));
-  //Puis dataend
-  write(file, &pmach->_dataend,sizeof(pmach->_dataend));
-
   putchar('\n');
   printf("Instruction text[] = {\n");
-  //Boucle pour sauvegarder et afficher les instructions
+  //Boucle pour afficher les instructions
   for(int i = 0; i < pmach->_textsize; i++){
 
     if(i%4 == 0){
@@ -97,9 +86,7 @@ void dump_memory(Machine *pmach){
       putchar('\t');
 
     }
-    //On écrit dans le fichier pour chaque itération
-    write(file,&pmach->_text[i]._raw, sizeof(pmach->_text[0]));
-    //Puis on affiche
+    //On affiche chaque instruction
     printf("0x%08x, ", pmach->_text[i]._raw);
     if(i%4 == 3){
       putchar('\n');
@@ -112,11 +99,9 @@ void dump_memory(Machine *pmach){
   
   
   printf("Word data[] = {\n");
-  //Boucle pour sauvegarder et afficher les données. 
+  //Boucle pour afficher les données. 
   for(int i = 0 ; i < pmach->_datasize ; i++){
-    //On écrit dans le fichier pour chaque itération
-    write(file,&pmach->_data[i],sizeof(Word));
-    //Puis on affiche
+    //On affiche chaque mot
     printf("\t0x%08x, ", pmach->_data[i]);
     if (i % 4 == 3){
       putchar('\n');
@@ -130,112 +115,133 @@ void dump_memory(Machine *pmach){
   
   printf("unsigned datasize = %d;\n", pmach->_datasize);
   printf("unsigned dataend = %d;\n", pmach->_dataend);
-  int closing=close(file);
-  if(closing!=0){
-    printf("Erreur lors de la fermture du fichier binaire dump.bin\n");
-    exit(1); 
+  //Sauvegarde binaire (image de version 2)
+  if(compress){
+    write_program_compressed(pmach, "dump.bin");
+  }else{
+    write_program(pmach, "dump.bin");
   }
-  
 }
 
-void print_program(Machine *pmach){
-  putchar('\n');
-  printf("*** PROGRAM (size: %d) ***", pmach->_textsize);
-  putchar('\n');
-  
-  for(int i = 0; i < pmach->_textsize; i++){
-    printf("0x%04x: 0x%08x\t ", i, pmach->_text[i]._raw);
-    print_instruction(pmach->_text[i],pmach->_text[i].instr_absolute._address);
-    putchar('\n');
-  }
+void dump_memory(Machine *pmach){
+  dump(pmach, false);
 }
 
-void print_data(Machine *pmach){
-  putchar('\n');
-  printf("*** DATA (size: %d, end = 0x%08x (%d)) ***", pmach->_datasize, pmach->_dataend, pmach->_dataend);
-  putchar('\n');
-    
-  for(int i = 0;i < pmach->_datasize; i++){
-    if((i%3 == 0) && (i != 0)){
-      putchar('\n');
-    }    
-    printf("0x%04x: 0x%08x %d\t", i, pmach->_data[i], pmach->_data[i]);
-    
-  }
-  putchar('\n');
+void dump_memory_compressed(Machine *pmach){
+  dump(pmach, true);
 }
 
-/*!
-  * Fonction put_cc. Cette fonction prend en parametre un code condition et renvoie la lettre correspondante.
-  * Pour CC_U => U
-  * Pour CC_Z => Z
-  * Pour CC_P => P
-  * Pour CC_N => N
-
-  * \param cc Code condition
-  * \return La lettre correspondante
- */
-char put_cc(Condition_Code cc){
-  switch(cc){
-  case CC_U: 
-    return 'U';
-  case CC_Z:
-    return 'Z'; 
-  case CC_P: 
-    return 'P';
-  case CC_N: 
-    return 'N';
-  }
-  return 'A'; 
+void print_program(Machine *pmach){
+  print_program_range(pmach, 0, pmach->_textsize, 0, NULL, NULL);
 }
 
-/*
- * Fonction print_registers. Cette fonction affiche tous les registres avec leur adresse et leur valeur.
- *
- * \param pmach Machine dont il faut afficher les registres
- */
-void print_registers(Machine *pmach){
-  for(int i = 0 ; i < NREGISTERS ; i++){
-    printf("R%02d: 0x%08x\t%d\t", i, pmach->_registers[i], pmach->_registers[i]);
-    if (i % 3 == 2){
-      putchar('\n');
-    }
-  }
+void print_data(Machine *pmach){
+  print_data_range(pmach, 0, pmach->_datasize, 0);
 }
 
 void print_cpu(Machine *pmach){
-  
-  printf("\n*** CPU ***\n");
-  printf("PC:  0x%08x\tCC: ",pmach->_pc); //On affiche l'adresse de PC
-  //On appelle la fonction put_cc qui renvoie le caractere à afficher en fonction du code condition de la machine courante.
-  char char_to_put=put_cc(pmach->_cc);
-  if(char_to_put=='A'){
-    printf("Erreur code condition dans la fonction put_cc dans machine.c\n");
-    exit(1);
+  print_cpu_flags(pmach, 0);
+}
+
+/*!
+ * Erreur de segment de texte, signalée aux crochets s'il y en a.
+ */
+static void segtext_error(Machine *pmach){
+  if(pmach->_hooks != NULL){
+    hooks_fault(pmach, ERR_SEGTEXT, pmach->_pc - 1);
   }
-  putchar(char_to_put);
-  putchar('\n');
-  putchar('\n');
-  //Appelle de la fonction print_registers qui affiche les registres avec leur adresse et leur valeur
-  print_registers(pmach);
-  putchar('\n');
+  error(ERR_SEGTEXT,pmach->_pc - 1); //On précise l'erreur rencontré: ERR_SEGTEXT qui correspond à la violation de la taille du segment de text ainsi que l'adresse à laquelle se trouve l'erreur, cette adresse se trouve à pc-1.
 }
 
 void simul(Machine *pmach, bool debug){
+  //Version instrumentée ou non de l'exécution, choisie une fois pour toutes (voir hooks.h)
+  bool (*execute)(Machine *, Instruction) = pmach->_hooks != NULL ? decode_execute_hooked : decode_execute;
+  bool textual = !hooks_notrace(pmach); //Une trace binaire remplace la trace textuelle
+  //Les crochets et la mise au point voient chaque instruction : pas d'accélération des boucles.
+  //Les lectures de périphériques ne se répètent pas : ni boucles accélérées, ni mémoïsation.
+  bool plain = pmach->_hooks == NULL && pmach->_devices == NULL && !debug;
+  bool forward = pmach->_loops != NULL && plain;
+  Memo *memo = plain ? pmach->_memo : NULL;
   bool stop=true; 
   while(stop){
     //On appelle la fonction trace qui se trouve dans exec.c. On lui donne en parametre le message à afficher, la machine qui est en cours d'execution (pmach), l'instruction en cours et l'adresse de l'instruction grâce à pc. 
 
-    trace("Execution",pmach,pmach->_text[pmach->_pc],pmach->_pc);
-
     if(pmach->_pc<pmach->_textsize){      
-      stop=decode_execute(pmach, pmach->_text[pmach->_pc++]); //On decode et execute l'instruction suivante dont l'adresse est pc+1. Cette fonction renvoie faux lorsque l'instruction a decoder est HALT qui marque la fin.
+      unsigned pc = pmach->_pc;
+      uint64_t n;
+      if(forward && (n = loops_forward(pmach, UINT64_MAX)) != 0){
+        if(textual){
+          printf("TRACE: Fast-forward: 0x%04x: %llu iterations\n", pc, (unsigned long long) n);
+        }
+        continue; //Le branchement arrière est ensuite exécuté normalement
+      }
+      if(memo != NULL && memo_call(pmach, UINT64_MAX)){
+        if(textual){
+          printf("TRACE: Memoized: 0x%04x: ", pc);
+          print_instruction(pmach->_text[pc], pc);
+          printf("\n");
+        }
+        continue;
+      }
+      if(textual){
+        trace("Execution",pmach,pmach->_text[pc],pc);
+      }
+      pmach->_icount++; //L'instruction est comptée avant son exécution (un CALL est ainsi attribué à l'appelant).
+      stop=execute(pmach, pmach->_text[pmach->_pc++]); //On decode et execute l'instruction suivante dont l'adresse est pc+1. Cette fonction renvoie faux lorsque l'instruction a decoder est HALT qui marque la fin.
+      if(memo != NULL && memo->_pending){
+        memo_return(pmach); //Enregistrement de l'appel s'il vient de revenir
+      }
       if(debug){
 	         debug=debug_ask(pmach);
       }
     }
     else{
-      error(ERR_SEGTEXT,pmach->_pc - 1); //On précise l'erreur rencontré: ERR_SEGTEXT qui correspond à la violation de la taille du segment de text ainsi que l'adresse à laquelle se trouve l'erreur, cette adresse se trouve à pc-1.
+      segtext_error(pmach);
+    }
+  }
+}
+
+Run_Status simul_run(Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr){
+  jmp_buf env;
+  jmp_buf *saved = error_recover;
+  int err = setjmp(env);
+  if(err != 0){
+    //On revient ici par longjmp depuis error() : la machine est dans l'état de l'erreur.
+    error_recover = saved;
+    if(pmach->_memo != NULL){
+      pmach->_memo->_pending = false; //L'appel en cours ne reviendra pas
+    }
+    *perr = err;
+    *paddr = error_addr;
+    return RUN_ERROR;
+  }
+  error_recover = &env;
+
+  //Fin du budget, sans débordement du compteur
+  uint64_t end = budget > UINT64_MAX - pmach->_icount ? UINT64_MAX : pmach->_icount + budget;
+  bool (*execute)(Machine *, Instruction) = pmach->_hooks != NULL ? decode_execute_hooked : decode_execute;
+  bool plain = pmach->_hooks == NULL && pmach->_devices == NULL;
+  bool forward = pmach->_loops != NULL && plain;
+  Memo *memo = plain ? pmach->_memo : NULL;
+  while(pmach->_icount < end){
+    if(pmach->_pc >= pmach->_textsize){
+      segtext_error(pmach); //Même convention d'adresse que simul()
+    }
+    if(forward && loops_forward(pmach, end) != 0){
+      continue; //Le budget est revérifié avant le branchement arrière
+    }
+    if(memo != NULL && memo_call(pmach, end)){
+      continue;
+    }
+    pmach->_icount++;
+    if(!execute(pmach, pmach->_text[pmach->_pc++])){
+      error_recover = saved;
+      return RUN_HALT;
+    }
+    if(memo != NULL && memo->_pending){
+      memo_return(pmach);
     }
   }
+  error_recover = saved;
+  return RUN_BUDGET;
 }
@@ -9,6 +9,13 @@
 #include <stdbool.h>
 
 #include "instruction.h"
+#include "error.h"
+
+struct Hooks;
+struct Loops;
+struct Memo;
+struct Program;
+struct Device;
 
 //! Nombre de resitres généraux
 #define NREGISTERS 16
@@ -77,12 +84,20 @@ typedef struct
     unsigned int _datasize;	//!< Taille utilisée pour les données
 
     unsigned int _dataend;      //!< Première adresse libre après les données statiques
+    struct Program *_program;	//!< Programme partagé dont vient le texte (voir program.h ; NULL sinon)
 
     // Registres de l'unité centrale
     unsigned _pc;		//!< Compteur ordinal
     Condition_Code _cc;		//!< Code condition : signe de la dernière opération
     Word _registers[NREGISTERS];//!< Registres généraux (accumulateurs)
 
+    // Instrumentation
+    uint64_t _icount;		//!< Nombre d'instructions exécutées
+    struct Hooks *_hooks;	//!< Crochets d'instrumentation (voir hooks.h ; NULL si aucun)
+    struct Loops *_loops;	//!< Boucles comptées à accélérer (voir loops.h ; NULL si aucune)
+    struct Memo *_memo;		//!< Sous-programmes purs à mémoïser (voir memo.h ; NULL si aucun)
+    struct Device *_devices;	//!< Périphériques projetés en mémoire (voir devices.h ; NULL si aucun)
+
 //! Définition de _sp comme synonyme du registre R15    
 #   define _sp _registers[NREGISTERS - 1] 
 } Machine;
@@ -90,7 +105,10 @@ typedef struct
 //! Chargement d'un programme
 /*!
  * La machine est réinitialisée et ses segments de texte et de données sont
- * remplacés par ceux fournis en paramètre.
+ * remplacés par ceux fournis en paramètre. Le compteur d'instructions est remis
+ * à zéro, aucun crochet d'instrumentation ni périphérique n'est enregistré,
+ * l'accélération des boucles et la mémoïsation sont désactivées, et la machine
+ * n'est attachée à aucun programme partagé (voir program_attach()).
  *
  * \param pmach la machine en cours d'exécution
  * \param textsize taille utile du segment de texte
@@ -104,7 +122,8 @@ void load_program(Machine *pmach,
 
 //! Lecture d'un programme depuis un fichier binaire
 /*!
- * Le fichier binaire a le format suivant :
+ * Le fichier est une image de version 2 ou, pour les fichiers antérieurs,
+ * de version 1 (voir image.h). Une image de version 1 a le format suivant :
  * 
  *    - 3 entiers non signés, la taille du segment de texte (\c textsize),
  *    celle du segment de données (\c datasize) et la première adresse libre de
@@ -117,7 +136,9 @@ void load_program(Machine *pmach,
  *    segment de données.
  *
  * Tous les entiers font 32 bits et les adresses de chaque segment commencent à
- * 0. La fonction initialise complétement la machine.
+ * 0. La fonction initialise complétement la machine. Le simulateur s'arrête
+ * si le fichier est illisible, si une image de version 2 est altérée (somme
+ * de contrôle) ou incohérente.
  *
  * \param pmach la machine à simuler
  * \param programfile le nom du fichier binaire
@@ -125,19 +146,47 @@ void load_program(Machine *pmach,
  */
 void read_program(Machine *mach, const char *programfile);  
  
+//! Écriture d'un programme dans un fichier binaire
+/*!
+ * Le fichier est une image de version 2 (voir image_write()), lue par
+ * read_program().
+ *
+ * \param pmach la machine dont on écrit le programme et les données
+ * \param programfile le nom du fichier binaire
+ */
+void write_program(Machine *pmach, const char *programfile);
+
+//! Écriture d'un programme dans un fichier binaire compressé
+/*!
+ * Comme write_program(), mais les sections qui y gagnent sont compressées
+ * (voir SECTION_COMPRESSED) ; read_program() les décompresse au chargement.
+ *
+ * \param pmach la machine dont on écrit le programme et les données
+ * \param programfile le nom du fichier binaire
+ */
+void write_program_compressed(Machine *pmach, const char *programfile);
+
 //! Affichage du programme et des données
 /*!
  * On affiche les instruction et les données en format hexadécimal, sous une
  * forme prête à être coupée-collée dans le simulateur.
  *
  * Pendant qu'on y est, on produit aussi un dump binaire dans le fichier
- * dump.prog. Le format de ce fichier est compatible avec l'option -b de
- * test_simul.
+ * dump.bin (voir write_program()). Le format de ce fichier est compatible
+ * avec l'option -b de test_simul.
  *
  * \param pmach la machine en cours d'exécution
  */
 void dump_memory(Machine *pmach);
 
+//! Affichage du programme et des données, dump binaire compressé
+/*!
+ * Comme dump_memory(), mais dump.bin est écrit par write_program_compressed().
+ *
+ * \param pmach la machine en cours d'exécution
+ */
+void dump_memory_compressed(Machine *pmach);
+
 //! Affichage des instructions du programme
 /*!
  * Les instructions sont affichées sous forme symbolique, précédées de leur adresse.
@@ -173,4 +222,27 @@ void print_cpu(Machine *pmach);
  */
 void simul(Machine *pmach, bool debug);
 
+//! Issue d'une exécution bornée (voir simul_run())
+typedef enum
+{
+    RUN_HALT = 0,	//!< Le programme a exécuté \c HALT
+    RUN_ERROR,		//!< Le programme a provoqué une erreur d'exécution
+    RUN_BUDGET,		//!< Le budget d'instructions est épuisé
+} Run_Status;
+
+//! Simulation silencieuse et bornée
+/*!
+ * Même boucle que simul() mais sans trace, sans mise au point interactive et
+ * sans terminer le simulateur en cas d'erreur : l'erreur est récupérée (voir
+ * \c error_recover) et la machine reste dans l'état où l'erreur s'est
+ * produite. L'exécution peut être reprise après \c RUN_BUDGET.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param budget nombre maximal d'instructions à exécuter
+ * \param perr code de l'erreur si le résultat est \c RUN_ERROR
+ * \param paddr adresse de l'erreur si le résultat est \c RUN_ERROR
+ * \return l'issue de l'exécution
+ */
+Run_Status simul_run(Machine *pmach, uint64_t budget, Error *perr, unsigned *paddr);
+
 #endif
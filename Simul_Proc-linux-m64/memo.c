@@ -0,0 +1,303 @@
+/***** memo.c *****/
+#include "memo.h"
+#include "exec.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! Contexte de l'analyse des sous-programmes
+typedef struct
+{
+    const Machine *pmach;
+    uint32_t *must;		//!< Registres écrits sur tous les chemins, avant chaque instruction
+    uint32_t *may;		//!< Registres écrits sur au moins un chemin, avant chaque instruction
+    bool *seen;			//!< Instruction atteinte ?
+    unsigned *visited;		//!< Instructions atteintes (pour la remise à zéro)
+    unsigned nvisited;
+    unsigned *work;		//!< Liste de travail
+    unsigned nwork;
+} Analysis;
+
+/*!
+ * Propagation des ensembles de registres écrits vers le successeur \a t.
+ *
+ * \return faux si \a t n'est pas une adresse du segment de texte
+ */
+static bool flow(Analysis *pa, unsigned t, uint32_t must, uint32_t may) {
+	if (t >= pa->pmach->_textsize)
+		return false;
+	if (!pa->seen[t]) {
+		pa->seen[t] = true;
+		pa->visited[pa->nvisited++] = t;
+		pa->must[t] = must;
+		pa->may[t] = may;
+	} else if ((pa->must[t] & must) != pa->must[t] || (pa->may[t] | may) != pa->may[t]) {
+		pa->must[t] &= must;
+		pa->may[t] |= may;
+	} else
+		return true;
+	pa->work[pa->nwork++] = t;
+	return true;
+}
+
+/*!
+ * Ajout d'un déplacement de pile lu par le sous-programme.
+ *
+ * \return faux si la clé devient trop grande
+ */
+static bool add_offset(Memo_Sub *psub, int offset) {
+	for (unsigned k = 0; k < psub->_noffsets; k++)
+		if (psub->_offsets[k] == offset)
+			return true;
+	if (psub->_noffsets == MEMO_MAXKEY)
+		return false;
+	psub->_offsets[psub->_noffsets++] = offset;
+	return true;
+}
+
+/*!
+ * Registres lus et écrits par une instruction permise dans un sous-programme
+ * pur.
+ *
+ * \return faux si l'instruction n'est pas permise
+ */
+static bool effect(Instruction instr, Memo_Sub *psub, uint32_t *preads, uint32_t *pwrites) {
+	unsigned reg = instr.instr_generic._regcond;
+	*preads = *pwrites = 0;
+	switch (instr.instr_generic._cop) {
+		case NOP:
+		case RET:
+			return true;
+		case BRANCH:
+			if (instruction_check(instr) != ERR_NOERROR)
+				return false;
+			if (reg != NC)
+				*preads = MEMO_CC;
+			return true;
+		case LOAD:
+		case ADD:
+		case SUB:
+		case MUL:
+		case DIV:
+		case MOD:
+		case AND:
+		case OR:
+		case XOR:
+		case SHL:
+		case SHR:
+			if (reg == NREGISTERS - 1)
+				return false; // R15 reste constant
+			if (!instr.instr_generic._immediate) {
+				if (!instr.instr_generic._indexed || instr.instr_indexed._rindex != NREGISTERS - 1)
+					return false; // Lecture hors du cadre de pile
+				if (!add_offset(psub, instr.instr_indexed._offset))
+					return false;
+			}
+			if (instr.instr_generic._cop != LOAD)
+				*preads = 1u << reg;
+			*pwrites = 1u << reg | MEMO_CC;
+			return true;
+		default:
+			return false;
+	}
+}
+
+/*!
+ * Analyse du sous-programme d'adresse \a s.
+ *
+ * \param pa le contexte (tableaux remis à zéro)
+ * \param s adresse d'entrée
+ * \param psub le sous-programme à remplir
+ * \return vrai si le sous-programme est pur et sa clé assez petite
+ */
+static bool analyse(Analysis *pa, unsigned s, Memo_Sub *psub) {
+	const Machine *pmach = pa->pmach;
+	memset(psub, 0, sizeof(*psub));
+	psub->_addr = s;
+
+	bool pure = flow(pa, s, 0, 0);
+	while (pure && pa->nwork > 0) {
+		unsigned a = pa->work[--pa->nwork];
+		Instruction instr = pmach->_text[a];
+		uint32_t reads, writes;
+		if (!effect(instr, psub, &reads, &writes)) {
+			pure = false;
+			break;
+		}
+		uint32_t must = pa->must[a] | writes, may = pa->may[a] | writes;
+		switch (instr.instr_generic._cop) {
+			case RET:
+				break;
+			case BRANCH: {
+				unsigned t = instr.instr_absolute._address;
+				// Une destination hors du segment de texte est une erreur (refusée par flow())
+				pure = flow(pa, t, must, may);
+				if (pure && instr.instr_generic._regcond != NC)
+					pure = flow(pa, a + 1, must, may);
+				break;
+			}
+			default:
+				pure = flow(pa, a + 1, must, may);
+		}
+	}
+
+	// Entrées : lues avant écriture ; registres écrits sur certains chemins seulement
+	for (unsigned k = 0; k < pa->nvisited; k++) {
+		unsigned a = pa->visited[k];
+		if (pure) {
+			uint32_t reads, writes;
+			effect(pmach->_text[a], psub, &reads, &writes);
+			psub->_inputs |= reads & ~pa->must[a];
+			if (pmach->_text[a].instr_generic._cop == RET) {
+				psub->_inputs |= pa->may[a] & ~pa->must[a];
+				psub->_outputs |= pa->may[a];
+			}
+		}
+		pa->seen[a] = false;
+	}
+	pa->nvisited = pa->nwork = 0;
+
+	return pure && psub->_noffsets + __builtin_popcount(psub->_inputs) <= MEMO_MAXKEY;
+}
+
+Memo *memo_enable(Machine *pmach) {
+	memo_disable(pmach);
+
+	unsigned n = pmach->_textsize;
+	Memo *pm = checked_calloc(sizeof(Memo), "la mémoïsation");
+	pm->_subs = checked_calloc(n * sizeof(Memo_Sub), "la mémoïsation");
+	pm->_at = checked_calloc(n * sizeof(int), "la mémoïsation");
+	pm->_table = checked_calloc(MEMO_SIZE * sizeof(Memo_Entry), "la mémoïsation");
+
+	Analysis an = {
+		.pmach = pmach,
+		.must = checked_calloc(n * sizeof(uint32_t), "la mémoïsation"),
+		.may = checked_calloc(n * sizeof(uint32_t), "la mémoïsation"),
+		.seen = checked_calloc(n * sizeof(bool), "la mémoïsation"),
+		.visited = checked_calloc(n * sizeof(unsigned), "la mémoïsation"),
+		.work = checked_calloc(n * sizeof(unsigned), "la mémoïsation"),
+	};
+	// Un sous-programme pur par adresse d'entrée, -1 pour un sous-programme impur
+	int *sub = checked_calloc(n * sizeof(int), "la mémoïsation");
+	bool *done = checked_calloc(n * sizeof(bool), "la mémoïsation");
+
+	for (unsigned a = 0; a < n; a++) {
+		pm->_at[a] = -1;
+		Instruction instr = pmach->_text[a];
+		unsigned s = instr.instr_absolute._address;
+		if (instr.instr_generic._cop != CALL || instruction_check(instr) != ERR_NOERROR
+		    || s >= n)
+			continue;
+		if (!done[s]) {
+			done[s] = true;
+			sub[s] = analyse(&an, s, &pm->_subs[pm->_nsubs]) ? (int) pm->_nsubs++ : -1;
+		}
+		pm->_at[a] = sub[s];
+	}
+
+	free(an.must);
+	free(an.may);
+	free(an.seen);
+	free(an.visited);
+	free(an.work);
+	free(sub);
+	free(done);
+	pmach->_memo = pm;
+	return pm;
+}
+
+void memo_disable(Machine *pmach) {
+	Memo *pm = pmach->_memo;
+	if (pm == NULL)
+		return;
+	free(pm->_subs);
+	free(pm->_at);
+	free(pm->_table);
+	free(pm);
+	pmach->_memo = NULL;
+}
+
+//! Hachage FNV-1a d'une clé
+static unsigned hash_key(unsigned sub, const Word *key, unsigned n) {
+	uint32_t h = 2166136261u ^ sub;
+	for (unsigned k = 0; k < n; k++)
+		h = (h ^ key[k]) * 16777619u;
+	return h % MEMO_SIZE;
+}
+
+bool memo_call(Machine *pmach, uint64_t limit) {
+	Memo *pm = pmach->_memo;
+	int i = pm->_at[pmach->_pc];
+	if (i < 0)
+		return false;
+	const Memo_Sub *psub = &pm->_subs[i];
+	Instruction instr = pmach->_text[pmach->_pc];
+	if (!condition_holds(instr.instr_generic._regcond, pmach->_cc))
+		return false;
+
+	// L'empilement de l'adresse de retour doit réussir (sinon : erreur normale)
+	Word sp = pmach->_sp;
+	if (sp <= pmach->_dataend || sp >= pmach->_datasize)
+		return false;
+	unsigned ret = pmach->_pc + 1;
+
+	// Clé : mots de pile vus depuis le sous-programme (R15 = sp - 1), puis registres
+	Word key[MEMO_MAXKEY];
+	unsigned n = 0;
+	for (unsigned k = 0; k < psub->_noffsets; k++) {
+		int addr = (int) (sp - 1) + psub->_offsets[k];
+		if (addr < 0 || (unsigned) addr >= pmach->_datasize)
+			return false; // Le sous-programme peut faire une erreur
+		key[n++] = (unsigned) addr == sp ? ret : pmach->_data[addr];
+	}
+	for (unsigned r = 0; r < NREGISTERS; r++)
+		if (psub->_inputs & 1u << r)
+			key[n++] = pmach->_registers[r];
+	if (psub->_inputs & MEMO_CC)
+		key[n++] = pmach->_cc;
+
+	Memo_Entry *pe = &pm->_table[hash_key(i, key, n)];
+	if (pe->_valid && pe->_sub == (unsigned) i && memcmp(pe->_key, key, n * sizeof(Word)) == 0
+	    && limit >= pmach->_icount && pe->_count <= limit - pmach->_icount) {
+		pmach->_data[sp] = ret;
+		for (unsigned r = 0; r < NREGISTERS; r++)
+			if (psub->_outputs & 1u << r)
+				pmach->_registers[r] = pe->_out[r];
+		if (psub->_outputs & MEMO_CC)
+			pmach->_cc = pe->_cc;
+		pmach->_icount += pe->_count;
+		pmach->_pc = ret;
+		pm->_hits++;
+		return true;
+	}
+
+	pm->_pending = true;
+	pm->_psub = i;
+	pm->_pret = ret;
+	pm->_psp = sp;
+	pm->_picount = pmach->_icount;
+	memcpy(pm->_pkey, key, n * sizeof(Word));
+	pm->_misses++;
+	return false;
+}
+
+void memo_return(Machine *pmach) {
+	Memo *pm = pmach->_memo;
+	// R15 ne change pas dans le sous-programme : il ne retrouve sa valeur qu'au retour
+	if (pmach->_sp != pm->_psp)
+		return;
+	pm->_pending = false;
+	if (pmach->_pc != pm->_pret)
+		return;
+
+	const Memo_Sub *psub = &pm->_subs[pm->_psub];
+	unsigned n = psub->_noffsets + __builtin_popcount(psub->_inputs);
+	Memo_Entry *pe = &pm->_table[hash_key(pm->_psub, pm->_pkey, n)];
+	pe->_valid = true;
+	pe->_sub = pm->_psub;
+	memcpy(pe->_key, pm->_pkey, n * sizeof(Word));
+	memcpy(pe->_out, pmach->_registers, sizeof(pe->_out));
+	pe->_cc = pmach->_cc;
+	pe->_count = pmach->_icount - pm->_picount;
+}
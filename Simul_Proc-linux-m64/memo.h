@@ -0,0 +1,124 @@
+#ifndef _MEMO_H_
+#define _MEMO_H_
+
+/*!
+ * \file memo.h
+ * \brief Mémoïsation des sous-programmes purs.
+ *
+ * Un sous-programme (adresse d'un \c CALL) est pur si toutes les instructions
+ * atteignables depuis son entrée sont des \c NOP, \c LOAD, \c ADD, \c SUB
+ * (sans modifier \c R15, opérande immédiat ou indexé par \c R15), des
+ * \c BRANCH et des \c RET. Il ne lit alors que son cadre de pile, n'écrit que
+ * des registres et revient avec le pointeur de pile d'avant l'appel.
+ *
+ * Son effet ne dépend que de la <em>clé</em> : les mots de pile qu'il peut
+ * lire (arguments et adresse de retour) et les registres (code condition
+ * compris) qu'il peut lire avant de les écrire. Il consiste en les registres
+ * qu'il peut écrire, le code condition et le nombre d'instructions exécutées.
+ *
+ * simul() et simul_run() enregistrent cet effet à la fin de chaque appel dans
+ * une table de taille bornée (en correspondance directe : une entrée chasse la
+ * précédente de même hachage). Quand la clé d'un appel y figure, l'appel n'est
+ * pas exécuté : l'adresse de retour est écrite dans la pile comme par \c CALL,
+ * les registres, le code condition et le compteur d'instructions prennent leur
+ * valeur exacte de fin d'appel et l'exécution reprend après le \c CALL.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Nombre maximal de mots d'une clé (au-delà, le sous-programme n'est pas mémoïsé)
+#define MEMO_MAXKEY 16
+
+//! Nombre d'entrées de la table des résultats
+#define MEMO_SIZE 1024
+
+//! Bit du code condition dans les ensembles de registres
+#define MEMO_CC (1u << NREGISTERS)
+
+//! Sous-programme pur
+typedef struct
+{
+    unsigned _addr;		//!< Adresse d'entrée
+    unsigned _noffsets;		//!< Nombre de mots de pile lus
+    int _offsets[MEMO_MAXKEY];	//!< Déplacements lus, relatifs à \c R15 dans le sous-programme
+    uint32_t _inputs;		//!< Registres lus avant d'être écrits (bit \c MEMO_CC : code condition)
+    uint32_t _outputs;		//!< Registres écrits (bit \c MEMO_CC : code condition)
+} Memo_Sub;
+
+//! Résultat d'un appel
+typedef struct
+{
+    bool _valid;		//!< Entrée occupée ?
+    unsigned _sub;		//!< Indice du sous-programme
+    Word _key[MEMO_MAXKEY];	//!< Clé de l'appel
+    Word _out[NREGISTERS];	//!< Valeur finale des registres de \c _outputs
+    Condition_Code _cc;		//!< Code condition final (si \c MEMO_CC est dans \c _outputs)
+    uint64_t _count;		//!< Instructions exécutées, \c CALL et \c RET compris
+} Memo_Entry;
+
+//! Mémoïsation des sous-programmes purs d'un programme
+typedef struct Memo
+{
+    Memo_Sub *_subs;		//!< Sous-programmes purs
+    unsigned _nsubs;		//!< Nombre de sous-programmes purs
+
+    //! Indice dans \c _subs du sous-programme appelé à chaque adresse, -1 sinon
+    /*! Tableau de \c _textsize entiers. */
+    int *_at;
+
+    Memo_Entry *_table;		//!< Résultats (\c MEMO_SIZE entrées)
+
+    // Appel en cours d'enregistrement
+    bool _pending;		//!< Un appel est-il en cours d'enregistrement ?
+    unsigned _psub;		//!< Son sous-programme
+    unsigned _pret;		//!< Son adresse de retour
+    Word _psp;			//!< \c R15 avant l'appel
+    uint64_t _picount;		//!< Compteur d'instructions avant l'appel
+    Word _pkey[MEMO_MAXKEY];	//!< Sa clé
+
+    uint64_t _hits;		//!< Appels évités
+    uint64_t _misses;		//!< Appels exécutés (et enregistrés)
+} Memo;
+
+//! Activation de la mémoïsation
+/*!
+ * Le segment de texte est analysé et le résultat est attaché à la machine
+ * (\c _memo). simul() et simul_run() mémoïsent alors les appels, sauf si des
+ * crochets sont enregistrés (voir hooks.h) ou en mode de mise au point.
+ *
+ * \param pmach la machine (programme chargé)
+ * \return l'analyse, avec une table vide
+ */
+Memo *memo_enable(Machine *pmach);
+
+//! Désactivation de la mémoïsation et libération de la table
+/*!
+ * \param pmach la machine
+ */
+void memo_disable(Machine *pmach);
+
+//! Appel éventuel d'un sous-programme pur à l'adresse \c _pc
+/*!
+ * Si le résultat de l'appel est connu et que le compteur d'instructions ne
+ * dépasse pas \a limit, l'appel est appliqué et \c _pc passe à l'instruction
+ * suivante. Sinon, l'appel (s'il a lieu) sera enregistré à son retour (voir
+ * memo_return()) et doit être exécuté normalement.
+ *
+ * \param pmach la machine (\c _pc est une adresse du segment de texte)
+ * \param limit valeur maximale du compteur d'instructions
+ * \return vrai si l'appel a été appliqué
+ */
+bool memo_call(Machine *pmach, uint64_t limit);
+
+//! Enregistrement de l'appel en cours s'il vient de revenir
+/*!
+ * À appeler après chaque instruction exécutée tant que \c _pending est vrai.
+ *
+ * \param pmach la machine
+ */
+void memo_return(Machine *pmach);
+
+#endif
@@ -0,0 +1,59 @@
+/*!
+ * \file opt_simul.c
+ * \brief Optimisation d'un programme binaire (voir peephole.h)
+ *
+ * Le programme est lu, optimisé puis réécrit au format de read_program().
+ * Le bilan (instructions économisées, par réécriture) est affiché.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+#include "peephole.h"
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: opt_simul [options] in.bin out.bin\n"
+	       "where options are:\n"
+	       "\t-l\tDisplay the optimized program\n"
+	       "\t-h\tprint this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+	bool listing = false;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		switch (argv[iarg][1]) {
+			case 'l':
+				listing = true;
+				break;
+			case 'h':
+				usage();
+				return EXIT_SUCCESS;
+			default:
+				fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+				usage();
+				return EXIT_FAILURE;
+		}
+	}
+	if (iarg + 2 != argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	Machine mach;
+	read_program(&mach, argv[iarg]);
+
+	Peephole_Stats stats;
+	if (!peephole_optimize(&mach, &stats))
+		fprintf(stderr, "opt_simul: a branch target is outside the text segment; program left unchanged\n");
+	peephole_print(&stats, stdout);
+	if (listing)
+		print_program(&mach);
+
+	write_program(&mach, argv[iarg + 1]);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,278 @@
+/***** peephole.c *****/
+#include "peephole.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//! Bornes d'une valeur immédiate (20 bits signés)
+#define IMM_MIN (-(1 << 19))
+#define IMM_MAX ((1 << 19) - 1)
+
+//! Contexte de l'optimisation
+typedef struct
+{
+    Instruction *text;		//!< Segment de texte (adresses d'origine)
+    unsigned n;			//!< Taille d'origine
+    unsigned datasize;		//!< Taille du segment de données
+    bool *dead;			//!< Instructions supprimées
+    bool *target;		//!< Instructions où l'on peut arriver autrement qu'en séquence
+    Peephole_Stats *ps;
+} Peephole;
+
+/*!
+ * \c BRANCH ou \c CALL bien formé (sans erreur \c ERR_IMMEDIATE ni \c ERR_CONDITION).
+ */
+static bool is_jump(Instruction instr) {
+	return (instr.instr_generic._cop == BRANCH || instr.instr_generic._cop == CALL)
+		&& instruction_check(instr) == ERR_NOERROR;
+}
+
+//! \c BRANCH bien formé
+static bool is_branch(Instruction instr) {
+	return instr.instr_generic._cop == BRANCH && is_jump(instr);
+}
+
+//! \c LOAD, \c ADD ou \c SUB immédiat
+static bool is_imm_alu(Instruction instr) {
+	Code_Op cop = instr.instr_generic._cop;
+	return (cop == LOAD || cop == ADD || cop == SUB) && instr.instr_generic._immediate;
+}
+
+/*!
+ * Première instruction conservée à partir de l'adresse \a i (ou \c n).
+ */
+static unsigned next_live(const Peephole *pp, unsigned i) {
+	while (i < pp->n && pp->dead[i])
+		i++;
+	return i;
+}
+
+/*!
+ * Instructions où l'on arrive par un branchement, un retour de
+ * sous-programme ou au lancement.
+ */
+static void find_targets(Peephole *pp) {
+	memset(pp->target, 0, pp->n + 1);
+	pp->target[next_live(pp, 0)] = true;
+	for (unsigned i = 0; i < pp->n; i++) {
+		Instruction instr = pp->text[i];
+		if (pp->dead[i] || !is_jump(instr))
+			continue;
+		unsigned t = instr.instr_absolute._address;
+		if (t < pp->n)
+			pp->target[next_live(pp, t)] = true;
+		if (instr.instr_generic._cop == CALL)
+			pp->target[next_live(pp, i + 1)] = true;
+	}
+}
+
+/*!
+ * Le code condition positionné juste avant l'instruction \a k est-il écrasé
+ * avant d'être lu ou observé (fin du programme, erreur) ?
+ */
+static bool cc_dead(const Peephole *pp, unsigned k) {
+	for (k = next_live(pp, k); k < pp->n; k = next_live(pp, k + 1)) {
+		Instruction instr = pp->text[k];
+		Code_Op cop = instr.instr_generic._cop;
+		bool safe_operand = instr.instr_generic._immediate
+			|| (!instr.instr_generic._indexed && instr.instr_absolute._address < pp->datasize);
+		// DIV et MOD peuvent échouer avant d'écrire le code condition
+		bool sets_cc = cop == LOAD || cop == ADD || cop == SUB || cop == MUL || cop == AND
+			|| cop == OR || cop == XOR || cop == SHL || cop == SHR;
+		if (sets_cc && safe_operand)
+			return true;
+		if (cop == STORE && !instr.instr_generic._immediate && safe_operand)
+			continue;
+		return false;
+	}
+	return false;
+}
+
+/*!
+ * Destination finale d'un branchement, à travers les branchements qui
+ * s'enchaînent à coup sûr (inconditionnels ou de même condition).
+ */
+static unsigned thread(const Peephole *pp, unsigned cond, unsigned t) {
+	for (unsigned steps = 0; steps < pp->n && t < pp->n; steps++) {
+		unsigned k = next_live(pp, t);
+		if (k >= pp->n)
+			break;
+		Instruction next = pp->text[k];
+		unsigned c2 = next.instr_generic._regcond;
+		if (!is_branch(next) || (c2 != NC && c2 != cond) || next.instr_absolute._address == t)
+			break;
+		t = next.instr_absolute._address;
+	}
+	return t;
+}
+
+/*!
+ * Une passe de réécritures.
+ *
+ * \return vrai si le programme a changé
+ */
+static bool pass(Peephole *pp) {
+	bool changed = false;
+	find_targets(pp);
+
+	for (unsigned i = 0; i < pp->n; i++) {
+		if (pp->dead[i])
+			continue;
+		Instruction *pi = &pp->text[i];
+		Code_Op cop = pi->instr_generic._cop;
+		unsigned j = next_live(pp, i + 1);
+		Instruction *pj = j < pp->n ? &pp->text[j] : NULL;
+
+		if (cop == NOP) {
+			pp->dead[i] = true;
+			pp->ps->_nops++;
+			changed = true;
+			continue;
+		}
+
+		if (is_jump(*pi)) {
+			unsigned t = pi->instr_absolute._address;
+			unsigned t2 = thread(pp, pi->instr_generic._regcond, t);
+			if (t2 != t) {
+				pi->instr_absolute._address = t2;
+				pp->ps->_threaded++;
+				changed = true;
+				t = t2;
+			}
+			if (cop == BRANCH && next_live(pp, t) == j) {
+				pp->dead[i] = true;
+				pp->ps->_jumps++;
+				changed = true;
+				continue;
+			}
+		}
+
+		// Fusion de deux opérations immédiates sur le même registre
+		if (pj != NULL && !pp->target[j] && is_imm_alu(*pi) && is_imm_alu(*pj)
+		    && pj->instr_generic._cop != LOAD
+		    && pi->instr_generic._regcond == pj->instr_generic._regcond) {
+			long a = pi->instr_immediate._value, b = pj->instr_immediate._value;
+			if (cop == SUB)
+				a = -a;
+			if (pj->instr_generic._cop == SUB)
+				b = -b;
+			long sum = a + b;
+			if (sum >= IMM_MIN && sum <= IMM_MAX) {
+				pi->instr_generic._cop = cop == LOAD ? LOAD : ADD;
+				pi->instr_immediate._value = sum;
+				pp->dead[j] = true;
+				pp->ps->_merged++;
+				changed = true;
+				continue;
+			}
+		}
+
+		// STORE Rn, x ; LOAD Rn, x : le LOAD ne change que le code condition. Seulement
+		// pour une adresse absolue du segment de données : un port de périphérique
+		// peut refuser la lecture, une adresse indexée sortir du segment
+		if (pj != NULL && !pp->target[j] && cop == STORE && !pi->instr_generic._immediate
+		    && !pi->instr_generic._indexed && pi->instr_absolute._address < pp->datasize
+		    && pj->instr_generic._cop == LOAD && !pj->instr_generic._immediate
+		    && !pj->instr_generic._indexed
+		    && pi->instr_generic._regcond == pj->instr_generic._regcond
+		    && pi->instr_absolute._address == pj->instr_absolute._address
+		    && cc_dead(pp, j + 1)) {
+			pp->dead[j] = true;
+			pp->ps->_loads++;
+			changed = true;
+			continue;
+		}
+
+		// Code inaccessible après un transfert inconditionnel
+		if ((is_branch(*pi) && pi->instr_generic._regcond == NC) || cop == RET || cop == HALT)
+			for (; j < pp->n && !pp->target[j]; j = next_live(pp, j + 1)) {
+				pp->dead[j] = true;
+				if (pp->text[j].instr_generic._cop == NOP)
+					pp->ps->_nops++;
+				else
+					pp->ps->_dead++;
+				changed = true;
+			}
+	}
+	return changed;
+}
+
+bool peephole_optimize(Machine *pmach, Peephole_Stats *pstats) {
+	memset(pstats, 0, sizeof(*pstats));
+	unsigned n = pmach->_textsize;
+	pstats->_before = pstats->_after = n;
+
+	for (unsigned i = 0; i < n; i++)
+		if (is_jump(pmach->_text[i]) && pmach->_text[i].instr_absolute._address >= n)
+			return false;
+
+	Peephole pp = {
+		.text = pmach->_text,
+		.n = n,
+		.datasize = pmach->_datasize,
+		.dead = checked_calloc(n + 1, "l'optimiseur"),
+		.target = checked_calloc(n + 1, "l'optimiseur"),
+		.ps = pstats,
+	};
+	while (pass(&pp))
+		;
+
+	// Une destination suivie seulement d'instructions supprimées deviendrait la
+	// fin du segment, où le branchement échoue avant tout effet (ERR_SEGTEXT) :
+	// un NOP est gardé à la première, vers lequel vont toutes ces destinations,
+	// pour que l'exécution sorte du texte en séquence
+	unsigned keep = n;
+	for (unsigned i = 0; i < n; i++) {
+		Instruction instr = pmach->_text[i];
+		unsigned t = instr.instr_absolute._address;
+		if (!pp.dead[i] && is_jump(instr) && t < keep && next_live(&pp, t) == n)
+			keep = t;
+	}
+	if (keep < n) {
+		static const Instruction nop = {.instr_generic = {._cop = NOP}};
+		if (pmach->_text[keep].instr_generic._cop == NOP)
+			pstats->_nops--;
+		else
+			pstats->_jumps--;
+		pmach->_text[keep] = nop;
+		pp.dead[keep] = false;
+	}
+
+	// Nouvelles adresses : une instruction supprimée est remplacée par la suivante
+	unsigned *map = checked_calloc((n + 1) * sizeof(unsigned), "l'optimiseur");
+	unsigned live = 0;
+	for (unsigned i = 0; i <= n; i++) {
+		map[i] = live;
+		if (i < n && !pp.dead[i])
+			live++;
+	}
+	for (unsigned i = 0; i < n; i++) {
+		Instruction *pi = &pmach->_text[i];
+		if (pp.dead[i] || !is_jump(*pi))
+			continue;
+		unsigned t = pi->instr_absolute._address;
+		pi->instr_absolute._address = next_live(&pp, t) == n ? map[keep] : map[t];
+	}
+	for (unsigned i = 0; i < n; i++)
+		if (!pp.dead[i])
+			pmach->_text[map[i]] = pmach->_text[i];
+	pmach->_textsize = live;
+	pstats->_after = live;
+
+	free(map);
+	free(pp.dead);
+	free(pp.target);
+	return true;
+}
+
+void peephole_print(const Peephole_Stats *pstats, FILE *out) {
+	fprintf(out, "\n*** PEEPHOLE (%u -> %u instructions, %u saved) ***\n",
+		pstats->_before, pstats->_after, pstats->_before - pstats->_after);
+	fprintf(out, "NOP removed:              %u\n", pstats->_nops);
+	fprintf(out, "Immediate pairs merged:   %u\n", pstats->_merged);
+	fprintf(out, "Reloads after store:      %u\n", pstats->_loads);
+	fprintf(out, "Branches threaded:        %u\n", pstats->_threaded);
+	fprintf(out, "Jumps to next removed:    %u\n", pstats->_jumps);
+	fprintf(out, "Unreachable removed:      %u\n", pstats->_dead);
+}
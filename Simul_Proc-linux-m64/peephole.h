@@ -0,0 +1,71 @@
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+/*!
+ * \file peephole.h
+ * \brief Optimisation « à lucarne » des programmes binaires.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "machine.h"
+
+//! Bilan de l'optimisation
+typedef struct
+{
+    unsigned _before;		//!< Nombre d'instructions avant
+    unsigned _after;		//!< Nombre d'instructions après
+    unsigned _nops;		//!< \c NOP supprimés
+    unsigned _merged;		//!< Paires \c LOAD/ADD/SUB immédiats fusionnées
+    unsigned _loads;		//!< \c LOAD d'une valeur qui vient d'être rangée supprimés
+    unsigned _threaded;		//!< Branchements vers un branchement redirigés
+    unsigned _jumps;		//!< Branchements vers l'instruction suivante supprimés
+    unsigned _dead;		//!< Instructions inaccessibles supprimées
+} Peephole_Stats;
+
+//! Optimisation du segment de texte d'un programme
+/*!
+ * Réécritures appliquées jusqu'à stabilité :
+ *
+ *   - suppression des \c NOP ;
+ *
+ *   - fusion de \c LOAD/ADD/SUB \c Rn, \c #a suivi de \c ADD/SUB \c Rn, \c #b
+ *   (le code condition final est le même) ;
+ *
+ *   - suppression d'un \c LOAD \c Rn qui suit un \c STORE \c Rn à la même
+ *   adresse absolue du segment de données (pas un port de périphérique, ni
+ *   une adresse indexée), si le code condition qu'il positionne est écrasé
+ *   avant d'être lu ;
+ *
+ *   - enfilage des branchements : un \c BRANCH ou \c CALL vers un \c BRANCH
+ *   inconditionnel, ou de même condition, va directement à sa destination ;
+ *
+ *   - suppression des branchements vers l'instruction suivante et des
+ *   instructions inaccessibles (après \c BRANCH \c NC, \c RET ou \c HALT).
+ *
+ * Aucune réécriture ne touche une instruction destination d'un branchement ou
+ * de retour de sous-programme là où cela changerait l'effet d'y arriver.
+ * Le segment de texte est ensuite compacté et toutes les destinations de
+ * \c BRANCH et \c CALL sont recalculées. Les adresses de retour n'étant
+ * produites que par \c CALL, le programme se comporte comme avant (registres,
+ * code condition, données hors pile), en moins d'instructions.
+ *
+ * Le programme est laissé tel quel si une destination de branchement est
+ * hors du segment de texte (le branchement provoquerait \c ERR_SEGTEXT avant
+ * comme après, mais pas forcément après le même nombre d'instructions).
+ *
+ * \param pmach la machine (programme chargé) ; \c _text et \c _textsize sont modifiés
+ * \param pstats le bilan
+ * \return faux si le programme a été laissé tel quel
+ */
+bool peephole_optimize(Machine *pmach, Peephole_Stats *pstats);
+
+//! Affichage du bilan de l'optimisation
+/*!
+ * \param pstats le bilan
+ * \param out le flot de sortie
+ */
+void peephole_print(const Peephole_Stats *pstats, FILE *out);
+
+#endif
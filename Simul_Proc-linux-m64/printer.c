@@ -0,0 +1,290 @@
+/***** printer.c *****/
+#include "printer.h"
+#include "error.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+//! Place libre garantie au début de chaque ligne (annotation comprise)
+#define PRINT_LINE 512
+
+//! Chiffres hexadécimaux
+static const char hex_digits[] = "0123456789abcdef";
+
+//! Noms des codes condition
+static const char cc_names[] = "UZPN";
+
+//! Début d'une ligne : le tampon est écrit s'il est plein, agrandi s'il le faut
+static void pbuf_line(Print_Buffer *pb) {
+	if (pb->_len >= PRINT_FLUSH)
+		pbuf_flush(pb);
+	if (pb->_max - pb->_len < PRINT_LINE) {
+		size_t max = pb->_max == 0 ? PRINT_FLUSH + PRINT_LINE : pb->_max * 2;
+		pb->_buf = checked_realloc(pb->_buf, max, "l'affichage");
+		pb->_max = max;
+	}
+}
+
+void pbuf_printf(Print_Buffer *pb, const char *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	int n = vsnprintf(pb->_buf + pb->_len, pb->_max - pb->_len, fmt, ap);
+	va_end(ap);
+	if (n >= 0 && (size_t) n >= pb->_max - pb->_len) {
+		// Texte plus long que la place libre : agrandissement puis nouvel essai
+		size_t max = pb->_len + n + PRINT_LINE;
+		pb->_buf = checked_realloc(pb->_buf, max, "l'affichage");
+		pb->_max = max;
+		va_start(ap, fmt);
+		n = vsnprintf(pb->_buf + pb->_len, pb->_max - pb->_len, fmt, ap);
+		va_end(ap);
+	}
+	if (n > 0)
+		pb->_len += n;
+}
+
+void pbuf_flush(Print_Buffer *pb) {
+	fflush(stdout); // Ce qui a été écrit par stdio passe avant
+	size_t done = 0;
+	while (done < pb->_len) {
+		ssize_t n = write(STDOUT_FILENO, pb->_buf + done, pb->_len - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break; // Sortie fermée : comme printf(), on n'insiste pas
+		done += n;
+	}
+	pb->_len = 0;
+}
+
+void pbuf_close(Print_Buffer *pb) {
+	pbuf_flush(pb);
+	free(pb->_buf);
+	pb->_buf = NULL;
+	pb->_max = 0;
+}
+
+//! Ajout de caractères (la place est garantie par pbuf_line())
+static void pbuf_put(Print_Buffer *pb, const char *s, size_t n) {
+	memcpy(pb->_buf + pb->_len, s, n);
+	pb->_len += n;
+}
+
+//! Ajout d'un mot en hexadécimal, sur \a digits chiffres
+static void pbuf_hex(Print_Buffer *pb, uint32_t value, unsigned digits) {
+	char *p = pb->_buf + pb->_len;
+	for (unsigned i = digits; i-- > 0; value >>= 4)
+		p[i] = hex_digits[value & 0xf];
+	pb->_len += digits;
+}
+
+//! Ajout d'un entier signé en décimal (comme "%d")
+static void pbuf_int(Print_Buffer *pb, int32_t value) {
+	char tmp[12];
+	unsigned n = 0;
+	uint32_t u = value < 0 ? 0u - (uint32_t) value : (uint32_t) value;
+	do {
+		tmp[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (value < 0)
+		tmp[n++] = '-';
+	char *p = pb->_buf + pb->_len;
+	for (unsigned i = 0; i < n; i++)
+		p[i] = tmp[n - 1 - i];
+	pb->_len += n;
+}
+
+//! Ajout d'une adresse au format "0x%04x" (plus de chiffres si nécessaire)
+static void pbuf_addr(Print_Buffer *pb, unsigned addr) {
+	unsigned digits = 4;
+	while (digits < 8 && (addr >> (4 * digits)) != 0)
+		digits++;
+	pbuf_put(pb, "0x", 2);
+	pbuf_hex(pb, addr, digits);
+}
+
+//! Affichage d'une ligne de \a n mots à partir de l'adresse \a addr
+typedef void Print_Row(Print_Buffer *pb, Machine *pmach, unsigned addr, unsigned n,
+                       unsigned flags, Annotation *annotate, void *ctx);
+
+//! Les \a n mots à partir de l'adresse \a addr sont-ils nuls ?
+typedef bool Zero_Row(Machine *pmach, unsigned addr, unsigned n);
+
+/*!
+ * Affichage des lignes d'une plage d'adresses, séparées par des fins de
+ * ligne, avec élision des lignes nulles consécutives si \c PRINT_ELIDE.
+ *
+ * \return le nombre de lignes (marques d'élision comprises)
+ */
+static unsigned print_rows(Print_Buffer *pb, Machine *pmach, unsigned from, unsigned to,
+                           unsigned per, unsigned flags, Zero_Row *zero, Print_Row *row,
+                           Annotation *annotate, void *ctx) {
+	unsigned lines = 0, skipped = 0;
+	bool prev_zero = false;
+	for (unsigned addr = from; addr < to; addr += per) {
+		unsigned n = to - addr < per ? to - addr : per;
+		bool is_zero = (flags & PRINT_ELIDE) && zero(pmach, addr, n);
+		if (is_zero && prev_zero) {
+			skipped += n;
+			continue;
+		}
+		pbuf_line(pb);
+		if (skipped != 0) {
+			pbuf_printf(pb, "%s*\t(%u zero words)", lines > 0 ? "\n" : "", skipped);
+			lines++;
+			skipped = 0;
+			pbuf_line(pb);
+		}
+		prev_zero = is_zero;
+		if (lines > 0)
+			pbuf_put(pb, "\n", 1);
+		row(pb, pmach, addr, n, flags, annotate, ctx);
+		lines++;
+	}
+	if (skipped != 0) {
+		pbuf_line(pb);
+		pbuf_printf(pb, "%s*\t(%u zero words)", lines > 0 ? "\n" : "", skipped);
+		lines++;
+	}
+	return lines;
+}
+
+//! En-tête d'un affichage : plage précisée si elle n'est pas tout le segment
+static void print_header(Print_Buffer *pb, const char *title, unsigned from, unsigned to,
+                         unsigned size) {
+	pbuf_printf(pb, "\n*** %s", title);
+	if (from != 0 || to != size)
+		pbuf_printf(pb, " [0x%04x, 0x%04x)", from, to);
+	pbuf_printf(pb, " ***\n");
+}
+
+//! Bornage d'une plage à la taille d'un segment
+static void clamp_range(unsigned *pfrom, unsigned *pto, unsigned size) {
+	if (*pto > size)
+		*pto = size;
+	if (*pfrom > *pto)
+		*pfrom = *pto;
+}
+
+static bool zero_text(Machine *pmach, unsigned addr, unsigned n) {
+	for (unsigned i = 0; i < n; i++)
+		if (pmach->_text[addr + i]._raw != 0)
+			return false;
+	return true;
+}
+
+static void text_row(Print_Buffer *pb, Machine *pmach, unsigned addr, unsigned n,
+                     unsigned flags, Annotation *annotate, void *ctx) {
+	if (flags & PRINT_HEX) {
+		pbuf_addr(pb, addr);
+		pbuf_put(pb, ":", 1);
+		for (unsigned i = 0; i < n; i++) {
+			pbuf_put(pb, " ", 1);
+			pbuf_hex(pb, pmach->_text[addr + i]._raw, 8);
+		}
+		return;
+	}
+	if (annotate != NULL)
+		annotate(ctx, addr, pb); // Préfixe de la ligne (couverture...)
+	pbuf_line(pb);
+	pbuf_addr(pb, addr);
+	pbuf_put(pb, ": 0x", 4);
+	pbuf_hex(pb, pmach->_text[addr]._raw, 8);
+	pbuf_put(pb, "\t ", 2);
+	pb->_len += format_instruction(pb->_buf + pb->_len, pmach->_text[addr]);
+}
+
+void print_program_range(Machine *pmach, unsigned from, unsigned to, unsigned flags,
+                         Annotation *annotate, void *ctx) {
+	Print_Buffer pb = {NULL, 0, 0};
+	clamp_range(&from, &to, pmach->_textsize);
+	pbuf_line(&pb);
+	char title[64];
+	snprintf(title, sizeof(title), "PROGRAM (size: %d)", pmach->_textsize);
+	print_header(&pb, title, from, to, pmach->_textsize);
+	if (print_rows(&pb, pmach, from, to, flags & PRINT_HEX ? 8 : 1, flags,
+	               zero_text, text_row, annotate, ctx) > 0)
+		pbuf_put(&pb, "\n", 1);
+	pbuf_close(&pb);
+}
+
+void print_program_annotated(Machine *pmach, Annotation *annotate, void *ctx) {
+	print_program_range(pmach, 0, pmach->_textsize, 0, annotate, ctx);
+}
+
+static bool zero_data(Machine *pmach, unsigned addr, unsigned n) {
+	for (unsigned i = 0; i < n; i++)
+		if (pmach->_data[addr + i] != 0)
+			return false;
+	return true;
+}
+
+static void data_row(Print_Buffer *pb, Machine *pmach, unsigned addr, unsigned n,
+                     unsigned flags, Annotation *annotate, void *ctx) {
+	if (flags & PRINT_HEX) {
+		pbuf_addr(pb, addr);
+		pbuf_put(pb, ":", 1);
+		for (unsigned i = 0; i < n; i++) {
+			pbuf_put(pb, " ", 1);
+			pbuf_hex(pb, pmach->_data[addr + i], 8);
+		}
+		return;
+	}
+	for (unsigned i = 0; i < n; i++) {
+		Word w = pmach->_data[addr + i];
+		pbuf_addr(pb, addr + i);
+		pbuf_put(pb, ": 0x", 4);
+		pbuf_hex(pb, w, 8);
+		pbuf_put(pb, " ", 1);
+		pbuf_int(pb, (int32_t) w);
+		pbuf_put(pb, "\t", 1);
+	}
+}
+
+void print_data_range(Machine *pmach, unsigned from, unsigned to, unsigned flags) {
+	Print_Buffer pb = {NULL, 0, 0};
+	clamp_range(&from, &to, pmach->_datasize);
+	pbuf_line(&pb);
+	char title[96];
+	snprintf(title, sizeof(title), "DATA (size: %d, end = 0x%08x (%d))",
+		 pmach->_datasize, pmach->_dataend, pmach->_dataend);
+	print_header(&pb, title, from, to, pmach->_datasize);
+	print_rows(&pb, pmach, from, to, flags & PRINT_HEX ? 8 : 3, flags,
+		   zero_data, data_row, NULL, NULL);
+	pbuf_line(&pb);
+	pbuf_put(&pb, "\n", 1);
+	pbuf_close(&pb);
+}
+
+void print_cpu_flags(Machine *pmach, unsigned flags) {
+	if (pmach->_cc > LAST_CC) {
+		printf("Erreur code condition dans la fonction print_cpu\n");
+		exit(1);
+	}
+	Print_Buffer pb = {NULL, 0, 0};
+	pbuf_line(&pb);
+	pbuf_printf(&pb, "\n*** CPU ***\nPC:  0x%08x\tCC: %c\n\n", pmach->_pc, cc_names[pmach->_cc]);
+	for (unsigned i = 0; i < NREGISTERS; i++) {
+		pbuf_line(&pb);
+		if (flags & PRINT_HEX) {
+			pbuf_put(&pb, i % 8 == 0 ? "R" : " R", i % 8 == 0 ? 1 : 2);
+			pbuf_printf(&pb, "%02u=", i);
+			pbuf_hex(&pb, pmach->_registers[i], 8);
+			if (i % 8 == 7)
+				pbuf_put(&pb, "\n", 1);
+		}
+		else {
+			pbuf_printf(&pb, "R%02u: 0x", i);
+			pbuf_hex(&pb, pmach->_registers[i], 8);
+			pbuf_put(&pb, "\t", 1);
+			pbuf_int(&pb, (int32_t) pmach->_registers[i]);
+			pbuf_put(&pb, i % 3 == 2 ? "\t\n" : "\t", i % 3 == 2 ? 2 : 1);
+		}
+	}
+	pbuf_put(&pb, "\n", 1);
+	pbuf_close(&pb);
+}
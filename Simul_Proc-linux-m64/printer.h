@@ -0,0 +1,107 @@
+#ifndef _PRINTER_H_
+#define _PRINTER_H_
+
+/*!
+ * \file printer.h
+ * \brief Affichage tamponné de l'état de la machine (listing, données, registres).
+ *
+ * Les affichages sont formatés dans un tampon en mémoire, sans passer par
+ * \c stdio, puis écrits sur la sortie standard par un seul appel système
+ * write() (la sortie \c stdio est vidée avant, pour garder l'ordre). Un
+ * tampon qui dépasse \c PRINT_FLUSH octets est écrit avant de continuer :
+ * un très grand segment de données s'affiche ainsi par morceaux de cette
+ * taille, et non mot à mot.
+ *
+ * Les affichages peuvent se limiter à une plage d'adresses, remplacer les
+ * suites de lignes nulles par une marque d'élision (\c PRINT_ELIDE) et se
+ * réduire aux mots en hexadécimal (\c PRINT_HEX). Sans option et sur tout le
+ * segment, ils sont identiques à ceux de print_program(), print_data() et
+ * print_cpu(), qui les utilisent.
+ */
+
+#include <stddef.h>
+
+#include "machine.h"
+
+//! Taille au-delà de laquelle le tampon est écrit en cours d'affichage
+#define PRINT_FLUSH (1u << 22)
+
+//! Options d'affichage, à combiner par \c |
+enum
+{
+    PRINT_ELIDE = 1,	//!< Les lignes nulles consécutives sont remplacées par une marque « * »
+    PRINT_HEX = 2,	//!< Format compact : mots en hexadécimal seulement, 8 par ligne
+};
+
+//! Tampon d'affichage
+typedef struct
+{
+    char *_buf;		//!< Contenu
+    size_t _len;	//!< Nombre d'octets écrits dans le tampon
+    size_t _max;	//!< Taille allouée
+} Print_Buffer;
+
+//! Ajout d'un texte formaté au tampon (comme printf())
+void pbuf_printf(Print_Buffer *pb, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+//! Écriture du tampon sur la sortie standard ; le tampon est vidé mais reste alloué
+void pbuf_flush(Print_Buffer *pb);
+
+//! Écriture puis libération du tampon
+void pbuf_close(Print_Buffer *pb);
+
+//! Annotation d'une ligne du listing : écrit dans \a pb un préfixe pour l'adresse \a addr
+typedef void Annotation(void *ctx, unsigned addr, Print_Buffer *pb);
+
+//! Affichage d'une partie du programme
+/*!
+ * Les instructions d'adresses \a from à \a to (exclue) sont affichées sous
+ * forme symbolique, précédées de leur adresse et de leur code ; en
+ * hexadécimal seulement avec \c PRINT_HEX. Avec \c PRINT_ELIDE, seule la
+ * première ligne d'une suite de lignes de mots nuls est affichée, suivie de
+ * la marque d'élision.
+ *
+ * \param pmach la machine
+ * \param from première adresse affichée
+ * \param to fin de la plage (bornée par la taille du segment de texte)
+ * \param flags options d'affichage
+ * \param annotate préfixe de chaque ligne (NULL : aucun ; ignoré avec \c PRINT_HEX)
+ * \param ctx contexte passé à \a annotate
+ */
+void print_program_range(Machine *pmach, unsigned from, unsigned to, unsigned flags,
+                         Annotation *annotate, void *ctx);
+
+//! Affichage des instructions du programme, chaque ligne précédée d'une annotation
+/*!
+ * Même affichage que print_program(), dont chaque ligne commence par ce
+ * qu'écrit \a annotate.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param annotate la fonction d'annotation (NULL : aucune)
+ * \param ctx contexte passé à \a annotate
+ */
+void print_program_annotated(Machine *pmach, Annotation *annotate, void *ctx);
+
+//! Affichage d'une partie du segment de données
+/*!
+ * Les mots d'adresses \a from à \a to (exclue) sont affichés en hexadécimal
+ * et en décimal, 3 par ligne ; en hexadécimal seulement, 8 par ligne, avec
+ * \c PRINT_HEX. Avec \c PRINT_ELIDE, seule la première ligne d'une suite de
+ * lignes nulles est affichée, suivie de la marque d'élision.
+ *
+ * \param pmach la machine
+ * \param from première adresse affichée
+ * \param to fin de la plage (bornée par la taille du segment de données)
+ * \param flags options d'affichage
+ */
+void print_data_range(Machine *pmach, unsigned from, unsigned to, unsigned flags);
+
+//! Affichage du compteur ordinal, du code condition et des registres
+/*!
+ * \param pmach la machine
+ * \param flags \c PRINT_HEX : registres en hexadécimal seulement, 8 par ligne
+ */
+void print_cpu_flags(Machine *pmach, unsigned flags);
+
+#endif
@@ -0,0 +1,196 @@
+/***** profile.c *****/
+#include "profile.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+/*!
+ * Ajoute un nœud à l'arbre des contextes d'appel.
+ *
+ * \param prof le profileur
+ * \param parent indice du nœud appelant
+ * \param addr adresse d'entrée de l'appelé
+ * \return l'indice du nouveau nœud
+ */
+static unsigned new_node(Profile *prof, unsigned parent, unsigned addr) {
+	if (prof->_nnodes == prof->_maxnodes) {
+		prof->_maxnodes *= 2;
+		prof->_nodes = checked_realloc(prof->_nodes, prof->_maxnodes * sizeof(Profile_Node), "le profileur");
+	}
+	unsigned n = prof->_nnodes++;
+	Profile_Node *pnode = &prof->_nodes[n];
+	pnode->_addr = addr;
+	pnode->_parent = parent;
+	pnode->_child = 0;
+	pnode->_sibling = 0;
+	pnode->_self = 0;
+	if (n != 0) {
+		pnode->_sibling = prof->_nodes[parent]._child;
+		prof->_nodes[parent]._child = n;
+	}
+	return n;
+}
+
+/*!
+ * Attribue au cadre courant les instructions exécutées depuis le dernier
+ * changement de cadre.
+ *
+ * \param prof le profileur
+ * \param icount nombre d'instructions exécutées
+ */
+static void attribute(Profile *prof, uint64_t icount) {
+	Profile_Node *pnode = &prof->_nodes[prof->_stack[prof->_depth]._node];
+	uint64_t delta = icount - prof->_mark;
+	pnode->_self += delta;
+	if (pnode->_addr < prof->_textsize)
+		prof->_entries[pnode->_addr]._exclusive += delta;
+	prof->_mark = icount;
+}
+
+/*!
+ * Dépile le cadre courant et met à jour le coût inclusif de l'appelé. En cas
+ * de récursion, seule l'activation la plus externe compte.
+ *
+ * \param prof le profileur
+ * \param icount nombre d'instructions exécutées
+ */
+static void pop_frame(Profile *prof, uint64_t icount) {
+	Profile_Frame *pframe = &prof->_stack[prof->_depth];
+	unsigned addr = prof->_nodes[pframe->_node]._addr;
+	if (addr < prof->_textsize) {
+		Profile_Entry *pentry = &prof->_entries[addr];
+		if (--pentry->_active == 0)
+			pentry->_inclusive += icount - pframe->_start;
+	}
+	prof->_depth--;
+}
+
+Profile *profile_new(unsigned textsize) {
+	Profile *prof = checked_realloc(NULL, sizeof(Profile), "le profileur");
+	prof->_textsize = textsize;
+	prof->_entries = checked_calloc(textsize * sizeof(Profile_Entry), "le profileur");
+
+	prof->_maxnodes = 64;
+	prof->_nnodes = 0;
+	prof->_nodes = checked_realloc(NULL, prof->_maxnodes * sizeof(Profile_Node), "le profileur");
+
+	prof->_maxdepth = 64;
+	prof->_stack = checked_realloc(NULL, prof->_maxdepth * sizeof(Profile_Frame), "le profileur");
+
+	// La racine : le programme principal, actif depuis le début
+	prof->_depth = 0;
+	prof->_stack[0]._node = new_node(prof, 0, 0);
+	prof->_stack[0]._start = 0;
+	prof->_mark = 0;
+	if (textsize > 0) {
+		prof->_entries[0]._calls = 1;
+		prof->_entries[0]._active = 1;
+	}
+	return prof;
+}
+
+/*!
+ * Crochet \c CALL : \a to est l'adresse du sous-programme appelé.
+ */
+static void hook_call(void *ctx, Machine *pmach, unsigned from, unsigned to) {
+	profile_call(ctx, to, pmach->_icount);
+}
+
+/*!
+ * Crochet \c RET.
+ */
+static void hook_ret(void *ctx, Machine *pmach, unsigned from, unsigned to) {
+	profile_ret(ctx, pmach->_icount);
+}
+
+void profile_attach(Profile *prof, Machine *pmach) {
+	prof->_hooks = (Hooks) {._ctx = prof, ._call = hook_call, ._ret = hook_ret};
+	hooks_add(pmach, &prof->_hooks);
+}
+
+void profile_detach(Profile *prof, Machine *pmach) {
+	hooks_remove(pmach, &prof->_hooks);
+}
+
+void profile_free(Profile *prof) {
+	if (prof == NULL)
+		return;
+	free(prof->_entries);
+	free(prof->_nodes);
+	free(prof->_stack);
+	free(prof);
+}
+
+void profile_call(Profile *prof, unsigned addr, uint64_t icount) {
+	attribute(prof, icount);
+
+	// Recherche (ou création) du contexte appelant -> appelé
+	unsigned parent = prof->_stack[prof->_depth]._node;
+	unsigned n = prof->_nodes[parent]._child;
+	while (n != 0 && prof->_nodes[n]._addr != addr)
+		n = prof->_nodes[n]._sibling;
+	if (n == 0)
+		n = new_node(prof, parent, addr);
+
+	if (++prof->_depth == prof->_maxdepth) {
+		prof->_maxdepth *= 2;
+		prof->_stack = checked_realloc(prof->_stack, prof->_maxdepth * sizeof(Profile_Frame), "le profileur");
+	}
+	prof->_stack[prof->_depth]._node = n;
+	prof->_stack[prof->_depth]._start = icount;
+
+	if (addr < prof->_textsize) {
+		prof->_entries[addr]._calls++;
+		prof->_entries[addr]._active++;
+	}
+}
+
+void profile_ret(Profile *prof, uint64_t icount) {
+	if (prof->_depth == 0)
+		return;
+	attribute(prof, icount);
+	pop_frame(prof, icount);
+}
+
+void profile_finish(Profile *prof, uint64_t icount) {
+	attribute(prof, icount);
+	while (prof->_depth > 0)
+		pop_frame(prof, icount);
+	if (prof->_textsize > 0 && prof->_entries[0]._active > 0) {
+		prof->_entries[0]._active = 0;
+		prof->_entries[0]._inclusive += icount - prof->_stack[0]._start;
+	}
+}
+
+void profile_write_folded(Profile *prof, FILE *out) {
+	unsigned *path = checked_realloc(NULL, prof->_nnodes * sizeof(unsigned), "le profileur");
+	for (unsigned n = 0; n < prof->_nnodes; n++) {
+		if (prof->_nodes[n]._self == 0)
+			continue;
+		// On remonte jusqu'à la racine puis on écrit le chemin à l'endroit
+		unsigned len = 0;
+		for (unsigned m = n; m != 0; m = prof->_nodes[m]._parent)
+			path[len++] = m;
+		fprintf(out, "@0x%04x", prof->_nodes[0]._addr);
+		while (len > 0)
+			fprintf(out, ";@0x%04x", prof->_nodes[path[--len]]._addr);
+		fprintf(out, " %" PRIu64 "\n", prof->_nodes[n]._self);
+	}
+	free(path);
+}
+
+void profile_print(Profile *prof, FILE *out) {
+	uint64_t total = prof->_textsize > 0 ? prof->_entries[0]._inclusive : 0;
+	fprintf(out, "\n*** PROFILE (instructions: %" PRIu64 ") ***\n", total);
+	fprintf(out, "Address   Calls       Inclusive          Exclusive\n");
+	for (unsigned addr = 0; addr < prof->_textsize; addr++) {
+		Profile_Entry *pentry = &prof->_entries[addr];
+		if (pentry->_calls == 0)
+			continue;
+		fprintf(out, "0x%04x  %8" PRIu64 "  %10" PRIu64 " %5.1f%%  %10" PRIu64 " %5.1f%%\n",
+			addr, pentry->_calls,
+			pentry->_inclusive, total ? 100.0 * pentry->_inclusive / total : 0.0,
+			pentry->_exclusive, total ? 100.0 * pentry->_exclusive / total : 0.0);
+	}
+}
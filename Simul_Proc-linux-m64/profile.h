@@ -0,0 +1,144 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*!
+ * \file profile.h
+ * \brief Profilage par graphe d'appel des programmes simulés.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hooks.h"
+
+//! Statistiques d'un sous-programme (indexées par son adresse d'entrée)
+typedef struct
+{
+    uint64_t _calls;		//!< Nombre d'appels (\c CALL effectifs)
+    uint64_t _inclusive;	//!< Instructions exécutées dans le sous-programme et ses appelés
+    uint64_t _exclusive;	//!< Instructions exécutées dans le sous-programme lui-même
+    unsigned _active;		//!< Nombre d'activations en cours (récursion)
+} Profile_Entry;
+
+//! Nœud de l'arbre des contextes d'appel
+typedef struct
+{
+    unsigned _addr;		//!< Adresse d'entrée de l'appelé
+    unsigned _parent;		//!< Indice du nœud appelant
+    unsigned _child;		//!< Premier appelé (0 si aucun)
+    unsigned _sibling;		//!< Appelé suivant du même appelant (0 si aucun)
+    uint64_t _self;		//!< Instructions exécutées dans ce contexte exactement
+} Profile_Node;
+
+//! Cadre de la pile d'appel fantôme
+typedef struct
+{
+    unsigned _node;		//!< Nœud de l'arbre des contextes
+    uint64_t _start;		//!< Nombre d'instructions au moment de l'appel
+} Profile_Frame;
+
+//! Profileur par graphe d'appel
+/*!
+ * Le profileur maintient une pile d'appel fantôme mise à jour à chaque \c CALL
+ * effectif et à chaque \c RET. Aucun travail n'est fait pour les autres
+ * instructions : la machine compte ses instructions (\c _icount) et le
+ * profileur attribue les écarts de ce compteur au cadre courant lors des
+ * changements de cadre.
+ *
+ * Le nœud 0 de l'arbre des contextes est la racine (point d'entrée du
+ * programme, adresse 0).
+ */
+typedef struct Profile
+{
+    unsigned _textsize;		//!< Taille du segment de texte profilé
+    Profile_Entry *_entries;	//!< Statistiques par adresse d'entrée (\c _textsize)
+
+    Profile_Node *_nodes;	//!< Arbre des contextes d'appel
+    unsigned _nnodes;		//!< Nombre de nœuds utilisés
+    unsigned _maxnodes;		//!< Nombre de nœuds alloués
+
+    Profile_Frame *_stack;	//!< Pile d'appel fantôme
+    unsigned _depth;		//!< Profondeur courante (le cadre 0 est la racine)
+    unsigned _maxdepth;		//!< Nombre de cadres alloués
+
+    uint64_t _mark;		//!< Compteur d'instructions lors du dernier changement de cadre
+
+    Hooks _hooks;		//!< Crochets \c CALL et \c RET (voir profile_attach())
+} Profile;
+
+//! Création d'un profileur pour un segment de texte de taille donnée
+/*!
+ * \param textsize taille du segment de texte
+ * \return le profileur (à libérer par profile_free())
+ */
+Profile *profile_new(unsigned textsize);
+
+//! Destruction d'un profileur
+/*!
+ * \param prof le profileur
+ */
+void profile_free(Profile *prof);
+
+//! Attachement du profileur à une machine
+/*!
+ * Le profileur enregistre ses crochets \c CALL et \c RET dans la machine :
+ * profile_call() et profile_ret() sont alors appelés à chaque appel et retour.
+ *
+ * \param prof le profileur
+ * \param pmach la machine profilée
+ */
+void profile_attach(Profile *prof, Machine *pmach);
+
+//! Détachement du profileur (avant profile_free())
+/*!
+ * \param prof le profileur
+ * \param pmach la machine profilée
+ */
+void profile_detach(Profile *prof, Machine *pmach);
+
+//! Notification d'un appel de sous-programme
+/*!
+ * \param prof le profileur
+ * \param addr adresse du sous-programme appelé
+ * \param icount nombre d'instructions exécutées (y compris le \c CALL)
+ */
+void profile_call(Profile *prof, unsigned addr, uint64_t icount);
+
+//! Notification d'un retour de sous-programme
+/*!
+ * Un \c RET sans appel correspondant (pile fantôme vide) est ignoré.
+ *
+ * \param prof le profileur
+ * \param icount nombre d'instructions exécutées (y compris le \c RET)
+ */
+void profile_ret(Profile *prof, uint64_t icount);
+
+//! Clôture du profil en fin d'exécution
+/*!
+ * Les cadres encore actifs sont dépilés comme s'ils retournaient.
+ *
+ * \param prof le profileur
+ * \param icount nombre total d'instructions exécutées
+ */
+void profile_finish(Profile *prof, uint64_t icount);
+
+//! Écriture du profil au format « folded stacks »
+/*!
+ * Une ligne par contexte d'appel : les adresses d'entrée séparées par des
+ * points-virgules, un espace et le nombre d'instructions exclusives. C'est le
+ * format d'entrée des outils de \e flame \e graph usuels (\c flamegraph.pl,
+ * \c speedscope, ...).
+ *
+ * \param prof le profileur
+ * \param out le fichier de sortie
+ */
+void profile_write_folded(Profile *prof, FILE *out);
+
+//! Affichage des statistiques par sous-programme
+/*!
+ * \param prof le profileur
+ * \param out le fichier de sortie
+ */
+void profile_print(Profile *prof, FILE *out);
+
+#endif
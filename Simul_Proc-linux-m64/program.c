@@ -0,0 +1,178 @@
+/***** program.c *****/
+#define _GNU_SOURCE
+#include "program.h"
+#include "image.h"
+#include "stackdepth.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+//! Taille arrondie à un nombre entier de pages
+static size_t round_pages(size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	return (size + page - 1) / page * page;
+}
+
+//! Le segment de données des machines est-il projeté en copie sur écriture ?
+static bool data_mapped(const Program *prog) {
+	return prog->_fd >= 0
+		&& prog->_datasize * sizeof(Word) >= PROGRAM_COW_PAGES * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+/*!
+ * Création d'un programme aux segments non initialisés, à remplir avant
+ * program_seal().
+ *
+ * Les segments sont rangés dans un fichier anonyme (\c memfd), le texte puis
+ * les données à partir d'une frontière de page, pour que les machines puissent
+ * projeter les données en copie sur écriture. Si le système ne le permet pas,
+ * une projection anonyme en tient lieu et les données sont toujours recopiées.
+ */
+static Program *program_create(unsigned textsize, unsigned datasize, unsigned dataend) {
+	Program *prog = checked_realloc(NULL, sizeof(Program), "le programme");
+	*prog = (Program) {._textsize = textsize, ._datasize = datasize, ._dataend = dataend, ._refs = 1};
+	prog->_textbytes = round_pages(textsize * sizeof(Instruction));
+	prog->_mapbytes = prog->_textbytes + round_pages(datasize * sizeof(Word));
+	if (prog->_mapbytes == 0)
+		prog->_mapbytes = round_pages(1);
+
+	prog->_fd = memfd_create("simul-program", MFD_CLOEXEC);
+	if (prog->_fd >= 0 && ftruncate(prog->_fd, prog->_mapbytes) != 0) {
+		close(prog->_fd);
+		prog->_fd = -1;
+	}
+	if (prog->_fd >= 0)
+		prog->_base = mmap(NULL, prog->_mapbytes, PROT_READ | PROT_WRITE, MAP_SHARED, prog->_fd, 0);
+	else
+		prog->_base = mmap(NULL, prog->_mapbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (prog->_base == MAP_FAILED) {
+		fprintf(stderr, "Erreur d'allocation mémoire pour le programme\n");
+		exit(1);
+	}
+	prog->_text = prog->_base;
+	prog->_data = (const Word *) ((char *) prog->_base + prog->_textbytes);
+	return prog;
+}
+
+//! Libération d'un programme (sans vérifier les références)
+static void program_destroy(Program *prog) {
+	munmap(prog->_base, prog->_mapbytes);
+	if (prog->_fd >= 0)
+		close(prog->_fd);
+	free(prog);
+}
+
+//! Fin du remplissage : analyse de la pile, puis segments en lecture seule
+static void program_seal(Program *prog) {
+	Machine mach;
+	load_program(&mach, prog->_textsize, (Instruction *) prog->_text,
+		     prog->_datasize, (Word *) prog->_data, prog->_dataend);
+	Stack_Report rep;
+	prog->_validation._stack_ok = stack_analysis(&mach, &rep);
+	prog->_validation._stack_depth = rep._depth;
+	prog->_validation._stack_where = rep._where;
+	prog->_validation._stack_capacity = rep._capacity;
+	stack_report_free(&rep);
+	mprotect(prog->_base, prog->_mapbytes, PROT_READ);
+}
+
+Program *program_new(unsigned textsize, const Instruction *text,
+                     unsigned datasize, const Word *data, unsigned dataend) {
+	Program *prog = program_create(textsize, datasize, dataend);
+	memcpy((Instruction *) prog->_text, text, textsize * sizeof(Instruction));
+	memcpy((Word *) prog->_data, data, datasize * sizeof(Word));
+	program_seal(prog);
+	return prog;
+}
+
+Program *program_load(Image_Reader *prd) {
+	Program *prog = program_create(prd->_textsize, prd->_datasize, prd->_dataend);
+	if (!image_read_text(prd, (Instruction *) prog->_text) || !image_read_data(prd, (Word *) prog->_data)) {
+		program_destroy(prog);
+		return NULL;
+	}
+	program_seal(prog);
+	return prog;
+}
+
+Program *program_read(const char *programfile) {
+	Image_Reader reader;
+	if (!image_open(&reader, programfile)) {
+		fprintf(stderr, "%s: %s\n", programfile, reader._error);
+		return NULL;
+	}
+	Program *prog = program_load(&reader);
+	if (prog == NULL)
+		fprintf(stderr, "%s: %s\n", programfile, reader._error);
+	image_close(&reader);
+	return prog;
+}
+
+Program *program_retain(Program *prog) {
+	__atomic_add_fetch(&prog->_refs, 1, __ATOMIC_RELAXED);
+	return prog;
+}
+
+void program_release(Program *prog) {
+	if (__atomic_sub_fetch(&prog->_refs, 1, __ATOMIC_ACQ_REL) == 0)
+		program_destroy(prog);
+}
+
+//! Projection privée (copie sur écriture) de l'image initiale des données
+static Word *map_data(Program *prog, void *addr) {
+	void *p = mmap(addr, prog->_mapbytes - prog->_textbytes, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | (addr != NULL ? MAP_FIXED : 0), prog->_fd, prog->_textbytes);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "Erreur d'allocation mémoire pour le programme\n");
+		exit(1);
+	}
+	return p;
+}
+
+void program_attach(Program *prog, Machine *pmach) {
+	Word *data;
+	if (data_mapped(prog))
+		data = map_data(prog, NULL);
+	else {
+		data = checked_realloc(NULL, prog->_datasize * sizeof(Word), "le programme");
+		memcpy(data, prog->_data, prog->_datasize * sizeof(Word));
+	}
+	load_program(pmach, prog->_textsize, (Instruction *) prog->_text, prog->_datasize, data, prog->_dataend);
+	pmach->_program = program_retain(prog);
+}
+
+void program_detach(Machine *pmach) {
+	Program *prog = pmach->_program;
+	if (data_mapped(prog))
+		munmap(pmach->_data, prog->_mapbytes - prog->_textbytes);
+	else
+		free(pmach->_data);
+	pmach->_text = NULL;
+	pmach->_data = NULL;
+	pmach->_program = NULL;
+	program_release(prog);
+}
+
+void program_reset(Machine *pmach) {
+	Program *prog = pmach->_program;
+	Word *data = pmach->_data;
+	// Nouvelle projection à la même adresse : les pages copiées sont abandonnées
+	if (data_mapped(prog))
+		map_data(prog, data);
+	else
+		memcpy(data, prog->_data, prog->_datasize * sizeof(Word));
+	// Crochets, accélérations et périphériques restent attachés (load_program() les oublie)
+	struct Hooks *hooks = pmach->_hooks;
+	struct Loops *loops = pmach->_loops;
+	struct Memo *memo = pmach->_memo;
+	struct Device *devices = pmach->_devices;
+	load_program(pmach, prog->_textsize, (Instruction *) prog->_text, prog->_datasize, data, prog->_dataend);
+	pmach->_program = prog;
+	pmach->_hooks = hooks;
+	pmach->_loops = loops;
+	pmach->_memo = memo;
+	pmach->_devices = devices;
+}
@@ -0,0 +1,120 @@
+#ifndef _PROGRAM_H_
+#define _PROGRAM_H_
+
+/*!
+ * \file program.h
+ * \brief Programme partagé en lecture seule par plusieurs machines.
+ *
+ * Un programme contient le segment de texte, l'image initiale du segment de
+ * données et les résultats des analyses faites une fois pour toutes au
+ * chargement (voir Image_Validation). Il est immuable : ses segments sont
+ * projetés en lecture seule, et toute écriture est une faute de l'hôte.
+ *
+ * Les machines s'y attachent (program_attach()) : elles partagent le segment
+ * de texte et ne reçoivent en propre que leurs registres et leur segment de
+ * données. Un petit segment de données est recopié ; au-delà de
+ * \c PROGRAM_COW_PAGES pages, il est projeté en copie sur écriture, de sorte
+ * que seules les pages écrites par la machine lui coûtent de la mémoire.
+ *
+ * Le programme est compté par références : chaque machine attachée en tient
+ * une, et il est libéré au dernier program_release(). Les compteurs sont
+ * atomiques : des threads différents peuvent attacher et détacher leurs
+ * machines du même programme.
+ */
+
+#include <stdbool.h>
+
+#include "machine.h"
+#include "imgcache.h"
+#include "image.h"
+
+//! Taille (en pages) à partir de laquelle le segment de données est projeté en copie sur écriture
+#define PROGRAM_COW_PAGES 4
+
+//! Programme partagé
+typedef struct Program
+{
+    unsigned _textsize;		//!< Taille du segment de texte
+    unsigned _datasize;		//!< Taille du segment de données
+    unsigned _dataend;		//!< Première adresse libre après les données statiques
+    const Instruction *_text;	//!< Segment de texte (lecture seule)
+    const Word *_data;		//!< Image initiale du segment de données (lecture seule)
+    Image_Validation _validation; //!< Analyse de la pile (voir stack_analysis())
+
+    int _fd;			//!< Fichier anonyme contenant les segments, ou -1
+    void *_base;		//!< Projection des segments
+    size_t _textbytes;		//!< Taille de la partie texte de la projection (pages entières)
+    size_t _mapbytes;		//!< Taille de la projection
+    unsigned _refs;		//!< Nombre de références
+} Program;
+
+//! Création d'un programme à partir de ses segments (recopiés)
+/*!
+ * \param textsize taille du segment de texte
+ * \param text le segment de texte
+ * \param datasize taille du segment de données
+ * \param data l'image initiale du segment de données
+ * \param dataend première adresse libre après les données statiques
+ * \return le programme, avec une référence
+ */
+Program *program_new(unsigned textsize, const Instruction *text,
+                     unsigned datasize, const Word *data, unsigned dataend);
+
+//! Lecture d'un programme depuis un fichier binaire (voir read_program())
+/*!
+ * Les segments sont lus directement dans la projection partagée.
+ *
+ * \param programfile le nom du fichier binaire
+ * \return le programme, avec une référence, ou NULL (avec un message) si le
+ * fichier est illisible ou n'est pas une image valide
+ */
+Program *program_read(const char *programfile);
+
+//! Lecture d'un programme depuis une image ouverte (voir image.h)
+/*!
+ * \param prd le lecteur, qui reste ouvert
+ * \return le programme, avec une référence, ou NULL (\c _error renseigné)
+ */
+Program *program_load(Image_Reader *prd);
+
+//! Nouvelle référence au programme
+/*!
+ * \return \a prog
+ */
+Program *program_retain(Program *prog);
+
+//! Abandon d'une référence ; le programme est libéré à la dernière
+void program_release(Program *prog);
+
+//! Attachement d'une machine au programme
+/*!
+ * La machine est initialisée comme par load_program() : elle pointe sur le
+ * segment de texte partagé et reçoit un segment de données privé, initialisé
+ * avec l'image du programme. Elle tient une référence au programme jusqu'à
+ * program_detach().
+ *
+ * \param prog le programme
+ * \param pmach la machine (sans programme attaché)
+ */
+void program_attach(Program *prog, Machine *pmach);
+
+//! Détachement d'une machine de son programme
+/*!
+ * Le segment de données privé est libéré et la référence abandonnée.
+ *
+ * \param pmach la machine, attachée par program_attach()
+ */
+void program_detach(Machine *pmach);
+
+//! Remise d'une machine attachée dans son état initial
+/*!
+ * Les registres sont remis à zéro et le segment de données privé reprend
+ * l'image initiale ; le segment de texte reste partagé. Les crochets,
+ * l'accélération des boucles, la mémoïsation et les périphériques restent
+ * attachés à la machine.
+ *
+ * \param pmach la machine, attachée par program_attach()
+ */
+void program_reset(Machine *pmach);
+
+#endif
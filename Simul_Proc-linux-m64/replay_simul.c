@@ -0,0 +1,104 @@
+/*!
+ * \file replay_simul.c
+ * \brief Relecture d'une trace binaire (option \c -t de \c test_simul)
+ *
+ * L'état de la machine après un nombre donné d'instructions est reconstruit à
+ * partir de l'image clé la plus proche, sans réexécuter le programme. Les
+ * instructions suivantes peuvent ensuite être listées avec leurs écritures.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "machine.h"
+#include "btrace.h"
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: replay_simul [options] trace [position]\n"
+	       "where options are:\n"
+	       "\t-n n\tList the n instructions following the position\n"
+	       "\t-h\tprint this help message\n"
+	       "Without position, the final state is displayed.\n");
+}
+
+/*!
+ * Affichage d'un enregistrement : numéro, instruction et écritures.
+ */
+static void print_record(const Btrace_Record *prec) {
+	printf("#%llu 0x%04x: ", (unsigned long long) prec->_index, prec->_pc);
+	if (prec->_known)
+		print_instruction(prec->_instr, prec->_pc);
+	else
+		printf("???");
+	for (unsigned i = 0; i < prec->_nwrites; i++) {
+		const Btrace_Write *pw = &prec->_writes[i];
+		printf(i == 0 ? "\t" : ", ");
+		if (pw->_mem)
+			printf("[0x%04x]", pw->_index);
+		else if (pw->_index == BTRACE_CC)
+			printf("CC");
+		else
+			printf("R%02u", pw->_index);
+		printf(" = 0x%08x", pw->_value);
+	}
+	printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+	uint64_t count = 0;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt != 'n' || iarg + 1 >= argc) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		count = strtoull(argv[++iarg], NULL, 10);
+	}
+	if (iarg >= argc) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	Btrace_Reader rd;
+	if (!btrace_reader_open(&rd, argv[iarg])) {
+		fprintf(stderr, "Not a valid binary trace: %s\n", argv[iarg]);
+		return EXIT_FAILURE;
+	}
+	if (rd._complete)
+		printf("%llu instructions, %u keyframes\n", (unsigned long long) rd._records, rd._nkeys);
+	else
+		printf("Interrupted trace (no index): sequential replay\n");
+
+	uint64_t pos = iarg + 1 < argc ? strtoull(argv[iarg + 1], NULL, 10) : UINT64_MAX;
+	if (pos == UINT64_MAX && rd._complete)
+		pos = rd._records;
+	if (!btrace_seek(&rd, pos) && pos != UINT64_MAX) {
+		fprintf(stderr, "Trace shorter than %llu instructions (%llu)\n",
+			(unsigned long long) pos, (unsigned long long) rd._current);
+		btrace_reader_close(&rd);
+		return EXIT_FAILURE;
+	}
+
+	printf("\n*** Machine state after %llu instructions ***\n", (unsigned long long) rd._current);
+	print_cpu(&rd._mach);
+	print_data(&rd._mach);
+
+	if (count > 0) {
+		printf("\n*** Following instructions ***\n\n");
+		Btrace_Record rec;
+		for (uint64_t i = 0; i < count && btrace_next(&rd, &rec); i++)
+			print_record(&rec);
+	}
+
+	btrace_reader_close(&rd);
+	return EXIT_SUCCESS;
+}
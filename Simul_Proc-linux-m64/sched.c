@@ -0,0 +1,89 @@
+/***** sched.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "sched.h"
+#include "error.h"
+#include "telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void sched_init(Scheduler *ps, unsigned quantum) {
+	memset(ps, 0, sizeof(*ps));
+	ps->_quantum = quantum > 0 ? quantum : SCHED_QUANTUM;
+}
+
+/*!
+ * Agrandissement des tableaux des tâches et de la file. La file est remise à
+ * plat (tête en 0) dans le nouveau tableau.
+ */
+static void sched_grow(Scheduler *ps) {
+	unsigned max = ps->_maxtasks > 0 ? 2 * ps->_maxtasks : 64;
+	Sched_Task *tasks = checked_realloc(ps->_tasks, max * sizeof(Sched_Task), "l'ordonnanceur");
+	unsigned *queue = checked_realloc(NULL, max * sizeof(unsigned), "l'ordonnanceur");
+	for (unsigned i = 0; i < ps->_ready; i++)
+		queue[i] = ps->_queue[(ps->_head + i) % ps->_maxtasks];
+	free(ps->_queue);
+	ps->_tasks = tasks;
+	ps->_queue = queue;
+	ps->_head = 0;
+	ps->_maxtasks = max;
+}
+
+unsigned sched_add(Scheduler *ps, Machine *pmach, uint64_t budget, uint64_t timeout) {
+	if (ps->_ntasks == ps->_maxtasks)
+		sched_grow(ps);
+	unsigned id = ps->_ntasks++;
+	ps->_tasks[id] = (Sched_Task) {
+		._mach = pmach,
+		._budget = budget,
+		._deadline = timeout > 0 ? telemetry_now_ns() + timeout : 0,
+		._start = pmach->_icount,
+		._state = TASK_READY,
+		._err = ERR_NOERROR,
+	};
+	ps->_queue[(ps->_head + ps->_ready++) % ps->_maxtasks] = id;
+	return id;
+}
+
+bool sched_step(Scheduler *ps) {
+	if (ps->_ready == 0)
+		return false;
+	unsigned id = ps->_queue[ps->_head];
+	ps->_head = (ps->_head + 1) % ps->_maxtasks;
+	ps->_ready--;
+	Sched_Task *pt = &ps->_tasks[id];
+
+	// Le quantum est raccourci pour ne pas dépasser le budget
+	uint64_t used = pt->_mach->_icount - pt->_start;
+	uint64_t slice = pt->_budget - used < ps->_quantum ? pt->_budget - used : ps->_quantum;
+	Run_Status status = simul_run(pt->_mach, slice, &pt->_err, &pt->_addr);
+	pt->_slices++;
+	ps->_slices++;
+
+	if (status == RUN_HALT)
+		pt->_state = TASK_HALT;
+	else if (status == RUN_ERROR)
+		pt->_state = TASK_ERROR;
+	else if (pt->_mach->_icount - pt->_start >= pt->_budget)
+		pt->_state = TASK_BUDGET;
+	else if (pt->_deadline != 0 && telemetry_now_ns() >= pt->_deadline)
+		pt->_state = TASK_DEADLINE;
+	else
+		ps->_queue[(ps->_head + ps->_ready++) % ps->_maxtasks] = id;
+	return true;
+}
+
+void sched_run(Scheduler *ps) {
+	while (sched_step(ps))
+		;
+}
+
+const Sched_Task *sched_task(const Scheduler *ps, unsigned id) {
+	return &ps->_tasks[id];
+}
+
+void sched_free(Scheduler *ps) {
+	free(ps->_tasks);
+	free(ps->_queue);
+	memset(ps, 0, sizeof(*ps));
+}
@@ -0,0 +1,102 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+/*!
+ * \file sched.h
+ * \brief Ordonnancement coopératif de nombreuses machines sur un seul thread.
+ *
+ * L'ordonnanceur garde une file circulaire de tâches prêtes ; chaque tâche est
+ * une machine (déjà chargée) et ses limites. La tâche en tête de file exécute
+ * au plus un \e quantum d'instructions par simul_run(), puis repasse en queue
+ * si elle n'est pas terminée. Changer de tâche revient à changer de pointeur
+ * de machine : des milliers de machines se partagent équitablement le thread.
+ *
+ * Une tâche se termine par \c HALT, par une erreur d'exécution, quand elle a
+ * épuisé son budget d'instructions, ou quand son échéance (temps réel) est
+ * passée ; l'échéance n'est vérifiée qu'entre deux quanta. Une boucle infinie
+ * du programme simulé ne bloque donc plus l'appelant.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Quantum par défaut (en instructions)
+#define SCHED_QUANTUM 1000
+
+//! État d'une tâche
+typedef enum
+{
+    TASK_READY = 0,		//!< Dans la file des tâches prêtes
+    TASK_HALT,			//!< Le programme a exécuté \c HALT
+    TASK_ERROR,			//!< Le programme a provoqué une erreur d'exécution
+    TASK_BUDGET,		//!< Le budget d'instructions est épuisé
+    TASK_DEADLINE,		//!< L'échéance est passée
+} Task_State;
+
+//! Une tâche : une machine et ses limites
+typedef struct
+{
+    Machine *_mach;		//!< La machine (qui appartient à l'appelant)
+    uint64_t _budget;		//!< Budget d'instructions (UINT64_MAX : aucun)
+    uint64_t _deadline;		//!< Échéance en ns d'horloge monotone (0 : aucune)
+    uint64_t _start;		//!< Compteur d'instructions de la machine à l'ajout
+    uint64_t _slices;		//!< Nombre de quanta exécutés
+    Task_State _state;		//!< État
+    Error _err;			//!< Erreur (si \c TASK_ERROR)
+    unsigned _addr;		//!< Adresse de l'erreur (si \c TASK_ERROR)
+} Sched_Task;
+
+//! Ordonnanceur
+typedef struct
+{
+    unsigned _quantum;		//!< Nombre maximal d'instructions par quantum
+    Sched_Task *_tasks;		//!< Les tâches, par numéro d'ajout
+    unsigned _ntasks;		//!< Nombre de tâches
+    unsigned _maxtasks;		//!< Capacité de \c _tasks et \c _queue
+    unsigned *_queue;		//!< File circulaire des numéros des tâches prêtes
+    unsigned _head;		//!< Tête de la file
+    unsigned _ready;		//!< Nombre de tâches prêtes
+    uint64_t _slices;		//!< Nombre total de quanta exécutés
+} Scheduler;
+
+//! Initialisation d'un ordonnanceur vide
+/*!
+ * \param ps l'ordonnanceur
+ * \param quantum nombre maximal d'instructions par quantum (0 : \c SCHED_QUANTUM)
+ */
+void sched_init(Scheduler *ps, unsigned quantum);
+
+//! Ajout d'une tâche en queue de file
+/*!
+ * \param ps l'ordonnanceur
+ * \param pmach la machine, prête à s'exécuter ; elle doit rester valide
+ * jusqu'à sched_free()
+ * \param budget nombre maximal d'instructions à exécuter (UINT64_MAX : aucun)
+ * \param timeout délai en nanosecondes à partir de maintenant (0 : aucun)
+ * \return le numéro de la tâche (voir sched_task())
+ */
+unsigned sched_add(Scheduler *ps, Machine *pmach, uint64_t budget, uint64_t timeout);
+
+//! Exécution d'un quantum de la tâche en tête de file
+/*!
+ * \param ps l'ordonnanceur
+ * \return faux s'il n'y avait plus de tâche prête
+ */
+bool sched_step(Scheduler *ps);
+
+//! Exécution jusqu'à ce que toutes les tâches soient terminées
+void sched_run(Scheduler *ps);
+
+//! Accès à une tâche
+/*!
+ * \param ps l'ordonnanceur
+ * \param id le numéro de la tâche, rendu par sched_add()
+ */
+const Sched_Task *sched_task(const Scheduler *ps, unsigned id);
+
+//! Libération d'un ordonnanceur (les machines ne sont pas libérées)
+void sched_free(Scheduler *ps);
+
+#endif
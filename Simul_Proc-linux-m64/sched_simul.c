@@ -0,0 +1,122 @@
+/*!
+ * \file sched_simul.c
+ * \brief Exécution de nombreuses machines par l'ordonnanceur coopératif
+ *
+ * Chaque fichier binaire de la ligne de commande (format de read_program())
+ * est chargé une fois en programme partagé (voir program.h) et exécuté par
+ * \c -c machines qui s'y attachent. Toutes les machines sont ordonnancées sur
+ * le thread principal (voir sched.h), avec un quantum, un budget et un délai
+ * communs. Les machines qui ne se terminent pas par \c HALT sont listées
+ * (toutes avec \c -v), suivies d'un bilan.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "machine.h"
+#include "program.h"
+#include "sched.h"
+#include "telemetry.h"
+
+//! Noms des états des tâches
+static const char *state_names[] = {"ready", "halt", "error", "budget", "deadline"};
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: sched_simul [options] prog.bin...\n"
+	       "where options are:\n"
+	       "\t-c n\t\tMachines per program (default: 1)\n"
+	       "\t-q n\t\tInstructions per time slice (default: %u)\n"
+	       "\t-n n\t\tInstruction budget per machine (default: none)\n"
+	       "\t-t ms\t\tWall-clock timeout per machine (default: none)\n"
+	       "\t-v\t\tList every machine, not only the unfinished ones\n"
+	       "\t-h\t\tprint this help message\n", SCHED_QUANTUM);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned copies = 1, quantum = SCHED_QUANTUM;
+	uint64_t budget = UINT64_MAX, timeout = 0;
+	bool verbose = false;
+
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; iarg++) {
+		char opt = argv[iarg][1];
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (opt == 'v') {
+			verbose = true;
+			continue;
+		}
+		if (iarg + 1 >= argc || strchr("cqnt", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 'c': copies = strtoul(val, NULL, 10); break;
+			case 'q': quantum = strtoul(val, NULL, 10); break;
+			case 'n': budget = strtoull(val, NULL, 10); break;
+			case 't': timeout = strtoull(val, NULL, 10) * 1000000; break;
+		}
+	}
+	if (iarg >= argc || copies == 0) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	unsigned nprogs = argc - iarg;
+	unsigned nmach = nprogs * copies;
+	Machine *machs = malloc(nmach * sizeof(Machine));
+	if (machs == NULL) {
+		fprintf(stderr, "Erreur d'allocation mémoire\n");
+		return EXIT_FAILURE;
+	}
+	Scheduler sched;
+	sched_init(&sched, quantum);
+	for (unsigned p = 0; p < nprogs; p++) {
+		Program *prog = program_read(argv[iarg + p]);
+		if (prog == NULL)
+			return EXIT_FAILURE;
+		for (unsigned k = 0; k < copies; k++) {
+			program_attach(prog, &machs[p * copies + k]);
+			sched_add(&sched, &machs[p * copies + k], budget, timeout);
+		}
+		program_release(prog);	// Les machines tiennent leurs références
+	}
+
+	double t0 = telemetry_now_ns() * 1e-9;
+	sched_run(&sched);
+	double elapsed = telemetry_now_ns() * 1e-9 - t0;
+
+	unsigned count[TASK_DEADLINE + 1] = {0};
+	uint64_t icount = 0;
+	for (unsigned id = 0; id < nmach; id++) {
+		const Sched_Task *pt = sched_task(&sched, id);
+		uint64_t used = pt->_mach->_icount - pt->_start;
+		count[pt->_state]++;
+		icount += used;
+		if (!verbose && pt->_state == TASK_HALT)
+			continue;
+		printf("%s[%u]: %s", argv[iarg + id / copies], id % copies, state_names[pt->_state]);
+		if (pt->_state == TASK_ERROR)
+			printf(" (error %d at 0x%04x)", pt->_err, pt->_addr);
+		printf(", %llu instructions, %llu slices\n",
+		       (unsigned long long) used, (unsigned long long) pt->_slices);
+	}
+	printf("%u machine(s): %u halted, %u errors, %u out of budget, %u past deadline\n",
+	       nmach, count[TASK_HALT], count[TASK_ERROR], count[TASK_BUDGET], count[TASK_DEADLINE]);
+	printf("%llu instructions in %llu slices, %.3f s\n",
+	       (unsigned long long) icount, (unsigned long long) sched._slices, elapsed);
+
+	for (unsigned i = 0; i < nmach; i++)
+		program_detach(&machs[i]);
+	free(machs);
+	sched_free(&sched);
+	return count[TASK_HALT] == nmach ? EXIT_SUCCESS : EXIT_FAILURE;
+}
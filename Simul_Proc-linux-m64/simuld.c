@@ -0,0 +1,596 @@
+/*!
+ * \file simuld.c
+ * \brief Serveur de simulation sur socket locale
+ *
+ * Le serveur écoute sur une socket du domaine Unix et exécute des programmes à
+ * la demande, sans rien afficher : ni sauvegarde \c dump.bin, ni listing, ni
+ * trace. Les images (format de read_program()) restent chargées en mémoire
+ * d'une requête à l'autre sous forme de programmes partagés (voir
+ * program.h) : seul le segment de données est recopié pour chaque exécution,
+ * le segment de texte, en lecture seule, est partagé.
+ *
+ * Chaque connexion est servie par un thread de la réserve ; plusieurs
+ * connexions s'exécutent donc en parallèle. Sur une connexion, chaque ligne
+ * est une requête et reçoit une ligne de réponse (un objet JSON) :
+ *
+ *   - <tt>run file=CHEMIN [budget=N] [set=ADR:VAL]... [dump=ADR:NB]</tt> :
+ *   exécute le fichier binaire. Il n'est relu que s'il a changé (même
+ *   périphérique, inode, taille et date de modification) ;
+ *
+ *   - <tt>run image=HEX ...</tt> : idem pour une image fournie en ligne, sous
+ *   forme du contenu hexadécimal du fichier binaire (par exemple
+ *   <tt>xxd -p -c 0</tt>). Elle est conservée sous son hachage ;
+ *
+ *   - \c stats : nombre d'images résidentes, de requêtes et d'instructions.
+ *
+ * \c set modifie une case du segment de données initial avant l'exécution (au
+ * plus \c DAEMON_MAXSETS par requête),
+ * \c dump demande le contenu final de \c NB cases à partir de \c ADR. La
+ * réponse à \c run donne l'issue (\c halt, \c error, \c budget), le code et
+ * l'adresse de l'erreur, le nombre d'instructions exécutées, le compteur
+ * ordinal, le code condition, les registres et la durée de la requête.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "machine.h"
+#include "error.h"
+#include "imgcache.h"
+#include "image.h"
+#include "program.h"
+#include "telemetry.h"
+
+//! Budget d'instructions par défaut d'une requête
+#define DAEMON_BUDGET 10000000ULL
+
+//! Nombre maximal d'images résidentes
+#define DAEMON_MAXIMAGES 1024
+
+//! Nombre de listes de la table des images (puissance de 2)
+#define DAEMON_BUCKETS 256
+
+//! Nombre maximal de threads
+#define DAEMON_MAXTHREADS 256
+
+//! Nombre maximal de cases modifiées par une requête
+#define DAEMON_MAXSETS 256
+
+//! Une image résidente
+typedef struct Resident
+{
+    char *_key;			//!< Chemin du fichier, ou "#hachage" pour une image en ligne
+    uint64_t _hash;		//!< Hachage de la clé
+    struct stat _st;		//!< Identité du fichier au chargement
+    Program *_program;		//!< Programme (texte partagé par les exécutions, données initiales)
+    unsigned _refs;		//!< Exécutions en cours
+    bool _stale;		//!< Retirée de la table (libérée au dernier déréférencement)
+    uint64_t _used;		//!< Date de dernière utilisation (numéro de requête)
+    struct Resident *_next;	//!< Suivante dans la même liste
+} Resident;
+
+// Paramètres
+static uint64_t max_budget = UINT64_MAX;
+static const char *sockpath = "simul.sock";
+
+// Images résidentes
+static pthread_mutex_t images_lock = PTHREAD_MUTEX_INITIALIZER;
+static Resident *images[DAEMON_BUCKETS];
+static unsigned nimages = 0;
+
+// Statistiques
+static uint64_t nrequests = 0;
+static uint64_t ninstructions = 0;
+
+// Connexions en attente d'un thread
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static int *queue = NULL;
+static unsigned queue_head = 0, queue_len = 0, queue_max = 0;
+
+/*======================================
+ *
+ *		IMAGES RÉSIDENTES
+ *======================================
+ */
+
+static void resident_free(Resident *pr) {
+	free(pr->_key);
+	if (pr->_program != NULL)
+		program_release(pr->_program);
+	free(pr);
+}
+
+/*!
+ * Construction d'une image à partir d'une image ouverte (voir image.h), qui
+ * est refermée. Au contraire de read_program(), une image invalide est
+ * refusée sans arrêter le serveur.
+ *
+ * \return l'image (non insérée), ou NULL si le contenu est invalide
+ */
+static Resident *resident_load(Image_Reader *prd) {
+	// Version 1 : taille exacte exigée (pas de mots manquants)
+	if (prd->_version == 1 && (prd->_size != (3 + prd->_textsize + prd->_datasize) * sizeof(uint32_t)
+				   || prd->_dataend > prd->_datasize)) {
+		image_close(prd);
+		return NULL;
+	}
+
+	Program *prog = program_load(prd);
+	image_close(prd);
+	if (prog == NULL)
+		return NULL;
+	Resident *pr = checked_realloc(NULL, sizeof(Resident), "le serveur");
+	memset(pr, 0, sizeof(*pr));
+	pr->_program = prog;
+	return pr;
+}
+
+/*!
+ * Construction d'une image à partir du contenu d'un fichier binaire.
+ */
+static Resident *resident_parse(const unsigned char *buf, size_t size) {
+	Image_Reader reader;
+	return image_open_buffer(&reader, buf, size) ? resident_load(&reader) : NULL;
+}
+
+/*!
+ * Lecture d'un fichier binaire en image, section par section.
+ */
+static Resident *resident_read(const char *file, struct stat *pst) {
+	Image_Reader reader;
+	if (!image_open(&reader, file))
+		return NULL;
+	if (fstat(reader._fd, pst) != 0) {
+		image_close(&reader);
+		return NULL;
+	}
+	return resident_load(&reader);
+}
+
+/*!
+ * Recherche d'une image dans la table (verrou tenu).
+ */
+static Resident *resident_find(const char *key, uint64_t hash) {
+	for (Resident *pr = images[hash & (DAEMON_BUCKETS - 1)]; pr != NULL; pr = pr->_next)
+		if (pr->_hash == hash && strcmp(pr->_key, key) == 0)
+			return pr;
+	return NULL;
+}
+
+/*!
+ * Retrait d'une image de la table (verrou tenu). Elle est libérée tout de
+ * suite si aucune exécution ne l'utilise, au dernier resident_release() sinon.
+ */
+static void resident_remove(Resident *pr) {
+	Resident **pp = &images[pr->_hash & (DAEMON_BUCKETS - 1)];
+	while (*pp != pr)
+		pp = &(*pp)->_next;
+	*pp = pr->_next;
+	nimages--;
+	pr->_stale = true;
+	if (pr->_refs == 0)
+		resident_free(pr);
+}
+
+/*!
+ * Insertion d'une image dans la table (verrou tenu). Si la table est pleine,
+ * l'image inutilisée depuis le plus longtemps est retirée.
+ */
+static void resident_insert(Resident *pr) {
+	if (nimages >= DAEMON_MAXIMAGES) {
+		Resident *oldest = NULL;
+		for (unsigned b = 0; b < DAEMON_BUCKETS; b++)
+			for (Resident *p = images[b]; p != NULL; p = p->_next)
+				if (oldest == NULL || p->_used < oldest->_used)
+					oldest = p;
+		resident_remove(oldest);
+	}
+	Resident **pb = &images[pr->_hash & (DAEMON_BUCKETS - 1)];
+	pr->_next = *pb;
+	*pb = pr;
+	nimages++;
+}
+
+/*!
+ * Image résidente d'un fichier binaire, relue si le fichier a changé.
+ *
+ * \return l'image, référencée (voir resident_release()), ou NULL
+ */
+static Resident *resident_file(const char *file, uint64_t now) {
+	struct stat st;
+	if (stat(file, &st) != 0)
+		return NULL;
+	uint64_t hash = cache_hash(file, strlen(file));
+
+	pthread_mutex_lock(&images_lock);
+	Resident *pr = resident_find(file, hash);
+	if (pr != NULL && pr->_st.st_dev == st.st_dev && pr->_st.st_ino == st.st_ino
+	    && pr->_st.st_size == st.st_size && pr->_st.st_mtim.tv_sec == st.st_mtim.tv_sec
+	    && pr->_st.st_mtim.tv_nsec == st.st_mtim.tv_nsec) {
+		pr->_refs++;
+		pr->_used = now;
+		pthread_mutex_unlock(&images_lock);
+		return pr;
+	}
+	pthread_mutex_unlock(&images_lock);
+
+	// Lecture hors verrou ; une autre requête a pu charger le fichier entre-temps
+	Resident *fresh = resident_read(file, &st);
+	if (fresh == NULL)
+		return NULL;
+	fresh->_key = strdup(file);
+	fresh->_hash = hash;
+	fresh->_st = st;
+	fresh->_refs = 1;
+	fresh->_used = now;
+
+	pthread_mutex_lock(&images_lock);
+	pr = resident_find(file, hash);
+	if (pr != NULL)
+		resident_remove(pr);
+	resident_insert(fresh);
+	pthread_mutex_unlock(&images_lock);
+	return fresh;
+}
+
+/*!
+ * Image résidente d'un contenu fourni en ligne (hexadécimal).
+ *
+ * \return l'image, référencée (voir resident_release()), ou NULL
+ */
+static Resident *resident_inline(const char *hex, uint64_t now) {
+	size_t len = strlen(hex);
+	if (len % 2 != 0)
+		return NULL;
+	unsigned char *buf = checked_realloc(NULL, len / 2, "le serveur");
+	for (size_t i = 0; i < len / 2; i++) {
+		unsigned v;
+		if (sscanf(hex + 2 * i, "%2x", &v) != 1) {
+			free(buf);
+			return NULL;
+		}
+		buf[i] = v;
+	}
+
+	char key[32];
+	uint64_t content = cache_hash(buf, len / 2);
+	snprintf(key, sizeof(key), "#%016llx", (unsigned long long) content);
+	uint64_t hash = cache_hash(key, strlen(key));
+
+	pthread_mutex_lock(&images_lock);
+	Resident *pr = resident_find(key, hash);
+	if (pr != NULL) {
+		pr->_refs++;
+		pr->_used = now;
+		pthread_mutex_unlock(&images_lock);
+		free(buf);
+		return pr;
+	}
+	pthread_mutex_unlock(&images_lock);
+
+	pr = resident_parse(buf, len / 2);
+	free(buf);
+	if (pr == NULL)
+		return NULL;
+	pr->_key = strdup(key);
+	pr->_hash = hash;
+	pr->_refs = 1;
+	pr->_used = now;
+
+	pthread_mutex_lock(&images_lock);
+	Resident *other = resident_find(key, hash);
+	if (other != NULL)
+		resident_remove(other);
+	resident_insert(pr);
+	pthread_mutex_unlock(&images_lock);
+	return pr;
+}
+
+/*!
+ * Fin d'utilisation d'une image par une exécution.
+ */
+static void resident_release(Resident *pr) {
+	pthread_mutex_lock(&images_lock);
+	if (--pr->_refs == 0 && pr->_stale)
+		resident_free(pr);
+	pthread_mutex_unlock(&images_lock);
+}
+
+/*======================================
+ *
+ *		REQUÊTES
+ *======================================
+ */
+
+//! Données propres à un thread
+typedef struct
+{
+    Word *_data;		//!< Segment de données de l'exécution en cours
+    unsigned _datamax;		//!< Taille allouée
+} Worker;
+
+/*!
+ * Réponse d'erreur à une requête mal formée.
+ */
+static void reply_invalid(FILE *out, const char *msg) {
+	fprintf(out, "{\"status\":\"invalid\",\"message\":\"%s\"}\n", msg);
+}
+
+/*!
+ * Exécution d'une requête \c run (\a args : la suite de la ligne).
+ */
+static void request_run(Worker *pw, char *args, FILE *out) {
+	uint64_t t0 = telemetry_now_ns();
+	uint64_t now = __atomic_add_fetch(&nrequests, 1, __ATOMIC_RELAXED);
+
+	const char *file = NULL, *hex = NULL;
+	uint64_t budget = DAEMON_BUDGET;
+	unsigned sets[DAEMON_MAXSETS][2];
+	unsigned nsets = 0, dumpaddr = 0, dumpcount = 0;
+
+	char *save = NULL;
+	for (char *tok = strtok_r(args, " \t", &save); tok != NULL; tok = strtok_r(NULL, " \t", &save)) {
+		char *val = strchr(tok, '=');
+		if (val == NULL) {
+			reply_invalid(out, "argument without value");
+			return;
+		}
+		*val++ = '\0';
+		char *end = NULL;
+		if (strcmp(tok, "file") == 0)
+			file = val;
+		else if (strcmp(tok, "image") == 0)
+			hex = val;
+		else if (strcmp(tok, "budget") == 0)
+			budget = strtoull(val, &end, 0);
+		else if (strcmp(tok, "set") == 0) {
+			if (nsets == DAEMON_MAXSETS) {
+				reply_invalid(out, "too many set= overrides");
+				return;
+			}
+			sets[nsets][0] = strtoul(val, &end, 0);
+			if (end == val || *end != ':') {	// La valeur est obligatoire
+				reply_invalid(out, "malformed number");
+				return;
+			}
+			val = end + 1;	// Vérifiée comme les autres nombres
+			sets[nsets][1] = strtol(val, &end, 0);
+			nsets++;
+		} else if (strcmp(tok, "dump") == 0) {
+			dumpaddr = strtoul(val, &end, 0);
+			if (*end == ':')
+				dumpcount = strtoul(end + 1, &end, 0);
+		} else {
+			reply_invalid(out, "unknown argument");
+			return;
+		}
+		if (end != NULL && (*end != '\0' || end == val)) {
+			reply_invalid(out, "malformed number");
+			return;
+		}
+	}
+	if ((file == NULL) == (hex == NULL)) {
+		reply_invalid(out, "exactly one of file= and image= is required");
+		return;
+	}
+	if (budget > max_budget)
+		budget = max_budget;
+
+	Resident *pr = file != NULL ? resident_file(file, now) : resident_inline(hex, now);
+	if (pr == NULL) {
+		reply_invalid(out, "cannot load image");
+		return;
+	}
+	const Program *prog = pr->_program;
+	for (unsigned i = 0; i < nsets; i++)
+		if (sets[i][0] >= prog->_datasize) {
+			resident_release(pr);
+			reply_invalid(out, "set address outside the data segment");
+			return;
+		}
+	if (dumpaddr > prog->_datasize || dumpcount > prog->_datasize - dumpaddr) {
+		resident_release(pr);
+		reply_invalid(out, "dump range outside the data segment");
+		return;
+	}
+
+	// Copie privée des données ; le texte est partagé (jamais modifié)
+	if (prog->_datasize > pw->_datamax) {
+		pw->_datamax = prog->_datasize;
+		pw->_data = checked_realloc(pw->_data, pw->_datamax * sizeof(Word), "le serveur");
+	}
+	memcpy(pw->_data, prog->_data, prog->_datasize * sizeof(Word));
+	for (unsigned i = 0; i < nsets; i++)
+		pw->_data[sets[i][0]] = sets[i][1];
+
+	Machine mach;
+	load_program(&mach, prog->_textsize, (Instruction *) prog->_text, prog->_datasize, pw->_data, prog->_dataend);
+	Error err = ERR_NOERROR;
+	unsigned addr = 0;
+	Run_Status status = simul_run(&mach, budget, &err, &addr);
+	resident_release(pr);
+	__atomic_add_fetch(&ninstructions, mach._icount, __ATOMIC_RELAXED);
+
+	static const char *status_names[] = {"halt", "error", "budget"};
+	static const char cc_names[] = "UZPN";
+	fprintf(out, "{\"status\":\"%s\",\"error\":%d,\"addr\":%u,\"icount\":%llu,\"pc\":%u,\"cc\":\"%c\",\"registers\":[",
+		status_names[status], status == RUN_ERROR ? err : ERR_NOERROR,
+		status == RUN_ERROR ? addr : 0, (unsigned long long) mach._icount, mach._pc,
+		cc_names[mach._cc <= LAST_CC ? mach._cc : CC_U]);
+	for (int r = 0; r < NREGISTERS; r++)
+		fprintf(out, r ? ",%d" : "%d", mach._registers[r]);
+	fprintf(out, "]");
+	if (dumpcount > 0) {
+		fprintf(out, ",\"data\":[");
+		for (unsigned i = 0; i < dumpcount; i++)
+			fprintf(out, i ? ",%d" : "%d", pw->_data[dumpaddr + i]);
+		fprintf(out, "]");
+	}
+	fprintf(out, ",\"ns\":%llu}\n", (unsigned long long) (telemetry_now_ns() - t0));
+}
+
+/*!
+ * Service d'une connexion : une réponse par ligne reçue.
+ */
+static void serve(Worker *pw, int fd) {
+	int fdout = dup(fd);
+	FILE *in = fdopen(fd, "r");
+	FILE *out = fdopen(fdout, "w");
+	if (in == NULL || out == NULL) {
+		if (in != NULL) fclose(in); else close(fd);
+		if (out != NULL) fclose(out); else if (fdout >= 0) close(fdout);
+		return;
+	}
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while ((len = getline(&line, &size, in)) > 0) {
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		char *args = line + strcspn(line, " \t");
+		if (*args != '\0')
+			*args++ = '\0';
+
+		if (strcmp(line, "run") == 0)
+			request_run(pw, args, out);
+		else if (strcmp(line, "stats") == 0) {
+			pthread_mutex_lock(&images_lock);
+			unsigned n = nimages;
+			pthread_mutex_unlock(&images_lock);
+			fprintf(out, "{\"images\":%u,\"requests\":%llu,\"instructions\":%llu}\n", n,
+				(unsigned long long) __atomic_load_n(&nrequests, __ATOMIC_RELAXED),
+				(unsigned long long) __atomic_load_n(&ninstructions, __ATOMIC_RELAXED));
+		} else if (line[0] != '\0')
+			reply_invalid(out, "unknown request");
+		if (fflush(out) != 0)
+			break;
+	}
+	free(line);
+	fclose(in);
+	fclose(out);
+}
+
+/*!
+ * Boucle d'un thread de la réserve : une connexion à la fois.
+ */
+static void *worker_main(void *arg) {
+	Worker w = {NULL, 0};
+	(void) arg;
+	for (;;) {
+		pthread_mutex_lock(&queue_lock);
+		while (queue_head == queue_len)
+			pthread_cond_wait(&queue_cond, &queue_lock);
+		int fd = queue[queue_head++];
+		if (queue_head == queue_len)
+			queue_head = queue_len = 0;
+		pthread_mutex_unlock(&queue_lock);
+		serve(&w, fd);
+	}
+	return NULL;
+}
+
+/*!
+ * Fin du serveur sur signal : la socket est retirée du système de fichiers.
+ */
+static void on_terminate(int sig) {
+	unlink(sockpath);
+	_exit(128 + sig);
+}
+
+//! Message d'aide
+static void usage(void) {
+	printf("Usage: simuld [options]\n"
+	       "where options are:\n"
+	       "\t-s path\tSocket path (default: simul.sock)\n"
+	       "\t-j n\tNumber of worker threads (default: number of cores)\n"
+	       "\t-n n\tMaximum instruction budget per request (default: none)\n"
+	       "\t-h\tprint this help message\n");
+}
+
+int main(int argc, char *argv[]) {
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (int iarg = 1; iarg < argc; iarg++) {
+		char opt = argv[iarg][0] == '-' ? argv[iarg][1] : '\0';
+		if (opt == 'h') {
+			usage();
+			return EXIT_SUCCESS;
+		}
+		if (iarg + 1 >= argc || strchr("sjn", opt) == NULL) {
+			fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+			usage();
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++iarg];
+		switch (opt) {
+			case 's': sockpath = val; break;
+			case 'j': nthreads = atol(val); break;
+			case 'n': max_budget = strtoull(val, NULL, 10); break;
+		}
+	}
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > DAEMON_MAXTHREADS)
+		nthreads = DAEMON_MAXTHREADS;
+
+	struct sockaddr_un sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sun_family = AF_UNIX;
+	if (strlen(sockpath) >= sizeof(sa.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n", sockpath);
+		return EXIT_FAILURE;
+	}
+	strcpy(sa.sun_path, sockpath);
+	int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(sockpath);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *) &sa, sizeof(sa)) != 0 || listen(lfd, 64) != 0) {
+		fprintf(stderr, "Cannot listen on %s: %s\n", sockpath, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, on_terminate);
+	signal(SIGTERM, on_terminate);
+
+	for (long t = 0; t < nthreads; t++) {
+		pthread_t th;
+		if (pthread_create(&th, NULL, worker_main, NULL) != 0) {
+			fprintf(stderr, "Cannot create worker thread\n");
+			return EXIT_FAILURE;
+		}
+		pthread_detach(th);
+	}
+	printf("simuld: listening on %s (%ld workers)\n", sockpath, nthreads);
+	fflush(stdout);
+
+	for (;;) {
+		int fd = accept(lfd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "accept: %s\n", strerror(errno));
+			continue;
+		}
+		pthread_mutex_lock(&queue_lock);
+		if (queue_len == queue_max) {
+			queue_max = queue_max ? 2 * queue_max : 64;
+			queue = checked_realloc(queue, queue_max * sizeof(int), "le serveur");
+		}
+		queue[queue_len++] = fd;
+		pthread_cond_signal(&queue_cond);
+		pthread_mutex_unlock(&queue_lock);
+	}
+}
@@ -0,0 +1,261 @@
+/***** stackdepth.c *****/
+#include "stackdepth.h"
+#include "error.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+//! État de l'analyse d'un sous-programme
+enum { SUB_NONE = 0, SUB_BUSY, SUB_DONE };
+
+//! Élément de la liste de travail : une adresse et la profondeur avant l'instruction
+typedef struct
+{
+    unsigned _pc;
+    int _depth;
+} Work;
+
+//! Contexte de l'analyse
+typedef struct
+{
+    Machine *pmach;
+    Stack_Report *prep;
+    unsigned char *state;	//!< État de l'analyse, par adresse d'entrée
+    unsigned *sub;		//!< Indice dans prep->_subs, par adresse d'entrée
+    unsigned *stamp;		//!< Numéro du parcours qui a visité chaque adresse
+    int *local;			//!< Profondeur relevée lors de ce parcours
+    unsigned nstamp;		//!< Numéro du dernier parcours
+    unsigned maxsubs;		//!< Nombre de sous-programmes alloués
+} Analysis;
+
+/*!
+ * Analyse d'un sous-programme (et, récursivement, de ses appelés).
+ *
+ * \param pa le contexte de l'analyse
+ * \param entry l'adresse d'entrée du sous-programme
+ * \param pwhere adresse de l'instruction qui atteint la profondeur maximale
+ * (ou qui la rend inconnue)
+ * \return la profondeur maximale, ou \c STACK_UNBOUNDED
+ */
+static unsigned analyse_sub(Analysis *pa, unsigned entry, unsigned *pwhere) {
+	Machine *pmach = pa->pmach;
+	Stack_Report *prep = pa->prep;
+
+	if (pa->state[entry] == SUB_BUSY) { // Récursion
+		*pwhere = entry;
+		return STACK_UNBOUNDED;
+	}
+	if (pa->state[entry] == SUB_DONE) {
+		*pwhere = prep->_subs[pa->sub[entry]]._where;
+		return prep->_subs[pa->sub[entry]]._depth;
+	}
+
+	pa->state[entry] = SUB_BUSY;
+	if (prep->_nsubs == pa->maxsubs) {
+		pa->maxsubs *= 2;
+		prep->_subs = checked_realloc(prep->_subs, pa->maxsubs * sizeof(Stack_Sub), "l'analyse de pile");
+	}
+	unsigned isub = prep->_nsubs++;
+	pa->sub[entry] = isub;
+
+	unsigned stamp = ++pa->nstamp;
+	unsigned maxwork = 16, nwork = 0;
+	Work *work = checked_realloc(NULL, maxwork * sizeof(Work), "l'analyse de pile");
+	work[nwork++] = (Work){entry, 0};
+
+	unsigned maxdepth = 0;
+	unsigned where = entry;
+	bool bounded = true;
+
+	while (bounded && nwork > 0) {
+		Work w = work[--nwork];
+		unsigned pc = w._pc;
+		int depth = w._depth;
+
+		if (pc >= pmach->_textsize) // ERR_SEGTEXT à l'exécution
+			continue;
+		if (pa->stamp[pc] == stamp) {
+			if (pa->local[pc] != depth) { // Boucle qui empile ou dépile
+				bounded = false;
+				where = pc;
+			}
+			continue;
+		}
+		pa->stamp[pc] = stamp;
+		pa->local[pc] = depth;
+		if (prep->_offset[pc] == INT_MIN)
+			prep->_offset[pc] = depth;
+		if (depth > 0 && (unsigned) depth > maxdepth) {
+			maxdepth = depth;
+			where = pc;
+		}
+
+		// Successeurs : au plus deux par instruction
+		Instruction instr = pmach->_text[pc];
+		Work next[2];
+		int nnext = 0;
+		switch (instr.instr_generic._cop) {
+			case PUSH:
+				if (depth + 1 > 0 && (unsigned) (depth + 1) > maxdepth) {
+					maxdepth = depth + 1;
+					where = pc;
+				}
+				next[nnext++] = (Work){pc + 1, depth + 1};
+				break;
+			case POP:
+				next[nnext++] = (Work){pc + 1, depth - 1};
+				break;
+			case LOAD:
+			case ADD:
+			case SUB:
+				if (instr.instr_generic._regcond == NREGISTERS - 1) {
+					if (instr.instr_generic._cop == LOAD || !instr.instr_generic._immediate) {
+						bounded = false;
+						where = pc;
+						break;
+					}
+					int delta = instr.instr_immediate._value;
+					// La pile croît vers les adresses basses
+					depth += instr.instr_generic._cop == ADD ? -delta : delta;
+					if (depth > 0 && (unsigned) depth > maxdepth) {
+						maxdepth = depth;
+						where = pc;
+					}
+				}
+				next[nnext++] = (Work){pc + 1, depth};
+				break;
+			case MUL:
+			case DIV:
+			case MOD:
+			case AND:
+			case OR:
+			case XOR:
+			case SHL:
+			case SHR:
+				// Pointeur de pile calculé : profondeur inconnue
+				if (instr.instr_generic._regcond == NREGISTERS - 1) {
+					bounded = false;
+					where = pc;
+					break;
+				}
+				next[nnext++] = (Work){pc + 1, depth};
+				break;
+			case CALL: {
+				unsigned target = instr.instr_absolute._address;
+				if (target < pmach->_textsize) {
+					unsigned callee_where;
+					unsigned callee = analyse_sub(pa, target, &callee_where);
+					if (callee == STACK_UNBOUNDED) {
+						bounded = false;
+						where = pc;
+						break;
+					}
+					long total = (long) depth + 1 + callee;
+					if (total > 0 && (unsigned long) total > maxdepth) {
+						maxdepth = total;
+						where = callee_where;
+					}
+				}
+				next[nnext++] = (Work){pc + 1, depth};
+				break;
+			}
+			case BRANCH:
+				if (instr.instr_generic._regcond != NC)
+					next[nnext++] = (Work){pc + 1, depth};
+				next[nnext++] = (Work){instr.instr_absolute._address, depth};
+				break;
+			case RET:
+			case HALT:
+			case ILLOP:
+				break;
+			case NOP:
+			case STORE:
+			case MOVE:
+			case FILL:
+				next[nnext++] = (Work){pc + 1, depth};
+				break;
+			default: // ERR_UNKNOWN à l'exécution
+				break;
+		}
+
+		if (nwork + nnext > maxwork) {
+			maxwork *= 2;
+			work = checked_realloc(work, maxwork * sizeof(Work), "l'analyse de pile");
+		}
+		for (int i = 0; i < nnext; i++)
+			work[nwork++] = next[i];
+	}
+	free(work);
+
+	Stack_Sub *psub = &prep->_subs[isub];
+	psub->_addr = entry;
+	psub->_depth = bounded ? maxdepth : STACK_UNBOUNDED;
+	psub->_where = where;
+	pa->state[entry] = SUB_DONE;
+
+	*pwhere = where;
+	return psub->_depth;
+}
+
+bool stack_analysis(Machine *pmach, Stack_Report *prep) {
+	unsigned textsize = pmach->_textsize;
+
+	prep->_capacity = pmach->_datasize > pmach->_dataend ? pmach->_datasize - pmach->_dataend - 1 : 0;
+	prep->_nsubs = 0;
+	prep->_subs = checked_realloc(NULL, 8 * sizeof(Stack_Sub), "l'analyse de pile");
+	prep->_offset = checked_realloc(NULL, textsize * sizeof(int), "l'analyse de pile");
+	for (unsigned i = 0; i < textsize; i++)
+		prep->_offset[i] = INT_MIN;
+	prep->_depth = 0;
+	prep->_where = 0;
+
+	if (textsize == 0)
+		return true;
+
+	Analysis a = {
+		.pmach = pmach,
+		.prep = prep,
+		.state = checked_realloc(NULL, textsize, "l'analyse de pile"),
+		.sub = checked_realloc(NULL, textsize * sizeof(unsigned), "l'analyse de pile"),
+		.stamp = checked_realloc(NULL, textsize * sizeof(unsigned), "l'analyse de pile"),
+		.local = checked_realloc(NULL, textsize * sizeof(int), "l'analyse de pile"),
+		.nstamp = 0,
+		.maxsubs = 8,
+	};
+	for (unsigned i = 0; i < textsize; i++) {
+		a.state[i] = SUB_NONE;
+		a.stamp[i] = 0;
+	}
+
+	prep->_depth = analyse_sub(&a, 0, &prep->_where);
+
+	free(a.state);
+	free(a.sub);
+	free(a.stamp);
+	free(a.local);
+
+	return prep->_depth != STACK_UNBOUNDED && prep->_depth <= prep->_capacity;
+}
+
+void stack_report_print(Stack_Report *prep, FILE *out) {
+	fprintf(out, "\n*** STACK (capacity: %u words) ***\n", prep->_capacity);
+	for (unsigned i = 0; i < prep->_nsubs; i++) {
+		Stack_Sub *psub = &prep->_subs[i];
+		if (psub->_depth == STACK_UNBOUNDED)
+			fprintf(out, "0x%04x: unbounded (at 0x%04x)\n", psub->_addr, psub->_where);
+		else
+			fprintf(out, "0x%04x: %u words (at 0x%04x)\n", psub->_addr, psub->_depth, psub->_where);
+	}
+	if (prep->_depth == STACK_UNBOUNDED)
+		fprintf(out, "Program: unbounded (at 0x%04x)\n", prep->_where);
+	else
+		fprintf(out, "Program: %u words%s\n", prep->_depth,
+			prep->_depth > prep->_capacity ? " -- OVERFLOW" : "");
+}
+
+void stack_report_free(Stack_Report *prep) {
+	free(prep->_subs);
+	free(prep->_offset);
+	prep->_subs = NULL;
+	prep->_offset = NULL;
+	prep->_nsubs = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef _STACKDEPTH_H_
+#define _STACKDEPTH_H_
+
+/*!
+ * \file stackdepth.h
+ * \brief Analyse statique de la profondeur maximale de pile.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <limits.h>
+
+#include "machine.h"
+
+//! Profondeur inconnue ou non bornée (récursion, boucle déséquilibrée, \c R15 calculé...)
+#define STACK_UNBOUNDED UINT_MAX
+
+//! Résultat de l'analyse pour un sous-programme
+typedef struct
+{
+    unsigned _addr;		//!< Adresse d'entrée du sous-programme
+    unsigned _depth;		//!< Profondeur maximale (en mots), appelés compris
+    unsigned _where;		//!< Adresse de l'instruction qui atteint cette profondeur
+} Stack_Sub;
+
+//! Résultat de l'analyse de pile d'un programme
+/*!
+ * Les profondeurs sont comptées en mots à partir du sommet de pile à l'entrée
+ * du sous-programme (l'adresse de retour empilée par \c CALL est comptée chez
+ * l'appelant). Le programme principal est le sous-programme d'adresse 0.
+ */
+typedef struct
+{
+    Stack_Sub *_subs;		//!< Sous-programmes, par ordre de découverte (0 en premier)
+    unsigned _nsubs;		//!< Nombre de sous-programmes
+    unsigned _depth;		//!< Profondeur maximale du programme complet
+    unsigned _where;		//!< Adresse de l'instruction qui atteint cette profondeur
+    unsigned _capacity;		//!< Nombre de mots empilables sans erreur \c ERR_SEGSTACK
+
+    //! Profondeur de pile avant chaque instruction, relative à l'entrée de son sous-programme
+    /*!
+     * Tableau de \c _textsize entiers ; \c INT_MIN pour les instructions non
+     * atteintes ou dont la profondeur n'est pas connue.
+     */
+    int *_offset;
+} Stack_Report;
+
+//! Analyse de la profondeur de pile du programme chargé dans une machine
+/*!
+ * On parcourt le graphe de flot de contrôle du segment de texte depuis
+ * l'adresse 0 en suivant \c PUSH, \c POP, \c CALL, \c RET, les branchements
+ * et les ajustements explicites \c ADD \c R15, \c #n et \c SUB \c R15, \c #n.
+ * Toute autre modification de \c R15 rend la profondeur inconnue.
+ *
+ * \param pmach la machine (le programme doit être chargé)
+ * \param prep le rapport à remplir (à libérer par stack_report_free())
+ * \return vrai si la pile est assurée de suffire, faux sinon
+ */
+bool stack_analysis(Machine *pmach, Stack_Report *prep);
+
+//! Affichage du rapport d'analyse de pile
+/*!
+ * \param prep le rapport
+ * \param out le fichier de sortie
+ */
+void stack_report_print(Stack_Report *prep, FILE *out);
+
+//! Libération du rapport d'analyse de pile
+/*!
+ * \param prep le rapport
+ */
+void stack_report_free(Stack_Report *prep);
+
+#endif
@@ -0,0 +1,87 @@
+/***** telemetry.c *****/
+#define _POSIX_C_SOURCE 200809L
+#include "telemetry.h"
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+//! Noms des phases dans le bilan
+static const char *phase_names[TELEMETRY_NPHASES] = {
+	"load", "dump", "listing", "analysis", "setup", "exec", "report",
+};
+
+uint64_t telemetry_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+void telemetry_init(Telemetry *pt) {
+	memset(pt, 0, sizeof(*pt));
+	pt->_phase = -1;
+	pt->_origin = telemetry_now_ns();
+}
+
+void telemetry_begin(Telemetry *pt, Telemetry_Phase phase) {
+	uint64_t t = telemetry_now_ns();
+	if (pt->_phase >= 0)
+		pt->_ns[pt->_phase] += t - pt->_since;
+	pt->_phase = phase;
+	pt->_since = t;
+}
+
+void telemetry_end(Telemetry *pt) {
+	if (pt->_phase < 0)
+		return;
+	pt->_ns[pt->_phase] += telemetry_now_ns() - pt->_since;
+	pt->_phase = -1;
+}
+
+double telemetry_seconds(const Telemetry *pt, Telemetry_Phase phase) {
+	uint64_t ns = pt->_ns[phase];
+	if (pt->_phase == (int) phase)
+		ns += telemetry_now_ns() - pt->_since;
+	return ns * 1e-9;
+}
+
+double telemetry_total(const Telemetry *pt) {
+	return (telemetry_now_ns() - pt->_origin) * 1e-9;
+}
+
+uint64_t telemetry_peak_rss(void) {
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+	return ru.ru_maxrss; // Kio sous Linux
+}
+
+//! Écriture d'une chaîne JSON (guillemets compris)
+static void write_string(const char *s, FILE *out) {
+	fputc('"', out);
+	for (; *s != '\0'; s++) {
+		unsigned char c = *s;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+void telemetry_write_json(const Telemetry *pt, const char *image, uint64_t instructions,
+                          bool complete, FILE *out) {
+	fprintf(out, "{\"image\":");
+	if (image != NULL)
+		write_string(image, out);
+	else
+		fprintf(out, "null");
+	fprintf(out, ",\"complete\":%s,\"phases\":{", complete ? "true" : "false");
+	for (int p = 0; p < TELEMETRY_NPHASES; p++)
+		fprintf(out, "%s\"%s\":%.6f", p > 0 ? "," : "", phase_names[p], telemetry_seconds(pt, p));
+	double exec = telemetry_seconds(pt, TELEMETRY_EXEC);
+	fprintf(out, "},\"total\":%.6f,\"instructions\":%llu,\"ips\":%.0f,\"peak_rss_kb\":%llu}\n",
+		telemetry_total(pt), (unsigned long long) instructions,
+		exec > 0 ? instructions / exec : 0.0, (unsigned long long) telemetry_peak_rss());
+}
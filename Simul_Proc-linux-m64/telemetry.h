@@ -0,0 +1,79 @@
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+/*!
+ * \file telemetry.h
+ * \brief Mesure du temps passé par le simulateur dans chacune de ses phases.
+ *
+ * Une mesure découpe la vie du simulateur en phases successives (chargement,
+ * dump, listing, analyse, préparation, exécution, état final), chronométrées
+ * à l'horloge monotone de l'hôte. Commencer une phase termine la précédente ;
+ * une phase peut être reprise, ses durées s'additionnent. Le bilan, une ligne
+ * JSON, ajoute le nombre d'instructions exécutées par la machine simulée, le
+ * débit (instructions par seconde d'exécution) et la mémoire résidente
+ * maximale du processus.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//! Phases mesurées (noms du bilan entre parenthèses)
+typedef enum
+{
+    TELEMETRY_LOAD = 0,		//!< Lecture du programme (\c load)
+    TELEMETRY_DUMP,		//!< Sauvegarde dump.bin et affichage hexadécimal (\c dump)
+    TELEMETRY_LISTING,		//!< Affichage de l'état initial (\c listing)
+    TELEMETRY_ANALYSIS,		//!< Analyse statique de la pile (\c analysis)
+    TELEMETRY_SETUP,		//!< Instrumentation, accélérations, périphériques (\c setup)
+    TELEMETRY_EXEC,		//!< Exécution du programme (\c exec)
+    TELEMETRY_REPORT,		//!< Bilans et affichage de l'état final (\c report)
+    TELEMETRY_NPHASES,		//!< Nombre de phases
+} Telemetry_Phase;
+
+//! Une mesure
+typedef struct
+{
+    uint64_t _origin;		//!< Début de la mesure (ns d'horloge monotone)
+    uint64_t _ns[TELEMETRY_NPHASES];//!< Durée cumulée de chaque phase (ns)
+    int _phase;			//!< Phase en cours (-1 : aucune)
+    uint64_t _since;		//!< Début de la phase en cours (ns)
+} Telemetry;
+
+//! Horloge monotone de l'hôte, en nanosecondes
+uint64_t telemetry_now_ns(void);
+
+//! Début d'une mesure, sans phase en cours
+void telemetry_init(Telemetry *pt);
+
+//! Début (ou reprise) d'une phase ; la phase en cours est terminée
+void telemetry_begin(Telemetry *pt, Telemetry_Phase phase);
+
+//! Fin de la phase en cours (sans effet s'il n'y en a pas)
+void telemetry_end(Telemetry *pt);
+
+//! Durée cumulée d'une phase en secondes, y compris si elle est en cours
+double telemetry_seconds(const Telemetry *pt, Telemetry_Phase phase);
+
+//! Durée totale de la mesure en secondes
+double telemetry_total(const Telemetry *pt);
+
+//! Mémoire résidente maximale du processus, en Kio (0 si inconnue)
+uint64_t telemetry_peak_rss(void);
+
+//! Écriture du bilan sur une ligne JSON
+/*!
+ * Les champs sont \c image, \c complete, \c phases (secondes par phase),
+ * \c total (secondes), \c instructions, \c ips (instructions par seconde
+ * d'exécution, 0 sans exécution) et \c peak_rss_kb.
+ *
+ * \param pt la mesure
+ * \param image le nom du programme mesuré (NULL : programme interne)
+ * \param instructions nombre d'instructions exécutées par la machine
+ * \param complete le simulateur est-il allé jusqu'au bout (sans erreur) ?
+ * \param out la destination
+ */
+void telemetry_write_json(const Telemetry *pt, const char *image, uint64_t instructions,
+                          bool complete, FILE *out);
+
+#endif
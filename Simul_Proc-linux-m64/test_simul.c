@@ -5,9 +5,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include "machine.h"
 #include "debug.h"
+#include "profile.h"
+#include "stackdepth.h"
+#include "imgcache.h"
+#include "btrace.h"
+#include "loops.h"
+#include "memo.h"
+#include "devices.h"
+#include "gdbstub.h"
+#include "telemetry.h"
+#include "printer.h"
+#include "error.h"
 
 //! Segment de texte
 extern Instruction text[];
@@ -24,6 +37,100 @@ extern const unsigned dataend;
 //! Taille utile du segment de données
 extern const unsigned datasize;  
 
+//! Console du programme simulé (option -o)
+static Console console;
+
+//! Vidage de la console, y compris quand une erreur termine le simulateur
+static void flush_console(void)
+{
+    console_flush(&console);
+}
+
+//! Mesure des phases du simulateur (option -T)
+static Telemetry telemetry;
+
+//! Fichier du bilan de la mesure (NULL : pas de mesure)
+static const char *telemetry_file = NULL;
+
+//! Programme mesuré (NULL : programme interne)
+static const char *telemetry_image = NULL;
+
+//! Machine simulée, pour son compteur d'instructions
+static Machine *telemetry_mach = NULL;
+
+//! Le simulateur est-il allé jusqu'au bout ?
+static bool telemetry_complete = false;
+
+//! Ajout du bilan de la mesure au fichier, une seule fois, y compris sur erreur fatale
+static void write_telemetry(void)
+{
+    if (telemetry_file == NULL)
+        return;
+    telemetry_end(&telemetry);
+    FILE *out = strcmp(telemetry_file, "-") == 0 ? stdout : fopen(telemetry_file, "a");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Cannot open telemetry file %s\n", telemetry_file);
+        return;
+    }
+    telemetry_write_json(&telemetry, telemetry_image,
+                         telemetry_mach != NULL ? telemetry_mach->_icount : 0, telemetry_complete, out);
+    if (out != stdout)
+        fclose(out);
+    telemetry_file = NULL;
+}
+
+//! Profil des appels (option -p ; NULL : pas de profil ou déjà écrit)
+static Profile *profile = NULL;
+
+//! Fichier du profil
+static const char *profile_file = NULL;
+
+//! Machine profilée
+static Machine *profile_mach = NULL;
+
+//! Écriture et affichage du profil, une seule fois, y compris quand une erreur termine le simulateur
+static void write_profile(void)
+{
+    if (profile == NULL)
+        return;
+    Profile *prof = profile;
+    profile = NULL;
+    profile_detach(prof, profile_mach);
+    profile_finish(prof, profile_mach->_icount);
+    FILE *out = fopen(profile_file, "w");
+    if (out == NULL)
+        fprintf(stderr, "Cannot open profile file %s\n", profile_file);
+    else
+    {
+        profile_write_folded(prof, out);
+        fclose(out);
+    }
+    profile_print(prof, stdout);
+    profile_free(prof);
+}
+
+//! Lecture d'une plage d'adresses "début:fin" (fin exclue ; chacune peut manquer)
+static void parse_range(const char *arg, unsigned *pfrom, unsigned *pto)
+{
+    char *end;
+    *pfrom = 0;
+    *pto = UINT_MAX;
+    if (*arg != ':')
+        *pfrom = strtoul(arg, &end, 0);
+    else
+        end = (char *) arg;
+    if (*end == ':' && end[1] != '\0')
+        *pto = strtoul(end + 1, &end, 0);
+    else if (*end == ':')
+        end++;
+    if (*end != '\0' || *pfrom > *pto)
+    {
+        fprintf(stderr, "Bad address range: %s (expected from:to)\n", arg);
+        exit(EXIT_FAILURE);
+    }
+}
+
 //! Help message.
 /*!
  * Printed with option \c -h.
@@ -35,6 +142,21 @@ static void usage()
            "\t-d\tDebug mode (interactive execution)\n"
            "\t-b\tA binary file is provided\n"
            "\t-l\tDo not execute; just display the listing\n"
+           "\t-p file\tProfile calls; write folded stacks into file\n"
+           "\t-s\tReject the program if its stack may overflow\n"
+           "\t-c dir\tLoad the binary file through the image cache in dir\n"
+           "\t-t file\tWrite a compact binary trace into file (see replay_simul)\n"
+           "\t-f\tFast-forward counted loops (see loops.h)\n"
+           "\t-m\tMemoize pure subroutines (see memo.h)\n"
+           "\t-z\tCompress the dump.bin image\n"
+           "\t-o file\tMap the console and the counter; console output into file (- for stdout)\n"
+           "\t-i file\tMap the input port, reading integers from file (see devices.h)\n"
+           "\t-g addr\tServe a GDB remote debugger on a TCP port or a Unix socket path\n"
+           "\t-T file\tAppend phase timings and throughput as a JSON line to file (- for stdout)\n"
+           "\t-r a:b\tDisplay only the data words from a to b (excluded)\n"
+           "\t-R a:b\tDisplay only the instructions from a to b (excluded)\n"
+           "\t-e\tElide runs of zero lines in the listings\n"
+           "\t-x\tCompact listings: words in hexadecimal only\n"
            "\t-h\tprint this help message\n"
            "If -b is given, the next argument must be a file name containing\n"
            "a valid program in binary format. Otherwise an internally defined\n"
@@ -49,10 +171,59 @@ static void usage()
  * <dl>
  *   <dt>-d</dt><dd>mode pas à pas (mise au point)</dd>
  *
- *   <dt>-f</dt><dd>le programme est dans un fichier binaire ; le nom de ce
+ *   <dt>-b</dt><dd>le programme est dans un fichier binaire ; le nom de ce
  *   fichier doit être fourni également en paramètre de la ligne de
  *   commande ; sans cette option, on exécute un programme de test prédéfini.</dd>
  *
+ *   <dt>-s</dt><dd>refuse d'exécuter le programme si l'analyse statique ne
+ *   garantit pas que la pile suffit.</dd>
+ *
+ *   <dt>-c répertoire</dt><dd>avec \c -b, le fichier binaire est chargé au
+ *   travers du cache d'images de ce répertoire.</dd>
+ *
+ *   <dt>-p fichier</dt><dd>profilage par graphe d'appel ; le profil est écrit
+ *   dans le fichier au format « folded stacks » (flame graph).</dd>
+ *
+ *   <dt>-t fichier</dt><dd>trace binaire compacte de l'exécution dans le
+ *   fichier (relue par \c replay_simul) au lieu de la trace textuelle.</dd>
+ *
+ *   <dt>-f</dt><dd>accélération des boucles comptées : leurs itérations sont
+ *   exécutées d'un coup (une seule ligne de trace).</dd>
+ *
+ *   <dt>-m</dt><dd>mémoïsation des sous-programmes purs : un appel déjà vu
+ *   avec les mêmes arguments n'est pas exécuté (une seule ligne de trace).</dd>
+ *
+ *   <dt>-z</dt><dd>le dump binaire \c dump.bin est compressé.</dd>
+ *
+ *   <dt>-o fichier</dt><dd>projection de la console et du compteur
+ *   d'instructions (voir devices.h) ; la console écrit dans le fichier (\c -
+ *   pour la sortie standard).</dd>
+ *
+ *   <dt>-i fichier</dt><dd>projection de l'entrée, qui lit les entiers du
+ *   fichier.</dd>
+ *
+ *   <dt>-g adresse</dt><dd>mise au point par un client du protocole distant
+ *   de GDB (voir gdbstub.h), sur un port TCP local (l'adresse n'a que des
+ *   chiffres) ou une socket Unix ; sans trace. Si le client se détache, la
+ *   suite de l'exécution est tracée normalement. Incompatible avec \c -d,
+ *   \c -f et \c -m.</dd>
+ *
+ *   <dt>-T fichier</dt><dd>mesure du temps passé dans chaque phase du
+ *   simulateur (voir telemetry.h) ; le bilan est ajouté au fichier (\c - :
+ *   sortie standard) sur une ligne JSON, même si une erreur termine le
+ *   simulateur.</dd>
+ *
+ *   <dt>-r début:fin</dt><dd>l'affichage du segment de données, avant et
+ *   après l'exécution, se limite aux adresses de \e début à \e fin (exclue ;
+ *   l'une ou l'autre peut manquer).</dd>
+ *
+ *   <dt>-R début:fin</dt><dd>même limite pour le listing du programme.</dd>
+ *
+ *   <dt>-e</dt><dd>dans les affichages, les lignes nulles consécutives sont
+ *   remplacées par une marque d'élision (voir printer.h).</dd>
+ *
+ *   <dt>-x</dt><dd>affichages compacts : mots en hexadécimal seulement.</dd>
+ *
  * </dl>
  */
 int main(int argc, char *argv[])
@@ -60,7 +231,20 @@ int main(int argc, char *argv[])
     bool debug = false;
     bool binfile = false;
     bool no_exec = false;
+    bool strict_stack = false;
     char *programfile = NULL;
+    char *profilefile = NULL;
+    char *cachedir = NULL;
+    char *tracefile = NULL;
+    bool fast_loops = false;
+    bool memoize = false;
+    bool compress = false;
+    char *consolefile = NULL;
+    char *inputfile = NULL;
+    char *gdbaddress = NULL;
+    unsigned data_from = 0, data_to = UINT_MAX;
+    unsigned text_from = 0, text_to = UINT_MAX;
+    unsigned print_flags = 0;
 
     if (argc > 1) 
     {
@@ -78,6 +262,95 @@ int main(int argc, char *argv[])
                  case 'l': 
                     no_exec = true;
                     break;
+                 case 's':
+                    strict_stack = true;
+                    break;
+                 case 'f':
+                    fast_loops = true;
+                    break;
+                 case 'm':
+                    memoize = true;
+                    break;
+                 case 'z':
+                    compress = true;
+                    break;
+                 case 'e':
+                    print_flags |= PRINT_ELIDE;
+                    break;
+                 case 'x':
+                    print_flags |= PRINT_HEX;
+                    break;
+                 case 'r':
+                 case 'R':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option %s requires an address range\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    if (argv[iarg][1] == 'r')
+                        parse_range(argv[++iarg], &data_from, &data_to);
+                    else
+                        parse_range(argv[++iarg], &text_from, &text_to);
+                    break;
+                 case 'c':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option -c requires a directory name\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    cachedir = argv[++iarg];
+                    break;
+                 case 'g':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option -g requires a port number or a socket path\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    gdbaddress = argv[++iarg];
+                    break;
+                 case 'T':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option -T requires a file name\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    telemetry_file = argv[++iarg];
+                    break;
+                 case 'o':
+                 case 'i':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option %s requires a file name\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    if (argv[iarg][1] == 'o')
+                        consolefile = argv[++iarg];
+                    else
+                        inputfile = argv[++iarg];
+                    break;
+                 case 'p':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option -p requires a file name\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    profilefile = argv[++iarg];
+                    break;
+                 case 't':
+                    if (iarg + 1 >= argc)
+                    {
+                        fprintf(stderr, "Option -t requires a file name\n");
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    tracefile = argv[++iarg];
+                    break;
                   case 'h':
                     usage();
                     exit(EXIT_SUCCESS);
@@ -93,30 +366,183 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (gdbaddress != NULL && (debug || fast_loops || memoize))
+    {
+        fprintf(stderr, "Option -g cannot be combined with -d, -f or -m\n");
+        exit(EXIT_FAILURE);
+    }
+
     Machine mach;
+    Image_Validation validation;
+    bool validated = false;
 
+    telemetry_init(&telemetry);
+    if (telemetry_file != NULL)
+    {
+        telemetry_image = binfile ? programfile : NULL;
+        telemetry_mach = &mach;
+        atexit(write_telemetry);
+    }
+
+    telemetry_begin(&telemetry, TELEMETRY_LOAD);
     if (!binfile) 
         load_program(&mach, textsize, text, datasize, data, dataend);
+    else if (cachedir != NULL)
+    {
+        cache_read_program(&mach, programfile, cachedir, &validation);
+        validated = true;
+    }
     else 
         read_program(&mach, programfile);   
 
+    telemetry_begin(&telemetry, TELEMETRY_DUMP);
     printf("\n*** Sauvegarde des programmes et données initiales en format binaire ***\n\n");
-    dump_memory(&mach);
+    if (compress)
+        dump_memory_compressed(&mach);
+    else
+        dump_memory(&mach);
 
+    telemetry_begin(&telemetry, TELEMETRY_LISTING);
     printf("\n*** Machine state before execution ***\n");
-    print_program(&mach);
-    print_data(&mach);
-    print_cpu(&mach);
+    print_program_range(&mach, text_from, text_to, print_flags, NULL, NULL);
+    print_data_range(&mach, data_from, data_to, print_flags);
+    print_cpu_flags(&mach, print_flags);
+
+    telemetry_begin(&telemetry, TELEMETRY_ANALYSIS);
+    if (!validated || !validation._stack_ok)
+    {
+        // Le cache ne garde que le verdict : le rapport est recalculé pour être affiché
+        Stack_Report stack;
+        bool stack_ok = stack_analysis(&mach, &stack);
+        if (!validated)
+        {
+            validation._stack_ok = stack_ok;
+            validation._stack_where = stack._where;
+        }
+        if (!stack_ok)
+            stack_report_print(&stack, stdout);
+        stack_report_free(&stack);
+    }
+    if (!validation._stack_ok)
+    {
+        if (strict_stack)
+            error(ERR_SEGSTACK, validation._stack_where);
+        warning(WARN_STACK, validation._stack_where);
+    }
 
     if (no_exec) 
+    {
+        telemetry_complete = true;
+        write_telemetry();
         return 0;
+    }
+
+    telemetry_begin(&telemetry, TELEMETRY_SETUP);
+    Btrace *bt = NULL;
+    if (profilefile != NULL)
+    {
+        profile = profile_new(mach._textsize);
+        profile_file = profilefile;
+        profile_mach = &mach;
+        profile_attach(profile, &mach);
+        atexit(write_profile);
+    }
+    if (tracefile != NULL)
+        bt = btrace_open(tracefile, &mach, 0);
+
+    if (fast_loops)
+        loops_enable(&mach);
+    if (memoize)
+        memo_enable(&mach);
+
+    Device counter;
+    Input input;
+    FILE *in = NULL, *out = NULL;
+    if (consolefile != NULL)
+    {
+        out = strcmp(consolefile, "-") == 0 ? stdout : fopen(consolefile, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Cannot open console file %s\n", consolefile);
+            exit(EXIT_FAILURE);
+        }
+        console_attach(&console, &mach, out);
+        counter_attach(&counter, &mach);
+        atexit(flush_console);
+    }
+    if (inputfile != NULL)
+    {
+        in = fopen(inputfile, "r");
+        if (in == NULL)
+        {
+            fprintf(stderr, "Cannot open input file %s\n", inputfile);
+            exit(EXIT_FAILURE);
+        }
+        input_attach(&input, &mach, in);
+    }
 
     printf("\n*** Execution trace ***\n\n");
-    simul(&mach, debug);
+    telemetry_begin(&telemetry, TELEMETRY_EXEC);
+    if (gdbaddress != NULL)
+    {
+        Error err;
+        unsigned addr;
+        switch (gdb_serve(&mach, gdbaddress, &err, &addr))
+        {
+        case GDB_DETACHED:
+            simul(&mach, false);
+            break;
+        case GDB_HALT:
+            warning(WARN_HALT, addr);
+            break;
+        case GDB_ERROR:
+            error(err, addr);
+        case GDB_KILLED:
+            printf("Program killed by the debugger at 0x%08x\n", mach._pc);
+            break;
+        }
+    }
+    else
+        simul(&mach, debug);
+    telemetry_begin(&telemetry, TELEMETRY_REPORT);
+
+    if (fast_loops)
+    {
+        printf("\n*** %u counted loop(s), %llu iteration(s) fast-forwarded ***\n",
+               mach._loops->_nloops, (unsigned long long) mach._loops->_forwarded);
+        loops_disable(&mach);
+    }
+    if (memoize)
+    {
+        printf("\n*** %u pure subroutine(s), %llu call(s) memoized, %llu executed ***\n",
+               mach._memo->_nsubs, (unsigned long long) mach._memo->_hits,
+               (unsigned long long) mach._memo->_misses);
+        memo_disable(&mach);
+    }
+
+    if (out != NULL)
+    {
+        console_detach(&console, &mach);
+        device_remove(&mach, &counter);
+        if (out != stdout)
+            fclose(out);
+    }
+    if (in != NULL)
+    {
+        input_detach(&input, &mach);
+        fclose(in);
+    }
+
+    if (bt != NULL)
+        btrace_close(bt);
+
+    write_profile();
 
     printf("\n*** Machine state after execution ***\n");
-    print_cpu(&mach);
-    print_data(&mach);
+    print_cpu_flags(&mach, print_flags);
+    print_data_range(&mach, data_from, data_to, print_flags);
 
+    telemetry_complete = true;
+    write_telemetry();
     return 0; 
 }